@@ -0,0 +1,71 @@
+# Profile-guided optimization（PGO）
+#
+# 手动分阶段构建:
+#   cmake -DRMDB_PGO=GENERATE ..   插桩构建，运行rmdb时把profile写到RMDB_PGO_PROFILE_DIR
+#   cmake -DRMDB_PGO=USE ..        用RMDB_PGO_PROFILE_DIR中的profile重新编译
+# 一键构建（在普通构建目录中）:
+#   make pgo        插桩构建 -> 运行test/tpcc_workload.py训练 -> -fprofile-use重新构建，输出bin/rmdb-pgo
+#   make pgo-bolt   在pgo的基础上再用llvm-bolt做链接后优化，输出bin/rmdb-pgo-bolt（需要安装llvm-bolt）
+# 两个阶段在同一个目录（${CMAKE_BINARY_DIR}/pgo）中构建，保证GCC按目标文件路径找到对应的profile
+
+set(RMDB_PGO "OFF" CACHE STRING "Profile guided optimization stage (OFF, GENERATE, USE)")
+set_property(CACHE RMDB_PGO PROPERTY STRINGS OFF GENERATE USE)
+set(RMDB_PGO_PROFILE_DIR "${CMAKE_BINARY_DIR}/pgo-profile" CACHE PATH "Directory of PGO profiles")
+option(RMDB_BOLT_RELOCS "Link with --emit-relocs so that the binary can be optimized by llvm-bolt" OFF)
+
+if(RMDB_PGO STREQUAL "GENERATE")
+    # rmdb是多线程的，计数器需要原子更新
+    add_compile_options(-fprofile-generate=${RMDB_PGO_PROFILE_DIR} -fprofile-update=atomic)
+    add_link_options(-fprofile-generate=${RMDB_PGO_PROFILE_DIR})
+elseif(RMDB_PGO STREQUAL "USE")
+    if(CMAKE_CXX_COMPILER_ID STREQUAL "Clang")
+        # clang的原始profile需要先用llvm-profdata合并
+        add_compile_options(-fprofile-use=${RMDB_PGO_PROFILE_DIR}/rmdb.profdata -Wno-profile-instr-unprofiled
+                            -Wno-profile-instr-out-of-date)
+        add_link_options(-fprofile-use=${RMDB_PGO_PROFILE_DIR}/rmdb.profdata)
+    else()
+        add_compile_options(-fprofile-use=${RMDB_PGO_PROFILE_DIR} -fprofile-correction -Wno-missing-profile)
+        add_link_options(-fprofile-use=${RMDB_PGO_PROFILE_DIR})
+    endif()
+elseif(NOT RMDB_PGO STREQUAL "OFF")
+    message(FATAL_ERROR "RMDB_PGO must be one of OFF, GENERATE, USE")
+endif()
+
+if(RMDB_BOLT_RELOCS)
+    add_link_options(-Wl,--emit-relocs)
+endif()
+
+# 一键构建的目标只在普通构建中提供
+if(RMDB_PGO STREQUAL "OFF")
+    find_package(Python3 COMPONENTS Interpreter)
+    find_program(RMDB_LLVM_BOLT llvm-bolt)
+    find_program(RMDB_LLVM_PROFDATA llvm-profdata)
+    set(RMDB_PGO_TRAINING_ARGS "--txns 5000" CACHE STRING "Arguments passed to test/tpcc_workload.py for PGO training")
+
+    set(RMDB_PGO_PIPELINE_ARGS
+        -DSOURCE_DIR=${CMAKE_SOURCE_DIR}
+        -DPGO_BUILD_DIR=${CMAKE_BINARY_DIR}/pgo
+        -DOUTPUT_DIR=${CMAKE_RUNTIME_OUTPUT_DIRECTORY}
+        -DGENERATOR=${CMAKE_GENERATOR}
+        -DCXX_COMPILER=${CMAKE_CXX_COMPILER}
+        -DCXX_COMPILER_ID=${CMAKE_CXX_COMPILER_ID}
+        -DC_COMPILER=${CMAKE_C_COMPILER}
+        -DFLEX_EXECUTABLE=${FLEX_EXECUTABLE}
+        -DBISON_EXECUTABLE=${BISON_EXECUTABLE}
+        -DPYTHON=${Python3_EXECUTABLE}
+        -DLLVM_PROFDATA=${RMDB_LLVM_PROFDATA}
+        "-DTRAINING_ARGS=${RMDB_PGO_TRAINING_ARGS}")
+    add_custom_target(pgo
+        COMMAND ${CMAKE_COMMAND} ${RMDB_PGO_PIPELINE_ARGS} -P ${CMAKE_SOURCE_DIR}/cmake/pgo_pipeline.cmake
+        USES_TERMINAL VERBATIM)
+    if(RMDB_LLVM_BOLT)
+        add_custom_target(pgo-bolt
+            COMMAND ${CMAKE_COMMAND} ${RMDB_PGO_PIPELINE_ARGS} -DLLVM_BOLT=${RMDB_LLVM_BOLT}
+                    -P ${CMAKE_SOURCE_DIR}/cmake/pgo_pipeline.cmake
+            USES_TERMINAL VERBATIM)
+    else()
+        add_custom_target(pgo-bolt
+            COMMAND ${CMAKE_COMMAND} -E echo "llvm-bolt not found, install it or set RMDB_LLVM_BOLT"
+            COMMAND ${CMAKE_COMMAND} -E false)
+    endif()
+endif()
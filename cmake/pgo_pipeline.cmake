@@ -0,0 +1,68 @@
+# PGO流水线，由pgo/pgo-bolt目标通过cmake -P调用，参数见cmake/pgo.cmake
+
+function(run)
+    execute_process(COMMAND ${ARGN} RESULT_VARIABLE result)
+    if(NOT result EQUAL 0)
+        string(REPLACE ";" " " command "${ARGN}")
+        message(FATAL_ERROR "[pgo] command failed: ${command}")
+    endif()
+endfunction()
+
+# 运行训练负载，exe为被训练的rmdb
+separate_arguments(TRAINING_ARGS UNIX_COMMAND "${TRAINING_ARGS}")
+function(train exe)
+    run(${PYTHON} ${SOURCE_DIR}/test/tpcc_workload.py --server ${exe} --workdir ${PGO_BUILD_DIR}/train
+        ${TRAINING_ARGS})
+endfunction()
+
+set(PROFILE_DIR ${PGO_BUILD_DIR}/profile)
+set(CONFIGURE_ARGS -G ${GENERATOR} -S ${SOURCE_DIR} -B ${PGO_BUILD_DIR} -DCMAKE_BUILD_TYPE=Release
+    -DCMAKE_CXX_COMPILER=${CXX_COMPILER} -DCMAKE_C_COMPILER=${C_COMPILER} -DRMDB_PGO_PROFILE_DIR=${PROFILE_DIR})
+if(FLEX_EXECUTABLE)
+    list(APPEND CONFIGURE_ARGS -DFLEX_EXECUTABLE=${FLEX_EXECUTABLE})
+endif()
+if(BISON_EXECUTABLE)
+    list(APPEND CONFIGURE_ARGS -DBISON_EXECUTABLE=${BISON_EXECUTABLE})
+endif()
+if(LLVM_BOLT)
+    list(APPEND CONFIGURE_ARGS -DRMDB_BOLT_RELOCS=ON)
+else()
+    list(APPEND CONFIGURE_ARGS -DRMDB_BOLT_RELOCS=OFF)
+endif()
+if(NOT PYTHON)
+    message(FATAL_ERROR "[pgo] python3 is required to run the training workload")
+endif()
+
+message(STATUS "[pgo] building instrumented rmdb")
+file(REMOVE_RECURSE ${PROFILE_DIR})
+run(${CMAKE_COMMAND} ${CONFIGURE_ARGS} -DRMDB_PGO=GENERATE)
+run(${CMAKE_COMMAND} --build ${PGO_BUILD_DIR} --target rmdb --parallel)
+
+message(STATUS "[pgo] running training workload")
+train(${PGO_BUILD_DIR}/bin/rmdb)
+if(CXX_COMPILER_ID STREQUAL "Clang")
+    if(NOT LLVM_PROFDATA)
+        message(FATAL_ERROR "[pgo] llvm-profdata is required to merge clang profiles")
+    endif()
+    file(GLOB RAW_PROFILES ${PROFILE_DIR}/*.profraw)
+    run(${LLVM_PROFDATA} merge -output=${PROFILE_DIR}/rmdb.profdata ${RAW_PROFILES})
+endif()
+
+message(STATUS "[pgo] building optimized rmdb")
+run(${CMAKE_COMMAND} ${CONFIGURE_ARGS} -DRMDB_PGO=USE)
+run(${CMAKE_COMMAND} --build ${PGO_BUILD_DIR} --target rmdb --parallel)
+run(${CMAKE_COMMAND} -E copy ${PGO_BUILD_DIR}/bin/rmdb ${OUTPUT_DIR}/rmdb-pgo)
+message(STATUS "[pgo] wrote ${OUTPUT_DIR}/rmdb-pgo")
+
+if(LLVM_BOLT)
+    # 插桩模式的BOLT不依赖perf，在虚拟机和容器中同样可用
+    message(STATUS "[pgo] running llvm-bolt")
+    set(FDATA ${PROFILE_DIR}/rmdb.fdata)
+    file(REMOVE ${FDATA})
+    run(${LLVM_BOLT} ${OUTPUT_DIR}/rmdb-pgo -instrument -instrumentation-file=${FDATA}
+        -o ${PGO_BUILD_DIR}/rmdb-bolt-instrumented)
+    train(${PGO_BUILD_DIR}/rmdb-bolt-instrumented)
+    run(${LLVM_BOLT} ${OUTPUT_DIR}/rmdb-pgo -o ${OUTPUT_DIR}/rmdb-pgo-bolt -data=${FDATA} -reorder-blocks=ext-tsp
+        -reorder-functions=hfsort -split-functions -split-all-cold -split-eh -dyno-stats)
+    message(STATUS "[pgo] wrote ${OUTPUT_DIR}/rmdb-pgo-bolt")
+endif()
@@ -16,6 +16,12 @@ See the Mulan PSL v2 for more details. */
  * @return {shared_ptr<Query>} Query
  */
 std::shared_ptr<Query> Analyze::do_analyze(std::shared_ptr<ast::TreeNode> parse) {
+    if (auto x = std::dynamic_pointer_cast<ast::ExplainStmt>(parse)) {
+        // explain analyze按内层语句分析，只打上标记
+        std::shared_ptr<Query> query = do_analyze(x->stmt);
+        query->explain_analyze = true;
+        return query;
+    }
     std::shared_ptr<Query> query = std::make_shared<Query>();
     if (auto x = std::dynamic_pointer_cast<ast::SelectStmt>(parse)) {
         // 处理表名
@@ -81,7 +87,7 @@ std::shared_ptr<Query> Analyze::do_analyze(std::shared_ptr<ast::TreeNode> parse)
             }
             for (auto &sv_having_cond : x->group->conds) {
                 // having 和 where 一样的处理
-                get_clause(x->group->conds, query->having_conds);
+                get_clause(query->tables, x->group->conds, query->having_conds);
                 check_where_clause(query->tables, query->having_conds, true);
             }
 
@@ -108,9 +114,21 @@ std::shared_ptr<Query> Analyze::do_analyze(std::shared_ptr<ast::TreeNode> parse)
             }
         }
 
-        //处理where条件
-        get_clause(x->conds, query->conds);
+        //处理where条件，子查询条件单独取出
+        get_clause(query->tables, get_sublinks(query->tables, x->conds, query->sublinks), query->conds);
         check_where_clause(query->tables, query->conds, false);
+
+        // 处理limit子句
+        if (x->limit != nullptr) {
+            if (x->limit->limit < 0) {
+                throw InvalidLimitError("LIMIT", x->limit->limit);
+            }
+            if (x->limit->offset < 0) {
+                throw InvalidLimitError("OFFSET", x->limit->offset);
+            }
+            query->limit = x->limit->limit;
+            query->offset = x->limit->offset;
+        }
     } else if (auto x = std::dynamic_pointer_cast<ast::UpdateStmt>(parse)) {
         // update语句只有一个表
         query->tables.push_back(x->tab_name);
@@ -118,14 +136,28 @@ std::shared_ptr<Query> Analyze::do_analyze(std::shared_ptr<ast::TreeNode> parse)
         if (!sm_manager_->db_.is_table(x->tab_name)) {
             throw TableNotFoundError(x->tab_name);
         }
-        get_clause(x->conds, query->conds);
+        check_not_view(x->tab_name);
+        get_clause(query->tables, get_sublinks(query->tables, x->conds, query->sublinks), query->conds);
         // 检查where子句的语义
         check_where_clause(query->tables, query->conds, false);
         // 从语法树中提取set子句
+        std::vector<ColMeta> all_cols;
+        get_all_cols(query->tables, all_cols);
         for (const auto &clause : x->set_clauses) {
-            query->set_clauses.push_back({// 补全表名
-                                          .lhs = {.tab_name = query->tables.at(0), .col_name = clause->col_name},
-                                          .rhs = convert_sv_value(clause->val)});
+            SetClause set_clause = {// 补全表名
+                                    .lhs = {.tab_name = query->tables.at(0), .col_name = clause->col_name}};
+            if (auto sv_val = std::dynamic_pointer_cast<ast::Value>(clause->val)) {
+                set_clause.rhs = convert_sv_value(sv_val);
+            } else {
+                // 含列的表达式在更新前的记录上求值，常量表达式直接求出值
+                auto rhs_expr = compile_expr(clause->val, all_cols);
+                if (rhs_expr->is_const()) {
+                    set_clause.rhs = fold_const(*rhs_expr);
+                } else {
+                    set_clause.rhs_expr = std::move(rhs_expr);
+                }
+            }
+            query->set_clauses.push_back(std::move(set_clause));
         }
         check_set_clause(query->tables.at(0), query->set_clauses);
     } else if (auto x = std::dynamic_pointer_cast<ast::DeleteStmt>(parse)) {
@@ -135,14 +167,60 @@ std::shared_ptr<Query> Analyze::do_analyze(std::shared_ptr<ast::TreeNode> parse)
         if (!sm_manager_->db_.is_table(x->tab_name)) {
             throw TableNotFoundError(x->tab_name);
         }
+        check_not_view(x->tab_name);
         //处理where条件
-        get_clause(x->conds, query->conds);
+        get_clause(query->tables, get_sublinks(query->tables, x->conds, query->sublinks), query->conds);
         check_where_clause({x->tab_name}, query->conds, false);
     } else if (auto x = std::dynamic_pointer_cast<ast::InsertStmt>(parse)) {
+        check_not_view(x->tab_name);
         // 处理insert 的values值
         for (auto &sv_val : x->vals) {
             query->values.push_back(convert_sv_value(sv_val));
         }
+    } else if (auto x = std::dynamic_pointer_cast<ast::CreateTable>(parse)) {
+        // 处理分区子句，列和上界的检查在建表时进行
+        if (x->partition != nullptr) {
+            auto &partition = query->partition;
+            partition.col_name = x->partition->col_name;
+            if (x->partition->type == ast::SV_PARTITION_HASH) {
+                partition.type = PARTITION_HASH;
+                if (x->partition->num_partitions < 1 || x->partition->num_partitions > RM_MAX_PARTITIONS) {
+                    throw InvalidPartitionError("number of partitions must be between 1 and " +
+                                                std::to_string(RM_MAX_PARTITIONS));
+                }
+                for (int i = 0; i < x->partition->num_partitions; i++) {
+                    partition.names.push_back("p" + std::to_string(i));
+                }
+            } else {
+                partition.type = PARTITION_RANGE;
+                partition.names = x->partition->names;
+                for (auto &sv_bound : x->partition->bounds) {
+                    partition.bounds.push_back(sv_bound != nullptr ? std::optional<Value>(convert_sv_value(sv_bound))
+                                                                   : std::nullopt);
+                }
+            }
+        }
+    } else if (auto x = std::dynamic_pointer_cast<ast::CreateView>(parse)) {
+        // 物化视图只支持单表上不带条件的分组聚合，增删改基表时可以按记录增量维护
+        auto &select = x->select;
+        if (select->tabs.size() != 1) {
+            throw InvalidViewError("must select from exactly one table");
+        }
+        if (select->group == nullptr || select->group->cols.empty()) {
+            throw InvalidViewError("must have a GROUP BY clause");
+        }
+        if (!select->conds.empty() || !select->group->conds.empty() || select->order != nullptr ||
+            select->limit != nullptr) {
+            throw InvalidViewError("WHERE, HAVING, ORDER BY and LIMIT are not supported");
+        }
+        std::shared_ptr<Query> select_query = do_analyze(select);
+        query->view.base_tab = select_query->tables.front();
+        query->view.sel_cols = std::move(select_query->cols);
+        query->view.group_cols = std::move(select_query->group_cols);
+    } else if (auto x = std::dynamic_pointer_cast<ast::CreateIndex>(parse)) {
+        check_not_view(x->tab_name);
+    } else if (auto x = std::dynamic_pointer_cast<ast::DropIndex>(parse)) {
+        check_not_view(x->tab_name);
     } else {
         // do nothing
     }
@@ -155,11 +233,18 @@ void Analyze::check_set_clause(const std::string &tab_name, std::vector<SetClaus
     TabMeta table = sm_manager_->db_.get_table(tab_name);
     for (auto &clause : clauses) {
         table.is_col(clause.lhs.col_name); // 检查列名是否存在
+        // 记录的位置由分区列决定，修改分区列需要把记录移到其他分区，不支持
+        if (table.partition.is_partitioned() && clause.lhs.col_name == table.partition.col_name) {
+            throw InvalidPartitionError("cannot update partition column " + clause.lhs.col_name);
+        }
         ColType lhs_type = table.get_col(clause.lhs.col_name)->type;
-        ColType rhs_type = clause.rhs.type;
+        ColType rhs_type = clause.rhs_expr != nullptr ? clause.rhs_expr->type() : clause.rhs.type;
         if (!colTypeCanHold(lhs_type, rhs_type)) { // 检查set语句两边的类型是否相容
             throw IncompatibleTypeError(coltype2str(lhs_type), coltype2str(rhs_type));
         }
+        if (clause.rhs_expr != nullptr) {
+            continue; // 执行时写入列中再转换类型
+        }
         if (lhs_type == TYPE_INT && rhs_type == TYPE_FLOAT) {
             clause.rhs.float2int();
         } else if (lhs_type == TYPE_FLOAT && rhs_type == TYPE_INT) {
@@ -195,10 +280,23 @@ TabCol Analyze::check_column(const std::vector<ColMeta> &all_cols, TabCol target
         if (!table.is_col(target.col_name)) {
             throw ColumnNotFoundError(target.col_name);
         }
+        // 表必须在本层查询的from中，子查询引用外层的列（相关子查询）也在这里报错
+        bool in_query = std::any_of(all_cols.begin(), all_cols.end(),
+                                    [&target](const ColMeta &col) { return col.tab_name == target.tab_name; });
+        if (!in_query) {
+            throw ColumnNotFoundError(target.tab_name + "." + target.col_name);
+        }
     }
     return target;
 }
 
+/// 物化视图的数据只能由基表的修改维护，不能直接增删改，也不能建删索引
+void Analyze::check_not_view(const std::string &tab_name) {
+    if (sm_manager_->db_.is_table(tab_name) && sm_manager_->db_.get_table(tab_name).view.is_view()) {
+        throw InvalidViewError("cannot modify materialized view " + tab_name + " directly");
+    }
+}
+
 void Analyze::get_all_cols(const std::vector<std::string> &tab_names, std::vector<ColMeta> &all_cols) {
     for (auto &sel_tab_name : tab_names) {
         // 这里db_不能写成get_db(), 注意要传指针
@@ -207,17 +305,79 @@ void Analyze::get_all_cols(const std::vector<std::string> &tab_names, std::vecto
     }
 }
 
+/// 取出where中最外层的子查询条件，子查询单独分析，返回其余的条件
+std::vector<std::shared_ptr<ast::BinaryExpr>>
+Analyze::get_sublinks(const std::vector<std::string> &tab_names,
+                      const std::vector<std::shared_ptr<ast::BinaryExpr>> &sv_conds, std::vector<SubLink> &sublinks) {
+    std::vector<std::shared_ptr<ast::BinaryExpr>> rest;
+    std::vector<ColMeta> all_cols;
+    get_all_cols(tab_names, all_cols);
+    for (auto &expr : sv_conds) {
+        auto sv_subquery = std::dynamic_pointer_cast<ast::SubQuery>(expr->rhs);
+        if (sv_subquery == nullptr) {
+            rest.push_back(expr);
+            continue;
+        }
+        SubLink sublink;
+        sublink.is_anti = expr->op == ast::SV_OP_NOT_IN || expr->op == ast::SV_OP_NOT_EXISTS;
+        // 子查询中的列只在子查询的表中查找，引用外层的列会报列不存在，即只支持不相关子查询
+        sublink.subquery = do_analyze(sv_subquery->stmt);
+        if (expr->lhs != nullptr) {
+            if (expr->lhs->aggr_type != ast::NO_AGGR) {
+                throw AmbiguousColumnError("aggregate functions are not allowed in WHERE clause");
+            }
+            if (sublink.subquery->cols.size() != 1) {
+                throw UnsupportedConditionError("IN subquery must return exactly one column");
+            }
+            sublink.lhs_col =
+                check_column(all_cols, {.tab_name = expr->lhs->tab_name, .col_name = expr->lhs->col_name});
+            auto &lhs_col = sublink.lhs_col;
+            ColType lhs_type = sm_manager_->db_.get_table(lhs_col.tab_name).get_col(lhs_col.col_name)->type;
+            auto &sub_col = sublink.subquery->cols[0];
+            ColType rhs_type = sub_col.aggr == ast::AGGR_TYPE_COUNT
+                                   ? TYPE_INT
+                                   : sm_manager_->db_.get_table(sub_col.tab_name).get_col(sub_col.col_name)->type;
+            if (!colTypeCanHold(lhs_type, rhs_type)) {
+                throw IncompatibleTypeError(coltype2str(lhs_type), coltype2str(rhs_type));
+            }
+        }
+        sublinks.push_back(std::move(sublink));
+    }
+    return rest;
+}
+
 /// 从语法树中提取出where语句
-void Analyze::get_clause(const std::vector<std::shared_ptr<ast::BinaryExpr>> &sv_conds, std::vector<Condition> &conds) {
+void Analyze::get_clause(const std::vector<std::string> &tab_names,
+                         const std::vector<std::shared_ptr<ast::BinaryExpr>> &sv_conds, std::vector<Condition> &conds) {
     conds.clear();
     for (auto &expr : sv_conds) {
+        if (std::dynamic_pointer_cast<ast::SubQuery>(expr->rhs) != nullptr) {
+            // 最外层的子查询条件已经被get_sublinks取出
+            throw UnsupportedConditionError("subquery in OR or HAVING clause");
+        }
         Condition cond;
+        cond.op = convert_sv_comp_op(expr->op);
+        if (cond.op == OP_OR) {
+            // 每个分支递归提取，表名在check_or_clause中补全
+            cond.is_rhs_val = true;
+            for (auto &sv_branch : expr->disjuncts) {
+                std::vector<Condition> branch;
+                get_clause(tab_names, sv_branch, branch);
+                cond.disjuncts.push_back(std::move(branch));
+            }
+            conds.push_back(std::move(cond));
+            continue;
+        }
         cond.lhs_col = {.tab_name = expr->lhs->tab_name,
                         .col_name = expr->lhs->col_name,
                         .alias = expr->lhs->alias,
                         .aggr = expr->lhs->aggr_type};
-        cond.op = convert_sv_comp_op(expr->op);
-        if (auto rhs_val = std::dynamic_pointer_cast<ast::Value>(expr->rhs)) {
+        if (auto rhs_vals = std::dynamic_pointer_cast<ast::ValueList>(expr->rhs)) {
+            cond.is_rhs_val = true;
+            for (auto &sv_val : rhs_vals->vals) {
+                cond.rhs_vals.push_back(convert_sv_value(sv_val));
+            }
+        } else if (auto rhs_val = std::dynamic_pointer_cast<ast::Value>(expr->rhs)) {
             cond.is_rhs_val = true;
             cond.rhs_val = convert_sv_value(rhs_val);
         } else if (auto rhs_col = std::dynamic_pointer_cast<ast::Col>(expr->rhs)) {
@@ -226,6 +386,19 @@ void Analyze::get_clause(const std::vector<std::shared_ptr<ast::BinaryExpr>> &sv
                             .col_name = rhs_col->col_name,
                             .alias = rhs_col->alias,
                             .aggr = rhs_col->aggr_type};
+        } else if (std::dynamic_pointer_cast<ast::ArithExpr>(expr->rhs) != nullptr) {
+            std::vector<ColMeta> all_cols;
+            get_all_cols(tab_names, all_cols);
+            auto rhs_expr = compile_expr(expr->rhs, all_cols);
+            if (rhs_expr->is_const()) {
+                cond.is_rhs_val = true;
+                cond.rhs_val = fold_const(*rhs_expr);
+            } else {
+                // 表名在check_where_clause中检查
+                cond.is_rhs_val = false;
+                cond.rhs_col = {.tab_name = rhs_expr->tab_name(), .col_name = "", .alias = "", .aggr = ast::NO_AGGR};
+                cond.rhs_expr = std::move(rhs_expr);
+            }
         }
         conds.push_back(cond);
     }
@@ -239,6 +412,10 @@ void Analyze::check_where_clause(const std::vector<std::string> &tab_names, std:
     get_all_cols(tab_names, all_cols);
     // Get raw values in where clause
     for (auto &cond : conds) {
+        if (cond.op == OP_OR) {
+            check_or_clause(tab_names, cond, is_having);
+            continue;
+        }
         // where 子句不能有聚合函数
         if ((!is_having && (cond.lhs_col.aggr != ast::NO_AGGR)) ||
             (!cond.is_rhs_val && cond.rhs_col.aggr != ast::NO_AGGR)) {
@@ -247,11 +424,38 @@ void Analyze::check_where_clause(const std::vector<std::string> &tab_names, std:
 
         // Infer table name from column name
         cond.lhs_col = check_column(all_cols, cond.lhs_col);
-        if (!cond.is_rhs_val) { // 如果右手边也是列，也需要检查列的合法性
+        if (!cond.is_rhs_val && cond.rhs_expr == nullptr) { // 如果右手边也是列，也需要检查列的合法性
             cond.rhs_col = check_column(all_cols, cond.rhs_col);
+            if (cond.rhs_col.tab_name == cond.lhs_col.tab_name && !is_having) {
+                // 同一张表的两列比较，作为只有一列的表达式在扫描中求值
+                auto rhs_expr = std::make_shared<ArithExpr>();
+                rhs_expr->push_col(*sm_manager_->db_.get_table(cond.rhs_col.tab_name).get_col(cond.rhs_col.col_name));
+                cond.rhs_expr = std::move(rhs_expr);
+            }
+        }
+        if (cond.rhs_expr != nullptr) {
+            if (is_having) {
+                throw UnsupportedConditionError("column expression in HAVING clause");
+            }
+            if (cond.op == OP_IN || cond.lhs_col.tab_name != cond.rhs_expr->tab_name()) {
+                throw UnsupportedConditionError("expression over columns of another table");
+            }
+            ColType lhs_type = sm_manager_->db_.get_table(cond.lhs_col.tab_name).get_col(cond.lhs_col.col_name)->type;
+            ColType rhs_type = cond.rhs_expr->type();
+            if (!colTypeCanHold(lhs_type, rhs_type)) {
+                throw IncompatibleTypeError(coltype2str(lhs_type), coltype2str(rhs_type));
+            }
+            continue;
         }
 
-        if (cond.lhs_col.aggr == ast::AGGR_TYPE_COUNT && cond.lhs_col.col_name == "*") {
+        if (cond.op == OP_IN) {
+            if (cond.lhs_col.aggr == ast::AGGR_TYPE_COUNT) {
+                check_in_list(TYPE_INT, sizeof(int), cond);
+            } else {
+                auto lhs_col = sm_manager_->db_.get_table(cond.lhs_col.tab_name).get_col(cond.lhs_col.col_name);
+                check_in_list(lhs_col->type, lhs_col->len, cond);
+            }
+        } else if (cond.lhs_col.aggr == ast::AGGR_TYPE_COUNT && cond.lhs_col.col_name == "*") {
             ColType lhs_type = TYPE_INT;
             ColType rhs_type;
             if (cond.is_rhs_val) {
@@ -301,6 +505,93 @@ void Analyze::check_where_clause(const std::vector<std::string> &tab_names, std:
     }
 }
 
+/// OR条件的各个分支分别检查，目前只支持同一张表上的列和值比较，这样OR条件可以下推到该表的扫描中求值
+void Analyze::check_or_clause(const std::vector<std::string> &tab_names, Condition &cond, bool is_having) {
+    if (is_having) {
+        throw UnsupportedConditionError("OR in HAVING clause");
+    }
+    std::string tab_name;
+    for (auto &branch : cond.disjuncts) {
+        check_where_clause(tab_names, branch, false); // 嵌套的OR已经补全了表名
+        for (auto &sub_cond : branch) {
+            if (!sub_cond.is_rhs_val) {
+                throw UnsupportedConditionError("OR between columns");
+            }
+            if (!tab_name.empty() && sub_cond.lhs_col.tab_name != tab_name) {
+                throw UnsupportedConditionError("OR across tables");
+            }
+            tab_name = sub_cond.lhs_col.tab_name;
+        }
+    }
+    cond.lhs_col = {.tab_name = tab_name, .col_name = "", .alias = "", .aggr = ast::NO_AGGR};
+}
+
+/// IN列表的值转换为左侧列的类型，再排序去重，扫描时可以二分查找，索引可以按升序逐个值探查
+void Analyze::check_in_list(ColType lhs_type, int lhs_len, Condition &cond) {
+    std::vector<Value> vals;
+    for (auto &val : cond.rhs_vals) {
+        if (!colTypeCanHold(lhs_type, val.type)) {
+            throw IncompatibleTypeError(coltype2str(lhs_type), coltype2str(val.type));
+        }
+        if (lhs_type == TYPE_FLOAT && val.type == TYPE_INT) {
+            val.int2float();
+        } else if (lhs_type == TYPE_INT && val.type == TYPE_FLOAT) {
+            if (val.float_val != (float)(int)val.float_val) {
+                continue; // 不是整数，不可能和int列相等
+            }
+            val.float2int();
+        }
+        val.init_raw(val.type == TYPE_STRING ? std::max<int>(lhs_len, val.str_val.size()) : lhs_len); // 字符串多的补0
+        vals.push_back(std::move(val));
+    }
+    std::sort(vals.begin(), vals.end());
+    vals.erase(std::unique(vals.begin(), vals.end()), vals.end());
+    cond.rhs_vals = std::move(vals);
+}
+
+/// 把语法树中的表达式编译为ArithExpr，列在all_cols中查找，所有列必须属于同一张表
+std::shared_ptr<ArithExpr> Analyze::compile_expr(const std::shared_ptr<ast::Expr> &sv_expr,
+                                                 const std::vector<ColMeta> &all_cols) {
+    auto expr = std::make_shared<ArithExpr>();
+    compile_expr(sv_expr, all_cols, *expr);
+    return expr;
+}
+
+/// 后序遍历语法树，依次压入操作数和运算符
+void Analyze::compile_expr(const std::shared_ptr<ast::Expr> &sv_expr, const std::vector<ColMeta> &all_cols,
+                           ArithExpr &expr) {
+    if (auto x = std::dynamic_pointer_cast<ast::ArithExpr>(sv_expr)) {
+        compile_expr(x->lhs, all_cols, expr);
+        compile_expr(x->rhs, all_cols, expr);
+        expr.apply(x->op);
+    } else if (auto x = std::dynamic_pointer_cast<ast::Col>(sv_expr)) {
+        if (x->aggr_type != ast::NO_AGGR) {
+            throw UnsupportedConditionError("aggregate function in arithmetic expression");
+        }
+        TabCol col = check_column(all_cols, {.tab_name = x->tab_name, .col_name = x->col_name});
+        if (!expr.is_const() && expr.tab_name() != col.tab_name) {
+            throw UnsupportedConditionError("expression over columns of another table");
+        }
+        expr.push_col(*sm_manager_->db_.get_table(col.tab_name).get_col(col.col_name));
+    } else if (auto x = std::dynamic_pointer_cast<ast::Value>(sv_expr)) {
+        expr.push_const(convert_sv_value(x));
+    } else {
+        throw InternalError("Unexpected sv expr type");
+    }
+}
+
+/// 常量表达式求值，结果是INT或FLOAT
+Value Analyze::fold_const(const ArithExpr &expr) {
+    ValueView view = expr.eval(nullptr);
+    Value val;
+    if (view.type == TYPE_INT) {
+        val.set_int(view.int_val);
+    } else {
+        val.set_float(view.float_val);
+    }
+    return val;
+}
+
 Value Analyze::convert_sv_value(const std::shared_ptr<ast::Value> &sv_val) {
     Value val;
     if (auto int_lit = std::dynamic_pointer_cast<ast::IntLit>(sv_val)) {
@@ -321,6 +612,7 @@ CompOp Analyze::convert_sv_comp_op(ast::SvCompOp op) {
     static const std::map<ast::SvCompOp, CompOp> m = {
         {ast::SV_OP_EQ, OP_EQ}, {ast::SV_OP_NE, OP_NE}, {ast::SV_OP_LT, OP_LT},
         {ast::SV_OP_GT, OP_GT}, {ast::SV_OP_LE, OP_LE}, {ast::SV_OP_GE, OP_GE},
+        {ast::SV_OP_IN, OP_IN}, {ast::SV_OP_OR, OP_OR},
     };
     return m.at(op);
 }
@@ -19,12 +19,23 @@ See the Mulan PSL v2 for more details. */
 #include "common/common.h"
 #include "system/sm.h"
 
+class Query;
+
+// where中的不相关子查询条件：col [NOT] IN (SELECT ...)或[NOT] EXISTS (SELECT ...)，规划为半连接/反连接
+struct SubLink {
+    TabCol lhs_col;                  // IN左侧的列，EXISTS时col_name为空
+    bool is_anti = false;            // NOT IN/NOT EXISTS
+    std::shared_ptr<Query> subquery; // 已经分析过的子查询，IN时只有一个投影列
+};
+
 class Query {
   public:
     std::shared_ptr<ast::TreeNode> parse;
     // TODO jointree
     // where条件
     std::vector<Condition> conds;
+    // where中的子查询条件
+    std::vector<SubLink> sublinks;
     // 投影列
     std::vector<TabCol> cols;
     // 表名
@@ -33,12 +44,21 @@ class Query {
     std::vector<SetClause> set_clauses;
     // insert 的values值
     std::vector<Value> values;
+    // create table 的分区方式
+    PartitionDef partition;
+    // create materialized view 的定义
+    ViewDef view;
 
     bool has_aggr;
     // group
     std::vector<TabCol> group_cols;
     // having
     std::vector<Condition> having_conds;
+    // limit/offset，limit为-1表示没有LIMIT子句
+    int limit = -1;
+    int offset = 0;
+    // explain analyze
+    bool explain_analyze = false;
 
     Query() {
     }
@@ -59,9 +79,21 @@ class Analyze {
   private:
     TabCol check_column(const std::vector<ColMeta> &all_cols, TabCol target);
     void get_all_cols(const std::vector<std::string> &tab_names, std::vector<ColMeta> &all_cols);
-    void get_clause(const std::vector<std::shared_ptr<ast::BinaryExpr>> &sv_conds, std::vector<Condition> &conds);
+    void check_not_view(const std::string &tab_name);
+    std::vector<std::shared_ptr<ast::BinaryExpr>>
+    get_sublinks(const std::vector<std::string> &tab_names,
+                 const std::vector<std::shared_ptr<ast::BinaryExpr>> &sv_conds, std::vector<SubLink> &sublinks);
+    void get_clause(const std::vector<std::string> &tab_names,
+                    const std::vector<std::shared_ptr<ast::BinaryExpr>> &sv_conds, std::vector<Condition> &conds);
     void check_where_clause(const std::vector<std::string> &tab_names, std::vector<Condition> &conds, bool is_having);
+    void check_or_clause(const std::vector<std::string> &tab_names, Condition &cond, bool is_having);
+    static void check_in_list(ColType lhs_type, int lhs_len, Condition &cond);
     void check_set_clause(const std::string &tab_name, std::vector<SetClause> &clauses);
+    std::shared_ptr<ArithExpr> compile_expr(const std::shared_ptr<ast::Expr> &sv_expr,
+                                            const std::vector<ColMeta> &all_cols);
+    void compile_expr(const std::shared_ptr<ast::Expr> &sv_expr, const std::vector<ColMeta> &all_cols,
+                      ArithExpr &expr);
+    static Value fold_const(const ArithExpr &expr);
     Value convert_sv_value(const std::shared_ptr<ast::Value> &sv_val);
     static CompOp convert_sv_comp_op(ast::SvCompOp op);
 };
@@ -14,12 +14,14 @@ See the Mulan PSL v2 for more details. */
 #include "parser/ast.h"
 #include "record/rm_defs.h"
 #include "system/sm_meta.h"
+#include <algorithm>
 #include <cassert>
 #include <cfloat>
 #include <climits>
 #include <cstring>
 #include <memory>
 #include <string>
+#include <type_traits>
 
 struct TabCol {
     std::string tab_name;
@@ -172,7 +174,7 @@ struct Value {
             value.set_int(is_max ? INT_MAX : INT_MIN);
             value.init_raw(sizeof(int));
         } else if (type == TYPE_FLOAT) {
-            value.set_float(is_max ? FLT_MAX : FLT_MIN);
+            value.set_float(is_max ? FLT_MAX : -FLT_MAX); // FLT_MIN是最小的正数
             value.init_raw(sizeof(float));
         } else if (type == TYPE_STRING) {
             // value.set_str(std::string(len, is_max ? 'z' : 'a'));
@@ -277,8 +279,316 @@ struct Value {
     }
 };
 
-//             =       !=    <       >      <=     >=
-enum CompOp { OP_EQ, OP_NE, OP_LT, OP_GT, OP_LE, OP_GE };
+/**
+ * 执行阶段求值用的值，16字节且可平凡复制：数值直接保存，字符串只保存指向记录（或Value）中数据的指针和长度，
+ * 从记录中取值和比较都不分配内存。ValueView不拥有数据，被指向的记录必须在使用期间有效。
+ * Value只用于规划阶段的常量、IN列表和聚合结果
+ */
+struct ValueView {
+    ColType type; // type of value
+    int len;      // 字符串的长度，不含末尾的'\0'
+    union {
+        int int_val;         // int和date
+        float float_val;     // float value
+        const char *str_val; // 字符串，不以'\0'结尾
+    };
+
+    static ValueView of(const char *base, const ColMeta &meta) {
+        return of(base + meta.offset, meta.type, meta.len);
+    }
+
+    // data指向字段的首地址，len是字段的长度
+    static ValueView of(const char *data, ColType type, int len) {
+        ValueView view;
+        view.type = type;
+        view.len = 0;
+        switch (type) {
+        case TYPE_DATE:
+        case TYPE_INT:
+            view.int_val = *(int *)data;
+            break;
+        case TYPE_FLOAT:
+            view.float_val = *(float *)data;
+            break;
+        case TYPE_STRING:
+            // 去掉末尾的'\0', 考虑无tailing-zero的情况
+            view.str_val = data;
+            view.len = (int)strnlen(data, len);
+            break;
+        default:
+            throw InternalError("not implemented");
+        }
+        return view;
+    }
+
+    static ValueView of(const Value &value) {
+        ValueView view;
+        view.type = value.type;
+        view.len = 0;
+        if (value.type == TYPE_STRING) {
+            view.str_val = value.str_val.data();
+            view.len = (int)value.str_val.size();
+        } else if (value.type == TYPE_FLOAT) {
+            view.float_val = value.float_val;
+        } else {
+            view.int_val = value.int_val;
+        }
+        return view;
+    }
+
+    /**
+     * @description: 三路比较，和Value的比较运算一致：int和float比较时int转为float，字符串按字典序
+     * @return {int} 小于、等于、大于rhs时分别返回负数、0、正数
+     */
+    [[nodiscard]] int compare(const ValueView &rhs) const {
+        if (type == TYPE_STRING || rhs.type == TYPE_STRING) {
+            // 字符串不能和数字类型比较
+            if (type != rhs.type) {
+                throw InternalError("cannot compare numeric type with string type");
+            }
+            int res = memcmp(str_val, rhs.str_val, std::min(len, rhs.len));
+            return res != 0 ? res : len - rhs.len;
+        }
+        if (type == TYPE_FLOAT || rhs.type == TYPE_FLOAT) {
+            float lhs_val = type == TYPE_FLOAT ? float_val : (float)int_val;
+            float rhs_val = rhs.type == TYPE_FLOAT ? rhs.float_val : (float)rhs.int_val;
+            return (lhs_val > rhs_val) - (lhs_val < rhs_val);
+        }
+        return (int_val > rhs.int_val) - (int_val < rhs.int_val);
+    }
+
+    // 写入类型为type、长度为len的字段，int和float相互转换，字符串末尾以'\0'填充
+    void store(char *dst, ColType dst_type, int dst_len) const {
+        switch (dst_type) {
+        case TYPE_DATE:
+        case TYPE_INT: {
+            int val = type == TYPE_FLOAT ? (int)float_val : int_val;
+            memcpy(dst, &val, sizeof(int));
+            break;
+        }
+        case TYPE_FLOAT: {
+            float val = type == TYPE_FLOAT ? float_val : (float)int_val;
+            memcpy(dst, &val, sizeof(float));
+            break;
+        }
+        case TYPE_STRING:
+            if (len > dst_len) {
+                throw StringOverflowError();
+            }
+            memcpy(dst, str_val, len);
+            memset(dst + len, 0, dst_len - len);
+            break;
+        default:
+            throw InternalError("not implemented");
+        }
+    }
+};
+
+static_assert(sizeof(ValueView) == 16 && std::is_trivially_copyable_v<ValueView>);
+
+/**
+ * 编译后的算术表达式，叶子是一张表的列或常量。分析阶段展开为后缀式的指令序列，列在记录中的偏移和每一步的类型
+ * 都已确定，在记录上求值时只用一个定长的栈，不分配内存，也不按列名查找。
+ * 含运算符时操作数只能是INT或FLOAT，任一侧是FLOAT时按FLOAT计算；只有一列时可以是任意类型，用于a < b
+ */
+class ArithExpr {
+  public:
+    static constexpr int MAX_DEPTH = 16; // 求值栈的深度
+
+    // 压入一列，col的偏移是在表的记录中的偏移
+    void push_col(const ColMeta &col) {
+        if (steps_.empty()) {
+            col_ = col;
+        }
+        if (col.type == TYPE_INT || col.type == TYPE_FLOAT) {
+            push_step({col.type == TYPE_INT ? LOAD_INT : LOAD_FLOAT, col.offset, {0}}, col.type);
+        } else {
+            push_step({LOAD_OTHER, col.offset, {0}}, col.type);
+        }
+        has_col_ = true;
+    }
+
+    void push_const(const Value &val) {
+        if (val.type == TYPE_INT) {
+            push_step({CONST_INT, 0, {val.int_val}}, TYPE_INT);
+        } else if (val.type == TYPE_FLOAT) {
+            Step step{CONST_FLOAT, 0, {0}};
+            step.float_val = val.float_val;
+            push_step(step, TYPE_FLOAT);
+        } else {
+            throw IncompatibleTypeError(coltype2str(val.type), "arithmetic expression");
+        }
+    }
+
+    // 弹出栈顶的两个操作数，压入lhs op rhs
+    void apply(ast::SvArithOp op) {
+        assert(types_.size() >= 2);
+        ColType rhs = types_.back();
+        ColType lhs = types_[types_.size() - 2];
+        for (ColType type : {lhs, rhs}) {
+            if (type != TYPE_INT && type != TYPE_FLOAT) {
+                throw IncompatibleTypeError(coltype2str(type), "arithmetic expression");
+            }
+        }
+        bool is_float = lhs == TYPE_FLOAT || rhs == TYPE_FLOAT;
+        if (is_float && rhs == TYPE_INT) {
+            steps_.push_back({TO_FLOAT, 0, {0}});
+        }
+        if (is_float && lhs == TYPE_INT) {
+            steps_.push_back({TO_FLOAT_LHS, 0, {0}});
+        }
+        steps_.push_back({(OpCode)((is_float ? ADD_FLOAT : ADD_INT) + op), 0, {0}});
+        types_.pop_back();
+        types_.back() = is_float ? TYPE_FLOAT : TYPE_INT;
+    }
+
+    // 表达式的结果类型
+    [[nodiscard]] ColType type() const {
+        assert(types_.size() == 1);
+        return types_[0];
+    }
+
+    // 不含列的表达式在分析阶段直接求值
+    [[nodiscard]] bool is_const() const {
+        return !has_col_;
+    }
+
+    // 表达式中的列所属的表
+    [[nodiscard]] const std::string &tab_name() const {
+        return col_.tab_name;
+    }
+
+    /**
+     * @description: 在记录上求值，record是表的一条记录，常量表达式可以传nullptr
+     * @return 结果的ValueView，只有一列且是字符串时指向record中的数据
+     */
+    [[nodiscard]] ValueView eval(const char *record) const {
+        if (steps_.size() == 1 && steps_[0].code == LOAD_OTHER) {
+            return ValueView::of(record + col_.offset, col_.type, col_.len);
+        }
+        union Num {
+            int int_val;
+            float float_val;
+        } stack[MAX_DEPTH];
+        int top = -1;
+        for (auto &step : steps_) {
+            switch (step.code) {
+            case LOAD_INT:
+                memcpy(&stack[++top].int_val, record + step.offset, sizeof(int));
+                break;
+            case LOAD_FLOAT:
+                memcpy(&stack[++top].float_val, record + step.offset, sizeof(float));
+                break;
+            case CONST_INT:
+                stack[++top].int_val = step.int_val;
+                break;
+            case CONST_FLOAT:
+                stack[++top].float_val = step.float_val;
+                break;
+            case TO_FLOAT:
+                stack[top].float_val = (float)stack[top].int_val;
+                break;
+            case TO_FLOAT_LHS:
+                stack[top - 1].float_val = (float)stack[top - 1].int_val;
+                break;
+            default:
+                top--;
+                if (step.code <= DIV_INT) {
+                    stack[top].int_val = int_op(step.code, stack[top].int_val, stack[top + 1].int_val);
+                } else {
+                    stack[top].float_val = float_op(step.code, stack[top].float_val, stack[top + 1].float_val);
+                }
+            }
+        }
+        ValueView view;
+        view.type = types_[0];
+        view.len = 0;
+        if (view.type == TYPE_INT) {
+            view.int_val = stack[0].int_val;
+        } else {
+            view.float_val = stack[0].float_val;
+        }
+        return view;
+    }
+
+  private:
+    // ADD_INT到DIV_INT、ADD_FLOAT到DIV_FLOAT的顺序和ast::SvArithOp一致
+    enum OpCode {
+        LOAD_INT,
+        LOAD_FLOAT,
+        LOAD_OTHER, // 字符串或日期列，只能单独出现
+        CONST_INT,
+        CONST_FLOAT,
+        TO_FLOAT,     // 栈顶转为float
+        TO_FLOAT_LHS, // 栈顶下面一个转为float
+        ADD_INT,
+        SUB_INT,
+        MUL_INT,
+        DIV_INT,
+        ADD_FLOAT,
+        SUB_FLOAT,
+        MUL_FLOAT,
+        DIV_FLOAT,
+    };
+
+    struct Step {
+        OpCode code;
+        int offset; // LOAD_*: 列在记录中的偏移
+        union {
+            int int_val; // CONST_INT
+            float float_val;
+        };
+    };
+
+    std::vector<Step> steps_;
+    std::vector<ColType> types_; // 编译时栈中每个操作数的类型，编译完成后只剩结果类型
+    ColMeta col_;                // 第一列，表达式只有一列时直接取值
+    bool has_col_ = false;
+
+    void push_step(const Step &step, ColType type) {
+        if (types_.size() >= MAX_DEPTH) {
+            throw UnsupportedConditionError("arithmetic expression is nested too deeply");
+        }
+        steps_.push_back(step);
+        types_.push_back(type);
+    }
+
+    // 先按64位计算再截断，溢出时按补码回绕
+    static int int_op(OpCode code, int lhs, int rhs) {
+        switch (code) {
+        case ADD_INT:
+            return (int)((int64_t)lhs + rhs);
+        case SUB_INT:
+            return (int)((int64_t)lhs - rhs);
+        case MUL_INT:
+            return (int)((int64_t)lhs * rhs);
+        default:
+            if (rhs == 0) {
+                throw DivisionByZeroError();
+            }
+            return (int)((int64_t)lhs / rhs);
+        }
+    }
+
+    static float float_op(OpCode code, float lhs, float rhs) {
+        switch (code) {
+        case ADD_FLOAT:
+            return lhs + rhs;
+        case SUB_FLOAT:
+            return lhs - rhs;
+        case MUL_FLOAT:
+            return lhs * rhs;
+        default:
+            if (rhs == 0) {
+                throw DivisionByZeroError();
+            }
+            return lhs / rhs;
+        }
+    }
+};
+
+//             =       !=    <       >      <=     >=     IN     OR
+enum CompOp { OP_EQ, OP_NE, OP_LT, OP_GT, OP_LE, OP_GE, OP_IN, OP_OR };
 
 struct Condition {
     TabCol lhs_col;  // left-hand side column
@@ -287,25 +597,54 @@ struct Condition {
     TabCol rhs_col;  // right-hand side column
     Value rhs_val;   // right-hand side value
 
-    [[nodiscard]] bool eval_with_rvalue(const Value &lhs) const {
+    std::vector<Value> rhs_vals;                   // OP_IN的值列表，已转换为左侧列的类型，升序且去重
+    std::vector<std::vector<Condition>> disjuncts; // OP_OR的各个分支，分支内是逻辑与，lhs_col只有表名
+    // 右侧是左侧表的列或含列的算术表达式时非空，此时is_rhs_val为false，rhs_col只有表名
+    std::shared_ptr<ArithExpr> rhs_expr;
+
+    [[nodiscard]] bool eval_with_rvalue(const ValueView &lhs) const {
         assert(is_rhs_val);
-        return eval(lhs, rhs_val);
+        if (op == OP_IN) {
+            auto less = [](const Value &val, const ValueView &key) { return ValueView::of(val).compare(key) < 0; };
+            auto it = std::lower_bound(rhs_vals.begin(), rhs_vals.end(), lhs, less);
+            return it != rhs_vals.end() && ValueView::of(*it).compare(lhs) == 0;
+        }
+        return eval(lhs, ValueView::of(rhs_val));
+    }
+
+    /**
+     * @description: 在一条记录上求值右侧是值的条件，OR条件的每个分支分别取列
+     * @param {ColOf} col_of 返回TabCol在记录中的ColMeta
+     */
+    template <typename ColOf>
+    [[nodiscard]] bool eval_record(const char *record, ColOf &&col_of) const {
+        if (op == OP_OR) {
+            return std::any_of(disjuncts.begin(), disjuncts.end(), [&](const std::vector<Condition> &conds) {
+                return std::all_of(conds.begin(), conds.end(),
+                                   [&](const Condition &cond) { return cond.eval_record(record, col_of); });
+            });
+        }
+        if (rhs_expr != nullptr) {
+            return eval(ValueView::of(record, col_of(lhs_col)), rhs_expr->eval(record));
+        }
+        return eval_with_rvalue(ValueView::of(record, col_of(lhs_col)));
     }
 
-    [[nodiscard]] bool eval(const Value &lhs, const Value &rhs) const {
+    [[nodiscard]] bool eval(const ValueView &lhs, const ValueView &rhs) const {
+        int res = lhs.compare(rhs);
         switch (op) {
         case OP_EQ:
-            return lhs == rhs;
+            return res == 0;
         case OP_NE:
-            return lhs != rhs;
+            return res != 0;
         case OP_LT:
-            return lhs < rhs;
+            return res < 0;
         case OP_GT:
-            return lhs > rhs;
+            return res > 0;
         case OP_LE:
-            return lhs <= rhs;
+            return res <= 0;
         case OP_GE:
-            return lhs >= rhs;
+            return res >= 0;
         default:
             throw InternalError("not implemented");
         }
@@ -314,5 +653,6 @@ struct Condition {
 
 struct SetClause {
     TabCol lhs;
-    Value rhs;
+    Value rhs;                           // 右侧是常量时的值
+    std::shared_ptr<ArithExpr> rhs_expr; // 右侧含列时非空，在更新前的记录上求值
 };
\ No newline at end of file
@@ -46,10 +46,31 @@ using slot_offset_t = size_t; // slot offset type
 using oid_t = uint16_t;
 using timestamp_t = int32_t; // timestamp type, used for transaction concurrency
 
+// 并行扫描时每个morsel包含的数据页数
+static constexpr int MORSEL_PAGES = 16;
+// gather同时提交的morsel数上限为该值乘以线程数，限制尚未被上层读取的结果占用的内存
+static constexpr int GATHER_MORSELS_PER_WORKER = 4;
+// 缓冲池按文件统计命中次数的分片数，各线程固定累加其中一个分片，命中时不争用同一缓存行
+static constexpr int BUFFER_POOL_HIT_SHARDS = 8;
+// 数据页不超过该值的小表在内存中缓存全部记录，读记录时不访问缓冲池
+static constexpr int RECORD_CACHE_PAGES = 4;
+// 每个索引的change buffer中最多暂存的删除数，叶子不在缓冲池中的删除先记下，之后批量合并到B+树
+static constexpr int CHANGE_BUFFER_SIZE = 1024;
+// 调度器中的任务连续执行超过该时间(微秒)后，在yield()处让出，先执行一个排队中的任务
+static constexpr int TASK_YIELD_SLICE_US = 2000;
+
 // log file
 static const std::string LOG_FILE_NAME = "db.log";
 
 // replacer
-static const std::string REPLACER_TYPE = "LRU";
+static const std::string REPLACER_TYPE = "CLOCK";
 
 static const std::string DB_META_NAME = "db.meta";
+
+// slow query log, 执行时间超过阈值(毫秒)的语句连同资源统计写入此文件
+static const std::string SLOW_QUERY_LOG_NAME = "slow_query.log";
+static constexpr double SLOW_QUERY_THRESHOLD_MS = 1000;
+
+// tracer, 每个线程的环形缓冲区能保存的span数，以及dump输出的文件
+static constexpr int TRACE_BUFFER_SIZE = 65536;
+static const std::string TRACE_FILE_NAME = "trace.json";
@@ -10,6 +10,9 @@ See the Mulan PSL v2 for more details. */
 
 #pragma once
 
+#include <chrono>
+
+#include "common/query_stats.h"
 #include "recovery/log_manager.h"
 #include "transaction/concurrency/lock_manager.h"
 #include "transaction/transaction.h"
@@ -25,6 +28,19 @@ class Context {
             int *offset = &const_offset)
         : lock_mgr_(lock_mgr), log_mgr_(log_mgr), txn_(txn), data_send_(data_send), offset_(offset) {
         ellipsis_ = false;
+        start_time_ = std::chrono::steady_clock::now();
+        thread_stats().reset(); // 丢弃上一条语句之后残留的计数
+    }
+
+    // 把当前线程累加的计数合并到本条语句的统计中
+    void collect_stats() {
+        stats_.merge(thread_stats());
+        thread_stats().reset();
+    }
+
+    // 语句开始执行至今经过的时间
+    double elapsed_ms() const {
+        return std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start_time_).count();
     }
 
     // TransactionManager *txn_mgr_;
@@ -34,4 +50,8 @@ class Context {
     char *data_send_;
     int *offset_;
     bool ellipsis_;
+    int session_id_ = -1; // 语句所在的会话（客户端连接的socket），临时表属于创建它的会话
+    std::string select_output_; // SELECT写入output.txt的内容，由结果缓存保存
+    QueryStats stats_;
+    std::chrono::steady_clock::time_point start_time_;
 };
\ No newline at end of file
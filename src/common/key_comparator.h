@@ -0,0 +1,243 @@
+/* Copyright (c) 2023 Renmin University of China
+RMDB is licensed under Mulan PSL v2.
+You can use this software according to the terms and conditions of the Mulan PSL v2.
+You may obtain a copy of Mulan PSL v2 at:
+        http://license.coscl.org.cn/MulanPSL2
+THIS SOFTWARE IS PROVIDED ON AN "AS IS" BASIS, WITHOUT WARRANTIES OF ANY KIND,
+EITHER EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO NON-INFRINGEMENT,
+MERCHANTABILITY OR FIT FOR A PARTICULAR PURPOSE.
+See the Mulan PSL v2 for more details. */
+
+#pragma once
+
+#include <algorithm>
+#include <array>
+#include <cstdint>
+#include <cstring>
+#include <type_traits>
+#include <vector>
+
+#include "common/common.h"
+
+/**
+ * 按键的模式生成的比较器，比较两条记录（或两个B+树的key）中的多列键。
+ * 常见的键在记录中连续存放时（单个INT、单个FLOAT、两个或三个INT、单个定长字符串），用列的类型和相对偏移
+ * 在编译期确定的模板比较；其他情况（列不相邻、两侧类型或长度不同、混合类型的多列键）退化为逐列比较。
+ * visit()把具体的比较器类型交给调用者的泛型lambda，排序和B+树的查找循环按键的模式分别实例化，
+ * 循环内没有类型分派和经过函数指针的调用。HAS_KEY为真的比较器还可以用key()把记录的键取成可直接比较的值，
+ * 排序时只需要排序紧凑的键
+ */
+class KeyComparator {
+  public:
+    // 一列键在两侧记录中的位置，两侧可以来自不同的表
+    struct KeyCol {
+        ColType lhs_type;
+        int lhs_offset;
+        int lhs_len;
+        ColType rhs_type;
+        int rhs_offset;
+        int rhs_len;
+    };
+
+    // N个连续的INT（或DATE）列，第i列相对于首列的偏移为i * sizeof(int)，N是常量，循环被展开
+    template <int N>
+    struct IntKeys {
+        static constexpr bool HAS_KEY = true;
+        using Key = std::conditional_t<N == 1, int, std::array<int, N>>; // 按字典序比较，和operator()一致
+
+        int lhs_base;
+        int rhs_base;
+
+        Key key(const char *a) const {
+            Key key;
+            memcpy(&key, a + lhs_base, sizeof(Key));
+            return key;
+        }
+
+        int operator()(const char *a, const char *b) const {
+            for (int i = 0; i < N; i++) {
+                int x = *(const int *)(a + lhs_base + i * sizeof(int));
+                int y = *(const int *)(b + rhs_base + i * sizeof(int));
+                if (x != y) {
+                    return x < y ? -1 : 1;
+                }
+            }
+            return 0;
+        }
+    };
+
+    struct FloatKey {
+        static constexpr bool HAS_KEY = true;
+        using Key = float;
+
+        int lhs_base;
+        int rhs_base;
+
+        Key key(const char *a) const {
+            return *(const float *)(a + lhs_base);
+        }
+
+        int operator()(const char *a, const char *b) const {
+            float x = *(const float *)(a + lhs_base);
+            float y = *(const float *)(b + rhs_base);
+            return (x > y) - (x < y);
+        }
+    };
+
+    // 两侧长度相同的字符串，末尾都以'\0'填充，直接比较整列和按字典序比较的结果相同
+    struct StringKey {
+        static constexpr bool HAS_KEY = false;
+
+        int lhs_base;
+        int rhs_base;
+        int len;
+
+        // 前8个字节按大端序组成的整数，整数的大小关系和这8个字节按memcmp比较的结果一致
+        uint64_t prefix(const char *a) const {
+            uint64_t prefix = 0;
+            memcpy(&prefix, a + lhs_base, std::min(len, (int)sizeof(prefix)));
+            return __builtin_bswap64(prefix);
+        }
+
+        int operator()(const char *a, const char *b) const {
+            return memcmp(a + lhs_base, b + rhs_base, len);
+        }
+    };
+
+    struct GenericKeys {
+        static constexpr bool HAS_KEY = false;
+
+        const std::vector<KeyCol> *cols;
+
+        int operator()(const char *a, const char *b) const {
+            for (auto &col : *cols) {
+                int res = compare_col(a, b, col);
+                if (res != 0) {
+                    return res;
+                }
+            }
+            return 0;
+        }
+    };
+
+    KeyComparator() = default;
+
+    // 比较两侧记录中一一对应的多列键，lhs_keys和rhs_keys是各自记录中的字段
+    static KeyComparator create(const std::vector<ColMeta> &lhs_keys, const std::vector<ColMeta> &rhs_keys) {
+        KeyComparator cmp;
+        for (size_t i = 0; i < lhs_keys.size(); i++) {
+            auto &lhs = lhs_keys[i];
+            auto &rhs = rhs_keys[i];
+            cmp.cols_.push_back({lhs.type, lhs.offset, lhs.len, rhs.type, rhs.offset, rhs.len});
+        }
+        cmp.specialize();
+        return cmp;
+    }
+
+    // 比较从首地址开始连续存放的多列键，即B+树的key
+    static KeyComparator create(const std::vector<ColType> &types, const std::vector<int> &lens) {
+        KeyComparator cmp;
+        int offset = 0;
+        for (size_t i = 0; i < types.size(); i++) {
+            cmp.cols_.push_back({types[i], offset, lens[i], types[i], offset, lens[i]});
+            offset += lens[i];
+        }
+        cmp.specialize();
+        return cmp;
+    }
+
+    /**
+     * @description: 用具体的比较器调用f，f的参数类型随键的模式不同，通常是泛型lambda
+     * @return f的返回值
+     */
+    template <typename F>
+    decltype(auto) visit(F &&f) const {
+        switch (shape_) {
+        case Shape::INT:
+            return f(IntKeys<1>{lhs_base_, rhs_base_});
+        case Shape::INT2:
+            return f(IntKeys<2>{lhs_base_, rhs_base_});
+        case Shape::INT3:
+            return f(IntKeys<3>{lhs_base_, rhs_base_});
+        case Shape::FLOAT:
+            return f(FloatKey{lhs_base_, rhs_base_});
+        case Shape::STRING:
+            return f(StringKey{lhs_base_, rhs_base_, str_len_});
+        default:
+            return f(GenericKeys{&cols_});
+        }
+    }
+
+    // 单次比较，a小于、等于、大于b时分别返回负数、0、正数
+    int operator()(const char *a, const char *b) const {
+        return visit([a, b](const auto &cmp) { return cmp(a, b); });
+    }
+
+    [[nodiscard]] bool is_specialized() const {
+        return shape_ != Shape::GENERIC;
+    }
+
+  private:
+    enum class Shape { GENERIC, INT, INT2, INT3, FLOAT, STRING };
+
+    Shape shape_ = Shape::GENERIC;
+    int lhs_base_ = 0; // 首列在左侧记录中的偏移
+    int rhs_base_ = 0; // 首列在右侧记录中的偏移
+    int str_len_ = 0;  // STRING模式下字符串的长度
+    std::vector<KeyCol> cols_;
+
+    static bool is_int(ColType type) {
+        return type == TYPE_INT || type == TYPE_DATE;
+    }
+
+    // 两侧类型和长度相同时直接比较内存中的值，否则按ValueView的规则比较（int和float、不同长度的字符串）
+    static int compare_col(const char *a, const char *b, const KeyCol &col) {
+        const char *x = a + col.lhs_offset;
+        const char *y = b + col.rhs_offset;
+        bool same_type = col.lhs_type == col.rhs_type || (is_int(col.lhs_type) && is_int(col.rhs_type));
+        if (same_type && col.lhs_len == col.rhs_len) {
+            switch (col.lhs_type) {
+            case TYPE_DATE:
+            case TYPE_INT:
+                return IntKeys<1>{0, 0}(x, y);
+            case TYPE_FLOAT:
+                return FloatKey{0, 0}(x, y);
+            case TYPE_STRING:
+                return memcmp(x, y, col.lhs_len);
+            default:
+                throw InternalError("Unexpected data type");
+            }
+        }
+        return ValueView::of(x, col.lhs_type, col.lhs_len).compare(ValueView::of(y, col.rhs_type, col.rhs_len));
+    }
+
+    // 所有列两侧类型和长度都相同、且在两侧记录中都连续存放时，按列的类型选择模板比较器
+    void specialize() {
+        shape_ = Shape::GENERIC;
+        if (cols_.empty()) {
+            return;
+        }
+        lhs_base_ = cols_[0].lhs_offset;
+        rhs_base_ = cols_[0].rhs_offset;
+        int lhs_offset = lhs_base_;
+        int rhs_offset = rhs_base_;
+        bool all_int = true;
+        for (auto &col : cols_) {
+            if (col.lhs_type != col.rhs_type || col.lhs_len != col.rhs_len || col.lhs_offset != lhs_offset ||
+                col.rhs_offset != rhs_offset) {
+                return;
+            }
+            all_int = all_int && is_int(col.lhs_type);
+            lhs_offset += col.lhs_len;
+            rhs_offset += col.rhs_len;
+        }
+        if (all_int && cols_.size() <= 3) {
+            shape_ = cols_.size() == 1 ? Shape::INT : (cols_.size() == 2 ? Shape::INT2 : Shape::INT3);
+        } else if (cols_.size() == 1 && cols_[0].lhs_type == TYPE_FLOAT) {
+            shape_ = Shape::FLOAT;
+        } else if (cols_.size() == 1 && cols_[0].lhs_type == TYPE_STRING) {
+            shape_ = Shape::STRING;
+            str_len_ = cols_[0].lhs_len;
+        }
+    }
+};
@@ -0,0 +1,84 @@
+/* Copyright (c) 2023 Renmin University of China
+RMDB is licensed under Mulan PSL v2.
+You can use this software according to the terms and conditions of the Mulan PSL v2.
+You may obtain a copy of Mulan PSL v2 at:
+        http://license.coscl.org.cn/MulanPSL2
+THIS SOFTWARE IS PROVIDED ON AN "AS IS" BASIS, WITHOUT WARRANTIES OF ANY KIND,
+EITHER EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO NON-INFRINGEMENT,
+MERCHANTABILITY OR FIT FOR A PARTICULAR PURPOSE.
+See the Mulan PSL v2 for more details. */
+
+#pragma once
+
+#include <cstdint>
+#include <string>
+#include <utility>
+#include <vector>
+
+// 单条语句的资源消耗统计
+struct QueryStats {
+    uint64_t bp_fetches = 0;          // fetch_page调用次数
+    uint64_t bp_misses = 0;           // fetch_page未命中，需要从磁盘读入的次数
+    uint64_t pages_read = 0;          // 从磁盘读取的页数
+    uint64_t pages_written = 0;       // 写回磁盘的页数
+    uint64_t tuples_scanned = 0;      // 扫描算子检查过的记录数
+    uint64_t runtime_filtered = 0;    // 扫描时被join下推的运行时过滤器丢弃的记录数
+    uint64_t partitions_pruned = 0;   // 扫描分区表时被选择条件裁剪掉的分区数
+    uint64_t ix_deletes_buffered = 0; // 叶子不在缓冲池中，暂存到change buffer的索引删除数
+    uint64_t tuples_produced = 0;     // 返回给客户端或被DML修改的记录数
+    uint64_t sort_spill_bytes = 0;    // 外部排序写入临时文件的字节数
+    uint64_t lock_waits = 0;          // 申请锁时发生等待的次数
+    uint64_t log_bytes = 0;           // 写入日志缓冲区的字节数
+
+    void merge(const QueryStats &other) {
+        bp_fetches += other.bp_fetches;
+        bp_misses += other.bp_misses;
+        pages_read += other.pages_read;
+        pages_written += other.pages_written;
+        tuples_scanned += other.tuples_scanned;
+        runtime_filtered += other.runtime_filtered;
+        partitions_pruned += other.partitions_pruned;
+        ix_deletes_buffered += other.ix_deletes_buffered;
+        tuples_produced += other.tuples_produced;
+        sort_spill_bytes += other.sort_spill_bytes;
+        lock_waits += other.lock_waits;
+        log_bytes += other.log_bytes;
+    }
+
+    void reset() {
+        *this = QueryStats();
+    }
+
+    // 以(名称, 值)的形式列出所有计数器，供EXPLAIN ANALYZE和慢查询日志输出
+    std::vector<std::pair<std::string, uint64_t>> items() const {
+        return {{"bp_fetches", bp_fetches},
+                {"bp_misses", bp_misses},
+                {"pages_read", pages_read},
+                {"pages_written", pages_written},
+                {"tuples_scanned", tuples_scanned},
+                {"runtime_filtered", runtime_filtered},
+                {"partitions_pruned", partitions_pruned},
+                {"ix_deletes_buffered", ix_deletes_buffered},
+                {"tuples_produced", tuples_produced},
+                {"sort_spill_bytes", sort_spill_bytes},
+                {"lock_waits", lock_waits},
+                {"log_bytes", log_bytes}};
+    }
+
+    std::string to_string() const {
+        std::string str;
+        for (auto &[name, value] : items()) {
+            if (!str.empty()) {
+                str += " ";
+            }
+            str += name + "=" + std::to_string(value);
+        }
+        return str;
+    }
+};
+
+// 当前线程的计数器。各模块直接累加，不需要加锁；语句结束时由Context::collect_stats()合并并清零
+inline QueryStats &thread_stats() {
+    static thread_local QueryStats stats;
+    return stats;
+}
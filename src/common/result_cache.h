@@ -0,0 +1,157 @@
+/* Copyright (c) 2023 Renmin University of China
+RMDB is licensed under Mulan PSL v2.
+You can use this software according to the terms and conditions of the Mulan PSL v2.
+You may obtain a copy of Mulan PSL v2 at:
+        http://license.coscl.org.cn/MulanPSL2
+THIS SOFTWARE IS PROVIDED ON AN "AS IS" BASIS, WITHOUT WARRANTIES OF ANY KIND,
+EITHER EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO NON-INFRINGEMENT,
+MERCHANTABILITY OR FIT FOR A PARTICULAR PURPOSE.
+See the Mulan PSL v2 for more details. */
+
+#pragma once
+
+#include <cctype>
+#include <functional>
+#include <list>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+/**
+ * @description: 查询结果缓存，以规范化后的SQL为key，保存SELECT返回给客户端的结果和写入output.txt的内容，
+ * 按总字节数做LRU淘汰。每个结果记下执行前它读到的各表的版本号，表被修改后版本号增加；
+ * 查找时版本号对不上的结果直接丢弃（惰性失效），命中时不需要解析、规划和执行
+ */
+class ResultCache {
+  public:
+    using TableVersions = std::vector<std::pair<std::string, uint64_t>>;
+    using VersionFn = std::function<uint64_t(const std::string &)>;
+
+    ResultCache(size_t capacity, VersionFn version_of) : capacity_(capacity), version_of_(std::move(version_of)) {
+    }
+
+    /**
+     * @description: 规范化SQL：去掉首尾空白和结尾的分号，引号之外的连续空白合并为一个空格。
+     * 标识符区分大小写，不改变大小写
+     */
+    static std::string normalize(const std::string &sql) {
+        std::string key;
+        key.reserve(sql.size());
+        char quote = 0;
+        bool pending_space = false;
+        for (char ch : sql) {
+            if (quote == 0 && isspace(static_cast<unsigned char>(ch))) {
+                pending_space = !key.empty();
+                continue;
+            }
+            if (pending_space) {
+                key.push_back(' ');
+                pending_space = false;
+            }
+            if (quote == 0 && (ch == '\'' || ch == '"')) {
+                quote = ch;
+            } else if (ch == quote) {
+                quote = 0;
+            }
+            key.push_back(ch);
+        }
+        while (!key.empty() && (key.back() == ';' || key.back() == ' ')) {
+            key.pop_back();
+        }
+        return key;
+    }
+
+    // 查询各表当前的版本号，在执行查询之前调用，执行期间表被修改时结果会在下次查找时失效
+    TableVersions snapshot(const std::vector<std::string> &tab_names) const {
+        TableVersions versions;
+        for (auto &tab_name : tab_names) {
+            versions.emplace_back(tab_name, version_of_(tab_name));
+        }
+        return versions;
+    }
+
+    /**
+     * @description: 查找缓存的结果
+     * @return {bool} 命中时返回true；不存在或者读过的表已经被修改时返回false，后者同时删除该结果
+     * @param {string&} key 规范化后的SQL
+     * @param {string*} reply 返回给客户端的结果
+     * @param {string*} output 写入output.txt的内容
+     */
+    bool lookup(const std::string &key, std::string *reply, std::string *output) {
+        std::scoped_lock lock{latch_};
+        auto it = index_.find(key);
+        if (it == index_.end()) {
+            misses_++;
+            return false;
+        }
+        for (auto &[tab_name, version] : it->second->versions) {
+            if (version_of_(tab_name) != version) {
+                erase(it->second);
+                misses_++;
+                return false;
+            }
+        }
+        lru_.splice(lru_.begin(), lru_, it->second);
+        *reply = it->second->reply;
+        *output = it->second->output;
+        hits_++;
+        return true;
+    }
+
+    // 保存一条SELECT的结果，versions是执行之前的snapshot()；超过容量时从最久未使用的结果开始淘汰
+    void insert(const std::string &key, std::string reply, std::string output, TableVersions versions) {
+        size_t bytes = key.size() + reply.size() + output.size();
+        if (bytes > capacity_) {
+            return;
+        }
+        std::scoped_lock lock{latch_};
+        auto it = index_.find(key);
+        if (it != index_.end()) {
+            erase(it->second);
+        }
+        while (size_ + bytes > capacity_) {
+            erase(std::prev(lru_.end()));
+        }
+        lru_.push_front(Entry{key, std::move(reply), std::move(output), std::move(versions), bytes});
+        index_[key] = lru_.begin();
+        size_ += bytes;
+    }
+
+    size_t size() const {
+        return size_;
+    }
+
+    size_t hits() const {
+        return hits_;
+    }
+
+    size_t misses() const {
+        return misses_;
+    }
+
+  private:
+    struct Entry {
+        std::string key;
+        std::string reply;      // 返回给客户端的结果
+        std::string output;     // 写入output.txt的内容
+        TableVersions versions; // 执行前读到的各表的版本号
+        size_t bytes;
+    };
+
+    size_t capacity_; // 缓存的结果总字节数上限
+    VersionFn version_of_;
+    std::list<Entry> lru_; // 表头是最近使用的结果
+    std::unordered_map<std::string, std::list<Entry>::iterator> index_;
+    size_t size_ = 0;
+    size_t hits_ = 0;
+    size_t misses_ = 0;
+    std::mutex latch_;
+
+    void erase(std::list<Entry>::iterator it) {
+        size_ -= it->bytes;
+        index_.erase(it->key);
+        lru_.erase(it);
+    }
+};
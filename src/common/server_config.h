@@ -0,0 +1,193 @@
+/* Copyright (c) 2023 Renmin University of China
+RMDB is licensed under Mulan PSL v2.
+You can use this software according to the terms and conditions of the Mulan PSL v2.
+You may obtain a copy of Mulan PSL v2 at:
+        http://license.coscl.org.cn/MulanPSL2
+THIS SOFTWARE IS PROVIDED ON AN "AS IS" BASIS, WITHOUT WARRANTIES OF ANY KIND,
+EITHER EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO NON-INFRINGEMENT,
+MERCHANTABILITY OR FIT FOR A PARTICULAR PURPOSE.
+See the Mulan PSL v2 for more details. */
+
+#pragma once
+
+#include <fstream>
+#include <iostream>
+#include <string>
+
+#include "common/config.h"
+#include "errors.h"
+
+/**
+ * 服务器运行时配置。默认值来自config.h，启动时依次被配置文件(--config)和命令行参数覆盖。
+ * 配置文件每行一个`key = value`，`#`之后为注释；命令行使用`--key=value`或`--key value`，key中的`-`等同于`_`。
+ * 表示内存大小的值可以带K/M/G后缀；buffer_pool_size不带后缀时表示帧数，带后缀时表示字节数。
+ */
+struct ServerConfig {
+    size_t buffer_pool_size = BUFFER_POOL_SIZE;               // 缓冲池帧数
+    size_t log_buffer_size = LOG_BUFFER_SIZE;                 // 日志缓冲区字节数
+    std::string replacer_type = REPLACER_TYPE;                // 缓冲池置换策略
+    int port = 8765;                                          // 监听端口
+    int max_conn_limit = 8;                                   // listen的backlog
+    size_t sort_memory = 800 * 1024 * 1024;                   // SortExecutor外部排序的内存预算
+    size_t merge_join_memory = 64 * 1024 * 1024;              // MergeJoinExecutor排序的内存预算，由需要排序的输入平分
+    bool merge_join_debug_output = false;                     // MergeJoinExecutor是否输出sorted_results.txt
+    bool enable_runtime_filter = true;                        // join是否向扫描下推运行时过滤器
+    size_t parallel_workers = 0;                              // 查询内并行的线程数，0表示CPU核数，1表示不并行
+    size_t parallel_min_pages = 64;                           // 数据页不少于此值的表才并行扫描
+    size_t record_cache_pages = RECORD_CACHE_PAGES;           // 数据页不超过此值的表缓存全部记录，0表示关闭
+    size_t change_buffer_size = CHANGE_BUFFER_SIZE;           // 每个索引暂存的删除数上限，0表示关闭change buffer
+    size_t result_cache_size = 0;                             // 查询结果缓存的字节数上限，0表示关闭
+    bool pin_workers = false;                                 // 是否按NUMA节点把调度器的工作线程绑定到CPU核
+    double slow_query_threshold_ms = SLOW_QUERY_THRESHOLD_MS; // 慢查询日志阈值
+
+    void set(std::string key, const std::string &value) {
+        for (auto &ch : key) {
+            if (ch == '-') {
+                ch = '_';
+            }
+        }
+        if (key == "buffer_pool_size") {
+            size_t bytes_or_frames = parse_size(key, value);
+            bool has_suffix = !value.empty() && !isdigit(value.back());
+            buffer_pool_size = has_suffix ? bytes_or_frames / PAGE_SIZE : bytes_or_frames;
+        } else if (key == "log_buffer_size") {
+            log_buffer_size = parse_size(key, value);
+        } else if (key == "replacer_type") {
+            if (value != "LRU" && value != "CLOCK") {
+                throw ConfigError(key, value);
+            }
+            replacer_type = value;
+        } else if (key == "port") {
+            port = static_cast<int>(parse_size(key, value));
+        } else if (key == "max_conn_limit") {
+            max_conn_limit = static_cast<int>(parse_size(key, value));
+        } else if (key == "sort_memory") {
+            sort_memory = parse_size(key, value);
+        } else if (key == "merge_join_memory") {
+            merge_join_memory = parse_size(key, value);
+        } else if (key == "merge_join_debug_output") {
+            merge_join_debug_output = parse_bool(key, value);
+        } else if (key == "enable_runtime_filter") {
+            enable_runtime_filter = parse_bool(key, value);
+        } else if (key == "parallel_workers") {
+            parallel_workers = parse_size(key, value);
+        } else if (key == "parallel_min_pages") {
+            parallel_min_pages = parse_size(key, value);
+        } else if (key == "record_cache_pages") {
+            record_cache_pages = parse_size(key, value);
+        } else if (key == "change_buffer_size") {
+            change_buffer_size = parse_size(key, value);
+        } else if (key == "result_cache_size") {
+            result_cache_size = parse_size(key, value);
+        } else if (key == "pin_workers") {
+            pin_workers = parse_bool(key, value);
+        } else if (key == "slow_query_threshold_ms") {
+            slow_query_threshold_ms = parse_size(key, value);
+        } else {
+            throw ConfigError(key, value);
+        }
+        if (buffer_pool_size == 0 || log_buffer_size == 0 || sort_memory == 0 || merge_join_memory == 0) {
+            throw ConfigError(key, value);
+        }
+    }
+
+    void load_file(const std::string &path) {
+        std::ifstream file(path);
+        if (file.fail()) {
+            throw FileNotFoundError(path);
+        }
+        std::string line;
+        while (std::getline(file, line)) {
+            line = line.substr(0, line.find('#'));
+            auto eq = line.find('=');
+            if (eq == std::string::npos) {
+                if (trim(line).empty()) {
+                    continue;
+                }
+                throw ConfigError(trim(line), "");
+            }
+            set(trim(line.substr(0, eq)), trim(line.substr(eq + 1)));
+        }
+    }
+
+    /**
+     * @description: 解析命令行参数，返回数据库名
+     * 用法: rmdb [--config <file>] [--<key>=<value> | --<key> <value>]... <database>
+     */
+    std::string parse_args(int argc, char **argv) {
+        std::string db_name;
+        for (int i = 1; i < argc; i++) {
+            std::string arg = argv[i];
+            if (arg.rfind("--", 0) != 0) {
+                if (!db_name.empty()) {
+                    throw ConfigError("database", arg);
+                }
+                db_name = arg;
+                continue;
+            }
+            std::string key = arg.substr(2);
+            std::string value;
+            auto eq = key.find('=');
+            if (eq != std::string::npos) {
+                value = key.substr(eq + 1);
+                key = key.substr(0, eq);
+            } else if (i + 1 < argc) {
+                value = argv[++i];
+            } else {
+                throw ConfigError(key, "");
+            }
+            if (key == "config") {
+                load_file(value);
+            } else {
+                set(key, value);
+            }
+        }
+        return db_name;
+    }
+
+  private:
+    static std::string trim(const std::string &str) {
+        auto begin = str.find_first_not_of(" \t\r");
+        if (begin == std::string::npos) {
+            return "";
+        }
+        auto end = str.find_last_not_of(" \t\r");
+        return str.substr(begin, end - begin + 1);
+    }
+
+    static bool parse_bool(const std::string &key, const std::string &value) {
+        if (value == "true" || value == "on" || value == "1") {
+            return true;
+        } else if (value == "false" || value == "off" || value == "0") {
+            return false;
+        }
+        throw ConfigError(key, value);
+    }
+
+    // 解析非负整数，支持K/M/G后缀
+    static size_t parse_size(const std::string &key, const std::string &value) {
+        size_t pos = 0;
+        size_t result;
+        if (value.empty() || !isdigit(value[0])) {
+            throw ConfigError(key, value);
+        }
+        try {
+            result = std::stoull(value, &pos);
+        } catch (std::exception &) {
+            throw ConfigError(key, value);
+        }
+        std::string suffix = value.substr(pos);
+        if (suffix == "K" || suffix == "k") {
+            result <<= 10;
+        } else if (suffix == "M" || suffix == "m") {
+            result <<= 20;
+        } else if (suffix == "G" || suffix == "g") {
+            result <<= 30;
+        } else if (!suffix.empty()) {
+            throw ConfigError(key, value);
+        }
+        return result;
+    }
+};
+
+inline ServerConfig server_config;
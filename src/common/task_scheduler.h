@@ -0,0 +1,431 @@
+/* Copyright (c) 2023 Renmin University of China
+RMDB is licensed under Mulan PSL v2.
+You can use this software according to the terms and conditions of the Mulan PSL v2.
+You may obtain a copy of Mulan PSL v2 at:
+        http://license.coscl.org.cn/MulanPSL2
+THIS SOFTWARE IS PROVIDED ON AN "AS IS" BASIS, WITHOUT WARRANTIES OF ANY KIND,
+EITHER EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO NON-INFRINGEMENT,
+MERCHANTABILITY OR FIT FOR A PARTICULAR PURPOSE.
+See the Mulan PSL v2 for more details. */
+
+#pragma once
+
+#include <pthread.h>
+#include <sched.h>
+
+#include <algorithm>
+#include <atomic>
+#include <cctype>
+#include <chrono>
+#include <condition_variable>
+#include <deque>
+#include <exception>
+#include <fstream>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "common/config.h"
+#include "common/query_stats.h"
+#include "common/server_config.h"
+
+/**
+ * 一组相互独立的任务（通常每个任务处理一个morsel）。任务被分配到各工作线程的队列中，
+ * 但每个任务在执行前要先被领取(claim)，所以提交任务的线程也可以通过run_task()/run_one()/wait()参与执行，
+ * 即使所有工作线程都在忙也不会死锁
+ */
+class TaskGroup {
+  public:
+    using TaskFn = std::function<void(size_t task, size_t worker)>;
+
+    TaskGroup(size_t num_tasks, TaskFn fn)
+        : fn_(std::move(fn)), num_tasks_(num_tasks), claimed_(std::make_unique<std::atomic<bool>[]>(num_tasks)) {
+    }
+
+    size_t num_tasks() const {
+        return num_tasks_;
+    }
+
+    /**
+     * @description: 领取并执行第task个任务
+     * @return {bool} 任务已被其他线程领取时返回false
+     * @param {size_t} worker 执行线程的编号，0表示提交任务的线程，工作线程从1开始编号
+     */
+    bool run_task(size_t task, size_t worker) {
+        if (claimed_[task].exchange(true)) {
+            return false;
+        }
+        std::exception_ptr error;
+        if (!cancelled_) {
+            try {
+                fn_(task, worker);
+            } catch (...) {
+                error = std::current_exception();
+            }
+        }
+        std::scoped_lock lock{latch_};
+        if (error != nullptr && error_ == nullptr) {
+            error_ = error;
+            cancelled_ = true;
+        }
+        if (worker != 0) {
+            // 工作线程的计数归入这组任务，由提交任务的线程在wait()时合并到本条语句
+            stats_.merge(thread_stats());
+            thread_stats().reset();
+        }
+        finished_++;
+        cv_.notify_all();
+        return true;
+    }
+
+    // 按下标顺序领取并执行一个尚未被领取的任务，所有任务都已被领取时返回false
+    bool run_one(size_t worker) {
+        for (size_t task = hint_.load(); task < num_tasks_; task++) {
+            if (run_task(task, worker)) {
+                hint_ = task + 1;
+                return true;
+            }
+        }
+        hint_ = num_tasks_;
+        return false;
+    }
+
+    // 尚未领取的任务不再执行，已经在执行的任务不受影响
+    void cancel() {
+        cancelled_ = true;
+    }
+
+    /**
+     * @description: 阻塞直到pred()为真或所有任务结束，任务抛出异常时在调用线程重新抛出
+     * pred()所依赖的状态必须在任务返回之前写入
+     */
+    template <typename Predicate>
+    void wait_until(Predicate &&pred) {
+        std::unique_lock lock{latch_};
+        cv_.wait(lock, [&] { return pred() || error_ != nullptr || finished_ == num_tasks_; });
+        if (error_ != nullptr) {
+            std::rethrow_exception(error_);
+        }
+    }
+
+    // 参与执行剩余的任务并等待全部结束，合并工作线程的计数，任务抛出异常时在调用线程重新抛出
+    void wait() {
+        while (run_one(0)) {
+        }
+        std::unique_lock lock{latch_};
+        cv_.wait(lock, [this] { return finished_ == num_tasks_; });
+        thread_stats().merge(stats_);
+        stats_.reset();
+        if (error_ != nullptr) {
+            std::rethrow_exception(error_);
+        }
+    }
+
+  private:
+    TaskFn fn_;
+    size_t num_tasks_;
+    std::unique_ptr<std::atomic<bool>[]> claimed_; // 每个任务是否已被领取
+    std::atomic<size_t> hint_{0};                  // run_one()从这里开始寻找未领取的任务
+    std::atomic<bool> cancelled_{false};           // 被取消或有任务失败
+    std::mutex latch_;                             // 保护以下成员
+    std::condition_variable cv_;                   // 每个任务结束时通知
+    size_t finished_ = 0;                          // 已结束（包括被取消跳过）的任务数
+    std::exception_ptr error_;                     // 第一个失败任务的异常
+    QueryStats stats_;                             // 工作线程执行任务时累加的计数
+};
+
+/**
+ * 全局共享的work-stealing调度器，查询的morsel、外部排序的run生成、建索引时的键提取等都提交到这里，
+ * 各子系统不再自己创建线程。
+ * - 每个工作线程有自己的双端队列：submit()把一组任务按连续的块分给各个队列，工作线程从自己队列的头部取任务，
+ *   队列空了就从其他线程队列的尾部窃取，优先窃取同一NUMA节点上的线程；
+ * - pin_workers开启时按NUMA节点顺序把工作线程绑定到CPU核；
+ * - 执行时间较长的任务可以调用yield()，让出时间先执行一个排队中的任务，避免短查询饿死。
+ */
+class TaskScheduler {
+  public:
+    // 调度器自身的计数，用于观察负载均衡情况
+    struct Stats {
+        uint64_t executed = 0; // 工作线程执行的任务数
+        uint64_t stolen = 0;   // 其中从其他线程队列中窃取的任务数
+        uint64_t yielded = 0;  // yield()时插入执行的任务数
+    };
+
+    explicit TaskScheduler(size_t num_threads, bool pin_workers = false) {
+        auto cpus = numa_ordered_cpus();
+        workers_.resize(num_threads + 1); // workers_[0]对应提交任务的线程，没有队列
+        for (size_t i = 1; i <= num_threads; i++) {
+            workers_[i] = std::make_unique<Worker>();
+            workers_[i]->cpu = cpus[(i - 1) % cpus.size()].first;
+            workers_[i]->node = cpus[(i - 1) % cpus.size()].second;
+        }
+        for (size_t i = 1; i <= num_threads; i++) {
+            // 窃取顺序：同一节点上的线程在前，其余在后，各自从自己的下一个开始轮转
+            for (size_t k = 1; k < num_threads; k++) {
+                size_t victim = (i - 1 + k) % num_threads + 1;
+                if (workers_[victim]->node == workers_[i]->node) {
+                    workers_[i]->victims.push_back(victim);
+                }
+            }
+            for (size_t k = 1; k < num_threads; k++) {
+                size_t victim = (i - 1 + k) % num_threads + 1;
+                if (workers_[victim]->node != workers_[i]->node) {
+                    workers_[i]->victims.push_back(victim);
+                }
+            }
+        }
+        for (size_t i = 1; i <= num_threads; i++) {
+            workers_[i]->thread = std::thread([this, i, pin_workers] {
+                if (pin_workers) {
+                    cpu_set_t set;
+                    CPU_ZERO(&set);
+                    CPU_SET(workers_[i]->cpu, &set);
+                    pthread_setaffinity_np(pthread_self(), sizeof(set), &set);
+                }
+                worker_loop(i);
+            });
+        }
+    }
+
+    ~TaskScheduler() {
+        {
+            std::scoped_lock lock{sleep_latch_};
+            stop_ = true;
+        }
+        sleep_cv_.notify_all();
+        for (size_t i = 1; i < workers_.size(); i++) {
+            workers_[i]->thread.join();
+        }
+    }
+
+    // 可以同时执行任务的线程数，包括提交任务的线程
+    size_t num_workers() const {
+        return workers_.size();
+    }
+
+    /**
+     * @description: 提交一组任务后立即返回，调用者需要通过wait()等待其结束
+     * 在工作线程中提交时任务全部放入当前线程的队列，由其他线程窃取；否则按连续的块分给各线程
+     */
+    std::shared_ptr<TaskGroup> submit(size_t num_tasks, TaskGroup::TaskFn fn) {
+        auto group = std::make_shared<TaskGroup>(num_tasks, std::move(fn));
+        size_t num_threads = workers_.size() - 1;
+        if (num_tasks == 0 || num_threads == 0) {
+            return group;
+        }
+        if (current_worker() != 0 && current_scheduler() == this) {
+            push(current_worker(), group, 0, num_tasks);
+        } else {
+            // 任务数少于线程数时从不同的线程开始，避免总是压在前几个线程上
+            size_t first = next_victim_.fetch_add(1) % num_threads;
+            for (size_t k = 0; k < num_threads; k++) {
+                size_t begin = num_tasks * k / num_threads;
+                size_t end = num_tasks * (k + 1) / num_threads;
+                if (begin < end) {
+                    push((first + k) % num_threads + 1, group, begin, end);
+                }
+            }
+        }
+        return group;
+    }
+
+    // 提交单个后台任务，例如外部排序中对已写满的run排序
+    std::shared_ptr<TaskGroup> spawn(std::function<void()> fn) {
+        return submit(1, [fn = std::move(fn)](size_t, size_t) { fn(); });
+    }
+
+    /**
+     * @description: 协作式让出，只能在不持有锁和页面pin的位置调用。
+     * 当前工作线程上的任务已连续执行超过TASK_YIELD_SLICE_US时，先执行一个排队中的任务再返回
+     */
+    static void yield() {
+        auto *scheduler = current_scheduler();
+        size_t worker = current_worker();
+        if (scheduler == nullptr || worker == 0) {
+            return;
+        }
+        auto &self = *scheduler->workers_[worker];
+        if (self.yielding || std::chrono::steady_clock::now() - self.task_start <
+                                 std::chrono::microseconds(TASK_YIELD_SLICE_US)) {
+            return;
+        }
+        Item item;
+        if (scheduler->pop(worker, item) || scheduler->steal(worker, item)) {
+            // 插入执行的任务有自己的计数，先把当前任务已经累加的计数保存起来
+            QueryStats saved = thread_stats();
+            thread_stats().reset();
+            self.yielding = true;
+            item.group->run_task(item.task, worker);
+            self.yielding = false;
+            thread_stats() = saved;
+            std::scoped_lock lock{self.latch};
+            self.stats.yielded++;
+        }
+        self.task_start = std::chrono::steady_clock::now();
+    }
+
+    Stats stats() const {
+        Stats total;
+        for (size_t i = 1; i < workers_.size(); i++) {
+            std::scoped_lock lock{workers_[i]->latch};
+            total.executed += workers_[i]->stats.executed;
+            total.stolen += workers_[i]->stats.stolen;
+            total.yielded += workers_[i]->stats.yielded;
+        }
+        return total;
+    }
+
+    static TaskScheduler &instance() {
+        static TaskScheduler scheduler(configured_workers() - 1, server_config.pin_workers);
+        return scheduler;
+    }
+
+    // server_config.parallel_workers为0时使用全部CPU核
+    static size_t configured_workers() {
+        size_t workers = server_config.parallel_workers;
+        if (workers == 0) {
+            workers = std::max(1u, std::thread::hardware_concurrency());
+        }
+        return workers;
+    }
+
+  private:
+    struct Item {
+        std::shared_ptr<TaskGroup> group;
+        size_t task;
+    };
+
+    struct Worker {
+        mutable std::mutex latch; // 保护items和stats
+        std::deque<Item> items;
+        Stats stats;
+        std::vector<size_t> victims; // 窃取时依次尝试的线程
+        int cpu = 0;
+        int node = 0;
+        bool yielding = false;
+        std::chrono::steady_clock::time_point task_start;
+        std::thread thread;
+    };
+
+    static size_t &current_worker() {
+        static thread_local size_t worker = 0;
+        return worker;
+    }
+
+    static TaskScheduler *&current_scheduler() {
+        static thread_local TaskScheduler *scheduler = nullptr;
+        return scheduler;
+    }
+
+    void push(size_t worker, const std::shared_ptr<TaskGroup> &group, size_t begin, size_t end) {
+        {
+            // 先增加计数再入队，queued_只会短暂地多于实际的任务数，不会减到0以下
+            std::scoped_lock lock{sleep_latch_};
+            queued_ += end - begin;
+        }
+        {
+            std::scoped_lock lock{workers_[worker]->latch};
+            for (size_t task = begin; task < end; task++) {
+                workers_[worker]->items.push_back({group, task});
+            }
+        }
+        sleep_cv_.notify_all();
+    }
+
+    // 从自己队列的头部取任务，保持morsel的顺序
+    bool pop(size_t worker, Item &item) {
+        auto &self = *workers_[worker];
+        std::scoped_lock lock{self.latch};
+        if (self.items.empty()) {
+            return false;
+        }
+        item = std::move(self.items.front());
+        self.items.pop_front();
+        queued_--;
+        return true;
+    }
+
+    // 从其他线程队列的尾部窃取，尾部的任务离该线程正在处理的位置最远
+    bool steal(size_t worker, Item &item) {
+        for (size_t victim : workers_[worker]->victims) {
+            {
+                auto &other = *workers_[victim];
+                std::scoped_lock lock{other.latch};
+                if (other.items.empty()) {
+                    continue;
+                }
+                item = std::move(other.items.back());
+                other.items.pop_back();
+                queued_--;
+            }
+            // 同一时刻只持有一个队列的锁，避免两个线程互相窃取时死锁
+            std::scoped_lock lock{workers_[worker]->latch};
+            workers_[worker]->stats.stolen++;
+            return true;
+        }
+        return false;
+    }
+
+    void worker_loop(size_t worker) {
+        current_worker() = worker;
+        current_scheduler() = this;
+        auto &self = *workers_[worker];
+        while (true) {
+            Item item;
+            if (pop(worker, item) || steal(worker, item)) {
+                self.task_start = std::chrono::steady_clock::now();
+                // 已被其他线程（通常是提交任务的线程）领取的任务直接跳过
+                if (item.group->run_task(item.task, worker)) {
+                    std::scoped_lock lock{self.latch};
+                    self.stats.executed++;
+                }
+                continue;
+            }
+            std::unique_lock lock{sleep_latch_};
+            sleep_cv_.wait(lock, [this] { return stop_ || queued_ > 0; });
+            if (stop_) {
+                return;
+            }
+        }
+    }
+
+    // 按NUMA节点排列的(CPU编号, 节点编号)，读不到节点信息时视为只有一个节点
+    static std::vector<std::pair<int, int>> numa_ordered_cpus() {
+        std::vector<std::pair<int, int>> cpus;
+        for (int node = 0;; node++) {
+            std::ifstream file("/sys/devices/system/node/node" + std::to_string(node) + "/cpulist");
+            if (file.fail()) {
+                break;
+            }
+            // cpulist的格式形如"0-7,16-23"
+            std::string range;
+            while (std::getline(file, range, ',')) {
+                if (range.empty() || !isdigit(range[0])) {
+                    continue;
+                }
+                auto dash = range.find('-');
+                int first = std::stoi(range.substr(0, dash));
+                int last = dash == std::string::npos ? first : std::stoi(range.substr(dash + 1));
+                for (int cpu = first; cpu <= last; cpu++) {
+                    cpus.emplace_back(cpu, node);
+                }
+            }
+        }
+        if (cpus.empty()) {
+            for (unsigned cpu = 0; cpu < std::max(1u, std::thread::hardware_concurrency()); cpu++) {
+                cpus.emplace_back(cpu, 0);
+            }
+        }
+        return cpus;
+    }
+
+    std::vector<std::unique_ptr<Worker>> workers_;
+    std::atomic<size_t> next_victim_{0}; // submit()时第一个块分给哪个线程
+    std::mutex sleep_latch_;             // 保护stop_，和sleep_cv_一起用于空闲线程的休眠和唤醒
+    std::condition_variable sleep_cv_;
+    std::atomic<size_t> queued_{0}; // 所有队列中的任务总数
+    bool stop_ = false;
+};
@@ -0,0 +1,170 @@
+/* Copyright (c) 2023 Renmin University of China
+RMDB is licensed under Mulan PSL v2.
+You can use this software according to the terms and conditions of the Mulan PSL v2.
+You may obtain a copy of Mulan PSL v2 at:
+        http://license.coscl.org.cn/MulanPSL2
+THIS SOFTWARE IS PROVIDED ON AN "AS IS" BASIS, WITHOUT WARRANTIES OF ANY KIND,
+EITHER EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO NON-INFRINGEMENT,
+MERCHANTABILITY OR FIT FOR A PARTICULAR PURPOSE.
+See the Mulan PSL v2 for more details. */
+
+#pragma once
+
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <fstream>
+#include <iomanip>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <vector>
+
+#include "common/config.h"
+
+// 一个已结束的span，name必须是字符串字面量
+struct TraceEvent {
+    const char *name;
+    uint64_t start_ns;
+    uint64_t dur_ns;
+};
+
+// 每个线程私有的环形缓冲区，写满后覆盖最旧的事件
+class TraceBuffer {
+  public:
+    explicit TraceBuffer(int tid) : tid_(tid), events_(TRACE_BUFFER_SIZE) {
+    }
+
+    void record(const TraceEvent &event) {
+        // 只和dump竞争，正常情况下不会阻塞
+        std::scoped_lock lock{latch_};
+        events_[head_ % events_.size()] = event;
+        head_++;
+    }
+
+    // 按时间顺序取出缓冲区中的事件
+    std::vector<TraceEvent> snapshot() {
+        std::scoped_lock lock{latch_};
+        std::vector<TraceEvent> result;
+        size_t begin = head_ > events_.size() ? head_ - events_.size() : 0;
+        for (size_t i = begin; i < head_; i++) {
+            result.push_back(events_[i % events_.size()]);
+        }
+        return result;
+    }
+
+    const int tid_;
+    std::atomic<bool> alive_{true}; // 所属线程是否还在运行
+
+  private:
+    std::mutex latch_;
+    std::vector<TraceEvent> events_;
+    size_t head_ = 0;
+};
+
+/**
+ * 可选开启的追踪器，记录纳秒精度的span，导出为Chrome trace_event格式（chrome://tracing或Perfetto打开）
+ * 关闭时每个span只有一次原子读的开销
+ */
+class Tracer {
+  public:
+    static bool enabled() {
+        return enabled_.load(std::memory_order_relaxed);
+    }
+
+    // 开启追踪，同时丢弃已退出线程的缓冲区
+    static void start() {
+        std::scoped_lock lock{registry_latch_};
+        std::vector<std::shared_ptr<TraceBuffer>> alive;
+        for (auto &buffer : buffers_) {
+            if (buffer->alive_) {
+                alive.push_back(buffer);
+            }
+        }
+        buffers_ = std::move(alive);
+        enabled_ = true;
+    }
+
+    static void stop() {
+        enabled_ = false;
+    }
+
+    static uint64_t now_ns() {
+        return std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now().time_since_epoch())
+            .count();
+    }
+
+    static void record(const char *name, uint64_t start_ns, uint64_t end_ns) {
+        local_buffer()->record({name, start_ns, end_ns - start_ns});
+    }
+
+    // 把所有线程的事件写成Chrome trace_event JSON，返回写出的事件数
+    static size_t dump(const std::string &path) {
+        std::vector<std::shared_ptr<TraceBuffer>> buffers;
+        {
+            std::scoped_lock lock{registry_latch_};
+            buffers = buffers_;
+        }
+        std::ofstream out(path, std::ios::out | std::ios::trunc);
+        // Chrome trace的时间单位为微秒，保留三位小数以体现纳秒精度
+        out << std::fixed << std::setprecision(3) << "{\"traceEvents\":[";
+        size_t count = 0;
+        for (auto &buffer : buffers) {
+            for (auto &event : buffer->snapshot()) {
+                out << (count == 0 ? "" : ",") << "\n{\"name\":\"" << event.name
+                    << "\",\"ph\":\"X\",\"pid\":1,\"tid\":" << buffer->tid_ << ",\"ts\":" << event.start_ns / 1000.0
+                    << ",\"dur\":" << event.dur_ns / 1000.0 << "}";
+                count++;
+            }
+        }
+        out << "\n],\"displayTimeUnit\":\"ns\"}\n";
+        return count;
+    }
+
+  private:
+    // 线程退出时把缓冲区标记为已退出，缓冲区本身保留到下一次start()，以便dump
+    struct BufferHolder {
+        std::shared_ptr<TraceBuffer> buffer;
+        ~BufferHolder() {
+            if (buffer != nullptr) {
+                buffer->alive_ = false;
+            }
+        }
+    };
+
+    static TraceBuffer *local_buffer() {
+        static thread_local BufferHolder holder;
+        if (holder.buffer == nullptr) {
+            std::scoped_lock lock{registry_latch_};
+            holder.buffer = std::make_shared<TraceBuffer>(next_tid_++);
+            buffers_.push_back(holder.buffer);
+        }
+        return holder.buffer.get();
+    }
+
+    static inline std::atomic<bool> enabled_{false};
+    static inline std::mutex registry_latch_;
+    static inline std::vector<std::shared_ptr<TraceBuffer>> buffers_;
+    static inline int next_tid_ = 1;
+};
+
+// RAII span，构造时记录开始时间，析构时写入当前线程的缓冲区
+class TraceSpan {
+  public:
+    explicit TraceSpan(const char *name) : name_(name), start_ns_(Tracer::enabled() ? Tracer::now_ns() : 0) {
+    }
+
+    ~TraceSpan() {
+        if (start_ns_ != 0 && Tracer::enabled()) {
+            Tracer::record(name_, start_ns_, Tracer::now_ns());
+        }
+    }
+
+  private:
+    const char *name_;
+    uint64_t start_ns_;
+};
+
+#define TRACE_CONCAT_INNER(a, b) a##b
+#define TRACE_CONCAT(a, b) TRACE_CONCAT_INNER(a, b)
+#define TRACE_SPAN(name) TraceSpan TRACE_CONCAT(trace_span_, __LINE__)(name)
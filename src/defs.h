@@ -39,6 +39,11 @@ struct Rid {
     friend bool operator!=(const Rid &x, const Rid &y) {
         return !(x == y);
     }
+
+    // 按记录在文件中的位置排序
+    friend bool operator<(const Rid &x, const Rid &y) {
+        return x.page_no < y.page_no || (x.page_no == y.page_no && x.slot_no < y.slot_no);
+    }
 };
 
 enum ColType { TYPE_INT, TYPE_FLOAT, TYPE_STRING, TYPE_NULL, TYPE_DATE };
@@ -181,15 +181,53 @@ class IncompatibleTypeError : public RMDBError {
     }
 };
 
+class DivisionByZeroError : public RMDBError {
+  public:
+    DivisionByZeroError() : RMDBError("Division by zero") {
+    }
+};
+
 class AmbiguousColumnError : public RMDBError {
   public:
     AmbiguousColumnError(const std::string &col_name) : RMDBError("Ambiguous column: " + col_name) {
     }
 };
 
+class UnsupportedConditionError : public RMDBError {
+  public:
+    UnsupportedConditionError(const std::string &msg) : RMDBError("Unsupported condition: " + msg) {
+    }
+};
+
+class InvalidLimitError : public RMDBError {
+  public:
+    InvalidLimitError(const std::string &clause, int value)
+        : RMDBError("Invalid " + clause + ": " + std::to_string(value)) {
+    }
+};
+
 class PageNotExistError : public RMDBError {
   public:
     PageNotExistError(const std::string &table_name, int page_no)
         : RMDBError("Page " + std::to_string(page_no) + " in table " + table_name + "not exits") {
     }
-};
\ No newline at end of file
+};
+
+class InvalidPartitionError : public RMDBError {
+  public:
+    InvalidPartitionError(const std::string &msg) : RMDBError("Invalid partition: " + msg) {
+    }
+};
+
+class InvalidViewError : public RMDBError {
+  public:
+    InvalidViewError(const std::string &msg) : RMDBError("Invalid materialized view: " + msg) {
+    }
+};
+
+class ConfigError : public RMDBError {
+  public:
+    ConfigError(const std::string &key, const std::string &value)
+        : RMDBError("Invalid config: " + key + " = " + value) {
+    }
+};
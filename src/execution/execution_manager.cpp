@@ -27,10 +27,17 @@ const char *help_info = "Supported SQL syntax:\n"
                         "  DROP TABLE table_name\n"
                         "  CREATE INDEX table_name (column_name)\n"
                         "  DROP INDEX table_name (column_name)\n"
+                        "  CREATE MATERIALIZED VIEW view_name AS SELECT selector FROM table_name GROUP BY column_list\n"
+                        "  DROP MATERIALIZED VIEW view_name\n"
                         "  INSERT INTO table_name VALUES (value [, value ...])\n"
                         "  DELETE FROM table_name [WHERE where_clause]\n"
                         "  UPDATE table_name SET column_name = value [, column_name = value ...] [WHERE where_clause]\n"
                         "  SELECT selector FROM table_name [WHERE where_clause]\n"
+                        "  EXPLAIN ANALYZE {INSERT | DELETE | UPDATE | SELECT} ...\n"
+                        "  SET ENABLE_TRACE = {TRUE | FALSE}\n"
+                        "  DUMP TRACE\n"
+                        "  SHOW BUFFER POOL\n"
+                        "  RESET BUFFER POOL\n"
                         "type:\n"
                         "  {INT | FLOAT | CHAR(n)}\n"
                         "where_clause:\n"
@@ -49,7 +56,7 @@ void QlManager::run_mutli_query(std::shared_ptr<Plan> plan, Context *context) {
     if (auto x = std::dynamic_pointer_cast<DDLPlan>(plan)) {
         switch (x->tag) {
         case T_CreateTable: {
-            sm_manager_->create_table(x->tab_name_, x->cols_, context);
+            sm_manager_->create_table(x->tab_name_, x->cols_, context, x->temporary_, x->partition_);
             break;
         }
         case T_DropTable: {
@@ -68,6 +75,14 @@ void QlManager::run_mutli_query(std::shared_ptr<Plan> plan, Context *context) {
             sm_manager_->show_index(x->tab_name_, context);
             break;
         }
+        case T_CreateView: {
+            sm_manager_->create_view(x->tab_name_, x->view_, context);
+            break;
+        }
+        case T_DropView: {
+            sm_manager_->drop_view(x->tab_name_, context);
+            break;
+        }
         default:
             throw InternalError("Unexpected field type");
             break;
@@ -92,6 +107,21 @@ void QlManager::run_cmd_utility(std::shared_ptr<Plan> plan, txn_id_t *txn_id, Co
             sm_manager_->desc_table(x->tab_name_, context);
             break;
         }
+        case T_ShowBufferPool: {
+            sm_manager_->show_buffer_pool(context);
+            break;
+        }
+        case T_ResetBufferPool: {
+            sm_manager_->get_bpm()->reset_stats();
+            break;
+        }
+        case T_DumpTrace: {
+            size_t num_events = Tracer::dump(TRACE_FILE_NAME);
+            std::string str = "dump " + std::to_string(num_events) + " trace events to " + TRACE_FILE_NAME + "\n";
+            memcpy(context->data_send_ + *(context->offset_), str.c_str(), str.length());
+            *(context->offset_) += str.length();
+            break;
+        }
         case T_Transaction_begin: {
             // 显示开启一个事务
             context->txn_->set_txn_mode(true);
@@ -127,6 +157,14 @@ void QlManager::run_cmd_utility(std::shared_ptr<Plan> plan, txn_id_t *txn_id, Co
             planner_->set_enable_sortmerge_join(x->bool_value_);
             break;
         }
+        case ast::SetKnobType::EnableTrace: {
+            if (x->bool_value_) {
+                Tracer::start();
+            } else {
+                Tracer::stop();
+            }
+            break;
+        }
         default: {
             throw RMDBError("Not implemented!\n");
             break;
@@ -156,18 +194,20 @@ void QlManager::select_from(std::unique_ptr<AbstractExecutor> executorTreeRoot,
     std::fstream outfile;
     outfile.open("output.txt", std::ios::out | std::ios::app);
 
-    outfile << "|";
+    // 写入文件的内容同时保存在context中，结果缓存命中时重新写入
+    std::string &output = context->select_output_;
+    output = "|";
     for (int i = 0; i < captions.size(); ++i) {
-        outfile << " " << captions[i] << " |";
+        output += " " + captions[i] + " |";
     }
-    outfile << "\n";
+    output += "\n";
+    outfile << output;
 
     // Print records
     size_t num_rec = 0;
     // 执行query_plan
-    auto _root = dynamic_cast<ProjectionExecutor *>(executorTreeRoot.release());
-    assert(_root != nullptr); // 非常糟糕的做法
-    std::unique_ptr<ProjectionExecutor> root(_root);
+    // 根节点是投影或者LIMIT
+    std::unique_ptr<AbstractExecutor> root = std::move(executorTreeRoot);
     for (root->beginTuple(); !root->is_end(); root->nextTuple()) {
         // 先select然后project，project计划包含select子计划
         auto Tuple = root->Next();
@@ -196,12 +236,15 @@ void QlManager::select_from(std::unique_ptr<AbstractExecutor> executorTreeRoot,
         // print record into buffer
         rec_printer.print_record(columns, context);
         // print record into file
-        outfile << "|";
+        size_t line_begin = output.size();
+        output += "|";
         for (int i = 0; i < columns.size(); ++i) {
-            outfile << " " << columns[i] << " |";
+            output += " " + columns[i] + " |";
         }
-        outfile << "\n";
+        output += "\n";
+        outfile << std::string_view(output).substr(line_begin);
         num_rec++;
+        thread_stats().tuples_produced++;
     }
     outfile.close();
     // Print footer into buffer
@@ -213,4 +256,27 @@ void QlManager::select_from(std::unique_ptr<AbstractExecutor> executorTreeRoot,
 // 执行DML语句
 void QlManager::run_dml(std::unique_ptr<AbstractExecutor> exec) {
     exec->Next();
+}
+
+// 执行explain analyze语句：照常执行查询（DML会真正修改数据），但不输出结果，改为输出本条语句的资源消耗
+void QlManager::explain_analyze(std::unique_ptr<AbstractExecutor> root, bool is_select, Context *context) {
+    if (is_select) {
+        for (root->beginTuple(); !root->is_end(); root->nextTuple()) {
+            root->Next();
+            thread_stats().tuples_produced++;
+        }
+    } else {
+        root->Next();
+    }
+    context->collect_stats();
+
+    RecordPrinter rec_printer(2);
+    rec_printer.print_separator(context);
+    rec_printer.print_record({"metric", "value"}, context);
+    rec_printer.print_separator(context);
+    for (auto &[name, value] : context->stats_.items()) {
+        rec_printer.print_record({name, std::to_string(value)}, context);
+    }
+    rec_printer.print_record({"elapsed_ms", std::to_string(context->elapsed_ms())}, context);
+    rec_printer.print_separator(context);
 }
\ No newline at end of file
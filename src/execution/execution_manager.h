@@ -45,4 +45,6 @@ class QlManager {
                      Context *context);
 
     void run_dml(std::unique_ptr<AbstractExecutor> exec);
+
+    void explain_analyze(std::unique_ptr<AbstractExecutor> root, bool is_select, Context *context);
 };
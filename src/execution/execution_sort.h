@@ -10,13 +10,15 @@ See the Mulan PSL v2 for more details. */
 
 #pragma once
 
+#include "common/server_config.h"
 #include "execution/external_merge_sort.h"
 #include "executor_abstract.h"
 
 class SortExecutor : public AbstractExecutor {
   private:
     std::unique_ptr<AbstractExecutor> prev_;
-    ColMeta cols_; // 框架中只支持一个键排序，需要自行修改数据结构支持多个键排序
+    ColMeta cols_;      // 框架中只支持一个键排序，需要自行修改数据结构支持多个键排序
+    KeyComparator cmp_; // 按排序列比较两条记录
     size_t tuple_num;
     bool is_desc_;
     std::vector<size_t> used_tuple;
@@ -25,43 +27,55 @@ class SortExecutor : public AbstractExecutor {
     std::unique_ptr<RmRecord> buffer;
     bool is_end_ = false;
 
+    size_t limit_hint_ = 0;                       // 上层只读取前limit_hint_条记录，0表示没有限制
+    std::vector<std::unique_ptr<RmRecord>> top_; // top-N模式下保留的记录，读完输入后按顺序排好
+    size_t top_pos_ = 0;                          // top-N模式下下一条要输出的记录
+
   public:
     SortExecutor(std::unique_ptr<AbstractExecutor> prev, const TabCol &sel_cols, bool is_desc) {
         prev_ = std::move(prev);
         cols_ = prev_->get_col_offset(sel_cols);
+        cmp_ = KeyComparator::create({cols_}, {cols_});
         is_desc_ = is_desc;
         tuple_num = 0;
         used_tuple.clear();
-        auto cmp = [](const void *a, const void *b, void *arg) {
-            auto col = (ColMeta *)arg;
-            auto lvalue = Value::col2Value((const char *)a, *col);
-            auto rvalue = Value::col2Value((const char *)b, *col);
-            if (lvalue < rvalue) {
-                return -1;
-            } else if (lvalue > rvalue) {
-                return 1;
-            } else {
-                return 0;
-            }
-        };
-        sorter = std::make_unique<ExternalMergeSorter>(1024 * 1024 * 800, prev_->tupleLen(), cmp, &cols_);
+        sorter = std::make_unique<ExternalMergeSorter>(server_config.sort_memory, prev_->tupleLen(), cmp_, is_desc_);
+    }
+
+    void set_limit_hint(size_t n) override {
+        limit_hint_ = n;
     }
 
     void beginTuple() override {
-        for (prev_->beginTuple(); !prev_->is_end(); prev_->nextTuple()) {
-            sorter->write(prev_->Next()->data);
+        TRACE_SPAN("Sort::beginTuple");
+        is_end_ = false;
+        if (use_top_n()) {
+            begin_top_n();
+        } else {
+            for (prev_->beginTuple(); !prev_->is_end(); prev_->nextTuple()) {
+                sorter->write(prev_->Next()->data);
+            }
+            sorter->endWrite();
+            sorter->beginRead();
         }
-        sorter->endWrite();
-        sorter->beginRead();
         nextTuple();
     }
 
     void nextTuple() override {
+        TRACE_SPAN("Sort::nextTuple");
+        assert(buffer == nullptr); // 保证上次的记录已经被`Next`取走
+        if (use_top_n()) {
+            if (top_pos_ == top_.size()) {
+                is_end_ = true;
+                return;
+            }
+            buffer = std::move(top_[top_pos_++]);
+            return;
+        }
         if (sorter->is_end()) {
             is_end_ = true;
             return;
         }
-        assert(buffer == nullptr); // 保证上次的记录已经被`Next`取走
         buffer = std::make_unique<RmRecord>(prev_->tupleLen());
         sorter->read(buffer->data);
     }
@@ -85,4 +99,37 @@ class SortExecutor : public AbstractExecutor {
     ExecutorType getType() override {
         return ExecutorType::SORT_EXECUTOR;
     }
-};
\ No newline at end of file
+
+  private:
+    // 按排序列比较两条记录，降序时结果取反
+    int compare(const char *a, const char *b) const {
+        int res = cmp_(a, b);
+        return is_desc_ ? -res : res;
+    }
+
+    // 只需要前N条且N条记录放得进排序内存时，用大小为N的堆代替外部排序
+    bool use_top_n() const {
+        return limit_hint_ > 0 && limit_hint_ <= server_config.sort_memory / prev_->tupleLen();
+    }
+
+    // 读完输入，堆顶是已保留的记录中最靠后的一条，新记录排在它前面时替换堆顶
+    void begin_top_n() {
+        auto before = [this](const std::unique_ptr<RmRecord> &a, const std::unique_ptr<RmRecord> &b) {
+            return compare(a->data, b->data) < 0;
+        };
+        top_.clear();
+        top_pos_ = 0;
+        for (prev_->beginTuple(); !prev_->is_end(); prev_->nextTuple()) {
+            auto record = prev_->Next();
+            if (top_.size() < limit_hint_) {
+                top_.push_back(std::move(record));
+                std::push_heap(top_.begin(), top_.end(), before);
+            } else if (before(record, top_.front())) {
+                std::pop_heap(top_.begin(), top_.end(), before);
+                top_.back() = std::move(record);
+                std::push_heap(top_.begin(), top_.end(), before);
+            }
+        }
+        std::sort_heap(top_.begin(), top_.end(), before);
+    }
+};
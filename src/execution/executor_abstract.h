@@ -11,7 +11,9 @@ See the Mulan PSL v2 for more details. */
 #pragma once
 
 #include "common/common.h"
+#include "common/tracer.h"
 #include "execution_defs.h"
+#include "runtime_filter.h"
 #include "index/ix.h"
 #include "system/sm.h"
 
@@ -26,6 +28,10 @@ enum ExecutorType {
     SORT_EXECUTOR,
     INSERT_EXECUTOR,
     INDEX_SCAN_EXECUTOR,
+    GATHER_EXECUTOR,
+    LIMIT_EXECUTOR,
+    INDEX_UNION_EXECUTOR,
+    SEMI_JOIN_EXECUTOR,
 };
 
 class AbstractExecutor {
@@ -68,6 +74,15 @@ class AbstractExecutor {
 
     virtual std::unique_ptr<RmRecord> Next() = 0;
 
+    // 接收join下推的运行时过滤器，返回false表示该算子不支持，由join自行过滤
+    virtual bool set_runtime_filter(std::shared_ptr<RuntimeFilter> filter) {
+        return false;
+    }
+
+    // 上层最多只读取前n条记录，算子可以据此提前结束或减少缓存，默认忽略
+    virtual void set_limit_hint(size_t n) {
+    }
+
     virtual ColMeta get_col_offset(const TabCol &target) {
         throw InternalError("virtual member function not implemented");
     }
@@ -99,6 +99,7 @@ class AggregationExecutor : public AbstractExecutor {
     }
 
     void beginTuple() override {
+        TRACE_SPAN("Aggregation::beginTuple");
         for (prev_->beginTuple(); !prev_->is_end(); prev_->nextTuple()) {
             auto record = prev_->Next();
             store_group(std::move(record));
@@ -107,6 +108,7 @@ class AggregationExecutor : public AbstractExecutor {
     }
 
     void nextTuple() override {
+        TRACE_SPAN("Aggregation::nextTuple");
         do {
             if (grouped_records_.empty() && group_cols_.empty()) {
                 if (!empty_table_aggr_) {
@@ -135,7 +137,7 @@ class AggregationExecutor : public AbstractExecutor {
             // 逻辑不短路，目前只实现逻辑与
             if (!std::all_of(having_conds_.begin(), having_conds_.end(), [base, this](const Condition &cond) {
                     if (cond.lhs_col.aggr == ast::NO_AGGR) {
-                        auto value = Value::col2Value(base, *get_col(sel_cols_initial_, cond.lhs_col, true));
+                        auto value = ValueView::of(base, *get_col(sel_cols_initial_, cond.lhs_col, true));
                         return cond.eval_with_rvalue(value);
                     } else {
                         ColMeta col_meta;
@@ -145,7 +147,7 @@ class AggregationExecutor : public AbstractExecutor {
                             col_meta = *get_col(sel_cols_initial_, cond.lhs_col, true);
                         }
                         auto value = aggregate_value(col_meta);
-                        return cond.eval_with_rvalue(value);
+                        return cond.eval_with_rvalue(ValueView::of(value));
                     }
                 })) {
                 to_delete.push_back(i);
@@ -160,6 +162,18 @@ class AggregationExecutor : public AbstractExecutor {
         return true;
     }
 
+    // 返回当前分组中该列最大（最小）的记录，比较时不构造Value
+    const char *extreme_record(const ColMeta &sel_col, bool is_max) {
+        const char *best = curr_records[0]->data;
+        for (auto &record : curr_records) {
+            int res = ValueView::of(record->data, sel_col).compare(ValueView::of(best, sel_col));
+            if (is_max ? res > 0 : res < 0) {
+                best = record->data;
+            }
+        }
+        return best;
+    }
+
     ColMeta make_count_star_col(TabCol c) {
         ColMeta col;
         col.name = "*";
@@ -193,22 +207,12 @@ class AggregationExecutor : public AbstractExecutor {
             break;
         case ast::AGGR_TYPE_MAX:
             val.type = sel_col.type;
-            val = Value::col2Value(curr_records[0]->data, sel_col);
-            for (auto &record : curr_records) {
-                Value tmp = Value::col2Value(record->data, sel_col);
-                if (tmp > val)
-                    val = tmp;
-            }
+            val = Value::col2Value(extreme_record(sel_col, true), sel_col);
             val.init_raw(sel_col.len);
             break;
         case ast::AGGR_TYPE_MIN:
             val.type = sel_col.type;
-            val = Value::col2Value(curr_records[0]->data, sel_col);
-            for (auto &record : curr_records) {
-                Value tmp = Value::col2Value(record->data, sel_col);
-                if (tmp < val)
-                    val = tmp;
-            }
+            val = Value::col2Value(extreme_record(sel_col, false), sel_col);
             val.init_raw(sel_col.len);
             break;
         case ast::AGGR_TYPE_SUM:
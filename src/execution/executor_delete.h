@@ -23,6 +23,7 @@ class DeleteExecutor : public AbstractExecutor {
     std::vector<Rid> rids_;        // 需要删除的记录的位置
     std::string tab_name_;         // 表名称
     SmManager *sm_manager_;
+    bool has_views_;               // 表上建有物化视图，删除后要用删除的记录维护视图
 
   public:
     DeleteExecutor(SmManager *sm_manager, const std::string &tab_name, std::vector<Condition> conds,
@@ -34,9 +35,11 @@ class DeleteExecutor : public AbstractExecutor {
         conds_ = std::move(conds);
         rids_ = std::move(rids);
         context_ = context;
+        has_views_ = sm_manager_->has_views(tab_name);
     }
 
     std::unique_ptr<RmRecord> Next() override {
+        TRACE_SPAN("Delete::Next");
         for (const Rid &rid : rids_) {
 
             // Update index
@@ -51,7 +54,7 @@ class DeleteExecutor : public AbstractExecutor {
                     memcpy(key + offset, record->data + col->offset, col->len);
                     offset += col->len;
                 }
-                ih->delete_entry(key, context_->txn_);
+                ih->delete_entry(key, rid, context_->txn_);
                 delete[] key;
             }
 
@@ -64,7 +67,15 @@ class DeleteExecutor : public AbstractExecutor {
                 context_->txn_->append_write_record(write_record);
             }
 
+            std::unique_ptr<RmRecord> old_record = has_views_ ? fh_->get_record(rid, context_) : nullptr;
             fh_->delete_record(rid, context_);
+            if (old_record != nullptr) {
+                sm_manager_->maintain_views(tab_name_, old_record->data, nullptr, context_);
+            }
+            thread_stats().tuples_produced++;
+        }
+        if (!rids_.empty()) {
+            sm_manager_->bump_table_version(tab_name_);
         }
         return nullptr;
     }
@@ -0,0 +1,250 @@
+/* Copyright (c) 2023 Renmin University of China
+RMDB is licensed under Mulan PSL v2.
+You can use this software according to the terms and conditions of the Mulan PSL v2.
+You may obtain a copy of Mulan PSL v2 at:
+        http://license.coscl.org.cn/MulanPSL2
+THIS SOFTWARE IS PROVIDED ON AN "AS IS" BASIS, WITHOUT WARRANTIES OF ANY KIND,
+EITHER EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO NON-INFRINGEMENT,
+MERCHANTABILITY OR FIT FOR A PARTICULAR PURPOSE.
+See the Mulan PSL v2 for more details. */
+
+#pragma once
+
+#include "common/task_scheduler.h"
+#include "execution_defs.h"
+#include "executor_abstract.h"
+#include "parallel_scan.h"
+
+/**
+ * gather交换算子：代替SeqScanExecutor并行扫描大表。每个morsel由TaskScheduler的线程独立完成过滤和投影，
+ * 结果写入该morsel自己的缓冲区，gather按morsel顺序输出，因此输出顺序和串行扫描完全相同。
+ * 同时提交的morsel不超过GATHER_MORSELS_PER_WORKER * 线程数，输出完一个morsel才提交下一个，
+ * 上层读得慢时内存中只保留这个窗口内的结果，而不是整张表。
+ * 等待的morsel尚未完成时，调用线程自己领取morsel执行，而不是空等
+ */
+class GatherExecutor : public AbstractExecutor {
+  private:
+    // 一个morsel中满足条件的记录（投影后），由执行该morsel的线程写入
+    struct MorselResult {
+        std::vector<char> data;
+        std::vector<Rid> rids;
+        std::atomic<bool> done{false};
+    };
+
+    ParallelTableScan scan_;
+    std::vector<ColMeta> cols_;     // 输出的列
+    std::vector<ColMeta> src_cols_; // cols_在表记录中对应的列，为空表示输出整条记录
+    size_t len_;
+
+    std::unique_ptr<MorselResult[]> morsels_;
+    size_t num_morsels_ = 0;
+    std::deque<std::shared_ptr<TaskGroup>> in_flight_; // 从curr_morsel_开始已提交的各morsel的任务
+    size_t next_submit_ = 0;                           // 下一个要提交的morsel
+    size_t window_ = 0;                                // 最多同时提交的morsel数
+    bool limit_reached_ = false;                       // 已完成的morsel足够上层使用，不再提交
+    size_t curr_morsel_ = 0;
+    size_t curr_row_ = 0;
+    size_t rows_before_ = 0; // curr_morsel_之前的morsel共输出的记录数
+    size_t limit_hint_ = 0;  // 上层只读取前limit_hint_条记录，0表示没有限制
+    Rid rid_{};
+
+  public:
+    /**
+     * @param {vector<TabCol>} proj_cols 上层只需要的列，工作线程只拷贝这些列；为空时输出整条记录
+     */
+    GatherExecutor(SmManager *sm_manager, std::string tab_name, std::vector<Condition> conds,
+                   const std::vector<TabCol> &proj_cols, Context *context)
+        : scan_(sm_manager, std::move(tab_name), std::move(conds)) {
+        context_ = context;
+        if (proj_cols.empty()) {
+            cols_ = scan_.cols();
+            len_ = scan_.tuple_len();
+            return;
+        }
+        size_t offset = 0;
+        for (auto &proj_col : proj_cols) {
+            auto pos = get_col(scan_.cols(), proj_col);
+            bool seen = std::any_of(src_cols_.begin(), src_cols_.end(),
+                                    [&pos](const ColMeta &col) { return col.name == pos->name; });
+            if (seen) {
+                continue;
+            }
+            src_cols_.push_back(*pos);
+            auto col = *pos;
+            col.offset = offset;
+            offset += col.len;
+            cols_.push_back(col);
+        }
+        len_ = offset;
+    }
+
+    ~GatherExecutor() override {
+        try {
+            finish(true);
+        } catch (std::exception &) {
+            // 析构时只需要确保工作线程不再访问本算子，任务的异常已经没有意义
+        }
+    }
+
+    [[nodiscard]] size_t tupleLen() const override {
+        return len_;
+    }
+
+    [[nodiscard]] const std::vector<ColMeta> &cols() const override {
+        return cols_;
+    }
+
+    void beginTuple() override {
+        TRACE_SPAN("Gather::beginTuple");
+        finish(true);
+        scan_.begin();
+        num_morsels_ = scan_.num_morsels();
+        morsels_ = std::make_unique<MorselResult[]>(num_morsels_);
+        curr_morsel_ = 0;
+        curr_row_ = 0;
+        rows_before_ = 0;
+        next_submit_ = 0;
+        window_ = GATHER_MORSELS_PER_WORKER * TaskScheduler::instance().num_workers();
+        limit_reached_ = false;
+        submit_morsels();
+        seek();
+    }
+
+    void nextTuple() override {
+        TRACE_SPAN("Gather::nextTuple");
+        curr_row_++;
+        seek();
+    }
+
+    [[nodiscard]] bool is_end() const override {
+        return curr_morsel_ >= num_morsels_;
+    }
+
+    std::unique_ptr<RmRecord> Next() override {
+        auto &morsel = morsels_[curr_morsel_];
+        return std::make_unique<RmRecord>(len_, morsel.data.data() + curr_row_ * len_);
+    }
+
+    Rid &rid() override {
+        rid_ = morsels_[curr_morsel_].rids[curr_row_];
+        return rid_;
+    }
+
+    bool set_runtime_filter(std::shared_ptr<RuntimeFilter> filter) override {
+        return scan_.set_runtime_filter(std::move(filter));
+    }
+
+    void set_limit_hint(size_t n) override {
+        limit_hint_ = n;
+    }
+
+    ColMeta get_col_offset(const TabCol &target) override {
+        auto it = std::find_if(cols_.begin(), cols_.end(),
+                               [&target](const ColMeta &col) { return col.name == target.col_name; });
+        assert(it != cols_.end());
+        return *it;
+    }
+
+    ExecutorType getType() override {
+        return GATHER_EXECUTOR;
+    }
+
+    [[nodiscard]] std::string tableName() const override {
+        return scan_.tab_name();
+    };
+
+  private:
+    // 在工作线程中执行：扫描一个morsel，把满足条件的记录投影后写入该morsel的缓冲区
+    void run_morsel(size_t i) {
+        auto &morsel = morsels_[i];
+        scan_.scan_morsel(i, [&](const Rid &rid, const char *record) {
+            size_t pos = morsel.data.size();
+            morsel.data.resize(pos + len_);
+            if (src_cols_.empty()) {
+                memcpy(morsel.data.data() + pos, record, len_);
+            } else {
+                for (size_t j = 0; j < src_cols_.size(); j++) {
+                    memcpy(morsel.data.data() + pos + cols_[j].offset, record + src_cols_[j].offset, cols_[j].len);
+                }
+            }
+            morsel.rids.push_back(rid);
+        });
+        morsel.done.store(true, std::memory_order_release);
+    }
+
+    // 补充提交morsel，直到窗口填满
+    void submit_morsels() {
+        while (!limit_reached_ && next_submit_ < num_morsels_ && next_submit_ - curr_morsel_ < window_) {
+            size_t morsel = next_submit_++;
+            in_flight_.push_back(
+                TaskScheduler::instance().submit(1, [this, morsel](size_t, size_t) { run_morsel(morsel); }));
+        }
+    }
+
+    // 定位到下一条记录，已经输出完的morsel立即释放，并提交窗口之后的下一个morsel
+    void seek() {
+        while (curr_morsel_ < num_morsels_) {
+            auto &morsel = morsels_[curr_morsel_];
+            wait_morsel(morsel);
+            if (curr_row_ < morsel.rids.size()) {
+                if (limit_hint_ > 0 && rows_before_ + morsel.rids.size() >= limit_hint_ && !limit_reached_) {
+                    // 已完成的morsel足够上层使用，后面的morsel不必再扫描
+                    limit_reached_ = true;
+                    for (size_t i = 1; i < in_flight_.size(); i++) {
+                        in_flight_[i]->cancel();
+                    }
+                }
+                return;
+            }
+            rows_before_ += morsel.rids.size();
+            std::vector<char>().swap(morsel.data);
+            std::vector<Rid>().swap(morsel.rids);
+            in_flight_.front()->wait(); // 任务已经结束，合并工作线程的统计
+            in_flight_.pop_front();
+            curr_morsel_++;
+            curr_row_ = 0;
+            submit_morsels();
+        }
+        finish(false);
+    }
+
+    void wait_morsel(MorselResult &morsel) {
+        if (in_flight_.empty()) {
+            throw InternalError("Gather: morsel was cancelled");
+        }
+        auto &group = in_flight_.front();
+        auto done = [&morsel] { return morsel.done.load(std::memory_order_acquire); };
+        while (!done()) {
+            if (!group->run_one(0)) {
+                group->wait_until(done);
+                if (!done()) {
+                    throw InternalError("Gather: morsel was cancelled");
+                }
+            }
+        }
+    }
+
+    // 等待已提交的任务全部结束并合并工作线程的统计，cancel为true时放弃尚未开始的morsel
+    void finish(bool cancel) {
+        if (cancel) {
+            for (auto &group : in_flight_) {
+                group->cancel();
+            }
+        }
+        // 每个任务都要等到结束，之后才能释放morsels_，第一个异常在最后重新抛出
+        std::exception_ptr error;
+        for (auto &group : in_flight_) {
+            try {
+                group->wait();
+            } catch (...) {
+                if (error == nullptr) {
+                    error = std::current_exception();
+                }
+            }
+        }
+        in_flight_.clear();
+        if (error != nullptr) {
+            std::rethrow_exception(error);
+        }
+    }
+};
@@ -0,0 +1,270 @@
+/* Copyright (c) 2023 Renmin University of China
+RMDB is licensed under Mulan PSL v2.
+You can use this software according to the terms and conditions of the Mulan PSL v2.
+You may obtain a copy of Mulan PSL v2 at:
+        http://license.coscl.org.cn/MulanPSL2
+THIS SOFTWARE IS PROVIDED ON AN "AS IS" BASIS, WITHOUT WARRANTIES OF ANY KIND,
+EITHER EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO NON-INFRINGEMENT,
+MERCHANTABILITY OR FIT FOR A PARTICULAR PURPOSE.
+See the Mulan PSL v2 for more details. */
+
+#pragma once
+
+#include <climits>
+#include <cmath>
+
+#include "execution_defs.h"
+#include "executor_abstract.h"
+#include "index/ix.h"
+#include "system/sm.h"
+
+/**
+ * 不扫描记录，直接从索引和表的元数据得到不分组的聚合结果：
+ * 1. MIN(col)/MAX(col)：WHERE只有若干等值条件，且存在索引以这些列为前缀、紧接着是col时，
+ *    在前缀范围的第一个/最后一个索引项上读出结果，只需要一次lower_bound/upper_bound（分区表上每个分区各一次）；
+ * 2. 没有WHERE条件的COUNT：直接返回表中维护的记录数（表中没有NULL，COUNT(col)等于COUNT(*)）。
+ * 没有满足条件的记录时和AggregationExecutor一致，输出一行NULL
+ */
+class IndexAggregationExecutor : public AbstractExecutor {
+  private:
+    SmManager *sm_manager_;
+    std::string tab_name_;
+    std::vector<Condition> conds_;
+    std::vector<ColMeta> sel_cols_initial_; // 聚合的列，offset指向表中的记录
+    std::vector<ColMeta> sel_cols_;         // 输出的列
+    size_t len_;
+
+    std::unique_ptr<RmRecord> result_;
+    bool is_end_ = true;
+
+  public:
+    IndexAggregationExecutor(SmManager *sm_manager, std::string tab_name, std::vector<Condition> conds,
+                             const std::vector<TabCol> &sel_cols, Context *context) {
+        sm_manager_ = sm_manager;
+        tab_name_ = std::move(tab_name);
+        conds_ = std::move(conds);
+        context_ = context;
+        auto &tab_cols = sm_manager_->db_.get_table(tab_name_).cols;
+        size_t offset = 0;
+        for (auto &sel_col : sel_cols) {
+            ColMeta col;
+            if (sel_col.col_name == "*") {
+                col.name = "*";
+                col.tab_name = "";
+                col.alias = sel_col.alias;
+                col.type = TYPE_INT;
+                col.len = sizeof(int);
+            } else {
+                col = *get_col(tab_cols, sel_col);
+            }
+            col.aggr = sel_col.aggr;
+            sel_cols_initial_.push_back(col);
+            if (col.aggr == ast::AGGR_TYPE_COUNT) {
+                col.type = TYPE_INT;
+                col.len = sizeof(int);
+            }
+            col.offset = offset;
+            offset += col.len;
+            sel_cols_.push_back(col);
+        }
+        len_ = offset;
+    }
+
+    // 判断能否不扫描记录得到聚合结果，规则见类的注释
+    static bool supported(SmManager *sm_manager, const std::string &tab_name, const std::vector<Condition> &conds,
+                          const std::vector<TabCol> &sel_cols, const std::vector<TabCol> &group_cols,
+                          const std::vector<Condition> &having_conds) {
+        if (sel_cols.empty() || !group_cols.empty() || !having_conds.empty()) {
+            return false;
+        }
+        TabMeta &tab = sm_manager->db_.get_table(tab_name);
+        for (auto &sel_col : sel_cols) {
+            if (sel_col.aggr == ast::AGGR_TYPE_COUNT) {
+                if (!conds.empty()) {
+                    return false;
+                }
+            } else if (sel_col.aggr == ast::AGGR_TYPE_MAX || sel_col.aggr == ast::AGGR_TYPE_MIN) {
+                if (find_index(tab, conds, sel_col.col_name) == nullptr) {
+                    return false;
+                }
+            } else {
+                return false;
+            }
+        }
+        return true;
+    }
+
+    void beginTuple() override {
+        TRACE_SPAN("IndexAggregation::beginTuple");
+        TabMeta &tab = sm_manager_->db_.get_table(tab_name_);
+        std::vector<Value> values;
+        bool found = true;
+        for (auto &col : sel_cols_initial_) {
+            Value val;
+            if (col.aggr == ast::AGGR_TYPE_COUNT) {
+                int count = sm_manager_->fhs_.at(tab_name_)->get_num_records();
+                found = count > 0;
+                val.set_int(count);
+            } else {
+                found = probe(tab, col, val);
+            }
+            if (!found) {
+                break;
+            }
+            val.init_raw(col.aggr == ast::AGGR_TYPE_COUNT ? sizeof(int) : col.len);
+            values.push_back(std::move(val));
+        }
+        result_ = std::make_unique<RmRecord>(len_);
+        if (found) {
+            for (size_t i = 0; i < sel_cols_.size(); i++) {
+                memcpy(result_->data + sel_cols_[i].offset, values[i].raw->data, values[i].raw->size);
+            }
+        } else {
+            // 和AggregationExecutor一致：没有记录时输出一行NULL
+            for (auto &col : sel_cols_) {
+                col.type = TYPE_NULL;
+            }
+            memset(result_->data, 0, len_);
+        }
+        is_end_ = false;
+    }
+
+    void nextTuple() override {
+        is_end_ = true;
+    }
+
+    [[nodiscard]] bool is_end() const override {
+        return is_end_;
+    }
+
+    [[nodiscard]] const std::vector<ColMeta> &cols() const override {
+        return sel_cols_;
+    }
+
+    [[nodiscard]] size_t tupleLen() const override {
+        return len_;
+    }
+
+    std::unique_ptr<RmRecord> Next() override {
+        return std::make_unique<RmRecord>(*result_);
+    }
+
+    Rid &rid() override {
+        return _abstract_rid;
+    }
+
+    // 和AggregationExecutor相同，ProjectionExecutor据此直接使用本算子的输出列
+    ExecutorType getType() override {
+        return ExecutorType::AGGREGATION_EXECUTOR;
+    }
+
+  private:
+    /**
+     * @description: 找到可以回答MIN/MAX(col_name)的索引：conds全部是不同列上的等值条件，
+     * 索引的前conds.size()列恰好是这些列，下一列是col_name。
+     * 等值条件的值要写入索引键，除了int和float之间可以转换，值的类型必须和列相同
+     */
+    static const IndexMeta *find_index(TabMeta &tab, const std::vector<Condition> &conds,
+                                       const std::string &col_name) {
+        for (auto &cond : conds) {
+            if (!cond.is_rhs_val || cond.op != OP_EQ || cond.lhs_col.tab_name != tab.name) {
+                return nullptr;
+            }
+            auto col = tab.get_col(cond.lhs_col.col_name);
+            bool numeric = (col->type == TYPE_INT || col->type == TYPE_FLOAT) &&
+                           (cond.rhs_val.type == TYPE_INT || cond.rhs_val.type == TYPE_FLOAT);
+            if (cond.rhs_val.type != col->type && !numeric) {
+                return nullptr;
+            }
+        }
+        for (auto &index : tab.indexes) {
+            if (index.cols.size() <= conds.size() || index.cols[conds.size()].name != col_name) {
+                continue;
+            }
+            bool prefix_matched = std::all_of(index.cols.begin(), index.cols.begin() + conds.size(),
+                                              [&conds](const ColMeta &col) {
+                                                  return std::count_if(conds.begin(), conds.end(),
+                                                                       [&col](const Condition &cond) {
+                                                                           return cond.lhs_col.col_name == col.name;
+                                                                       }) == 1;
+                                              });
+            if (prefix_matched) {
+                return &index;
+            }
+        }
+        return nullptr;
+    }
+
+    /**
+     * @description: 在索引中等值前缀范围的第一项（MIN）或最后一项（MAX）上读出col的值
+     * @return {bool} 前缀范围为空时返回false
+     */
+    bool probe(TabMeta &tab, const ColMeta &col, Value &val) {
+        const IndexMeta *index = find_index(tab, conds_, col.name);
+        assert(index != nullptr);
+        auto ih = sm_manager_->ihs_.at(sm_manager_->get_ix_manager()->get_index_name(tab_name_, index->cols)).get();
+        bool is_max = col.aggr == ast::AGGR_TYPE_MAX;
+
+        // 前缀填等值条件的值，其余列填最小值（MIN）或最大值（MAX）
+        std::vector<char> key(index->col_tot_len);
+        std::vector<ColType> prefix_types;
+        std::vector<int> prefix_lens;
+        size_t offset = 0;
+        ColMeta key_col = col; // col在索引键中的位置
+        for (size_t i = 0; i < index->cols.size(); i++) {
+            auto &index_col = index->cols[i];
+            if (i < conds_.size()) {
+                auto cond = std::find_if(conds_.begin(), conds_.end(), [&index_col](const Condition &c) {
+                    return c.lhs_col.col_name == index_col.name;
+                });
+                if (!store_key(cond->rhs_val, index_col, key.data() + offset)) {
+                    return false; // 列中不可能有等于该值的记录
+                }
+                prefix_types.push_back(index_col.type);
+                prefix_lens.push_back(index_col.len);
+            } else {
+                auto edge = Value::makeEdgeValue(index_col.type, index_col.len, is_max);
+                memcpy(key.data() + offset, edge.raw->data, index_col.len);
+            }
+            if (i == conds_.size()) {
+                key_col.offset = offset;
+            }
+            offset += index_col.len;
+        }
+
+        std::vector<char> entry(index->col_tot_len);
+        if (!(is_max ? ih->last_entry(key.data(), entry.data()) : ih->first_entry(key.data(), entry.data()))) {
+            return false;
+        }
+        if (!prefix_types.empty() && ix_compare(entry.data(), key.data(), prefix_types, prefix_lens) != 0) {
+            return false; // 前缀范围内没有索引项
+        }
+        val = Value::col2Value(entry.data(), key_col);
+        return true;
+    }
+
+    /**
+     * @description: 把等值条件的值转换为列的类型写入索引键，rhs_val.raw保留的是值本身的类型和长度，不能直接拷贝
+     * @return {bool} 列中不可能有等于该值的记录时返回false，例如int列 = 3.5、字符串比列长
+     */
+    static bool store_key(const Value &rhs, const ColMeta &col, char *dst) {
+        if (col.type == TYPE_INT && rhs.type == TYPE_FLOAT) {
+            if (rhs.float_val != std::floor(rhs.float_val) || rhs.float_val < (float)INT_MIN ||
+                rhs.float_val >= -(float)INT_MIN) {
+                return false;
+            }
+            *(int *)dst = (int)rhs.float_val;
+        } else if (col.type == TYPE_FLOAT && rhs.type == TYPE_INT) {
+            *(float *)dst = (float)rhs.int_val;
+        } else if (col.type == TYPE_STRING) {
+            if ((int)rhs.str_val.size() > col.len) {
+                return false;
+            }
+            memset(dst, 0, col.len);
+            memcpy(dst, rhs.str_val.data(), rhs.str_val.size());
+        } else {
+            memcpy(dst, rhs.raw->data, col.len);
+        }
+        return true;
+    }
+};
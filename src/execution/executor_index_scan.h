@@ -15,6 +15,7 @@ See the Mulan PSL v2 for more details. */
 #include "executor_abstract.h"
 #include "index/ix.h"
 #include "system/sm.h"
+#include "system/sm_partition.h"
 
 class IndexScanExecutor : public AbstractExecutor {
   private:
@@ -30,10 +31,18 @@ class IndexScanExecutor : public AbstractExecutor {
 
     std::vector<std::string> index_col_names_; // index scan涉及到的索引包含的字段
     IndexMeta index_meta_;                     // index scan涉及到的索引元数据
+    std::vector<int> partitions_;              // 分区裁剪后需要扫描的分区，分区表上每个分区一棵B+树
+
+    // 等值和IN条件组合出的每个探查范围，按键的升序排列，互不相交
+    std::vector<std::vector<char>> lower_keys_;
+    std::vector<std::vector<char>> upper_keys_;
+    size_t probe_ = 0; // 正在扫描的探查范围
 
     Rid rid_;
     std::unique_ptr<RecScan> scan_;
 
+    std::shared_ptr<RuntimeFilter> runtime_filter_; // join下推的运行时过滤器，可能为空
+
     SmManager *sm_manager_;
 
   public:
@@ -65,104 +74,134 @@ class IndexScanExecutor : public AbstractExecutor {
             }
         }
         fed_conds_ = conds_; // 非等值的索引条件在前面
+        partitions_ = Partitioner(tab_).prune(conds_);
 
+        // index_conds_[i]是第i个索引列上的条件：优先取等值条件，其次是IN条件，遇到范围条件或没有条件的列就停止
+        // 其余条件只在evalConditions中过滤，因此conds_可以是任意顺序，也可以包含不在索引中的列
+        size_t num_probes = 1;
         for (auto &col_name : index_col_names_) {
-            for (auto &cond : conds_) {
-                if (cond.lhs_col.col_name == col_name) {
-                    index_conds_.push_back(cond);
-                }
-                if (cond.op != OP_EQ)
-                    break; // 1. conds_已经按照索引顺序排好序 2. 遇到非等值条件就break
+            auto find = [&](auto &&pred) {
+                return std::find_if(conds_.begin(), conds_.end(), [&](const Condition &cond) {
+                    return cond.is_rhs_val && cond.lhs_col.col_name == col_name && pred(cond.op);
+                });
+            };
+            auto eq_it = find([](CompOp op) { return op == OP_EQ; });
+            if (eq_it != conds_.end()) {
+                index_conds_.push_back(*eq_it);
+                continue;
+            }
+            auto in_it = find([](CompOp op) { return op == OP_IN; });
+            if (in_it != conds_.end() && num_probes * in_it->rhs_vals.size() <= MAX_INDEX_PROBES) {
+                // IN列表的每个值各探查一次
+                num_probes *= in_it->rhs_vals.size();
+                index_conds_.push_back(*in_it);
+                continue;
+            }
+            auto range_it = find([](CompOp op) { return op != OP_EQ && op != OP_IN && op != OP_OR; });
+            if (range_it != conds_.end()) {
+                index_conds_.push_back(*range_it);
             }
+            break;
         }
     }
 
     void beginTuple() override {
+        TRACE_SPAN("IndexScan::beginTuple");
         // 索引扫描的实现
-        // 1. 根据条件找到索引的起始位置
-        // 2. 从起始位置开始扫描索引，找到满足条件的记录
+        // 1. 根据条件得到若干个探查范围，IN条件的每个值（多个IN条件时是它们的组合）对应一个范围
+        // 2. 依次在每个范围内扫描索引，找到满足条件的记录
         // 3. 从数据文件中读取记录
         // 4. 返回记录
-
-        auto lower_k = new char[index_meta_.col_tot_len];
-        auto upper_k = new char[index_meta_.col_tot_len];
+        lower_keys_.assign(1, std::vector<char>(index_meta_.col_tot_len));
+        upper_keys_.assign(1, std::vector<char>(index_meta_.col_tot_len));
         // 根据条件填充lower_k和upper_k
         size_t offset = 0;
         for (int i = 0; i < index_col_names_.size(); ++i) {
-            Value val;
-            if (i < index_conds_.size()) {
-
-                // 该索引col有条件
-                auto &cond = index_conds_[i];
-                auto col_meta = *tab_.get_col(cond.lhs_col.col_name);
-                switch (cond.op) {
-                case OP_NE:
-                    // lower_k 是最小值
-                    val = Value::makeEdgeValue(col_meta.type, col_meta.len, false);
-                    memcpy(lower_k + offset, val.raw->data, col_meta.len);
-                    // upper_k 是最大值
-                    val = Value::makeEdgeValue(col_meta.type, col_meta.len, true);
-                    memcpy(upper_k + offset, val.raw->data, col_meta.len);
-                    break;
-                case OP_EQ:
-                    memcpy(lower_k + offset, cond.rhs_val.raw->data, col_meta.len);
-                    memcpy(upper_k + offset, cond.rhs_val.raw->data, col_meta.len);
-                    break;
-                case OP_LE:
-                case OP_LT:
-                    // lower_k 是最小值
-                    val = Value::makeEdgeValue(col_meta.type, col_meta.len, false);
-                    memcpy(lower_k + offset, val.raw->data, col_meta.len);
-                    memcpy(upper_k + offset, cond.rhs_val.raw->data, col_meta.len);
-                    break;
-                case OP_GE:
-                case OP_GT:
-                    // upper_k 是最大值
-                    val = Value::makeEdgeValue(col_meta.type, col_meta.len, true);
-                    memcpy(lower_k + offset, cond.rhs_val.raw->data, col_meta.len);
-                    memcpy(upper_k + offset, val.raw->data, col_meta.len);
-                    break;
-                default:
-                    assert(false);
+            auto col_meta = *tab_.get_col(index_col_names_[i]);
+            auto fill = [&](const char *lower, const char *upper) {
+                for (size_t k = 0; k < lower_keys_.size(); k++) {
+                    memcpy(lower_keys_[k].data() + offset, lower, col_meta.len);
+                    memcpy(upper_keys_[k].data() + offset, upper, col_meta.len);
                 }
-            } else {
+            };
+            auto min_val = Value::makeEdgeValue(col_meta.type, col_meta.len, false);
+            auto max_val = Value::makeEdgeValue(col_meta.type, col_meta.len, true);
+            if (i >= index_conds_.size()) {
                 // 该索引col没有条件，直接用最小值和最大值
-                auto col_meta = *tab_.get_col(index_col_names_[i]);
-                val = Value::makeEdgeValue(col_meta.type, col_meta.len, false);
-                memcpy(lower_k + offset, val.raw->data, col_meta.len);
-                val = Value::makeEdgeValue(col_meta.type, col_meta.len, true);
-                memcpy(upper_k + offset, val.raw->data, col_meta.len);
+                fill(min_val.raw->data, max_val.raw->data);
+                offset += col_meta.len;
+                continue;
             }
-            offset += tab_.get_col(index_col_names_[i])->len;
+            // 该索引col有条件
+            auto &cond = index_conds_[i];
+            switch (cond.op) {
+            case OP_NE:
+                fill(min_val.raw->data, max_val.raw->data);
+                break;
+            case OP_EQ:
+                fill(cond.rhs_val.raw->data, cond.rhs_val.raw->data);
+                break;
+            case OP_IN: {
+                // 已有的每个范围按IN列表展开，值列表升序，展开后各范围仍然按键的升序排列
+                std::vector<std::vector<char>> lower_keys;
+                std::vector<std::vector<char>> upper_keys;
+                for (size_t k = 0; k < lower_keys_.size(); k++) {
+                    for (auto &val : cond.rhs_vals) {
+                        lower_keys.push_back(lower_keys_[k]);
+                        upper_keys.push_back(upper_keys_[k]);
+                        memcpy(lower_keys.back().data() + offset, val.raw->data, col_meta.len);
+                        memcpy(upper_keys.back().data() + offset, val.raw->data, col_meta.len);
+                    }
+                }
+                lower_keys_ = std::move(lower_keys);
+                upper_keys_ = std::move(upper_keys);
+                break;
+            }
+            case OP_LE:
+            case OP_LT:
+                fill(min_val.raw->data, cond.rhs_val.raw->data);
+                break;
+            case OP_GE:
+            case OP_GT:
+                fill(cond.rhs_val.raw->data, max_val.raw->data);
+                break;
+            default:
+                assert(false);
+            }
+            offset += col_meta.len;
         }
 
-        Iid lower_iid = ih_->lower_bound(lower_k);
-        Iid upper_iid = ih_->upper_bound(upper_k);
-
-        scan_ = std::make_unique<IxScan>(ih_, lower_iid, upper_iid, ih_->get_buffer_pool_manager());
+        probe_ = 0;
+        if (lower_keys_.empty()) {
+            // IN列表为空，没有需要探查的范围，不扫描任何分区
+            scan_ = ih_->range_scan(nullptr, nullptr, {});
+            return;
+        }
+        open_probe();
+        seek();
+    }
 
-        // 查看是否有符合的
-        while (!scan_->is_end()) {
-            rid_ = scan_->rid();
-            if (evalConditions())
-                break;
-            scan_->next();
+    bool set_runtime_filter(std::shared_ptr<RuntimeFilter> filter) override {
+        const auto &keys = filter->probe_keys();
+        auto on_this_table = [this](const ColMeta &col) { return col.tab_name == tab_name_; };
+        if (!std::all_of(keys.begin(), keys.end(), on_this_table)) {
+            return false;
         }
+        runtime_filter_ = std::move(filter);
+        return true;
     }
 
     bool evalConditions() {
-        auto handle = fh_->get_record(scan_->rid(), context_);
-        char *base = handle->data;
-
-        // 逻辑不短路，目前只实现逻辑与
-        return std::all_of(conds_.begin(), conds_.end(), [base, this](const Condition &cond) {
-            auto value = Value::col2Value(base, get_col_offset(cond.lhs_col));
-
-            // std::cout << "compare: " << cond.lhs_col.col_name << " ";
-            // value.print();
-            // std::cout << std::endl;
-
-            return cond.eval_with_rvalue(value);
+        thread_stats().tuples_scanned++;
+        // 直接在页面上求值，不满足条件的记录不会被拷贝
+        return fh_->test_record(scan_->rid(), [this](const char *base) {
+            if (runtime_filter_ != nullptr && !runtime_filter_->may_contain(base)) {
+                thread_stats().runtime_filtered++;
+                return false;
+            }
+            auto col_of = [this](const TabCol &col) { return get_col_offset(col); };
+            return std::all_of(conds_.begin(), conds_.end(),
+                               [base, &col_of](const Condition &cond) { return cond.eval_record(base, col_of); });
         });
     }
 
@@ -174,15 +213,11 @@ class IndexScanExecutor : public AbstractExecutor {
     }
 
     void nextTuple() override {
+        TRACE_SPAN("IndexScan::nextTuple");
         if (scan_->is_end())
             return;
         scan_->next();
-        while (!scan_->is_end()) {
-            rid_ = scan_->rid();
-            if (evalConditions())
-                break;
-            scan_->next();
-        }
+        seek();
     }
 
     std::unique_ptr<RmRecord> Next() override {
@@ -211,4 +246,29 @@ class IndexScanExecutor : public AbstractExecutor {
     [[nodiscard]] size_t tupleLen() const override {
         return len_;
     };
+
+  private:
+    static constexpr size_t MAX_INDEX_PROBES = 4096; // IN列表展开后探查范围的上限，超过时IN条件只用于过滤
+
+    // 扫描当前的探查范围，分区表上各分区的扫描按键的顺序归并，输出顺序和非分区表相同
+    void open_probe() {
+        scan_ = ih_->range_scan(lower_keys_[probe_].data(), upper_keys_[probe_].data(), partitions_);
+    }
+
+    // 从当前位置找到下一条满足条件的记录，当前范围扫描完后继续下一个范围
+    void seek() {
+        while (true) {
+            while (!scan_->is_end()) {
+                rid_ = scan_->rid();
+                if (evalConditions())
+                    return;
+                scan_->next();
+            }
+            if (probe_ + 1 >= lower_keys_.size()) {
+                return;
+            }
+            probe_++;
+            open_probe();
+        }
+    }
 };
\ No newline at end of file
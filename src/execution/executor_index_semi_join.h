@@ -0,0 +1,164 @@
+/* Copyright (c) 2023 Renmin University of China
+RMDB is licensed under Mulan PSL v2.
+You can use this software according to the terms and conditions of the Mulan PSL v2.
+You may obtain a copy of Mulan PSL v2 at:
+        http://license.coscl.org.cn/MulanPSL2
+THIS SOFTWARE IS PROVIDED ON AN "AS IS" BASIS, WITHOUT WARRANTIES OF ANY KIND,
+EITHER EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO NON-INFRINGEMENT,
+MERCHANTABILITY OR FIT FOR A PARTICULAR PURPOSE.
+See the Mulan PSL v2 for more details. */
+
+#pragma once
+
+#include "execution_defs.h"
+#include "executor_abstract.h"
+#include "executor_semi_join.h"
+#include "index/ix.h"
+#include "system/sm.h"
+
+/**
+ * 子查询是单表上的SELECT col，且col是子查询表上某个索引的第一列时的半连接/反连接：
+ * 不执行子查询，对每条外层记录用连接列的值在该索引上探查，前缀相等的索引项中有满足子查询条件的记录即为匹配。
+ * 外层记录比子查询表少得多时，比扫描整个子查询表构建哈希表代价低
+ */
+class IndexSemiJoinExecutor : public AbstractExecutor {
+  private:
+    std::unique_ptr<AbstractExecutor> outer_; // 外层输入
+    ColMeta outer_meta_;                      // 连接列在外层记录中的位置
+    bool is_anti_;                            // NOT IN
+
+    std::string tab_name_;         // 子查询的表
+    std::vector<Condition> conds_; // 子查询的where条件
+    std::vector<ColMeta> cols_;    // 子查询表的字段
+    RmFileHandle *fh_;
+    IxIndexHandle *ih_;
+    ColMeta key_col_;              // 索引的第一列，即子查询的结果列
+    std::vector<char> lower_key_;  // 第一列填连接列的值，其余列填最小值
+    std::vector<char> upper_key_;  // 第一列填连接列的值，其余列填最大值
+    std::vector<char> entry_;      // 读出的索引项
+
+    std::unique_ptr<RmRecord> current_; // 当前的外层记录
+    bool is_end_ = true;
+
+  public:
+    IndexSemiJoinExecutor(SmManager *sm_manager, std::unique_ptr<AbstractExecutor> outer, const TabCol &outer_col,
+                          std::string tab_name, std::vector<Condition> conds,
+                          const std::vector<std::string> &index_col_names, bool is_anti) {
+        outer_ = std::move(outer);
+        outer_meta_ = *get_col(outer_->cols(), outer_col);
+        is_anti_ = is_anti;
+        tab_name_ = std::move(tab_name);
+        conds_ = std::move(conds);
+        TabMeta &tab = sm_manager->db_.get_table(tab_name_);
+        cols_ = tab.cols;
+        fh_ = sm_manager->fhs_.at(tab_name_).get();
+        ih_ = sm_manager->ihs_.at(sm_manager->get_ix_manager()->get_index_name(tab_name_, index_col_names)).get();
+
+        IndexMeta &index = *tab.get_index_meta(index_col_names);
+        key_col_ = index.cols[0];
+        lower_key_.resize(index.col_tot_len);
+        upper_key_.resize(index.col_tot_len);
+        entry_.resize(index.col_tot_len);
+        size_t offset = 0;
+        for (auto &col : index.cols) {
+            if (offset > 0) {
+                auto min = Value::makeEdgeValue(col.type, col.len, false);
+                auto max = Value::makeEdgeValue(col.type, col.len, true);
+                memcpy(lower_key_.data() + offset, min.raw->data, col.len);
+                memcpy(upper_key_.data() + offset, max.raw->data, col.len);
+            }
+            offset += col.len;
+        }
+    }
+
+    void beginTuple() override {
+        TRACE_SPAN("IndexSemiJoin::beginTuple");
+        outer_->beginTuple();
+        is_end_ = false;
+        seek();
+    }
+
+    void nextTuple() override {
+        TRACE_SPAN("IndexSemiJoin::nextTuple");
+        assert(!is_end());
+        outer_->nextTuple();
+        seek();
+    }
+
+    [[nodiscard]] bool is_end() const override {
+        return is_end_;
+    }
+
+    std::unique_ptr<RmRecord> Next() override {
+        return std::move(current_);
+    }
+
+    Rid &rid() override {
+        return outer_->rid();
+    }
+
+    [[nodiscard]] const std::vector<ColMeta> &cols() const override {
+        return outer_->cols();
+    }
+
+    [[nodiscard]] size_t tupleLen() const override {
+        return outer_->tupleLen();
+    }
+
+    ColMeta get_col_offset(const TabCol &target) override {
+        return *get_col(outer_->cols(), target);
+    }
+
+    [[nodiscard]] std::string tableName() const override {
+        return outer_->tableName();
+    }
+
+    ExecutorType getType() override {
+        return SEMI_JOIN_EXECUTOR;
+    }
+
+  private:
+    // 在索引上探查外层记录的连接列的值，返回子查询的结果中是否有该值
+    bool probe(const char *record) {
+        std::string key;
+        if (!SemiJoinExecutor::make_key(record, outer_meta_, key_col_.type, key) || (int)key.size() > key_col_.len) {
+            return false; // 转换为索引列的类型后不可能相等
+        }
+        memset(lower_key_.data(), 0, key_col_.len);
+        memcpy(lower_key_.data(), key.data(), key.size());
+        memcpy(upper_key_.data(), lower_key_.data(), key_col_.len);
+
+        if (conds_.empty()) {
+            // 没有条件时只需要看第一个不小于该值的索引项
+            return ih_->first_entry(lower_key_.data(), entry_.data()) &&
+                   ix_compare(entry_.data(), lower_key_.data(), key_col_.type, key_col_.len) == 0;
+        }
+        auto col_of = [this](const TabCol &col) {
+            return *std::find_if(cols_.begin(), cols_.end(),
+                                 [&col](const ColMeta &c) { return c.name == col.col_name; });
+        };
+        for (auto scan = ih_->range_scan(lower_key_.data(), upper_key_.data()); !scan->is_end(); scan->next()) {
+            thread_stats().tuples_scanned++;
+            bool matched = fh_->test_record(scan->rid(), [this, &col_of](const char *base) {
+                return std::all_of(conds_.begin(), conds_.end(),
+                                   [base, &col_of](const Condition &cond) { return cond.eval_record(base, col_of); });
+            });
+            if (matched) {
+                return true;
+            }
+        }
+        return false;
+    }
+
+    // 从外层的当前记录开始，找到下一条满足条件的记录
+    void seek() {
+        for (; !outer_->is_end(); outer_->nextTuple()) {
+            current_ = outer_->Next();
+            if (probe(current_->data) != is_anti_) {
+                return;
+            }
+        }
+        current_ = nullptr;
+        is_end_ = true;
+    }
+};
@@ -0,0 +1,134 @@
+/* Copyright (c) 2023 Renmin University of China
+RMDB is licensed under Mulan PSL v2.
+You can use this software according to the terms and conditions of the Mulan PSL v2.
+You may obtain a copy of Mulan PSL v2 at:
+        http://license.coscl.org.cn/MulanPSL2
+THIS SOFTWARE IS PROVIDED ON AN "AS IS" BASIS, WITHOUT WARRANTIES OF ANY KIND,
+EITHER EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO NON-INFRINGEMENT,
+MERCHANTABILITY OR FIT FOR A PARTICULAR PURPOSE.
+See the Mulan PSL v2 for more details. */
+
+#pragma once
+
+#include "execution_defs.h"
+#include "execution_manager.h"
+#include "executor_abstract.h"
+#include "index/ix.h"
+#include "system/sm.h"
+
+/**
+ * OR条件的每个分支都能用索引时，分别做索引扫描，把得到的Rid合并：
+ * 按记录在文件中的位置排序去重，再按表上的全部条件过滤，同一条记录只输出一次。
+ * 输出按Rid的顺序，不保证按任何索引列有序
+ */
+class IndexUnionExecutor : public AbstractExecutor {
+  private:
+    std::string tab_name_;         // 表的名称
+    std::vector<Condition> conds_; // 表上的全部条件，包括被拆开的OR条件
+    RmFileHandle *fh_;             // 表的数据文件句柄
+    std::vector<ColMeta> cols_;    // scan后生成的记录的字段
+    size_t len_;                   // scan后生成的每条记录的长度
+
+    std::vector<std::unique_ptr<AbstractExecutor>> branches_; // OR条件每个分支上的索引扫描
+    std::vector<Rid> rids_;                                   // 各分支得到的Rid，已排序去重
+    size_t pos_ = 0;                                          // 当前记录在rids_中的位置
+
+    std::shared_ptr<RuntimeFilter> runtime_filter_; // join下推的运行时过滤器，可能为空
+
+    SmManager *sm_manager_;
+
+  public:
+    IndexUnionExecutor(SmManager *sm_manager, std::string tab_name, std::vector<Condition> conds,
+                       std::vector<std::unique_ptr<AbstractExecutor>> branches, Context *context) {
+        sm_manager_ = sm_manager;
+        tab_name_ = std::move(tab_name);
+        conds_ = std::move(conds);
+        branches_ = std::move(branches);
+        TabMeta &tab = sm_manager_->db_.get_table(tab_name_);
+        fh_ = sm_manager_->fhs_.at(tab_name_).get();
+        cols_ = tab.cols;
+        len_ = cols_.back().offset + cols_.back().len;
+        context_ = context;
+    }
+
+    [[nodiscard]] size_t tupleLen() const override {
+        return len_;
+    }
+
+    [[nodiscard]] const std::vector<ColMeta> &cols() const override {
+        return cols_;
+    };
+
+    void beginTuple() override {
+        TRACE_SPAN("IndexUnion::beginTuple");
+        rids_.clear();
+        for (auto &branch : branches_) {
+            for (branch->beginTuple(); !branch->is_end(); branch->nextTuple()) {
+                rids_.push_back(branch->rid());
+            }
+        }
+        std::sort(rids_.begin(), rids_.end());
+        rids_.erase(std::unique(rids_.begin(), rids_.end()), rids_.end());
+        pos_ = 0;
+        while (!is_end() && !evalConditions()) {
+            pos_++;
+        }
+    }
+
+    void nextTuple() override {
+        TRACE_SPAN("IndexUnion::nextTuple");
+        do {
+            pos_++;
+        } while (!is_end() && !evalConditions());
+    }
+
+    bool set_runtime_filter(std::shared_ptr<RuntimeFilter> filter) override {
+        const auto &keys = filter->probe_keys();
+        auto on_this_table = [this](const ColMeta &col) { return col.tab_name == tab_name_; };
+        if (!std::all_of(keys.begin(), keys.end(), on_this_table)) {
+            return false;
+        }
+        runtime_filter_ = std::move(filter);
+        return true;
+    }
+
+    // 分支的索引扫描已经计入tuples_scanned，这里不重复统计
+    bool evalConditions() {
+        return fh_->test_record(rids_[pos_], [this](const char *base) {
+            if (runtime_filter_ != nullptr && !runtime_filter_->may_contain(base)) {
+                thread_stats().runtime_filtered++;
+                return false;
+            }
+            auto col_of = [this](const TabCol &col) { return get_col_offset(col); };
+            return std::all_of(conds_.begin(), conds_.end(),
+                               [base, &col_of](const Condition &cond) { return cond.eval_record(base, col_of); });
+        });
+    }
+
+    ColMeta get_col_offset(const TabCol &target) override {
+        auto it = std::find_if(cols_.begin(), cols_.end(),
+                               [&target](const ColMeta &col) { return col.name == target.col_name; });
+        assert(it != cols_.end());
+        return *it;
+    }
+
+    [[nodiscard]] bool is_end() const override {
+        return pos_ >= rids_.size();
+    }
+
+    std::unique_ptr<RmRecord> Next() override {
+        return fh_->get_record(rids_[pos_], context_);
+    }
+
+    Rid &rid() override {
+        return rids_[pos_];
+    }
+
+    ExecutorType getType() override {
+        return INDEX_UNION_EXECUTOR;
+    }
+
+    [[nodiscard]] std::string tableName() const override {
+        return tab_name_;
+    };
+};
@@ -38,6 +38,7 @@ class InsertExecutor : public AbstractExecutor {
     };
 
     std::unique_ptr<RmRecord> Next() override {
+        TRACE_SPAN("Insert::Next");
         // Make record buffer
         RmRecord rec(fh_->get_file_hdr().record_size);
         for (size_t i = 0; i < values_.size(); i++) {
@@ -75,6 +76,7 @@ class InsertExecutor : public AbstractExecutor {
 
         // Insert into record file
         rid_ = fh_->insert_record(rec.data, context_);
+        thread_stats().tuples_produced++;
 
         // Insert into index
         for (int i = 0; i < recs.size(); ++i) {
@@ -83,6 +85,7 @@ class InsertExecutor : public AbstractExecutor {
             auto ih = sm_manager_->ihs_.at(sm_manager_->get_ix_manager()->get_index_name(tab_name_, index.cols)).get();
             ih->insert_entry(rec->data, rid_, context_->txn_);
         }
+        sm_manager_->maintain_views(tab_name_, nullptr, rec.data, context_);
 
         // Operate Transaction
         if (context_->txn_->get_txn_mode()) {
@@ -91,6 +94,8 @@ class InsertExecutor : public AbstractExecutor {
             WriteRecord *write_record = new WriteRecord(WType::INSERT_TUPLE, tab_name_, rid_);
             context_->txn_->append_write_record(write_record);
         }
+        // 记录和索引都已写入，之前缓存的本表的查询结果失效
+        sm_manager_->bump_table_version(tab_name_);
 
         return nullptr;
     }
@@ -0,0 +1,84 @@
+/* Copyright (c) 2023 Renmin University of China
+RMDB is licensed under Mulan PSL v2.
+You can use this software according to the terms and conditions of the Mulan PSL v2.
+You may obtain a copy of Mulan PSL v2 at:
+        http://license.coscl.org.cn/MulanPSL2
+THIS SOFTWARE IS PROVIDED ON AN "AS IS" BASIS, WITHOUT WARRANTIES OF ANY KIND,
+EITHER EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO NON-INFRINGEMENT,
+MERCHANTABILITY OR FIT FOR A PARTICULAR PURPOSE.
+See the Mulan PSL v2 for more details. */
+
+#pragma once
+
+#include "execution_defs.h"
+#include "executor_abstract.h"
+
+/**
+ * LIMIT/OFFSET算子：跳过前offset条记录，最多输出limit条。
+ * 输出够limit条后不再调用子算子的nextTuple，流水线上的扫描和连接随之停止；
+ * 构造时把limit + offset作为提示下传，排序等需要读完输入的算子据此减少工作量
+ */
+class LimitExecutor : public AbstractExecutor {
+  private:
+    std::unique_ptr<AbstractExecutor> prev_;
+    size_t limit_;
+    size_t offset_;
+    size_t emitted_ = 0; // 已经输出的记录数
+
+  public:
+    LimitExecutor(std::unique_ptr<AbstractExecutor> prev, size_t limit, size_t offset) {
+        prev_ = std::move(prev);
+        limit_ = limit;
+        offset_ = offset;
+        prev_->set_limit_hint(limit_ + offset_);
+    }
+
+    void beginTuple() override {
+        TRACE_SPAN("Limit::beginTuple");
+        emitted_ = 0;
+        if (limit_ == 0) {
+            return; // LIMIT 0不需要执行子算子
+        }
+        prev_->beginTuple();
+        for (size_t i = 0; i < offset_ && !prev_->is_end(); i++) {
+            prev_->Next(); // 取走记录，部分算子要求nextTuple前记录已被取走
+            prev_->nextTuple();
+        }
+    }
+
+    void nextTuple() override {
+        TRACE_SPAN("Limit::nextTuple");
+        emitted_++;
+        if (emitted_ < limit_) {
+            prev_->nextTuple();
+        }
+    }
+
+    [[nodiscard]] bool is_end() const override {
+        return emitted_ >= limit_ || prev_->is_end();
+    }
+
+    std::unique_ptr<RmRecord> Next() override {
+        return prev_->Next();
+    }
+
+    Rid &rid() override {
+        return prev_->rid();
+    }
+
+    [[nodiscard]] size_t tupleLen() const override {
+        return prev_->tupleLen();
+    }
+
+    [[nodiscard]] const std::vector<ColMeta> &cols() const override {
+        return prev_->cols();
+    }
+
+    ColMeta get_col_offset(const TabCol &target) override {
+        return prev_->get_col_offset(target);
+    }
+
+    ExecutorType getType() override {
+        return LIMIT_EXECUTOR;
+    }
+};
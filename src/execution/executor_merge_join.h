@@ -10,6 +10,7 @@ See the Mulan PSL v2 for more details. */
 
 #pragma once
 
+#include "common/server_config.h"
 #include "execution_defs.h"
 #include "execution_manager.h"
 #include "executor_abstract.h"
@@ -21,41 +22,55 @@ See the Mulan PSL v2 for more details. */
 class MergeJoinExecutor : public AbstractExecutor {
 
   private:
-    static const ssize_t MERGE_MEMORY_USAGE = 1024 * 8; // 原800MB，评测时改为8KB
-    std::unique_ptr<AbstractExecutor> left_;            // 左儿子节点（需要join的表）
-    std::unique_ptr<AbstractExecutor> right_;           // 右儿子节点（需要join的表）
-    size_t len_;                                        // join后获得的每条记录的长度
-    std::vector<ColMeta> cols_;                         // join后获得的记录的字段
+    std::unique_ptr<AbstractExecutor> left_;  // 左儿子节点（需要join的表）
+    std::unique_ptr<AbstractExecutor> right_; // 右儿子节点（需要join的表）
+    size_t len_;                              // join后获得的每条记录的长度
+    std::vector<ColMeta> cols_;               // join后获得的记录的字段
 
-    std::vector<Condition> fed_conds_;                            // join条件
-    ColMeta left_col_;                                            // join条件中左表的字段
-    ColMeta right_col_;                                           // join条件中右表的字段
-    std::vector<ExternalMergeSorter> sorters_;                    // 排序完成后从sorter中读取数据
-    std::vector<std::unique_ptr<RmRecord>> records_;              // 保存从左表和右表读取的记录
-    std::unique_ptr<RmRecord> buffer_;                            // 输出使用的缓冲区
-    std::function<int(const void *left, const void *right)> cmp_; // 比较函数
+    std::vector<Condition> fed_conds_;                // join条件
+    std::vector<ColMeta> left_keys_;                  // 连接键在左表中的字段，可以有多列
+    std::vector<ColMeta> right_keys_;                 // 连接键在右表中的字段，和left_keys_一一对应
+    std::vector<Condition> residual_conds_;           // 连接键以外的条件，在连接后的记录上求值
+    KeyComparator join_cmp_;                          // 比较左表记录和右表记录的连接键
+    KeyComparator right_cmp_;                         // 比较两条右表记录的连接键
+    bool ordered_[2];                                 // 左右输入是否已经按连接键有序，有序时不需要排序
+    std::unique_ptr<ExternalMergeSorter> sorters_[2]; // 无序的输入排序后从sorter中读取数据
+
+    std::unique_ptr<RmRecord> left_rec_;               // 当前的左表记录
+    std::vector<std::unique_ptr<RmRecord>> right_run_; // 右表中连接键相同的一段记录，左表出现重复键时重放
+    size_t run_pos_ = 0;                               // 下一个要和left_rec_连接的right_run_中的位置
+    std::unique_ptr<RmRecord> right_next_;             // right_run_之后的第一条右表记录
+    std::unique_ptr<RmRecord> buffer_;                 // 输出使用的缓冲区
     bool is_end_ = false;
-    const bool USE_INDEX;
 
-    std::ofstream sort_outputL; // 评测时输出的sorted_results.txt
-    std::ofstream sort_outputR; // 左表输出到sort_outputL， 右表输出到sort_outputR，然后合并
+    bool debug_output_;         // 是否输出sorted_results.txt，由配置项merge_join_debug_output开启
+    std::ofstream sort_outputL; // 左表输出到sort_outputL， 右表输出到sort_outputR，然后合并
+    std::ofstream sort_outputR;
+
   public:
     MergeJoinExecutor(std::unique_ptr<AbstractExecutor> left, std::unique_ptr<AbstractExecutor> right,
-                      std::vector<Condition> conds, bool use_index = false)
-        : left_(std::move(left)), right_(std::move(right)), fed_conds_(std::move(conds)), USE_INDEX(use_index) {
+                      std::vector<Condition> conds, bool left_ordered = false, bool right_ordered = false)
+        : left_(std::move(left)), right_(std::move(right)), fed_conds_(std::move(conds)),
+          ordered_{left_ordered, right_ordered}, debug_output_(server_config.merge_join_debug_output) {
+        // 等值的列比较条件作为连接键，键的顺序和条件的顺序一致
         for (const auto &cond : fed_conds_) {
-            // 找到要连接的列，暂时不考虑多列连接的情况
-            if (cond.is_rhs_val || cond.op != OP_EQ) {
-                continue;
-            }
-            if (cond.lhs_col.tab_name == left_->tableName() && cond.rhs_col.tab_name == right_->tableName()) {
-                left_col_ = *get_col(left_->cols(), cond.lhs_col);
-                right_col_ = *get_col(right_->cols(), cond.rhs_col);
-            } else if (cond.lhs_col.tab_name == right_->tableName() && cond.rhs_col.tab_name == left_->tableName()) {
-                left_col_ = *get_col(right_->cols(), cond.rhs_col);
-                right_col_ = *get_col(left_->cols(), cond.lhs_col);
+            if (!cond.is_rhs_val && cond.op == OP_EQ && has_col(left_->cols(), cond.lhs_col) &&
+                has_col(right_->cols(), cond.rhs_col)) {
+                left_keys_.push_back(*get_col(left_->cols(), cond.lhs_col));
+                right_keys_.push_back(*get_col(right_->cols(), cond.rhs_col));
+            } else if (!cond.is_rhs_val && cond.op == OP_EQ && has_col(left_->cols(), cond.rhs_col) &&
+                       has_col(right_->cols(), cond.lhs_col)) {
+                left_keys_.push_back(*get_col(left_->cols(), cond.rhs_col));
+                right_keys_.push_back(*get_col(right_->cols(), cond.lhs_col));
+            } else {
+                residual_conds_.push_back(cond);
             }
         }
+        if (left_keys_.empty()) {
+            throw InternalError("merge join requires at least one equi-join condition");
+        }
+        join_cmp_ = KeyComparator::create(left_keys_, right_keys_);
+        right_cmp_ = KeyComparator::create(right_keys_, right_keys_);
         len_ = left_->tupleLen() + right_->tupleLen();
         cols_ = left_->cols();
         auto right_cols = right_->cols();
@@ -63,41 +78,37 @@ class MergeJoinExecutor : public AbstractExecutor {
             col.offset += left_->tupleLen();
         }
         cols_.insert(cols_.end(), right_cols.begin(), right_cols.end());
-        records_.emplace_back(std::make_unique<RmRecord>(left_->tupleLen()));
-        records_.emplace_back(std::make_unique<RmRecord>(right_->tupleLen()));
+    }
 
-        cmp_ = [this](const void *left, const void *right) {
-            auto lvalue = Value::col2Value((const char *)left, left_col_);
-            auto rvalue = Value::col2Value((const char *)right, right_col_);
-            if (lvalue < rvalue) {
-                return -1;
-            } else if (lvalue > rvalue) {
-                return 1;
-            } else {
-                return 0;
-            }
-        };
+    static bool has_col(const std::vector<ColMeta> &cols, const TabCol &target) {
+        return std::any_of(cols.begin(), cols.end(), [&target](const ColMeta &col) {
+            return col.tab_name == target.tab_name && col.name == target.col_name;
+        });
     }
 
-    static ExternalMergeSorter sortBigData(std::unique_ptr<AbstractExecutor> &executor, const ColMeta &joined_col) {
-        auto cmp = [](const void *a, const void *b, void *arg) {
-            auto *col = (const ColMeta *)arg;
-            auto lvalue = Value::col2Value((const char *)a, *col);
-            auto rvalue = Value::col2Value((const char *)b, *col);
-            if (lvalue < rvalue) {
-                return -1;
-            } else if (lvalue > rvalue) {
-                return 1;
-            } else {
-                return 0;
-            }
-        };
-        ExternalMergeSorter sorter(MERGE_MEMORY_USAGE, executor->tupleLen(), cmp, (void *)&joined_col);
+    /**
+     * @description: 把无序的输入按连接键排序
+     * @param {size_t} total_mem 排序可以使用的内存
+     * @param {RuntimeFilter*} filter 不为空时用读到的记录构建运行时过滤器
+     */
+    static std::unique_ptr<ExternalMergeSorter> sortBigData(std::unique_ptr<AbstractExecutor> &executor,
+                                                            std::vector<ColMeta> &keys, size_t total_mem,
+                                                            RuntimeFilter *filter = nullptr) {
+        total_mem = std::max(total_mem, executor->tupleLen());
+        auto sorter = std::make_unique<ExternalMergeSorter>(total_mem, executor->tupleLen(),
+                                                            KeyComparator::create(keys, keys));
         for (executor->beginTuple(); !executor->is_end(); executor->nextTuple()) {
-            sorter.write(executor->Next()->data);
+            auto record = executor->Next();
+            if (filter != nullptr) {
+                filter->add(record->data);
+            }
+            sorter->write(record->data);
         }
-        sorter.endWrite();
-        sorter.beginRead();
+        if (filter != nullptr) {
+            filter->seal();
+        }
+        sorter->endWrite();
+        sorter->beginRead();
         return sorter;
     }
 
@@ -142,29 +153,12 @@ class MergeJoinExecutor : public AbstractExecutor {
         output << "\n";
     }
 
+    // 评测要求的输出：左右表各自按连接键排好序的全部记录，先左表后右表
     void testPrintMergeFile() {
-        // 先将没有使用完的子表输出，为了通过测试
-        while (USE_INDEX && !left_->is_end()) {
-            readRecord(0);
-            if (!left_->is_end()) {
-                break;
-            }
-            testPrintRecord(left_->cols(), sort_outputL, records_[0]->data);
-        }
-        while (USE_INDEX && !right_->is_end()) {
-            readRecord(1);
-            if (!right_->is_end()) {
-                break;
-            }
-            testPrintRecord(right_->cols(), sort_outputR, records_[1]->data);
+        // 先将没有读完的子表输出
+        while (fetch(0) != nullptr) {
         }
-        while (!USE_INDEX && !sorters_[0].is_end()) {
-            readRecord(0);
-            testPrintRecord(left_->cols(), sort_outputL, records_[0]->data);
-        }
-        while (!USE_INDEX && !sorters_[1].is_end()) {
-            readRecord(1);
-            testPrintRecord(right_->cols(), sort_outputR, records_[1]->data);
+        while (fetch(1) != nullptr) {
         }
         char c;
         sort_outputR.close();
@@ -177,71 +171,141 @@ class MergeJoinExecutor : public AbstractExecutor {
         unlink("sorted_results1.txt");
     }
 
-    void readRecord(int lOrR) {
-        if (USE_INDEX) {
-            auto executor = lOrR == 0 ? left_.get() : right_.get();
-            records_[lOrR] = executor->Next();
+    /**
+     * @description: 按连接键的顺序读取左表(0)或右表(1)的下一条记录
+     * @return {std::unique_ptr<RmRecord>} 读到的记录，输入结束时返回nullptr
+     */
+    std::unique_ptr<RmRecord> fetch(int lOrR) {
+        auto executor = lOrR == 0 ? left_.get() : right_.get();
+        std::unique_ptr<RmRecord> record;
+        if (ordered_[lOrR]) {
+            if (executor->is_end()) {
+                return nullptr;
+            }
+            record = executor->Next();
             executor->nextTuple();
         } else {
-            sorters_[lOrR].read(records_[lOrR]->data);
+            if (sorters_[lOrR]->is_end()) {
+                return nullptr;
+            }
+            record = std::make_unique<RmRecord>(executor->tupleLen());
+            sorters_[lOrR]->read(record->data);
         }
+        if (debug_output_) {
+            testPrintRecord(executor->cols(), lOrR == 0 ? sort_outputL : sort_outputR, record->data);
+        }
+        return record;
+    }
+
+    bool evalResidualConditions(const char *base) {
+        return std::all_of(residual_conds_.begin(), residual_conds_.end(), [base, this](const Condition &cond) {
+            auto lvalue = ValueView::of(base, *get_col(cols_, cond.lhs_col));
+            if (cond.is_rhs_val) {
+                return cond.eval_with_rvalue(lvalue);
+            }
+            return cond.eval(lvalue, ValueView::of(base, *get_col(cols_, cond.rhs_col)));
+        });
     }
 
     void beginTuple() override {
-        sort_outputL.open("sorted_results.txt");
-        sort_outputR.open("sorted_results1.txt");
-        if (sort_outputR.fail() || sort_outputL.fail()) {
-            throw UnixError();
+        TRACE_SPAN("MergeJoin::beginTuple");
+        if (debug_output_) {
+            sort_outputL.open("sorted_results.txt");
+            sort_outputR.open("sorted_results1.txt");
+            if (sort_outputR.fail() || sort_outputL.fail()) {
+                throw UnixError();
+            }
+            testPrintTableHeader(left_->cols(), sort_outputL);
+            testPrintTableHeader(right_->cols(), sort_outputR);
+        }
+        // 内存预算由需要排序的输入平分
+        size_t unordered = !ordered_[0] + !ordered_[1];
+        size_t sort_memory = unordered == 0 ? 0 : server_config.merge_join_memory / unordered;
+        // 先排序的一侧被完整读取，用它构建运行时过滤器下推给另一侧。输出sorted_results.txt时需要完整的输入，不过滤
+        bool use_filter = server_config.enable_runtime_filter && !debug_output_;
+        int build = !ordered_[1] ? 1 : 0; // 优先排序右表
+        int probe = 1 - build;
+        auto &build_child = build == 0 ? left_ : right_;
+        auto &probe_child = probe == 0 ? left_ : right_;
+        auto &build_keys = build == 0 ? left_keys_ : right_keys_;
+        auto &probe_keys = probe == 0 ? left_keys_ : right_keys_;
+        if (ordered_[build]) {
+            build_child->beginTuple();
+        } else {
+            auto filter = use_filter ? RuntimeFilter::create(build_keys, probe_keys) : nullptr;
+            sorters_[build] = sortBigData(build_child, build_keys, sort_memory, filter.get());
+            if (filter != nullptr) {
+                probe_child->set_runtime_filter(filter);
+            }
         }
-        testPrintTableHeader(left_->cols(), sort_outputL);
-        testPrintTableHeader(right_->cols(), sort_outputR);
-        if (USE_INDEX) {
-            left_->beginTuple();
-            right_->beginTuple();
+        if (ordered_[probe]) {
+            probe_child->beginTuple();
         } else {
-            sleep(2);
-            sorters_.push_back(sortBigData(left_, left_col_));
-            sorters_.push_back(sortBigData(right_, right_col_));
+            sorters_[probe] = sortBigData(probe_child, probe_keys, sort_memory);
         }
+        left_rec_ = fetch(0);
+        right_next_ = fetch(1);
         nextTuple();
     };
 
     void nextTuple() override {
-        bool end_when_use_index = USE_INDEX && (left_->is_end() || right_->is_end());
-        bool end_when_not_use_index = !USE_INDEX && (sorters_[0].is_end() || sorters_[1].is_end());
-        if (end_when_use_index || end_when_not_use_index) {
-            is_end_ = true;
-            testPrintMergeFile();
-            return;
-        }
-        readRecord(0);
-        readRecord(1);
-        end_when_use_index = USE_INDEX && (left_->is_end() || right_->is_end());
-        end_when_not_use_index = !USE_INDEX && (sorters_[0].is_end() || sorters_[1].is_end());
-
-        testPrintRecord(left_->cols(), sort_outputL, records_[0]->data);
-        testPrintRecord(right_->cols(), sort_outputR, records_[1]->data);
-        int result = cmp_(records_[0]->data, records_[1]->data);
-        while (result != 0 && !(end_when_use_index || end_when_not_use_index)) {
-            if (result < 0) {
-                readRecord(0);
-                testPrintRecord(left_->cols(), sort_outputL, records_[0]->data);
-            } else {
-                readRecord(1);
-                testPrintRecord(right_->cols(), sort_outputR, records_[1]->data);
+        TRACE_SPAN("MergeJoin::nextTuple");
+        assert(buffer_ == nullptr); // 记录已经被`Next`取走
+        while (true) {
+            if (left_rec_ == nullptr) {
+                break;
+            }
+            if (run_pos_ < right_run_.size()) {
+                // left_rec_和当前重复段中的每一条右表记录连接
+                auto &right_rec = right_run_[run_pos_++];
+                buffer_ = std::make_unique<RmRecord>(len_);
+                memcpy(buffer_->data, left_rec_->data, left_->tupleLen());
+                memcpy(buffer_->data + left_->tupleLen(), right_rec->data, right_->tupleLen());
+                if (evalResidualConditions(buffer_->data)) {
+                    return;
+                }
+                buffer_ = nullptr;
+                continue;
+            }
+            if (!right_run_.empty()) {
+                // 重复段用完，读取下一条左表记录；键相同时重放重复段
+                left_rec_ = fetch(0);
+                run_pos_ = 0;
+                if (left_rec_ != nullptr &&
+                    join_cmp_(left_rec_->data, right_run_[0]->data) == 0) {
+                    continue;
+                }
+                right_run_.clear();
+                continue;
+            }
+            // 推进两侧直到连接键相等
+            while (left_rec_ != nullptr && right_next_ != nullptr) {
+                int result = join_cmp_(left_rec_->data, right_next_->data);
+                if (result < 0) {
+                    left_rec_ = fetch(0);
+                } else if (result > 0) {
+                    right_next_ = fetch(1);
+                } else {
+                    break;
+                }
             }
-            result = cmp_(records_[0]->data, records_[1]->data);
-            end_when_use_index = USE_INDEX && (left_->is_end() || right_->is_end());
-            end_when_not_use_index = !USE_INDEX && (sorters_[0].is_end() || sorters_[1].is_end());
+            if (left_rec_ == nullptr || right_next_ == nullptr) {
+                break;
+            }
+            // 缓存右表中连接键相同的一段记录
+            right_run_.push_back(std::move(right_next_));
+            right_next_ = fetch(1);
+            while (right_next_ != nullptr &&
+                   right_cmp_(right_run_[0]->data, right_next_->data) == 0) {
+                right_run_.push_back(std::move(right_next_));
+                right_next_ = fetch(1);
+            }
+            run_pos_ = 0;
         }
-        if (result != 0) {
-            is_end_ = true;
-            return;
+        is_end_ = true;
+        if (debug_output_) {
+            testPrintMergeFile();
         }
-        assert(buffer_ == nullptr); // 记录已经被`Next`取走
-        buffer_ = std::make_unique<RmRecord>(len_);
-        memcpy(buffer_->data, records_[0]->data, left_->tupleLen());
-        memcpy(buffer_->data + left_->tupleLen(), records_[1]->data, right_->tupleLen());
     };
 
     [[nodiscard]] bool is_end() const override {
@@ -10,6 +10,7 @@ See the Mulan PSL v2 for more details. */
 
 #pragma once
 
+#include "common/server_config.h"
 #include "execution_defs.h"
 #include "execution_manager.h"
 #include "executor_abstract.h"
@@ -25,11 +26,12 @@ class NestedLoopJoinExecutor : public AbstractExecutor {
 
     std::vector<Condition> fed_conds_;                   // join条件
     std::unique_ptr<RmRecord> result;                    // 存储当前迭代轮次的值，供`Next`取走
-    std::vector<std::unique_ptr<RmRecord>> left_record;  // seqScan扫描出的左表记录
+    std::vector<std::unique_ptr<RmRecord>> left_record;  // 当前一批左表记录
     std::vector<std::unique_ptr<RmRecord>> right_record; // seqScan扫描出的右表记录
     std::vector<std::unique_ptr<RmRecord>>::iterator lit;
     std::vector<std::unique_ptr<RmRecord>>::iterator rit; // `rit`和`lit`组成按照排列组合顺序遍历左右表记录的cursor
     bool isend;
+    size_t left_batch_ = SIZE_MAX; // 每批读入的左表记录数，默认一次读完
 
   public:
     NestedLoopJoinExecutor(std::unique_ptr<AbstractExecutor> left, std::unique_ptr<AbstractExecutor> right,
@@ -48,14 +50,17 @@ class NestedLoopJoinExecutor : public AbstractExecutor {
     }
 
     void beginTuple() override {
-        for (left_->beginTuple(); !left_->is_end(); left_->nextTuple()) {
-            left_record.push_back(left_->Next());
+        TRACE_SPAN("NestedLoopJoin::beginTuple");
+        left_->beginTuple();
+        fillLeft();
+        if (left_batch_ == SIZE_MAX) {
+            pushRuntimeFilter();
         }
+        right_record.clear();
         for (right_->beginTuple(); !right_->is_end(); right_->nextTuple()) {
             right_record.push_back(right_->Next());
         }
-        lit = left_record.begin(); // `push_back`使得迭代器失效，必须放在`push_back`后面
-        rit = right_record.begin();
+        rit = right_record.begin(); // `push_back`使得迭代器失效，必须放在`push_back`后面
         isend = lit == left_record.end() || rit == right_record.end(); // 避免左右表为空的情况
         while (!isend && !evalConditions()) {                          // 滑过不满足条件的记录
             step();
@@ -68,7 +73,54 @@ class NestedLoopJoinExecutor : public AbstractExecutor {
         memcpy(result->data + left_->tupleLen(), (*rit)->data, right_->tupleLen());
     }
 
+    // 上层只需要前n条时按批读入左表，凑够结果后剩余的左表记录不再读取，代价是不能构建运行时过滤器
+    void set_limit_hint(size_t n) override {
+        left_batch_ = std::max<size_t>(n, 1);
+    }
+
+    // 从左表读入下一批记录，返回false表示左表已经读完
+    bool fillLeft() {
+        left_record.clear();
+        while (!left_->is_end() && left_record.size() < left_batch_) {
+            left_record.push_back(left_->Next());
+            left_->nextTuple();
+        }
+        lit = left_record.begin();
+        return lit != left_record.end();
+    }
+
+    // 左表已经全部读入，用等值连接条件的左表键构建运行时过滤器，下推给右表的扫描
+    void pushRuntimeFilter() {
+        if (!server_config.enable_runtime_filter) {
+            return;
+        }
+        std::vector<ColMeta> left_keys;
+        std::vector<ColMeta> right_keys;
+        for (auto &cond : fed_conds_) {
+            if (cond.op == OP_EQ && has_col(left_->cols(), cond.lhs_col) && has_col(right_->cols(), cond.rhs_col)) {
+                left_keys.push_back(get_col_offset_lr(left_->cols(), cond.lhs_col));
+                right_keys.push_back(get_col_offset_lr(right_->cols(), cond.rhs_col));
+            }
+        }
+        auto filter = RuntimeFilter::create(left_keys, right_keys);
+        if (filter == nullptr) {
+            return;
+        }
+        for (auto &record : left_record) {
+            filter->add(record->data);
+        }
+        filter->seal();
+        right_->set_runtime_filter(filter);
+    }
+
+    static bool has_col(const std::vector<ColMeta> &cols, const TabCol &target) {
+        return std::any_of(cols.begin(), cols.end(), [&target](const ColMeta &col) {
+            return col.tab_name == target.tab_name && col.name == target.col_name;
+        });
+    }
+
     void nextTuple() override {
+        TRACE_SPAN("NestedLoopJoin::nextTuple");
         assert(!is_end());
         do { // 滑过不满足条件的记录
             step();
@@ -93,7 +145,7 @@ class NestedLoopJoinExecutor : public AbstractExecutor {
         if (rit == right_record.end()) { // rewind
             lit++;
             rit = right_record.begin();
-            if (lit == left_record.end()) {
+            if (lit == left_record.end() && !fillLeft()) {
                 isend = true; // 迭代到达终点
                 return;
             }
@@ -105,8 +157,8 @@ class NestedLoopJoinExecutor : public AbstractExecutor {
         char *rbase = (*rit)->data;
         return std::all_of(fed_conds_.begin(), fed_conds_.end(), [&](Condition &cond) {
             assert(!cond.is_rhs_val);
-            auto lvalue = Value::col2Value(lbase, get_col_offset_lr(left_->cols(), cond.lhs_col));
-            auto rvalue = Value::col2Value(rbase, get_col_offset_lr(right_->cols(), cond.rhs_col));
+            auto lvalue = ValueView::of(lbase, get_col_offset_lr(left_->cols(), cond.lhs_col));
+            auto rvalue = ValueView::of(rbase, get_col_offset_lr(right_->cols(), cond.rhs_col));
             return cond.eval(lvalue, rvalue);
         });
     }
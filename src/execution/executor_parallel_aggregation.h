@@ -0,0 +1,339 @@
+/* Copyright (c) 2023 Renmin University of China
+RMDB is licensed under Mulan PSL v2.
+You can use this software according to the terms and conditions of the Mulan PSL v2.
+You may obtain a copy of Mulan PSL v2 at:
+        http://license.coscl.org.cn/MulanPSL2
+THIS SOFTWARE IS PROVIDED ON AN "AS IS" BASIS, WITHOUT WARRANTIES OF ANY KIND,
+EITHER EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO NON-INFRINGEMENT,
+MERCHANTABILITY OR FIT FOR A PARTICULAR PURPOSE.
+See the Mulan PSL v2 for more details. */
+
+#pragma once
+
+#include <unordered_map>
+
+#include "common/task_scheduler.h"
+#include "execution_defs.h"
+#include "executor_abstract.h"
+#include "parallel_scan.h"
+
+/**
+ * 单表上的并行分组聚合，输出和AggregationExecutor相同：
+ * 1. 各线程扫描领取到的morsel，在线程私有的哈希表中做部分聚合，哈希表按分组键的哈希值分区（repartition）；
+ * 2. 每个分区由一个任务合并所有线程的部分结果；
+ * 3. gather：收集所有分组，求值HAVING，按分组在扫描顺序中首次出现的位置排序后输出。
+ * 只支持可以合并的聚合：COUNT，INT/FLOAT列的SUM，MIN/MAX；不支持时由supported()返回false，退回串行执行。
+ * 浮点数SUM的累加顺序和串行执行不同，可能有舍入误差
+ */
+class ParallelAggregationExecutor : public AbstractExecutor {
+  private:
+    struct GroupState {
+        uint64_t first_seen;       // 组内第一条记录在扫描顺序中的位置，(morsel << 32) | 行号
+        std::string first_record;  // 组内第一条记录，用于输出分组列和非聚合列
+        size_t count = 0;          // 组内记录数
+        std::vector<int64_t> int_sums;
+        std::vector<float> float_sums;
+        std::vector<Value> extremes; // MIN/MAX的当前值
+
+        void merge(GroupState &other, const std::vector<ColMeta> &agg_cols) {
+            if (other.first_seen < first_seen) {
+                first_seen = other.first_seen;
+                first_record = std::move(other.first_record);
+            }
+            count += other.count;
+            for (size_t i = 0; i < agg_cols.size(); i++) {
+                auto aggr = agg_cols[i].aggr;
+                int_sums[i] += other.int_sums[i];
+                float_sums[i] += other.float_sums[i];
+                if ((aggr == ast::AGGR_TYPE_MAX && other.extremes[i] > extremes[i]) ||
+                    (aggr == ast::AGGR_TYPE_MIN && other.extremes[i] < extremes[i])) {
+                    extremes[i] = std::move(other.extremes[i]);
+                }
+            }
+        }
+    };
+    using GroupTable = std::unordered_map<std::string, GroupState>;
+
+    ParallelTableScan scan_;
+    std::vector<ColMeta> group_cols_;
+    std::vector<Condition> having_conds_;
+    std::vector<ColMeta> sel_cols_initial_; // 聚合前的列，offset指向扫描出的记录
+    std::vector<ColMeta> sel_cols_;         // 输出的列
+    size_t len_;
+
+    size_t num_partitions_;
+    std::vector<std::vector<GroupTable>> partials_; // 每个线程每个分区的部分聚合结果
+    std::vector<std::unique_ptr<RmRecord>> results_;
+    size_t curr_idx_ = 0;
+
+  public:
+    ParallelAggregationExecutor(SmManager *sm_manager, std::string tab_name, std::vector<Condition> conds,
+                                const std::vector<TabCol> &sel_cols, const std::vector<TabCol> &group_cols,
+                                const std::vector<Condition> &having_conds, Context *context)
+        : scan_(sm_manager, std::move(tab_name), std::move(conds)), having_conds_(having_conds) {
+        context_ = context;
+        for (auto &group_col : group_cols) {
+            group_cols_.push_back(*get_col(scan_.cols(), group_col));
+        }
+        size_t offset = 0;
+        for (auto &sel_col : sel_cols) {
+            ColMeta col;
+            if (sel_col.aggr == ast::AGGR_TYPE_COUNT && sel_col.col_name == "*") {
+                col = make_count_star_col(sel_col);
+            } else {
+                col = *get_col(scan_.cols(), sel_col);
+                col.aggr = sel_col.aggr;
+            }
+            sel_cols_initial_.push_back(col);
+            if (col.aggr == ast::AGGR_TYPE_COUNT) {
+                col.type = TYPE_INT;
+                col.len = sizeof(int);
+            }
+            col.offset = offset;
+            offset += col.len;
+            sel_cols_.push_back(col);
+        }
+        len_ = offset;
+        num_partitions_ = TaskScheduler::instance().num_workers();
+    }
+
+    // 判断能否并行执行，规则见类的注释；HAVING中的列必须是分组列、COUNT(*)或select列表中的聚合
+    static bool supported(SmManager *sm_manager, const std::string &tab_name, const std::vector<TabCol> &sel_cols,
+                          const std::vector<TabCol> &group_cols, const std::vector<Condition> &having_conds) {
+        auto &cols = sm_manager->db_.get_table(tab_name).cols;
+        for (auto &sel_col : sel_cols) {
+            if (sel_col.aggr == ast::AGGR_TYPE_SUM) {
+                auto type = get_col(cols, sel_col)->type;
+                if (type != TYPE_INT && type != TYPE_FLOAT) {
+                    return false;
+                }
+            }
+        }
+        auto same_col = [](const TabCol &a, const TabCol &b) {
+            return a.tab_name == b.tab_name && a.col_name == b.col_name;
+        };
+        for (auto &cond : having_conds) {
+            if (!cond.is_rhs_val) {
+                return false;
+            }
+            auto &lhs = cond.lhs_col;
+            bool ok;
+            if (lhs.aggr == ast::NO_AGGR) {
+                ok = std::any_of(group_cols.begin(), group_cols.end(),
+                                 [&](const TabCol &col) { return same_col(col, lhs); }) &&
+                     std::any_of(sel_cols.begin(), sel_cols.end(),
+                                 [&](const TabCol &col) { return same_col(col, lhs) && col.aggr == ast::NO_AGGR; });
+            } else if (lhs.aggr == ast::AGGR_TYPE_COUNT && lhs.col_name == "*") {
+                ok = true;
+            } else {
+                ok = std::any_of(sel_cols.begin(), sel_cols.end(),
+                                 [&](const TabCol &col) { return same_col(col, lhs) && col.aggr == lhs.aggr; });
+            }
+            if (!ok) {
+                return false;
+            }
+        }
+        return true;
+    }
+
+    void beginTuple() override {
+        TRACE_SPAN("ParallelAggregation::beginTuple");
+        auto &scheduler = TaskScheduler::instance();
+        scan_.begin();
+        partials_.assign(scheduler.num_workers(), std::vector<GroupTable>(num_partitions_));
+        scheduler.submit(scan_.num_morsels(), [this](size_t morsel, size_t worker) {
+            aggregate_morsel(morsel, partials_[worker]);
+        })->wait();
+
+        // 每个分区合并到第0个线程的哈希表中
+        scheduler.submit(num_partitions_, [this](size_t partition, size_t) {
+            auto &merged = partials_[0][partition];
+            for (size_t worker = 1; worker < partials_.size(); worker++) {
+                for (auto &[key, state] : partials_[worker][partition]) {
+                    auto it = merged.find(key);
+                    if (it == merged.end()) {
+                        merged.emplace(key, std::move(state));
+                    } else {
+                        it->second.merge(state, sel_cols_initial_);
+                    }
+                }
+                partials_[worker][partition].clear();
+            }
+        })->wait();
+
+        std::vector<GroupState *> groups;
+        for (auto &partition : partials_[0]) {
+            for (auto &[key, state] : partition) {
+                groups.push_back(&state);
+            }
+        }
+        std::sort(groups.begin(), groups.end(),
+                  [](const GroupState *a, const GroupState *b) { return a->first_seen < b->first_seen; });
+        results_.clear();
+        if (groups.empty() && group_cols_.empty()) {
+            // 和AggregationExecutor一致：空表上不分组的聚合输出一行NULL
+            for (auto &col : sel_cols_) {
+                col.type = TYPE_NULL;
+            }
+            results_.push_back(std::make_unique<RmRecord>(len_));
+            memset(results_.back()->data, 0, len_);
+        }
+        for (auto group : groups) {
+            std::vector<Value> values;
+            for (size_t i = 0; i < sel_cols_initial_.size(); i++) {
+                values.push_back(aggregate_value(*group, i));
+            }
+            if (evalConditions(*group, values)) {
+                results_.push_back(make_record(values));
+            }
+        }
+        partials_.clear();
+        curr_idx_ = 0;
+    }
+
+    void nextTuple() override {
+        curr_idx_++;
+    }
+
+    [[nodiscard]] bool is_end() const override {
+        return curr_idx_ >= results_.size();
+    }
+
+    [[nodiscard]] const std::vector<ColMeta> &cols() const override {
+        return sel_cols_;
+    }
+
+    std::unique_ptr<RmRecord> Next() override {
+        return std::make_unique<RmRecord>(*results_[curr_idx_]);
+    }
+
+    Rid &rid() override {
+        return _abstract_rid;
+    }
+
+    // 和AggregationExecutor相同，ProjectionExecutor据此直接使用本算子的输出列
+    ExecutorType getType() override {
+        return ExecutorType::AGGREGATION_EXECUTOR;
+    }
+
+  private:
+    // 在工作线程中执行：把一个morsel的记录聚合到该线程的哈希表中
+    void aggregate_morsel(size_t morsel, std::vector<GroupTable> &tables) {
+        uint64_t row = 0;
+        std::string key;
+        scan_.scan_morsel(morsel, [&](const Rid &, const char *record) {
+            key.clear();
+            for (auto &col : group_cols_) {
+                key.append(record + col.offset, col.len);
+            }
+            auto &table = tables[std::hash<std::string>()(key) % num_partitions_];
+            uint64_t position = (morsel << 32) | row;
+            auto it = table.find(key);
+            if (it == table.end()) {
+                it = table.emplace(key, new_group(record, position)).first;
+            } else if (position < it->second.first_seen) {
+                // 窃取来的morsel不一定按顺序执行，组内第一条记录要按扫描顺序确定
+                it->second.first_seen = position;
+                it->second.first_record.assign(record, scan_.tuple_len());
+            }
+            update_group(it->second, record);
+            row++;
+        });
+    }
+
+    GroupState new_group(const char *record, uint64_t first_seen) {
+        GroupState state;
+        state.first_seen = first_seen;
+        state.first_record.assign(record, scan_.tuple_len());
+        state.int_sums.assign(sel_cols_initial_.size(), 0);
+        state.float_sums.assign(sel_cols_initial_.size(), 0);
+        state.extremes.resize(sel_cols_initial_.size());
+        for (size_t i = 0; i < sel_cols_initial_.size(); i++) {
+            auto &col = sel_cols_initial_[i];
+            if (col.aggr == ast::AGGR_TYPE_MAX || col.aggr == ast::AGGR_TYPE_MIN) {
+                state.extremes[i] = Value::col2Value(record, col);
+            }
+        }
+        return state;
+    }
+
+    void update_group(GroupState &state, const char *record) {
+        state.count++;
+        for (size_t i = 0; i < sel_cols_initial_.size(); i++) {
+            auto &col = sel_cols_initial_[i];
+            if (col.aggr == ast::AGGR_TYPE_SUM) {
+                if (col.type == TYPE_INT) {
+                    state.int_sums[i] += *(const int *)(record + col.offset);
+                } else {
+                    state.float_sums[i] += *(const float *)(record + col.offset);
+                }
+            } else if (col.aggr == ast::AGGR_TYPE_MAX || col.aggr == ast::AGGR_TYPE_MIN) {
+                // 只在极值改变时才构造Value
+                int res = ValueView::of(record, col).compare(ValueView::of(state.extremes[i]));
+                if (col.aggr == ast::AGGR_TYPE_MAX ? res > 0 : res < 0) {
+                    state.extremes[i] = Value::col2Value(record, col);
+                }
+            }
+        }
+    }
+
+    Value aggregate_value(const GroupState &state, size_t i) {
+        auto &col = sel_cols_initial_[i];
+        Value val;
+        switch (col.aggr) {
+        case ast::NO_AGGR:
+            val = Value::col2Value(state.first_record.data(), col);
+            break;
+        case ast::AGGR_TYPE_COUNT:
+            val.set_int(state.count);
+            break;
+        case ast::AGGR_TYPE_SUM:
+            if (col.type == TYPE_INT) {
+                val.set_int((int)state.int_sums[i]);
+            } else {
+                val.set_float(state.float_sums[i]);
+            }
+            break;
+        case ast::AGGR_TYPE_MAX:
+        case ast::AGGR_TYPE_MIN:
+            val = state.extremes[i];
+            break;
+        default:
+            throw InternalError("Unknown AggrType");
+        }
+        val.init_raw(sel_cols_[i].len);
+        return val;
+    }
+
+    bool evalConditions(const GroupState &state, const std::vector<Value> &values) {
+        return std::all_of(having_conds_.begin(), having_conds_.end(), [&](const Condition &cond) {
+            if (cond.lhs_col.aggr == ast::AGGR_TYPE_COUNT && cond.lhs_col.col_name == "*") {
+                Value count;
+                count.set_int(state.count);
+                return cond.eval_with_rvalue(ValueView::of(count));
+            }
+            auto pos = get_col(sel_cols_initial_, cond.lhs_col, true);
+            return cond.eval_with_rvalue(ValueView::of(values[pos - sel_cols_initial_.begin()]));
+        });
+    }
+
+    std::unique_ptr<RmRecord> make_record(const std::vector<Value> &values) {
+        auto record = std::make_unique<RmRecord>(len_);
+        for (size_t i = 0; i < sel_cols_.size(); i++) {
+            memcpy(record->data + sel_cols_[i].offset, values[i].raw->data, values[i].raw->size);
+        }
+        return record;
+    }
+
+    static ColMeta make_count_star_col(const TabCol &c) {
+        ColMeta col;
+        col.name = "*";
+        col.tab_name = "";
+        col.alias = c.alias;
+        col.type = TYPE_INT;
+        col.len = sizeof(int);
+        col.offset = 0;
+        col.aggr = ast::AGGR_TYPE_COUNT;
+        return col;
+    }
+};
@@ -40,10 +40,12 @@ class ProjectionExecutor : public AbstractExecutor {
     }
 
     void beginTuple() override {
+        TRACE_SPAN("Projection::beginTuple");
         prev_->beginTuple();
     }
 
     void nextTuple() override {
+        TRACE_SPAN("Projection::nextTuple");
         prev_->nextTuple();
     }
 
@@ -76,6 +78,11 @@ class ProjectionExecutor : public AbstractExecutor {
         return _abstract_rid;
     }
 
+    // 投影和输入一一对应
+    void set_limit_hint(size_t n) override {
+        prev_->set_limit_hint(n);
+    }
+
     ExecutorType getType() override {
         return PROJECTION_EXECUTOR;
     }
@@ -0,0 +1,188 @@
+/* Copyright (c) 2023 Renmin University of China
+RMDB is licensed under Mulan PSL v2.
+You can use this software according to the terms and conditions of the Mulan PSL v2.
+You may obtain a copy of Mulan PSL v2 at:
+        http://license.coscl.org.cn/MulanPSL2
+THIS SOFTWARE IS PROVIDED ON AN "AS IS" BASIS, WITHOUT WARRANTIES OF ANY KIND,
+EITHER EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO NON-INFRINGEMENT,
+MERCHANTABILITY OR FIT FOR A PARTICULAR PURPOSE.
+See the Mulan PSL v2 for more details. */
+
+#pragma once
+
+#include <unordered_set>
+
+#include "common/server_config.h"
+#include "execution_defs.h"
+#include "executor_abstract.h"
+
+/**
+ * 不相关子查询的半连接/反连接：子查询（build side）只执行一次，结果列的值放入哈希表，
+ * 之后逐条读取外层输入，只输出在哈希表中有（IN）或没有（NOT IN）匹配值的记录，记录原样输出。
+ * EXISTS没有连接列，子查询读到第一条记录即可，所有外层记录的结果都相同。
+ * 半连接时还用子查询的结果构建运行时过滤器下推给外层的扫描，不可能匹配的记录在扫描时就被跳过
+ */
+class SemiJoinExecutor : public AbstractExecutor {
+  private:
+    std::unique_ptr<AbstractExecutor> outer_;    // 外层输入
+    std::unique_ptr<AbstractExecutor> subquery_; // 子查询，只有一个输出列
+    TabCol outer_col_;                           // 外层的连接列，EXISTS时col_name为空
+    ColMeta outer_meta_;                         // 连接列在外层记录中的位置
+    bool is_anti_;                               // NOT IN/NOT EXISTS
+
+    std::unordered_set<std::string> keys_; // 子查询的结果，转换为外层连接列的类型
+    bool has_null_ = false;                // 子查询结果中有NULL（空输入上的聚合），此时NOT IN不成立
+    bool exists_ = false;                  // EXISTS时子查询是否有结果
+    std::unique_ptr<RmRecord> current_;    // 当前的外层记录
+    bool is_end_ = true;
+
+  public:
+    SemiJoinExecutor(std::unique_ptr<AbstractExecutor> outer, std::unique_ptr<AbstractExecutor> subquery,
+                     TabCol outer_col, bool is_anti) {
+        outer_ = std::move(outer);
+        subquery_ = std::move(subquery);
+        outer_col_ = std::move(outer_col);
+        is_anti_ = is_anti;
+        if (!outer_col_.col_name.empty()) {
+            outer_meta_ = *get_col(outer_->cols(), outer_col_);
+        }
+    }
+
+    void beginTuple() override {
+        TRACE_SPAN("SemiJoin::beginTuple");
+        if (outer_col_.col_name.empty()) {
+            subquery_->set_limit_hint(1);
+            subquery_->beginTuple();
+            exists_ = !subquery_->is_end();
+            if (exists_ == is_anti_) {
+                // 结果对所有外层记录都不成立，不需要读取外层输入
+                is_end_ = true;
+                return;
+            }
+        } else {
+            build();
+        }
+        outer_->beginTuple();
+        is_end_ = false;
+        seek();
+    }
+
+    void nextTuple() override {
+        TRACE_SPAN("SemiJoin::nextTuple");
+        assert(!is_end());
+        outer_->nextTuple();
+        seek();
+    }
+
+    [[nodiscard]] bool is_end() const override {
+        return is_end_;
+    }
+
+    std::unique_ptr<RmRecord> Next() override {
+        return std::move(current_);
+    }
+
+    Rid &rid() override {
+        return outer_->rid();
+    }
+
+    [[nodiscard]] const std::vector<ColMeta> &cols() const override {
+        return outer_->cols();
+    }
+
+    [[nodiscard]] size_t tupleLen() const override {
+        return outer_->tupleLen();
+    }
+
+    ColMeta get_col_offset(const TabCol &target) override {
+        return *get_col(outer_->cols(), target);
+    }
+
+    [[nodiscard]] std::string tableName() const override {
+        return outer_->tableName();
+    }
+
+    ExecutorType getType() override {
+        return SEMI_JOIN_EXECUTOR;
+    }
+
+    /**
+     * @description: 把列值转换为key_type类型后作为哈希表的键，int和float相互比较时按外层列的类型
+     * @return {bool} float转换为int时不是整数则返回false，不可能和int列相等
+     */
+    static bool make_key(const char *record, const ColMeta &col, ColType key_type, std::string &key) {
+        const char *data = record + col.offset;
+        if (col.type == TYPE_STRING) {
+            key.assign(data, strnlen(data, col.len)); // 和Value的比较一致，忽略末尾的'\0'
+        } else if (col.type == TYPE_FLOAT || key_type == TYPE_FLOAT) {
+            float value = col.type == TYPE_FLOAT ? *(const float *)data : (float)*(const int *)data;
+            if (key_type != TYPE_FLOAT) {
+                if (value != (float)(int)value) {
+                    return false;
+                }
+                int int_value = (int)value;
+                key.assign((const char *)&int_value, sizeof(int));
+                return true;
+            }
+            value = value == 0 ? 0.0f : value; // -0.0和0.0相等
+            key.assign((const char *)&value, sizeof(float));
+        } else {
+            key.assign(data, sizeof(int));
+        }
+        return true;
+    }
+
+  private:
+    // 执行子查询，把结果列的值放入哈希表；半连接时同时构建运行时过滤器下推给外层
+    void build() {
+        keys_.clear();
+        has_null_ = false;
+        subquery_->beginTuple();
+        const ColMeta sub_meta = subquery_->cols()[0];
+        std::shared_ptr<RuntimeFilter> filter;
+        if (!is_anti_ && server_config.enable_runtime_filter) {
+            filter = RuntimeFilter::create({sub_meta}, {outer_meta_});
+        }
+        std::string key;
+        for (; !subquery_->is_end(); subquery_->nextTuple()) {
+            auto record = subquery_->Next();
+            // 聚合在Next()中才把结果为NULL的列的类型改为TYPE_NULL
+            if (subquery_->cols()[0].type == TYPE_NULL) {
+                has_null_ = true;
+                continue;
+            }
+            if (make_key(record->data, sub_meta, outer_meta_.type, key)) {
+                keys_.insert(key);
+                if (filter != nullptr) {
+                    filter->add(record->data);
+                }
+            }
+        }
+        if (filter != nullptr) {
+            filter->seal();
+            outer_->set_runtime_filter(filter);
+        }
+    }
+
+    bool matches(const RmRecord &record) {
+        if (outer_col_.col_name.empty()) {
+            return exists_ != is_anti_;
+        }
+        std::string key;
+        make_key(record.data, outer_meta_, outer_meta_.type, key);
+        bool found = keys_.count(key) > 0;
+        return is_anti_ ? !found && !has_null_ : found;
+    }
+
+    // 从外层的当前记录开始，找到下一条满足条件的记录
+    void seek() {
+        for (; !outer_->is_end(); outer_->nextTuple()) {
+            current_ = outer_->Next();
+            if (matches(*current_)) {
+                return;
+            }
+        }
+        current_ = nullptr;
+        is_end_ = true;
+    }
+};
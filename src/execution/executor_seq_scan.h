@@ -15,6 +15,7 @@ See the Mulan PSL v2 for more details. */
 #include "executor_abstract.h"
 #include "index/ix.h"
 #include "system/sm.h"
+#include "system/sm_partition.h"
 
 class SeqScanExecutor : public AbstractExecutor {
   private:
@@ -24,10 +25,13 @@ class SeqScanExecutor : public AbstractExecutor {
     std::vector<ColMeta> cols_;        // scan后生成的记录的字段
     size_t len_;                       // scan后生成的每条记录的长度
     std::vector<Condition> fed_conds_; // 同conds_，两个字段相同
+    std::vector<int> partitions_;      // 分区裁剪后需要扫描的分区
 
     Rid rid_{};
     std::unique_ptr<RecScan> scan_; // table_iterator
 
+    std::shared_ptr<RuntimeFilter> runtime_filter_; // join下推的运行时过滤器，可能为空
+
     SmManager *sm_manager_;
 
   public:
@@ -43,6 +47,7 @@ class SeqScanExecutor : public AbstractExecutor {
         context_ = context;
 
         fed_conds_ = conds_;
+        partitions_ = Partitioner(tab).prune(conds_);
     }
 
     [[nodiscard]] size_t tupleLen() const override {
@@ -54,7 +59,8 @@ class SeqScanExecutor : public AbstractExecutor {
     };
 
     void beginTuple() override {
-        scan_ = std::make_unique<RmScan>(fh_);
+        TRACE_SPAN("SeqScan::beginTuple");
+        scan_ = std::make_unique<RmScan>(fh_, partitions_);
         // 当前记录未消费，可能需要
         while (!is_end() && !evalConditions()) { // 滑过不满足条件的记录
             scan_->next();
@@ -62,19 +68,34 @@ class SeqScanExecutor : public AbstractExecutor {
     }
 
     void nextTuple() override {
+        TRACE_SPAN("SeqScan::nextTuple");
         // 当前记录已经消费完了
         do {
             scan_->next(); // 滑过不满足条件的记录
         } while (!is_end() && !evalConditions());
     }
 
+    bool set_runtime_filter(std::shared_ptr<RuntimeFilter> filter) override {
+        const auto &keys = filter->probe_keys();
+        auto on_this_table = [this](const ColMeta &col) { return col.tab_name == tab_name_; };
+        if (!std::all_of(keys.begin(), keys.end(), on_this_table)) {
+            return false;
+        }
+        runtime_filter_ = std::move(filter);
+        return true;
+    }
+
     bool evalConditions() {
-        auto handle = fh_->get_record(scan_->rid(), context_);
-        char *base = handle->data;
-        // 逻辑不短路，目前只实现逻辑与
-        return std::all_of(conds_.begin(), conds_.end(), [base, this](const Condition &cond) {
-            auto value = Value::col2Value(base, get_col_offset(cond.lhs_col));
-            return cond.eval_with_rvalue(value);
+        thread_stats().tuples_scanned++;
+        // 直接在页面上求值，不满足条件的记录不会被拷贝
+        return fh_->test_record(scan_->rid(), [this](const char *base) {
+            if (runtime_filter_ != nullptr && !runtime_filter_->may_contain(base)) {
+                thread_stats().runtime_filtered++;
+                return false;
+            }
+            auto col_of = [this](const TabCol &col) { return get_col_offset(col); };
+            return std::all_of(conds_.begin(), conds_.end(),
+                               [base, &col_of](const Condition &cond) { return cond.eval_record(base, col_of); });
         });
     }
 
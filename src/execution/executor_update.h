@@ -26,6 +26,12 @@ class UpdateExecutor : public AbstractExecutor {
     std::vector<SetClause> set_clauses_;
     SmManager *sm_manager_;
 
+    std::vector<ColMeta> set_cols_;          // set_clauses_[i]写入的列
+    std::vector<int> new_val_offsets_;       // set_clauses_[i]的新值在new_vals_中的偏移
+    std::unique_ptr<char[]> new_vals_;       // 各set子句的新值，常量在构造时写好，表达式每条记录求值一次
+    std::vector<IndexMeta> changed_indexes_; // 含有被修改的列的索引，其余索引的key不会变化
+    bool has_views_;                         // 表上建有物化视图，更新后要用新旧记录维护视图
+
   public:
     UpdateExecutor(SmManager *sm_manager, const std::string &tab_name, std::vector<SetClause> set_clauses,
                    std::vector<Condition> conds, std::vector<Rid> rids, Context *context) {
@@ -37,98 +43,175 @@ class UpdateExecutor : public AbstractExecutor {
         conds_ = std::move(conds);
         rids_ = std::move(rids);
         context_ = context;
+        has_views_ = sm_manager_->has_views(tab_name);
+
+        int offset = 0;
+        for (auto &clause : set_clauses_) {
+            set_cols_.push_back(*tab_.get_col(clause.lhs.col_name));
+            new_val_offsets_.push_back(offset);
+            offset += set_cols_.back().len;
+        }
+        new_vals_ = std::make_unique<char[]>(offset);
+        for (size_t i = 0; i < set_clauses_.size(); i++) {
+            auto &clause = set_clauses_[i];
+            if (clause.rhs_expr == nullptr) {
+                clause.rhs.init_raw(set_cols_[i].len);
+                memcpy(new_vals_.get() + new_val_offsets_[i], clause.rhs.raw->data, set_cols_[i].len);
+            }
+        }
+        for (auto &index : tab_.indexes) {
+            bool changed = std::any_of(index.cols.begin(), index.cols.end(), [this](const ColMeta &col) {
+                return std::any_of(set_cols_.begin(), set_cols_.end(),
+                                   [&col](const ColMeta &set_col) { return set_col.name == col.name; });
+            });
+            if (changed) {
+                changed_indexes_.push_back(index);
+            }
+        }
     }
 
     std::unique_ptr<RmRecord> Next() override {
-        int record_size = fh_->get_file_hdr().record_size;
-        // auto buf = std::make_unique<char[]>(record_size);
-        // std::vector<std::unique_ptr<char[]>> bufs;
+        TRACE_SPAN("Update::Next");
         // NOTE: 按照
         // MySQL，这里本应当是一个事务，因为需要检测唯一索引是否有重复的记录。现在的实现没有考虑在检测到重复的时候回滚，而是直接抛出异常，原有的数据不会被修改回去。
 
-        for (const auto &rid : rids_) {
-            auto buf = std::make_unique<char[]>(record_size);
-            auto record = fh_->get_record(rid, context_);
-            memcpy(buf.get(), record->data, record_size);
-            for (auto &clause : set_clauses_) {
-                auto col = tab_.get_col(clause.lhs.col_name);
-                clause.rhs.init_raw(col->len);
-                memcpy(buf.get() + col->offset, clause.rhs.raw->data, col->len);
+        try {
+            for (const auto &rid : rids_) {
+                if (changed_indexes_.empty()) {
+                    update_in_place(rid);
+                } else {
+                    update_with_indexes(rid);
+                }
+                thread_stats().tuples_produced++;
             }
+        } catch (RMDBError &) {
+            // 抛出异常之前更新过的记录不会被改回去，同样要让缓存的查询结果失效
+            sm_manager_->bump_table_version(tab_name_);
+            throw;
+        }
+        if (!rids_.empty()) {
+            sm_manager_->bump_table_version(tab_name_);
+        }
 
-            // Update index
-            std::vector<std::unique_ptr<RmRecord>> old_keys;
-            std::vector<std::unique_ptr<RmRecord>> new_keys;
-            std::vector<bool> check;
-            for (auto &index : tab_.indexes) {
-                auto ih =
-                    sm_manager_->ihs_.at(sm_manager_->get_ix_manager()->get_index_name(tab_name_, index.cols)).get();
-                char *key_old = new char[index.col_tot_len];
-                char *key_new = new char[index.col_tot_len];
-                size_t offset = 0;
-                for (int i = 0; i < index.col_num; i++) {
-                    auto col = tab_.get_col(index.cols[i].name);
-                    memcpy(key_old + offset, record->data + col->offset, col->len);
-                    memcpy(key_new + offset, buf.get() + col->offset, col->len);
-                    offset += col->len;
-                }
+        return nullptr;
+    }
 
-                // 如果old_key和new_key相同，说明没有修改索引列，不能检测重复
-                bool is_same = memcmp(key_old, key_new, index.col_tot_len) == 0;
-                check.emplace_back(is_same);
-                if (is_same)
-                    continue;
+    Rid &rid() override {
+        return _abstract_rid;
+    }
 
-                // check duplicate
-                std::vector<Rid> _ret;
-                if (ih->get_value(key_new, &_ret, context_->txn_)) {
-                    throw IndexKeyDuplicateError();
-                }
+    ExecutorType getType() override {
+        return ExecutorType::UPDATE_EXECUTOR;
+    }
+
+  private:
+    // 在更新前的记录上计算含列的set子句，所有子句都读取旧值（set a = b, b = a交换两列）
+    void eval_set_clauses(const char *record) {
+        for (size_t i = 0; i < set_clauses_.size(); i++) {
+            auto &expr = set_clauses_[i].rhs_expr;
+            if (expr != nullptr) {
+                expr->eval(record).store(new_vals_.get() + new_val_offsets_[i], set_cols_[i].type, set_cols_[i].len);
+            }
+        }
+    }
 
-                old_keys.emplace_back(std::make_unique<RmRecord>(index.col_tot_len, key_old));
-                new_keys.emplace_back(std::make_unique<RmRecord>(index.col_tot_len, key_new));
+    void write_set_clauses(char *record) const {
+        for (size_t i = 0; i < set_cols_.size(); i++) {
+            memcpy(record + set_cols_[i].offset, new_vals_.get() + new_val_offsets_[i], set_cols_[i].len);
+        }
+    }
+
+    // 没有修改索引列：直接在页面上求值并写入新值，不拷贝记录（有物化视图时除外），也不维护索引
+    void update_in_place(const Rid &rid) {
+        int record_size = fh_->get_file_hdr().record_size;
+        std::unique_ptr<RmRecord> view_old_record;
+        fh_->modify_record(rid, [this, &rid, record_size, &view_old_record](char *record) {
+            eval_set_clauses(record); // 求值出错时记录还没有被修改
+            if (has_views_) {
+                view_old_record = std::make_unique<RmRecord>(record_size, record);
+            }
+            if (!context_->txn_->get_txn_mode()) {
+                write_set_clauses(record);
+                return;
             }
+            RmRecord old_record(record_size, record);
+            write_set_clauses(record);
+            // 添加的是更新之后的记录
+            auto write_record = new WriteRecord(WType::UPDATE_TUPLE, tab_name_, rid, RmRecord(record_size, record));
+            write_record->old_record_ = old_record;
+            context_->txn_->append_write_record(write_record);
+        });
+        if (view_old_record != nullptr) {
+            // 页面已经释放，在旧记录的副本上写入新值，维护视图时可能要扫描本表
+            RmRecord view_new_record(record_size, view_old_record->data);
+            write_set_clauses(view_new_record.data);
+            sm_manager_->maintain_views(tab_name_, view_old_record->data, view_new_record.data, context_);
+        }
+    }
 
-            int key_cur = 0;
-            for (int i = 0; i < tab_.indexes.size(); i++) {
-                auto &index = tab_.indexes[i];
-
-                if (check[i])
-                    continue; // 如果old_key和new_key相同，说明没有修改索引列
-                auto &old_key = old_keys[key_cur];
-                auto &new_key = new_keys[key_cur++];
-                auto ih =
-                    sm_manager_->ihs_.at(sm_manager_->get_ix_manager()->get_index_name(tab_name_, index.cols)).get();
-                ih->delete_entry(old_key->data, context_->txn_);
-                ih->insert_entry(new_key->data, rid, context_->txn_);
+    void update_with_indexes(const Rid &rid) {
+        int record_size = fh_->get_file_hdr().record_size;
+        auto buf = std::make_unique<char[]>(record_size);
+        auto record = fh_->get_record(rid, context_);
+        memcpy(buf.get(), record->data, record_size);
+        eval_set_clauses(record->data);
+        write_set_clauses(buf.get());
+
+        // Update index
+        std::vector<std::unique_ptr<RmRecord>> old_keys;
+        std::vector<std::unique_ptr<RmRecord>> new_keys;
+        std::vector<bool> check;
+        for (auto &index : changed_indexes_) {
+            auto ih = sm_manager_->ihs_.at(sm_manager_->get_ix_manager()->get_index_name(tab_name_, index.cols)).get();
+            auto key_old = std::make_unique<RmRecord>(index.col_tot_len);
+            auto key_new = std::make_unique<RmRecord>(index.col_tot_len);
+            size_t offset = 0;
+            for (int i = 0; i < index.col_num; i++) {
+                auto col = tab_.get_col(index.cols[i].name);
+                memcpy(key_old->data + offset, record->data + col->offset, col->len);
+                memcpy(key_new->data + offset, buf.get() + col->offset, col->len);
+                offset += col->len;
             }
 
-            // Operate Transaction
-            if (context_->txn_->get_txn_mode()) {
-                // 添加的是更新之后的记录
-                // auto write_record = WriteRecord(WType::UPDATE_TUPLE, tab_name_, rid, *fh_->get_record(rid,
-                // context_)); auto new_rm_record = std::make_unique<RmRecord>(record_size, buf.get()); auto
-                // write_record = WriteRecord(WType::UPDATE_TUPLE, tab_name_, rid, *new_rm_record);
-                // write_record.old_record_ = *std::move(record);
-
-                auto new_rm_record = std::make_unique<RmRecord>(record_size, buf.get());
-                WriteRecord *write_record =
-                    new WriteRecord(WType::UPDATE_TUPLE, tab_name_, rid, *std::move(new_rm_record));
-                write_record->old_record_ = *std::move(record);
-                context_->txn_->append_write_record(write_record);
+            // 如果old_key和new_key相同，说明没有修改索引列，不能检测重复
+            bool is_same = memcmp(key_old->data, key_new->data, index.col_tot_len) == 0;
+            check.emplace_back(is_same);
+            if (is_same)
+                continue;
+
+            // check duplicate
+            std::vector<Rid> _ret;
+            if (ih->get_value(key_new->data, &_ret, context_->txn_)) {
+                throw IndexKeyDuplicateError();
             }
 
-            fh_->update_record(rid, buf.get(), context_);
+            old_keys.emplace_back(std::move(key_old));
+            new_keys.emplace_back(std::move(key_new));
         }
 
-        return nullptr;
-    }
+        int key_cur = 0;
+        for (size_t i = 0; i < changed_indexes_.size(); i++) {
+            auto &index = changed_indexes_[i];
+
+            if (check[i])
+                continue; // 如果old_key和new_key相同，说明没有修改索引列
+            auto &old_key = old_keys[key_cur];
+            auto &new_key = new_keys[key_cur++];
+            auto ih = sm_manager_->ihs_.at(sm_manager_->get_ix_manager()->get_index_name(tab_name_, index.cols)).get();
+            ih->delete_entry(old_key->data, rid, context_->txn_);
+            ih->insert_entry(new_key->data, rid, context_->txn_);
+        }
 
-    Rid &rid() override {
-        return _abstract_rid;
-    }
+        fh_->update_record(rid, buf.get(), context_);
+        sm_manager_->maintain_views(tab_name_, record->data, buf.get(), context_);
 
-    ExecutorType getType() override {
-        return ExecutorType::UPDATE_EXECUTOR;
+        // Operate Transaction
+        if (context_->txn_->get_txn_mode()) {
+            // 添加的是更新之后的记录
+            auto new_rm_record = std::make_unique<RmRecord>(record_size, buf.get());
+            WriteRecord *write_record = new WriteRecord(WType::UPDATE_TUPLE, tab_name_, rid, *std::move(new_rm_record));
+            write_record->old_record_ = *std::move(record);
+            context_->txn_->append_write_record(write_record);
+        }
     }
-};
\ No newline at end of file
+};
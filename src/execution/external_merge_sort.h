@@ -10,6 +10,9 @@ See the Mulan PSL v2 for more details. */
 
 #pragma once
 
+#include "common/key_comparator.h"
+#include "common/query_stats.h"
+#include "common/task_scheduler.h"
 #include "errors.h"
 #include <cstring>
 #include <fcntl.h>
@@ -24,50 +27,61 @@ See the Mulan PSL v2 for more details. */
 #include <fstream>
 #include <ios>
 #include <memory>
+#include <numeric>
 
 class ExternalMergeSorter {
   private:
     const ssize_t TOTAL_MEM; // 指示排序算法最多能使用的内存(近似)，此参数影响文件大小和缓冲区大小
     const ssize_t RECORD_SIZE;
+    const ssize_t RUN_SIZE; // 每个run(临时文件)的字节数，两个run和排序一个run用的下标数组一起不超过TOTAL_MEM
     std::vector<std::string> filenames_;              // 大表分隔后存储在多个文件中
     std::vector<std::ifstream> opened_files;          // 保存打开的文件
     std::vector<std::unique_ptr<char[]>> buffer_list; // 分配个每个ifstream对象的缓冲区
     std::vector<std::unique_ptr<char[]>> record_list; // 每个文件“第一个”记录
     std::vector<ssize_t> heap;                        // 堆模拟败者树
 
-    int (*cmp_)(const void *, const void *, void *); // 比较函数
-
-    void *arg_;           // 比较函数传入的额外参数，用于比较记录的任意属性，传递给`qsort_r`
+    KeyComparator cmp_;   // 按排序键比较两条记录
+    bool desc_;           // 是否降序
     int total_record = 0; // 记录总数，用于判断是否读完
 
     // 以下只在write函数中使用
     ssize_t index = 0;    // 当前插入记录在文件中的偏移
     char *data = nullptr; // 写入时文件映射在此处
     bool isFull = true;   // 当前使用的文件是否已满
+
+    // 已写满、正在由调度器排序的上一个run，最多一个
+    std::shared_ptr<TaskGroup> pending_run_;
+
   public:
-    ExternalMergeSorter(ssize_t total_mem, ssize_t record_size, int (*cmp)(const void *, const void *, void *),
-                        void *arg = nullptr)
+    ExternalMergeSorter(ssize_t total_mem, ssize_t record_size, KeyComparator cmp, bool desc = false)
         // 保证每个文件大小是记录大小的整数倍
-        : TOTAL_MEM(total_mem - total_mem % record_size), RECORD_SIZE(record_size), cmp_(cmp), arg_(arg) {
+        : TOTAL_MEM(total_mem - total_mem % record_size), RECORD_SIZE(record_size),
+          RUN_SIZE(run_size(total_mem, record_size, cmp)), cmp_(std::move(cmp)), desc_(desc) {
     }
 
     ExternalMergeSorter(ExternalMergeSorter &&sorter) noexcept
-        : TOTAL_MEM(sorter.TOTAL_MEM), RECORD_SIZE(sorter.RECORD_SIZE) {
+        : TOTAL_MEM(sorter.TOTAL_MEM), RECORD_SIZE(sorter.RECORD_SIZE), RUN_SIZE(sorter.RUN_SIZE) {
         filenames_ = std::move(sorter.filenames_);
         opened_files = std::move(sorter.opened_files);
         buffer_list = std::move(sorter.buffer_list);
         record_list = std::move(sorter.record_list);
         heap = std::move(sorter.heap);
-        cmp_ = sorter.cmp_;
-        arg_ = sorter.arg_;
+        cmp_ = std::move(sorter.cmp_);
+        desc_ = sorter.desc_;
         total_record = sorter.total_record;
         index = sorter.index;
         data = sorter.data;
         isFull = sorter.isFull;
+        pending_run_ = std::move(sorter.pending_run_);
     }
 
     /// 上层函数可能不读完所有记录
     ~ExternalMergeSorter() {
+        try {
+            wait_pending_run();
+        } catch (std::exception &) {
+            // 析构时只需要等待排序任务结束
+        }
         for (size_t i = 0; i < opened_files.size(); ++i) {
             if (opened_files[i].is_open()) {
                 opened_files[i].close();
@@ -79,8 +93,14 @@ class ExternalMergeSorter {
     void write(const char *record) {
         if (isFull) {
             if (data != nullptr) {
-                ::qsort_r(data, TOTAL_MEM / RECORD_SIZE, RECORD_SIZE, cmp_, arg_);
-                munmap(data, TOTAL_MEM);
+                // 写满的run交给调度器排序，同时继续写下一个run；内存中最多同时有两个run
+                wait_pending_run();
+                pending_run_ = TaskScheduler::instance().spawn(
+                    [data = data, size = RUN_SIZE, record_size = RECORD_SIZE, cmp = cmp_, desc = desc_] {
+                        sort_run(data, size / record_size, record_size, cmp, desc);
+                        munmap(data, size);
+                        thread_stats().sort_spill_bytes += size;
+                    });
             }
             char filename[] = "auxiliary_sort_fileXXXXXX";
             int fd = mkstemp(filename);
@@ -88,8 +108,8 @@ class ExternalMergeSorter {
             if (fd == -1) {
                 throw UnixError();
             }
-            ftruncate(fd, TOTAL_MEM);
-            data = (char *)mmap(nullptr, TOTAL_MEM, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+            ftruncate(fd, RUN_SIZE);
+            data = (char *)mmap(nullptr, RUN_SIZE, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
             if (data == (void *)-1) {
                 throw UnixError();
             }
@@ -100,15 +120,17 @@ class ExternalMergeSorter {
         memcpy(data + index * RECORD_SIZE, record, RECORD_SIZE);
         index++;
         total_record++;
-        if (index == TOTAL_MEM / RECORD_SIZE) {
+        if (index == RUN_SIZE / RECORD_SIZE) {
             isFull = true;
         }
     }
 
     void endWrite() {
+        wait_pending_run();
         if (data != nullptr) {
-            ::qsort_r(data, index, RECORD_SIZE, cmp_, arg_);
-            munmap(data, TOTAL_MEM);
+            sort_run(data, index, RECORD_SIZE, cmp_, desc_);
+            munmap(data, RUN_SIZE);
+            thread_stats().sort_spill_bytes += index * RECORD_SIZE;
             int fd = open(filenames_.back().c_str(), O_RDWR);
             if (fd == -1) {
                 throw UnixError();
@@ -122,6 +144,9 @@ class ExternalMergeSorter {
     }
 
     void beginRead() {
+        if (filenames_.empty()) {
+            return; // 没有写入任何记录，is_end()为真
+        }
         ssize_t _buffer_size = TOTAL_MEM / filenames_.size();
         const ssize_t buffer_size = _buffer_size - _buffer_size % RECORD_SIZE; // 尽量使用更多的内存
         for (const auto &filename : filenames_) {
@@ -155,8 +180,9 @@ class ExternalMergeSorter {
         for (ssize_t i = (1 << height) - 1; i >= 1; i--) {
             ssize_t left = i << 1;
             ssize_t right = i << 1 ^ 1;
-            if (winners[left] != -1 && (winners[right] == -1 || cmp_(record_list[winners[left]].get(),
-                                                                     record_list[winners[right]].get(), arg_) <= 0)) {
+            if (winners[left] != -1 &&
+                (winners[right] == -1 ||
+                 compare(record_list[winners[left]].get(), record_list[winners[right]].get()) <= 0)) {
                 // 左节点获胜
                 winners[i] = winners[left];
                 heap[i] = winners[right];
@@ -171,6 +197,12 @@ class ExternalMergeSorter {
 
     /// 取出最小的记录后，调整败者树
     void adjust() {
+        cmp_.visit([this](const auto &key_cmp) { adjust(key_cmp); });
+    }
+
+    /// 按比较器的具体类型实例化，一次调整中的多次比较不再经过类型分派
+    template <typename Cmp>
+    void adjust(const Cmp &key_cmp) {
         ssize_t file_index = heap[0]; // 此记录已经使用完了
         opened_files[file_index].read(record_list[file_index].get(), RECORD_SIZE);
         size_t height = std::ceil(std::log2(filenames_.size()));
@@ -185,8 +217,8 @@ class ExternalMergeSorter {
         while (cur != 1) {             // 使用新值重新参与比赛
             ssize_t parent = cur >> 1; // heap[parent]是上次比赛中的败者
             // 父节点保存了左右子树两胜者中的次胜者(败者)
-            if (winner != -1 &&
-                (heap[parent] == -1 || cmp_(record_list[winner].get(), record_list[heap[parent]].get(), arg_) <= 0)) {
+            if (winner != -1 && (heap[parent] == -1 || compare(key_cmp, record_list[winner].get(),
+                                                               record_list[heap[parent]].get()) <= 0)) {
                 // winner参赛并取胜，败者不变，winner继续参与下一轮比赛
                 cur = parent;
             } else {
@@ -208,4 +240,111 @@ class ExternalMergeSorter {
     [[nodiscard]] bool is_end() const {
         return total_record == 0;
     }
+
+  private:
+    /**
+     * @description: 每个run的字节数。写满的run在后台排序时下一个run同时在写，内存中最多有两个run，
+     * 排序其中一个时还需要每条记录一个(键, 下标)或下标，三者之和不超过total_mem
+     */
+    static ssize_t run_size(ssize_t total_mem, ssize_t record_size, const KeyComparator &cmp) {
+        ssize_t order_size = cmp.visit([](const auto &key_cmp) -> ssize_t {
+            using Cmp = std::decay_t<decltype(key_cmp)>;
+            if constexpr (Cmp::HAS_KEY) {
+                return sizeof(std::pair<typename Cmp::Key, uint32_t>);
+            } else if constexpr (std::is_same_v<Cmp, KeyComparator::StringKey>) {
+                return sizeof(std::pair<uint64_t, uint32_t>);
+            } else {
+                return sizeof(uint32_t);
+            }
+        });
+        return std::max<ssize_t>(1, total_mem / (2 * record_size + order_size)) * record_size;
+    }
+
+    int compare(const char *a, const char *b) const {
+        int res = cmp_(a, b);
+        return desc_ ? -res : res;
+    }
+
+    template <typename Cmp>
+    int compare(const Cmp &key_cmp, const char *a, const char *b) const {
+        int res = key_cmp(a, b);
+        return desc_ ? -res : res;
+    }
+
+    /**
+     * @description: 排序一个run中的num条记录。按比较器的具体类型实例化std::sort，得到排序后的下标，
+     * 再按下标把记录搬到位。能取出定长键时排序(键, 下标)，访存连续；否则排序下标，比较时访问记录
+     */
+    static void sort_run(char *data, size_t num, size_t record_size, const KeyComparator &cmp, bool desc) {
+        assert(num <= UINT32_MAX);
+        cmp.visit([&](const auto &key_cmp) {
+            using Cmp = std::decay_t<decltype(key_cmp)>;
+            if constexpr (Cmp::HAS_KEY) {
+                std::vector<std::pair<typename Cmp::Key, uint32_t>> keys(num);
+                for (size_t i = 0; i < num; i++) {
+                    keys[i] = {key_cmp.key(data + i * record_size), (uint32_t)i};
+                }
+                if (desc) {
+                    std::sort(keys.begin(), keys.end(), [](const auto &x, const auto &y) { return y.first < x.first; });
+                } else {
+                    std::sort(keys.begin(), keys.end(), [](const auto &x, const auto &y) { return x.first < y.first; });
+                }
+                gather(data, num, record_size, [&keys](size_t i) -> uint32_t & { return keys[i].second; });
+            } else if constexpr (std::is_same_v<Cmp, KeyComparator::StringKey>) {
+                // 先比较字符串的前8个字节，相同时再比较整个字符串，多数比较不需要访问记录
+                std::vector<std::pair<uint64_t, uint32_t>> keys(num);
+                for (size_t i = 0; i < num; i++) {
+                    keys[i] = {key_cmp.prefix(data + i * record_size), (uint32_t)i};
+                }
+                std::sort(keys.begin(), keys.end(), [&](const auto &x, const auto &y) {
+                    if (x.first != y.first) {
+                        return desc ? x.first > y.first : x.first < y.first;
+                    }
+                    int res = key_cmp(data + x.second * record_size, data + y.second * record_size);
+                    return desc ? res > 0 : res < 0;
+                });
+                gather(data, num, record_size, [&keys](size_t i) -> uint32_t & { return keys[i].second; });
+            } else {
+                std::vector<uint32_t> order(num);
+                std::iota(order.begin(), order.end(), 0);
+                std::sort(order.begin(), order.end(), [&](uint32_t x, uint32_t y) {
+                    int res = key_cmp(data + x * record_size, data + y * record_size);
+                    return desc ? res > 0 : res < 0;
+                });
+                gather(data, num, record_size, [&order](size_t i) -> uint32_t & { return order[i]; });
+            }
+        });
+    }
+
+    /**
+     * @description: 排序后第i个位置应放原来的第source(i)条记录。沿置换的环原地移动记录，只需要一条记录的
+     * 临时空间；放好的位置把source(i)改为i，下标数组同时用作访问标记
+     */
+    template <typename Source>
+    static void gather(char *data, size_t num, size_t record_size, const Source &source) {
+        std::unique_ptr<char[]> saved(new char[record_size]);
+        for (size_t i = 0; i < num; i++) {
+            if (source(i) == i) {
+                continue;
+            }
+            // 环上第一个位置的记录先移出，其余位置依次从source拷入，最后一个位置放移出的记录
+            memcpy(saved.get(), data + i * record_size, record_size);
+            size_t j = i;
+            while (source(j) != i) {
+                size_t k = source(j);
+                memcpy(data + j * record_size, data + k * record_size, record_size);
+                source(j) = j;
+                j = k;
+            }
+            memcpy(data + j * record_size, saved.get(), record_size);
+            source(j) = j;
+        }
+    }
+
+    void wait_pending_run() {
+        if (pending_run_ != nullptr) {
+            auto run = std::move(pending_run_);
+            run->wait();
+        }
+    }
 };
\ No newline at end of file
@@ -0,0 +1,134 @@
+/* Copyright (c) 2023 Renmin University of China
+RMDB is licensed under Mulan PSL v2.
+You can use this software according to the terms and conditions of the Mulan PSL v2.
+You may obtain a copy of Mulan PSL v2 at:
+        http://license.coscl.org.cn/MulanPSL2
+THIS SOFTWARE IS PROVIDED ON AN "AS IS" BASIS, WITHOUT WARRANTIES OF ANY KIND,
+EITHER EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO NON-INFRINGEMENT,
+MERCHANTABILITY OR FIT FOR A PARTICULAR PURPOSE.
+See the Mulan PSL v2 for more details. */
+
+#pragma once
+
+#include "common/task_scheduler.h"
+#include "execution_defs.h"
+#include "runtime_filter.h"
+#include "system/sm.h"
+#include "system/sm_partition.h"
+
+/**
+ * 把表的数据页按MORSEL_PAGES划分为morsel，每个morsel可以由任意线程独立扫描，分区表只划分裁剪后剩下的分区。
+ * 扫描时直接在页面上求值选择条件和运行时过滤器，只把满足条件的记录交给调用者
+ */
+class ParallelTableScan {
+  public:
+    ParallelTableScan(SmManager *sm_manager, std::string tab_name, std::vector<Condition> conds)
+        : tab_name_(std::move(tab_name)), conds_(std::move(conds)) {
+        TabMeta &tab = sm_manager->db_.get_table(tab_name_);
+        fh_ = sm_manager->fhs_.at(tab_name_).get();
+        cols_ = tab.cols;
+        len_ = cols_.back().offset + cols_.back().len;
+        for (auto &cond : conds_) {
+            cond_cols_.push_back(cond.op == OP_OR ? ColMeta() : col_of(cond.lhs_col));
+        }
+        partitions_ = Partitioner(tab).prune(conds_);
+    }
+
+    // 配置允许并行且表足够大时才值得拆分，否则串行扫描的开销更小
+    static bool worthwhile(SmManager *sm_manager, const std::string &tab_name) {
+        if (TaskScheduler::configured_workers() <= 1) {
+            return false;
+        }
+        auto num_pages = sm_manager->fhs_.at(tab_name)->get_num_pages();
+        return num_pages > 0 && (size_t)num_pages >= server_config.parallel_min_pages;
+    }
+
+    // 按当前的页数划分morsel，扫描开始前调用
+    void begin() {
+        morsels_ = fh_->page_morsels(partitions_, MORSEL_PAGES);
+    }
+
+    size_t num_morsels() const {
+        return morsels_.size();
+    }
+
+    /**
+     * @description: 扫描第morsel个morsel，按记录在文件中的顺序对满足条件的记录调用fn(rid, record)
+     * record指向页面内的数据，只在fn执行期间有效
+     */
+    template <typename Fn>
+    void scan_morsel(size_t morsel, Fn &&fn) const {
+        TRACE_SPAN("ParallelTableScan::morsel");
+        for (int page_no = morsels_[morsel].begin; page_no < morsels_[morsel].end; page_no++) {
+            fh_->for_each_record(page_no, [&](int slot_no, const char *record) {
+                if (eval_conditions(record)) {
+                    fn(Rid{page_no, slot_no}, record);
+                }
+            });
+            TaskScheduler::yield(); // 页面已经解锁并unpin，可以安全地让出
+        }
+    }
+
+    bool set_runtime_filter(std::shared_ptr<RuntimeFilter> filter) {
+        const auto &keys = filter->probe_keys();
+        auto on_this_table = [this](const ColMeta &col) { return col.tab_name == tab_name_; };
+        if (!std::all_of(keys.begin(), keys.end(), on_this_table)) {
+            return false;
+        }
+        runtime_filter_ = std::move(filter);
+        return true;
+    }
+
+    const std::string &tab_name() const {
+        return tab_name_;
+    }
+
+    const std::vector<ColMeta> &cols() const {
+        return cols_;
+    }
+
+    size_t tuple_len() const {
+        return len_;
+    }
+
+  private:
+    bool eval_conditions(const char *record) const {
+        thread_stats().tuples_scanned++;
+        if (runtime_filter_ != nullptr && !runtime_filter_->may_contain(record)) {
+            thread_stats().runtime_filtered++;
+            return false;
+        }
+        for (size_t i = 0; i < conds_.size(); i++) {
+            auto &cond = conds_[i];
+            bool ok;
+            if (cond.op == OP_OR) {
+                ok = cond.eval_record(record, [this](const TabCol &col) { return col_of(col); });
+            } else if (cond.rhs_expr != nullptr) {
+                ok = cond.eval(ValueView::of(record, cond_cols_[i]), cond.rhs_expr->eval(record));
+            } else {
+                ok = cond.eval_with_rvalue(ValueView::of(record, cond_cols_[i]));
+            }
+            if (!ok) {
+                return false;
+            }
+        }
+        return true;
+    }
+
+    ColMeta col_of(const TabCol &target) const {
+        auto it = std::find_if(cols_.begin(), cols_.end(),
+                               [&target](const ColMeta &col) { return col.name == target.col_name; });
+        assert(it != cols_.end());
+        return *it;
+    }
+
+    std::string tab_name_;
+    std::vector<Condition> conds_;
+    std::vector<ColMeta> cond_cols_; // conds_中每个条件左侧的列，OR条件在求值时按分支取列
+    RmFileHandle *fh_;
+    std::vector<ColMeta> cols_;
+    size_t len_;
+    std::vector<int> partitions_;      // 分区裁剪后需要扫描的分区
+    std::vector<RmPageRange> morsels_; // 各morsel的页面范围
+    std::shared_ptr<RuntimeFilter> runtime_filter_;
+};
@@ -0,0 +1,149 @@
+/* Copyright (c) 2023 Renmin University of China
+RMDB is licensed under Mulan PSL v2.
+You can use this software according to the terms and conditions of the Mulan PSL v2.
+You may obtain a copy of Mulan PSL v2 at:
+        http://license.coscl.org.cn/MulanPSL2
+THIS SOFTWARE IS PROVIDED ON AN "AS IS" BASIS, WITHOUT WARRANTIES OF ANY KIND,
+EITHER EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO NON-INFRINGEMENT,
+MERCHANTABILITY OR FIT FOR A PARTICULAR PURPOSE.
+See the Mulan PSL v2 for more details. */
+
+#pragma once
+
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <cstring>
+#include <functional>
+#include <limits>
+#include <memory>
+#include <string_view>
+#include <vector>
+
+#include "system/sm_meta.h"
+
+/**
+ * 运行时连接过滤器。join先完整读取一侧（build side）时，用其连接键构建Bloom filter和第一列键的min/max，
+ * 下推给另一侧（probe side）的扫描算子，扫描时先用它过滤，不可能连接成功的记录不会被拷贝出页面
+ * 只在两侧连接键类型一一相同时使用，保证相等的键有相同的哈希值
+ * 用法：对build side的每条记录调用add()，读完后调用seal()，之后才能调用may_contain()
+ */
+class RuntimeFilter {
+  public:
+    static constexpr int BITS_PER_KEY = 10; // 约1%的误判率
+    static constexpr int NUM_HASHES = 4;
+
+    /**
+     * @param {vector<ColMeta>} build_keys build side的连接键
+     * @param {vector<ColMeta>} probe_keys probe side的连接键，和build_keys一一对应
+     */
+    RuntimeFilter(std::vector<ColMeta> build_keys, std::vector<ColMeta> probe_keys)
+        : build_keys_(std::move(build_keys)), probe_keys_(std::move(probe_keys)) {
+        ranged_ = build_keys_[0].type == TYPE_INT || build_keys_[0].type == TYPE_FLOAT;
+    }
+
+    // 两侧连接键类型一一相同时才构建过滤器，否则返回nullptr
+    static std::shared_ptr<RuntimeFilter> create(const std::vector<ColMeta> &build_keys,
+                                                 const std::vector<ColMeta> &probe_keys) {
+        if (build_keys.empty() || build_keys.size() != probe_keys.size()) {
+            return nullptr;
+        }
+        for (size_t i = 0; i < build_keys.size(); i++) {
+            if (build_keys[i].type != probe_keys[i].type) {
+                return nullptr;
+            }
+        }
+        return std::make_shared<RuntimeFilter>(build_keys, probe_keys);
+    }
+
+    void add(const char *build_record) {
+        // build side的大小事先未知，先保存哈希值，seal()时再确定位图大小
+        pending_.push_back(hash_keys(build_record, build_keys_));
+        if (ranged_) {
+            double key = numeric_key(build_record, build_keys_[0]);
+            min_ = std::min(min_, key);
+            max_ = std::max(max_, key);
+        }
+    }
+
+    void seal() {
+        size_t num_bits = std::max<size_t>(64, pending_.size() * BITS_PER_KEY);
+        bits_.assign((num_bits + 63) / 64, 0);
+        for (auto hash : pending_) {
+            for (int i = 0; i < NUM_HASHES; i++) {
+                uint64_t bit = bit_index(hash, i);
+                bits_[bit / 64] |= uint64_t(1) << (bit % 64);
+            }
+        }
+        pending_.clear();
+        pending_.shrink_to_fit();
+    }
+
+    // 返回false时probe side的记录一定不能连接成功
+    bool may_contain(const char *probe_record) const {
+        if (ranged_) {
+            double key = numeric_key(probe_record, probe_keys_[0]);
+            if (key < min_ || key > max_) {
+                return false;
+            }
+        }
+        uint64_t hash = hash_keys(probe_record, probe_keys_);
+        for (int i = 0; i < NUM_HASHES; i++) {
+            uint64_t bit = bit_index(hash, i);
+            if ((bits_[bit / 64] & (uint64_t(1) << (bit % 64))) == 0) {
+                return false;
+            }
+        }
+        return true;
+    }
+
+    const std::vector<ColMeta> &probe_keys() const {
+        return probe_keys_;
+    }
+
+  private:
+    static double numeric_key(const char *record, const ColMeta &col) {
+        if (col.type == TYPE_INT) {
+            return *(const int *)(record + col.offset);
+        }
+        return *(const float *)(record + col.offset);
+    }
+
+    static uint64_t hash_keys(const char *record, const std::vector<ColMeta> &keys) {
+        uint64_t hash = 0;
+        for (auto &col : keys) {
+            const char *data = record + col.offset;
+            size_t key_hash;
+            if (col.type == TYPE_STRING) {
+                // 和Value的比较一致，忽略末尾的'\0'
+                key_hash = std::hash<std::string_view>()(std::string_view(data, strnlen(data, col.len)));
+            } else if (col.type == TYPE_FLOAT) {
+                float value = *(const float *)data;
+                key_hash = std::hash<float>()(value == 0 ? 0.0f : value); // -0.0和0.0相等
+            } else {
+                key_hash = std::hash<int>()(*(const int *)data);
+            }
+            hash = (hash ^ key_hash) * 0x9E3779B97F4A7C15ULL;
+        }
+        // murmur3的finalizer，让低位也充分混合
+        hash ^= hash >> 33;
+        hash *= 0xFF51AFD7ED558CCDULL;
+        hash ^= hash >> 33;
+        return hash;
+    }
+
+    // 双重哈希生成第i个位置
+    uint64_t bit_index(uint64_t hash, int i) const {
+        uint64_t h1 = hash;
+        uint64_t h2 = (hash >> 32) | 1;
+        return (h1 + i * h2) % (bits_.size() * 64);
+    }
+
+    std::vector<ColMeta> build_keys_;
+    std::vector<ColMeta> probe_keys_;
+    std::vector<uint64_t> pending_; // seal()之前保存build side的哈希值
+    std::vector<uint64_t> bits_;
+    bool ranged_; // 第一列键是数值类型时额外用min/max过滤
+    double min_ = std::numeric_limits<double>::infinity();
+    double max_ = -std::numeric_limits<double>::infinity();
+};
@@ -12,6 +12,7 @@ See the Mulan PSL v2 for more details. */
 
 #include <vector>
 
+#include "common/key_comparator.h"
 #include "defs.h"
 #include "storage/buffer_pool_manager.h"
 
@@ -35,8 +36,9 @@ class IxFileHdr {
     int keys_size_;                  // keys_size = (btree_order + 1) * col_tot_len
     // first_leaf初始化之后没有进行修改，只不过是在测试文件中遍历叶子结点的时候用了
     page_id_t first_leaf_; // 首叶节点对应的页号，在上层IxManager的open函数进行初始化，初始化为root page_no
-    page_id_t last_leaf_; // 尾叶节点对应的页号
-    int tot_len_;         // 记录结构体的整体长度
+    page_id_t last_leaf_;   // 尾叶节点对应的页号
+    int tot_len_;           // 记录结构体的整体长度
+    KeyComparator key_cmp_; // 按字段类型生成的key比较器，不写入磁盘，反序列化时生成
 
     IxFileHdr() {
         tot_len_ = col_num_ = 0;
@@ -125,6 +127,7 @@ class IxFileHdr {
         last_leaf_ = *reinterpret_cast<const page_id_t *>(src + offset);
         offset += sizeof(page_id_t);
         assert(offset == tot_len_);
+        key_cmp_ = KeyComparator::create(col_types_, col_lens_);
     }
 };
 
@@ -10,8 +10,12 @@ See the Mulan PSL v2 for more details. */
 
 #include "ix_index_handle.h"
 #include "ix_scan.h"
+#include "common/query_stats.h"
+#include <algorithm>
 #include <cstring>
+#include <memory>
 #include <mutex>
+#include <numeric>
 
 /**
  * @brief 在当前node中查找第一个>=target的key_idx
@@ -22,14 +26,17 @@ See the Mulan PSL v2 for more details. */
 int IxNodeHandle::lower_bound(const char *target) const {
     // Todo:
     // 查找当前节点中第一个大于等于target的key，并返回key的位置给上层
-    // 提示: 可以采用多种查找方式，如顺序遍历、二分查找等；使用ix_compare()函数进行比较
-    int size = page_hdr->num_key;
-    for (int i = 0; i < size; ++i) {
-        if (ix_compare(get_key(i), target, file_hdr->col_types_, file_hdr->col_lens_) >= 0) {
-            return i;
+    // 提示: 可以采用多种查找方式，如顺序遍历、二分查找等；使用file_hdr->key_cmp_进行比较
+    // 按key的模式实例化查找循环
+    return file_hdr->key_cmp_.visit([this, target](const auto &cmp) {
+        int size = page_hdr->num_key;
+        for (int i = 0; i < size; ++i) {
+            if (cmp(get_key(i), target) >= 0) {
+                return i;
+            }
         }
-    }
-    return size;
+        return size;
+    });
 }
 
 /**
@@ -41,14 +48,17 @@ int IxNodeHandle::lower_bound(const char *target) const {
 int IxNodeHandle::upper_bound(const char *target) const {
     // Todo:
     // 查找当前节点中第一个大于target的key，并返回key的位置给上层
-    // 提示: 可以采用多种查找方式：顺序遍历、二分查找等；使用ix_compare()函数进行比较
-    int size = page_hdr->num_key;
-    for (int i = 0; i < size; ++i) {
-        if (ix_compare(get_key(i), target, file_hdr->col_types_, file_hdr->col_lens_) > 0) {
-            return i;
+    // 提示: 可以采用多种查找方式：顺序遍历、二分查找等；使用file_hdr->key_cmp_进行比较
+    // 按key的模式实例化查找循环
+    return file_hdr->key_cmp_.visit([this, target](const auto &cmp) {
+        int size = page_hdr->num_key;
+        for (int i = 0; i < size; ++i) {
+            if (cmp(get_key(i), target) > 0) {
+                return i;
+            }
         }
-    }
-    return size;
+        return size;
+    });
 }
 
 /**
@@ -73,7 +83,7 @@ bool IxNodeHandle::leaf_lookup(const char *key, Rid **value) {
         return false;
 
     // 可能有大于的情况，这里要做double-check
-    if (ix_compare(get_key(pos), key, file_hdr->col_types_, file_hdr->col_lens_) != 0)
+    if (file_hdr->key_cmp_(get_key(pos), key) != 0)
         return false;
 
     *value = get_rid(pos);
@@ -149,7 +159,7 @@ int IxNodeHandle::insert(const char *key, const Rid &value) {
 
     auto pos = lower_bound(key);
 
-    if (pos != get_size() && ix_compare(get_key(pos), key, file_hdr->col_types_, file_hdr->col_lens_) == 0) {
+    if (pos != get_size() && file_hdr->key_cmp_(get_key(pos), key) == 0) {
         // duplicate
         throw IndexKeyDuplicateError();
     } else {
@@ -198,15 +208,17 @@ int IxNodeHandle::remove(const char *key) {
     if (pos == get_size())
         return get_size();
 
-    if (ix_compare(get_key(pos), key, file_hdr->col_types_, file_hdr->col_lens_) == 0) {
+    if (file_hdr->key_cmp_(get_key(pos), key) == 0) {
         erase_pair(pos);
     }
 
     return get_size();
 }
 
-IxIndexHandle::IxIndexHandle(DiskManager *disk_manager, BufferPoolManager *buffer_pool_manager, int fd)
-    : disk_manager_(disk_manager), buffer_pool_manager_(buffer_pool_manager), fd_(fd) {
+IxIndexHandle::IxIndexHandle(DiskManager *disk_manager, BufferPoolManager *buffer_pool_manager, int fd,
+                             size_t change_buffer_size)
+    : disk_manager_(disk_manager), buffer_pool_manager_(buffer_pool_manager), fd_(fd),
+      change_buffer_size_(change_buffer_size) {
     // init file_hdr_
     disk_manager_->read_page(fd, IX_FILE_HDR_PAGE, (char *)&file_hdr_, sizeof(file_hdr_));
     char *buf = new char[PAGE_SIZE];
@@ -214,10 +226,12 @@ IxIndexHandle::IxIndexHandle(DiskManager *disk_manager, BufferPoolManager *buffe
     disk_manager_->read_page(fd, IX_FILE_HDR_PAGE, buf, PAGE_SIZE);
     file_hdr_ = new IxFileHdr();
     file_hdr_->deserialize(buf);
+    pending_deletes_ = std::set<std::string, KeyLess>(KeyLess{file_hdr_});
 
-    // disk_manager管理的fd对应的文件中，设置从file_hdr_->num_pages开始分配page_no
-    int now_page_no = disk_manager_->get_fd2pageno(fd);
-    disk_manager_->set_fd2pageno(fd, now_page_no + 1);
+    // disk_manager管理的fd对应的文件中，从文件现有的页数开始分配page_no。删除结点时num_pages会减小，但页面
+    // 不回收，不能从num_pages开始；也不能沿用fd上次的计数，分区索引的各个文件先全部创建再打开，fd会被复用
+    int num_pages = disk_manager_->get_file_size(disk_manager_->get_file_name(fd)) / PAGE_SIZE;
+    disk_manager_->set_fd2pageno(fd, std::max(num_pages, IX_INIT_NUM_PAGES));
 }
 
 /**
@@ -226,25 +240,25 @@ IxIndexHandle::IxIndexHandle(DiskManager *disk_manager, BufferPoolManager *buffe
  * @param operation 查找到目标键值对后要进行的操作类型
  * @param transaction 事务参数，如果不需要则默认传入nullptr
  * @return [leaf node] and [root_is_latched] 返回目标叶子结点以及根结点是否加锁
- * @note need to Unlatch and unpin the leaf node outside!
- * 注意：用了FindLeafPage之后一定要unlatch叶结点，否则下次latch该结点会堵塞！
+ * @note 查找时叶子结点持有读锁，插入删除时持有写锁，返回的结点析构时解锁并unpin；调用者需要持有root_latch_
  */
-std::pair<IxNodeHandle *, bool> IxIndexHandle::find_leaf_page(const char *key, Operation operation,
-                                                              Transaction *transaction, bool find_first) {
+std::pair<std::unique_ptr<IxNodeHandle>, bool> IxIndexHandle::find_leaf_page(const char *key, Operation operation,
+                                                                             Transaction *transaction,
+                                                                             bool find_first) {
     // Todo:
     // 1. 获取根节点
     // 2. 从根节点开始不断向下查找目标key
     // 3. 找到包含该key值的叶子结点停止查找，并返回叶子节点
 
-    page_id_t page_id;
-    auto cur = fetch_node(file_hdr_->root_page_);
+    auto fetch = [this, operation](page_id_t page_no) {
+        return operation == Operation::FIND ? fetch_node_read(page_no) : fetch_node(page_no);
+    };
+    auto cur = fetch(file_hdr_->root_page_);
     while (!cur->is_leaf_page()) {
-        page_id = cur->internal_lookup(key);
-        buffer_pool_manager_->unpin_page(cur->get_page_id(), false);
-        cur = fetch_node(page_id);
+        cur = fetch(cur->internal_lookup(key));
     }
 
-    return std::make_pair(cur, false);
+    return std::make_pair(std::move(cur), false);
 }
 
 /**
@@ -262,7 +276,19 @@ bool IxIndexHandle::get_value(const char *key, std::vector<Rid> *result, Transac
     // 3. 把rid存入result参数中
     // 提示：使用完buffer_pool提供的page之后，记得unpin page；记得处理并发的上锁
 
-    std::scoped_lock lock{root_latch_};
+    if (!partitions_.empty()) {
+        // 索引不一定包含分区列，key可能在任何一个分区中
+        bool found = false;
+        for (auto &partition : partitions_) {
+            found |= partition->get_value(key, result, transaction);
+        }
+        return found;
+    }
+    std::shared_lock lock{root_latch_};
+    // 删除还暂存在change buffer中时，叶子里的这一项已经不存在了
+    if (is_delete_pending(key)) {
+        return false;
+    }
 
     // 1. 获取目标key值所在的叶子结点
     auto leaf_node = find_leaf_page(key, Operation::FIND, transaction).first;
@@ -272,19 +298,15 @@ bool IxIndexHandle::get_value(const char *key, std::vector<Rid> *result, Transac
     if (ok)
         result->emplace_back(*rid);
 
-    buffer_pool_manager_->unpin_page(leaf_node->get_page_id(), false);
-
     return ok;
 }
 
 /**
  * @brief  将传入的一个node拆分(Split)成两个结点，在node的右边生成一个新结点new node
  * @param node 需要拆分的结点
- * @return 拆分得到的new_node
- * @note need to unpin the new node outside
- * 注意：本函数执行完毕后，原node和new node都需要在函数外面进行unpin
+ * @return 拆分得到的new_node，持有写锁
  */
-IxNodeHandle *IxIndexHandle::split(IxNodeHandle *node) {
+std::unique_ptr<IxNodeHandle> IxIndexHandle::split(IxNodeHandle *node) {
     // Todo:
     // 1. 将原结点的键值对平均分配，右半部分分裂为新的右兄弟结点
     //    需要初始化新节点的page_hdr内容
@@ -300,6 +322,7 @@ IxNodeHandle *IxIndexHandle::split(IxNodeHandle *node) {
 
     new_node->insert_pairs(0, node->get_key(pos), node->get_rid(pos), node->get_size() - pos);
     node->set_size(pos);
+    node->mark_dirty();
 
     if (new_node->is_leaf_page()) {
         // 2. 如果新的右兄弟结点是叶子结点，更新新旧节点的prev_leaf和next_leaf指针
@@ -308,14 +331,13 @@ IxNodeHandle *IxIndexHandle::split(IxNodeHandle *node) {
 
         auto new_node_next = fetch_node(node->page_hdr->next_leaf); // TODO: 这里可能会报错的。
         new_node_next->page_hdr->prev_leaf = new_node->get_page_no();
+        new_node_next->mark_dirty();
 
         node->page_hdr->next_leaf = new_node->get_page_no();
 
-        buffer_pool_manager_->unpin_page(new_node_next->get_page_id(), true);
-
     } else {
         for (int i = 0; i < new_node->get_size(); ++i)
-            maintain_child(new_node, i);
+            maintain_child(new_node.get(), i);
     }
 
     return new_node;
@@ -332,7 +354,7 @@ IxNodeHandle *IxIndexHandle::split(IxNodeHandle *node) {
  * @param key 要插入parent的key
  * @note 一个结点插入了键值对之后需要分裂，分裂后左半部分的键值对保留在原结点，在参数中称为old_node，
  * 右半部分的键值对分裂为新的右兄弟节点，在参数中称为new_node（参考Split函数来理解old_node和new_node）
- * @note 本函数执行完毕后，new node和old node都需要在函数外面进行unpin
+ * @note old_node和new_node由调用者持有写锁
  */
 void IxIndexHandle::insert_into_parent(IxNodeHandle *old_node, const char *key, IxNodeHandle *new_node,
                                        Transaction *transaction) {
@@ -344,8 +366,7 @@ void IxIndexHandle::insert_into_parent(IxNodeHandle *old_node, const char *key,
     // 提示：记得unpin page
 
     if (old_node->is_root_page()) {
-        IxNodeHandle *root;
-        root = create_node();
+        auto root = create_node();
         root->page_hdr->is_leaf = false;
         root->page_hdr->next_free_page_no = IX_NO_PAGE;
 
@@ -367,10 +388,11 @@ void IxIndexHandle::insert_into_parent(IxNodeHandle *old_node, const char *key,
 
         old_node->page_hdr->parent = root->get_page_no();
         new_node->page_hdr->parent = root->get_page_no();
+        old_node->mark_dirty();
+        new_node->mark_dirty();
     } else {
         // 递归更新
-        IxNodeHandle *parent;
-        parent = fetch_node(old_node->get_parent_page_no()); // 2. 获取原结点（old_node）的父亲结点
+        auto parent = fetch_node(old_node->get_parent_page_no()); // 2. 获取原结点（old_node）的父亲结点
         int pos = parent->find_child(old_node); // 找到 old node 在 parent 中的位置，然后将 new node 插在这个位置之后。
 
         // 不是叶子节点。
@@ -379,10 +401,11 @@ void IxIndexHandle::insert_into_parent(IxNodeHandle *old_node, const char *key,
         t.slot_no = -1;
 
         parent->insert_pair(pos + 1, key, t);
+        parent->mark_dirty();
         // 如果超出了，递归更新
         if (parent->get_size() >= parent->get_max_size()) { // 达到这个就换，而不是大于
-            auto new_node = split(parent);                  // we split the parent node.
-            insert_into_parent(parent, new_node->get_key(0), new_node, transaction);
+            auto parent_sibling = split(parent.get());      // we split the parent node.
+            insert_into_parent(parent.get(), parent_sibling->get_key(0), parent_sibling.get(), transaction);
         }
     }
 }
@@ -400,27 +423,42 @@ page_id_t IxIndexHandle::insert_entry(const char *key, const Rid &value, Transac
     // 3. 如果结点已满，分裂结点，并把新结点的相关信息插入父节点
     // 提示：记得unpin page；若当前叶子节点是最右叶子节点，则需要更新file_hdr_.last_leaf；记得处理并发的上锁
 
-    std::scoped_lock lock{root_latch_};
+    if (!partitions_.empty()) {
+        return partition_of_rid(value)->insert_entry(key, value, transaction);
+    }
+    std::unique_lock lock{root_latch_};
+    // 同一个key的删除还暂存着时先执行它，否则叶子里的旧项会让这次插入落空，之后合并时又把它删掉
+    if (is_delete_pending(key)) {
+        pending_deletes_.erase(std::string(key, file_hdr_->col_tot_len_));
+        num_pending_deletes_.store(pending_deletes_.size(), std::memory_order_relaxed);
+        remove_entry(key, transaction);
+    }
     // 1. 查找key值应该插入到哪个叶子节点
     auto leaf_node = find_leaf_page(key, Operation::INSERT, transaction).first;
     // 2. 在该叶子节点中插入键值对
     int kv_num_before = leaf_node->get_size();
     int kv_num = leaf_node->insert(key, value);
+    if (kv_num_before != kv_num) {
+        leaf_node->mark_dirty();
+    }
+    if (kv_num_before != kv_num &&
+        file_hdr_->key_cmp_(leaf_node->get_key(0), key) == 0) {
+        // 插在最左叶子的开头，父结点中的key需要随之更新，否则之后分裂插入的key会和它乱序
+        maintain_parent(leaf_node.get());
+    }
 
     if (kv_num_before != kv_num && kv_num == leaf_node->get_max_size()) {
         // full, we split it
-        auto new_leaf_node = split(leaf_node);
+        auto new_leaf_node = split(leaf_node.get());
         // 并把新结点的相关信息插入父节点
-        insert_into_parent(leaf_node, new_leaf_node->get_key(0), new_leaf_node,
+        insert_into_parent(leaf_node.get(), new_leaf_node->get_key(0), new_leaf_node.get(),
                            transaction); // 新的节点现在只有一个kv。
-        buffer_pool_manager_->unpin_page(new_leaf_node->get_page_id(), true);
 
         if (file_hdr_->last_leaf_ == leaf_node->get_page_no()) {
             // 更新 file_hdr
             file_hdr_->last_leaf_ = new_leaf_node->get_page_no();
         }
     }
-    buffer_pool_manager_->unpin_page(leaf_node->get_page_id(), kv_num_before != kv_num);
     return leaf_node->get_page_no();
 }
 
@@ -428,6 +466,8 @@ page_id_t IxIndexHandle::insert_entry(const char *key, const Rid &value, Transac
  * @brief 用于删除B+树中含有指定key的键值对
  * @param key 要删除的key值
  * @param transaction 事务指针
+ * @return 是否删除了键值对；目标叶子不在缓冲池中时删除暂存到change buffer，不读叶子，直接返回true。
+ * 暂存时不检查key是否存在，调用者删除的是表中记录对应的索引项，key一定存在，不依赖返回值
  */
 bool IxIndexHandle::delete_entry(const char *key, Transaction *transaction) {
     // Todo:
@@ -435,22 +475,111 @@ bool IxIndexHandle::delete_entry(const char *key, Transaction *transaction) {
     // 2. 在该叶子结点中删除键值对
     // 3. 如果删除成功需要调用CoalesceOrRedistribute来进行合并或重分配操作，并根据函数返回结果判断是否有结点需要删除
     // 4. 如果需要并发，并且需要删除叶子结点，则需要在事务的delete_page_set中添加删除结点的对应页面；记得处理并发的上锁
-    std::scoped_lock lock{root_latch_};
+    assert(partitions_.empty()); // 分区索引要用rid找到所在的分区
+    std::unique_lock lock{root_latch_};
+    if (is_delete_pending(key)) {
+        return false;
+    }
+    if (buffer_delete(key)) {
+        return true;
+    }
+    return remove_entry(key, transaction);
+}
+
+/**
+ * @brief 删除rid对应记录的索引项
+ * @param key 要删除的key值
+ * @param rid key对应的记录，分区索引按其中的分区号找到所在的B+树
+ * @param transaction 事务指针
+ * @return 和delete_entry(key, transaction)相同
+ */
+bool IxIndexHandle::delete_entry(const char *key, const Rid &rid, Transaction *transaction) {
+    if (!partitions_.empty()) {
+        return partition_of_rid(rid)->delete_entry(key, transaction);
+    }
+    return delete_entry(key, transaction);
+}
 
+/**
+ * @brief 从叶子中删除key并调整B+树，delete_entry和合并change buffer时调用
+ * @note 调用者需要持有root_latch_的写锁
+ */
+bool IxIndexHandle::remove_entry(const char *key, Transaction *transaction) {
     auto tar = find_leaf_page(key, Operation::DELETE, transaction).first;
     int num = tar->get_size();
     bool ok = num != tar->remove(key);
     if (ok) {
-        bool need_delete = coalesce_or_redistribute(tar, transaction); // 是否需要删除结点
+        tar->mark_dirty();
+        bool need_delete = coalesce_or_redistribute(tar.get(), transaction); // 是否需要删除结点
         if (need_delete) {
         }
     }
 
-    buffer_pool_manager_->unpin_page(tar->get_page_id(), ok);
-
     return ok;
 }
 
+/**
+ * @brief 目标叶子不在缓冲池中时把删除暂存到change buffer，只读内部结点
+ * @return 是否暂存了；临时表的索引、没有开启change buffer或者叶子在缓冲池中时返回false，由调用者直接删除
+ * @note 调用者需要持有root_latch_的写锁。暂存满时先合并已有的删除，这次删除不再暂存
+ */
+bool IxIndexHandle::buffer_delete(const char *key) {
+    if (mem_pages_ != nullptr || change_buffer_size_ == 0) {
+        return false;
+    }
+    if (pending_deletes_.size() >= change_buffer_size_) {
+        merge_pending_deletes();
+        return false;
+    }
+    if (buffer_pool_manager_->is_resident(PageId{fd_, leaf_page_of(key)})) {
+        return false;
+    }
+    pending_deletes_.emplace(key, file_hdr_->col_tot_len_);
+    num_pending_deletes_.store(pending_deletes_.size(), std::memory_order_relaxed);
+    thread_stats().ix_deletes_buffered++;
+    return true;
+}
+
+void IxIndexHandle::merge_change_buffer() {
+    for (auto &partition : partitions_) {
+        partition->merge_change_buffer();
+    }
+    if (num_pending_deletes() == 0) {
+        return;
+    }
+    std::unique_lock lock{root_latch_};
+    merge_pending_deletes();
+}
+
+// 按key的顺序执行暂存的删除，调用者需要持有root_latch_的写锁
+void IxIndexHandle::merge_pending_deletes() {
+    auto pending = std::move(pending_deletes_);
+    pending_deletes_ = std::set<std::string, KeyLess>(KeyLess{file_hdr_});
+    num_pending_deletes_.store(0, std::memory_order_relaxed);
+    for (auto &key : pending) {
+        remove_entry(key.data(), nullptr);
+    }
+}
+
+/**
+ * @brief key所在叶子结点的页号，只读内部结点，不读叶子
+ * @note 调用者需要持有root_latch_的写锁。树的层数在根结点变化后的第一次调用时沿最左路径重新计算
+ */
+page_id_t IxIndexHandle::leaf_page_of(const char *key) {
+    if (height_ == 0) {
+        height_ = 1;
+        for (auto node = fetch_node_read(file_hdr_->root_page_); !node->is_leaf_page();
+             node = fetch_node_read(node->value_at(0))) {
+            height_++;
+        }
+    }
+    page_id_t page_no = file_hdr_->root_page_;
+    for (int level = height_; level > 1; level--) {
+        page_no = fetch_node_read(page_no)->internal_lookup(key);
+    }
+    return page_no;
+}
+
 /**
  * @brief 用于处理合并和重分配的逻辑，用于删除键值对后调用
  *
@@ -482,23 +611,26 @@ bool IxIndexHandle::coalesce_or_redistribute(IxNodeHandle *node, Transaction *tr
     }
 
     // 这里是合并或者redistribute
-    auto node_parent = fetch_node(node->page_hdr->parent);               // 找到父节点
-    int node_pos = node_parent->find_child(node);                        // 找到 node 在 parent 中的位置
-    int siblings_pos = node_pos - 1 == -1 ? node_pos + 1 : node_pos - 1; // 优先选取前驱结点进行合并
-    if (siblings_pos > node_parent->get_size()) {
+    auto node_parent = fetch_node(node->page_hdr->parent);    // 找到父节点
+    int node_pos = node_parent->find_child(node);             // 找到 node 在 parent 中的位置
+    int siblings_pos = node_pos == 0 ? 1 : node_pos - 1;      // 优先选取前驱结点进行合并
+    if (siblings_pos >= node_parent->get_size()) {
         throw RMDBError("coalesce_or_redistribute: No siblings found!");
     }
     auto sibling = fetch_node(node_parent->get_rid(siblings_pos)->page_no); // 获取兄弟结点
+    node->mark_dirty();
+    sibling->mark_dirty();
+    node_parent->mark_dirty();
 
     bool need_delete = false;
     if (node->get_size() + sibling->get_size() >= node->get_min_size() * 2) {
         // 如果node结点和兄弟结点的键值对数量之和，能够支撑两个B+树结点，则只需要重新分配键值对。（够用）
-        redistribute(sibling, node, node_parent, siblings_pos);
+        redistribute(sibling.get(), node, node_parent.get(), node_pos);
     } else {
-        need_delete = coalesce(&sibling, &node, &node_parent, siblings_pos, transaction, root_is_latched);
+        IxNodeHandle *neighbor_node = sibling.get();
+        IxNodeHandle *parent = node_parent.get();
+        need_delete = coalesce(&neighbor_node, &node, &parent, node_pos, transaction, root_is_latched);
     }
-    buffer_pool_manager_->unpin_page(sibling->get_page_id(), true);
-    buffer_pool_manager_->unpin_page(node_parent->get_page_id(), true);
 
     return need_delete;
 }
@@ -515,21 +647,15 @@ bool IxIndexHandle::adjust_root(IxNodeHandle *old_root_node) {
     // 2. 如果old_root_node是叶结点，且大小为0，则直接更新root page
     // 3. 除了上述两种情况，不需要进行操作
 
-    if (old_root_node->is_leaf_page()) {
-        // 这里的情况是：根节点是叶子结点（整个b+树只有一个节点）
-        if (old_root_node->get_size() == 0) {
-            release_node_handle(*old_root_node);
-            update_root_page_no(2);
-            return true;
-        }
-    } else {
-        if (old_root_node->get_size() == 1) {
-            auto new_root = fetch_node(file_hdr_->root_page_);
-            new_root->page_hdr->parent = 0;
-            update_root_page_no(new_root->get_page_no());
-            buffer_pool_manager_->unpin_page(new_root->get_page_id(), true);
-            return true;
-        }
+    // 根节点是叶子结点（整个b+树只有一个节点）时，即使删空也保留，空树就是没有键的根叶子
+    if (!old_root_node->is_leaf_page() && old_root_node->get_size() == 1) {
+        // 唯一的孩子成为新的根
+        auto new_root = fetch_node(old_root_node->value_at(0));
+        new_root->page_hdr->parent = IX_NO_PAGE;
+        new_root->mark_dirty();
+        update_root_page_no(new_root->get_page_no());
+        release_node_handle(*old_root_node);
+        return true;
     }
 
     return false;
@@ -562,8 +688,9 @@ void IxIndexHandle::redistribute(IxNodeHandle *neighbor_node, IxNodeHandle *node
         node->insert_pair(node->get_size(), neighbor_node->get_key(0), *neighbor_node->get_rid(0));
         neighbor_node->erase_pair(0);
         maintain_child(node, node->get_size() - 1); // 保证后面的孩子结点的父节点信息正确。
-        maintain_parent(
-            neighbor_node); // 更新父节点的信息。如果neighbor_node是node的后继节点，那么就需要保证删除neighbor_node的第一个key之后，neighbor_node后来的第一个key被更新到parent中。
+        // 更新父节点的信息：neighbor_node的第一个key变了；node删除的可能是它的第一个key
+        maintain_parent(neighbor_node);
+        maintain_parent(node);
     } else {
         // neighbor是node前驱结点
         node->insert_pair(0, neighbor_node->get_key(neighbor_node->get_size() - 1),
@@ -576,7 +703,7 @@ void IxIndexHandle::redistribute(IxNodeHandle *neighbor_node, IxNodeHandle *node
 
 /**
  * @brief 合并(Coalesce)函数是将node和其直接前驱进行合并，也就是和它左边的neighbor_node进行合并；
- * 假设node一定在右边。如果上层传入的index=0，说明node在左边，那么交换node和neighbor_node，保证node在右边；合并到左结点，实际上就是删除了右结点；
+ * 如果上层传入的index=0，说明node在左边，那么把右边的neighbor_node合并到node；合并到左结点，实际上就是删除了右结点；
  * Move all the key & value pairs from one page to its sibling page, and notify buffer pool manager to delete this page.
  * Parent page must be adjusted to take info of deletion into account. Remember to deal with coalesce or redistribute
  * recursively if necessary.
@@ -596,23 +723,27 @@ bool IxIndexHandle::coalesce(IxNodeHandle **neighbor_node, IxNodeHandle **node,
     // 3. 释放和删除node结点，并删除parent中node结点的信息，返回parent是否需要被删除
     // 提示：如果是叶子结点且为最右叶子结点，需要更新file_hdr_.last_leaf
 
-    if (index == 0) {
-        std::swap(*neighbor_node, *node);
-    }
+    // 不交换调用者的指针
+    IxNodeHandle *left = index == 0 ? *node : *neighbor_node;
+    IxNodeHandle *right = index == 0 ? *neighbor_node : *node;
+    int right_pos = index == 0 ? 1 : index;
 
-    // 把node结点的键值对移动到neighbor_node中，并更新node结点孩子结点的父节点信息
-    (*neighbor_node)
-        ->insert_pairs((*neighbor_node)->get_size(), (*node)->get_key(0), (*node)->get_rid(0), (*node)->get_size());
-    for (int i = 0; i < (*node)->get_size(); ++i) {
-        maintain_child(*neighbor_node, i + (*neighbor_node)->get_size());
+    // 把右结点的键值对移动到左结点中，并更新移动过去的孩子结点的父节点信息
+    int left_size = left->get_size();
+    left->insert_pairs(left_size, right->get_key(0), right->get_rid(0), right->get_size());
+    for (int i = left_size; i < left->get_size(); ++i) {
+        maintain_child(left, i);
     }
 
-    release_node_handle(**node); // 释放node结点
-    (*parent)->erase_pair(index);
-
-    if ((*node)->is_leaf_page() && (*node)->get_page_no() == file_hdr_->last_leaf_) {
-        file_hdr_->last_leaf_ = (*neighbor_node)->get_page_no();
+    if (right->is_leaf_page()) {
+        erase_leaf(right); // 从叶子链表中摘除
+        if (right->get_page_no() == file_hdr_->last_leaf_) {
+            file_hdr_->last_leaf_ = left->get_page_no();
+        }
     }
+    release_node_handle(*right); // 释放右结点
+    (*parent)->erase_pair(right_pos);
+    maintain_parent(left); // 左结点删除的可能是它的第一个key
 
     return coalesce_or_redistribute(*parent, transaction); // 检测上层是否需要继续合并（因为parent可能也下溢了）
 }
@@ -627,11 +758,10 @@ bool IxIndexHandle::coalesce(IxNodeHandle **neighbor_node, IxNodeHandle **node,
  * @note iid和rid存的不是一个东西，rid是上层传过来的记录位置，iid是索引内部生成的索引槽位置
  */
 Rid IxIndexHandle::get_rid(const Iid &iid) const {
-    IxNodeHandle *node = fetch_node(iid.page_no);
+    auto node = fetch_node_read(iid.page_no);
     if (iid.slot_no >= node->get_size()) {
         throw IndexEntryNotFoundError();
     }
-    buffer_pool_manager_->unpin_page(node->get_page_id(), false); // unpin it!
     return *node->get_rid(iid.slot_no);
 }
 
@@ -644,13 +774,7 @@ Rid IxIndexHandle::get_rid(const Iid &iid) const {
  * 可用*(int *)key转换回去
  */
 Iid IxIndexHandle::lower_bound(const char *key) {
-    auto leaf = find_leaf_page(key, Operation::FIND, nullptr).first; // 找到叶子结点
-    int pos = leaf->lower_bound(key);                                // 找到key在叶子结点中的位置
-    buffer_pool_manager_->unpin_page(leaf->get_page_id(), false);    // unpin it!
-    if (pos == leaf->get_size() && leaf->get_page_no() != file_hdr_->last_leaf_) {
-        return Iid{.page_no = leaf->get_next_leaf(), .slot_no = 0};
-    }
-    return Iid{.page_no = leaf->get_page_no(), .slot_no = pos};
+    return find_bound(key, false);
 }
 
 /**
@@ -660,15 +784,41 @@ Iid IxIndexHandle::lower_bound(const char *key) {
  * @return Iid
  */
 Iid IxIndexHandle::upper_bound(const char *key) {
-    auto leaf = find_leaf_page(key, Operation::FIND, nullptr).first; // 找到叶子结点
-    int pos = leaf->upper_bound(key);                                // 找到key在叶子结点中的位置
-    buffer_pool_manager_->unpin_page(leaf->get_page_id(), false);    // unpin it!
+    return find_bound(key, true);
+}
+
+/**
+ * @brief lower_bound和upper_bound的实现。范围扫描会读到暂存的删除所在的叶子，有暂存的删除时在同一个写锁下
+ * 先合并再查找，否则加读锁查找；之后新暂存的删除由IxScan跳过
+ */
+Iid IxIndexHandle::find_bound(const char *key, bool upper) {
+    std::unique_lock<std::shared_mutex> exclusive;
+    std::shared_lock<std::shared_mutex> shared;
+    if (num_pending_deletes() > 0) {
+        exclusive = std::unique_lock{root_latch_};
+        merge_pending_deletes();
+    } else {
+        shared = std::shared_lock{root_latch_};
+    }
+    auto leaf = find_leaf_page(key, Operation::FIND, nullptr).first;   // 找到叶子结点
+    int pos = upper ? leaf->upper_bound(key) : leaf->lower_bound(key); // 找到key在叶子结点中的位置
     if (pos == leaf->get_size() && leaf->get_page_no() != file_hdr_->last_leaf_) {
         return Iid{.page_no = leaf->get_next_leaf(), .slot_no = 0};
     }
     return Iid{.page_no = leaf->get_page_no(), .slot_no = pos};
 }
 
+/**
+ * @brief key的删除是否还暂存在change buffer中，不需要持有root_latch_。没有暂存的删除时不加锁
+ */
+bool IxIndexHandle::is_deleted(const char *key) const {
+    if (num_pending_deletes() == 0) {
+        return false;
+    }
+    std::shared_lock lock{root_latch_};
+    return is_delete_pending(key);
+}
+
 /**
  * @brief 指向最后一个叶子的最后一个结点的后一个
  * 用处在于可以作为IxScan的最后一个
@@ -676,10 +826,8 @@ Iid IxIndexHandle::upper_bound(const char *key) {
  * @return Iid
  */
 Iid IxIndexHandle::leaf_end() const {
-    IxNodeHandle *node = fetch_node(file_hdr_->last_leaf_);
-    Iid iid = {.page_no = file_hdr_->last_leaf_, .slot_no = node->get_size()};
-    buffer_pool_manager_->unpin_page(node->get_page_id(), false); // unpin it!
-    return iid;
+    auto node = fetch_node_read(file_hdr_->last_leaf_);
+    return Iid{.page_no = file_hdr_->last_leaf_, .slot_no = node->get_size()};
 }
 
 /**
@@ -694,38 +842,147 @@ Iid IxIndexHandle::leaf_begin() const {
 }
 
 /**
- * @brief 获取一个指定结点
+ * @brief 读取叶子结点中iid处的键
+ *
+ * @param iid 叶子结点中的位置
+ * @param key 输出参数，长度为索引字段的总长度
+ * @return iid越过叶子结点末尾时返回false
+ */
+bool IxIndexHandle::read_entry(const Iid &iid, char *key) const {
+    auto node = fetch_node_read(iid.page_no);
+    bool exists = iid.slot_no < node->get_size();
+    if (exists) {
+        memcpy(key, node->get_key(iid.slot_no), file_hdr_->col_tot_len_);
+    }
+    return exists;
+}
+
+/**
+ * @brief 把iid移动到前一个索引项，必要时沿prev_leaf移动到前一个叶子
+ *
+ * @param iid 叶子结点中的位置，可以是upper_bound或leaf_end的结果
+ * @return iid已经是第一个索引项时返回false，iid不变
+ */
+bool IxIndexHandle::prev_entry(Iid &iid) const {
+    Iid prev = iid;
+    while (prev.slot_no == 0) {
+        if (prev.page_no == file_hdr_->first_leaf_) {
+            return false;
+        }
+        page_id_t prev_leaf = fetch_node_read(prev.page_no)->get_prev_leaf();
+        prev = {.page_no = prev_leaf, .slot_no = fetch_node_read(prev_leaf)->get_size()};
+    }
+    prev.slot_no--;
+    iid = prev;
+    return true;
+}
+
+/**
+ * @brief 按键的升序扫描[lower_key, upper_key]内的索引项
+ *
+ * @param partitions 要扫描的分区，升序；非分区索引只有0号分区，为空时没有要扫描的索引项
+ * @return 只扫描一个分区时是该分区上的IxScan，否则是对各分区的IxScan做k路归并的IxMergeScan
+ */
+std::unique_ptr<RecScan> IxIndexHandle::range_scan(const char *lower_key, const char *upper_key,
+                                                   const std::vector<int> &partitions) {
+    std::vector<std::unique_ptr<IxScan>> scans;
+    for (int i : partitions) {
+        IxIndexHandle *ih = partition(i);
+        Iid lower = ih->lower_bound(lower_key);
+        Iid upper = ih->upper_bound(upper_key);
+        scans.push_back(std::make_unique<IxScan>(ih, lower, upper, ih->buffer_pool_manager_));
+    }
+    if (scans.size() == 1) {
+        return std::move(scans.front());
+    }
+    return std::make_unique<IxMergeScan>(std::move(scans), &file_hdr_->key_cmp_, file_hdr_->col_tot_len_);
+}
+
+/**
+ * @brief 在所有分区中按键的升序扫描[lower_key, upper_key]内的索引项
+ */
+std::unique_ptr<RecScan> IxIndexHandle::range_scan(const char *lower_key, const char *upper_key) {
+    std::vector<int> partitions(num_partitions());
+    std::iota(partitions.begin(), partitions.end(), 0);
+    return range_scan(lower_key, upper_key, partitions);
+}
+
+/**
+ * @brief first_entry和last_entry的实现。分区索引在每个分区中找到最近的键，再取其中最小（first）或最大（last）的
+ *
+ * @param entry 输出参数，长度为索引字段的总长度
+ * @param last 为true时找不大于key的最大的键，否则找不小于key的最小的键
+ */
+bool IxIndexHandle::bound_entry(const char *key, char *entry, bool last) {
+    if (partitions_.empty()) {
+        Iid iid = last ? upper_bound(key) : lower_bound(key);
+        return (!last || prev_entry(iid)) && read_entry(iid, entry);
+    }
+    std::vector<char> candidate(file_hdr_->col_tot_len_);
+    bool found = false;
+    for (auto &partition : partitions_) {
+        if (!partition->bound_entry(key, candidate.data(), last)) {
+            continue;
+        }
+        int cmp = found ? file_hdr_->key_cmp_(candidate.data(), entry) : 0;
+        if (!found || (last ? cmp > 0 : cmp < 0)) {
+            memcpy(entry, candidate.data(), file_hdr_->col_tot_len_);
+            found = true;
+        }
+    }
+    return found;
+}
+
+/**
+ * @brief 获取一个指定结点并加写锁，用于插入删除
  *
  * @param page_no
- * @return IxNodeHandle*
- * @note pin the page, remember to unpin it outside!
+ * @return std::unique_ptr<IxNodeHandle> 析构时解锁并unpin，修改过结点时需要调用mark_dirty()
  */
-IxNodeHandle *IxIndexHandle::fetch_node(int page_no) const {
-    Page *page = buffer_pool_manager_->fetch_page(PageId{fd_, page_no});
-    IxNodeHandle *node = new IxNodeHandle(file_hdr_, page);
+std::unique_ptr<IxNodeHandle> IxIndexHandle::fetch_node(int page_no) {
+    WritePageGuard guard = mem_pages_ != nullptr ? mem_pages_->fetch_page_write(PageId{fd_, page_no})
+                                                  : buffer_pool_manager_->fetch_page_write(PageId{fd_, page_no});
+    if (!guard) {
+        throw PageNotExistError("index fd " + std::to_string(fd_), page_no);
+    }
+    return std::make_unique<IxNodeHandle>(file_hdr_, std::move(guard));
+}
 
-    return node;
+/**
+ * @brief 获取一个指定结点并加读锁，用于查找和扫描
+ *
+ * @param page_no
+ * @return std::unique_ptr<IxNodeHandle> 析构时解锁并unpin
+ */
+std::unique_ptr<IxNodeHandle> IxIndexHandle::fetch_node_read(int page_no) const {
+    ReadPageGuard guard = mem_pages_ != nullptr ? mem_pages_->fetch_page_read(PageId{fd_, page_no})
+                                                 : buffer_pool_manager_->fetch_page_read(PageId{fd_, page_no});
+    if (!guard) {
+        throw PageNotExistError("index fd " + std::to_string(fd_), page_no);
+    }
+    return std::make_unique<IxNodeHandle>(file_hdr_, std::move(guard));
 }
 
 /**
  * @brief 创建一个新结点
  *
- * @return IxNodeHandle*
- * @note pin the page, remember to unpin it outside!
- * 注意：对于Index的处理是，删除某个页面后，认为该被删除的页面是free_page
+ * @return std::unique_ptr<IxNodeHandle> 持有写锁
+ * @note 注意：对于Index的处理是，删除某个页面后，认为该被删除的页面是free_page
  * 而first_free_page实际上就是最新被删除的页面，初始为IX_NO_PAGE
  * 在最开始插入时，一直是create node，那么first_page_no一直没变，一直是IX_NO_PAGE
  * 与Record的处理不同，Record将未插入满的记录页认为是free_page
  */
-IxNodeHandle *IxIndexHandle::create_node() {
-    IxNodeHandle *node;
+std::unique_ptr<IxNodeHandle> IxIndexHandle::create_node() {
     file_hdr_->num_pages_++;
 
     PageId new_page_id = {.fd = fd_, .page_no = INVALID_PAGE_ID};
     // 从3开始分配page_no，第一次分配之后，new_page_id.page_no=3，file_hdr_.num_pages=4
-    Page *page = buffer_pool_manager_->new_page(&new_page_id);
-    node = new IxNodeHandle(file_hdr_, page);
-    return node;
+    WritePageGuard guard = mem_pages_ != nullptr ? mem_pages_->new_page_write(&new_page_id)
+                                                  : buffer_pool_manager_->new_page_write(&new_page_id);
+    if (!guard) {
+        throw PageNotExistError("index fd " + std::to_string(fd_), new_page_id.page_no);
+    }
+    return std::make_unique<IxNodeHandle>(file_hdr_, std::move(guard));
 }
 
 /**
@@ -735,20 +992,20 @@ IxNodeHandle *IxIndexHandle::create_node() {
  */
 void IxIndexHandle::maintain_parent(IxNodeHandle *node) {
     IxNodeHandle *curr = node;
+    std::unique_ptr<IxNodeHandle> curr_holder; // curr不是node时持有它
     while (curr->get_parent_page_no() != IX_NO_PAGE) {
         // Load its parent
-        IxNodeHandle *parent = fetch_node(curr->get_parent_page_no());
+        auto parent = fetch_node(curr->get_parent_page_no());
         int rank = parent->find_child(curr);      // 找到当前结点在父节点中的位置
         char *parent_key = parent->get_key(rank); // 获取当前节点在父节点中的key
         char *child_first_key = curr->get_key(0); // 获取当前节点的第一个key
         if (memcmp(parent_key, child_first_key, file_hdr_->col_tot_len_) == 0) { // 如果相等，不需要更新
-            assert(buffer_pool_manager_->unpin_page(parent->get_page_id(), true));
             break;
         }
         memcpy(parent_key, child_first_key, file_hdr_->col_tot_len_); // 修改了parent node
-        curr = parent;
-
-        assert(buffer_pool_manager_->unpin_page(parent->get_page_id(), true));
+        parent->mark_dirty();
+        curr = parent.get();
+        curr_holder = std::move(parent);
     }
 }
 
@@ -760,13 +1017,13 @@ void IxIndexHandle::maintain_parent(IxNodeHandle *node) {
 void IxIndexHandle::erase_leaf(IxNodeHandle *leaf) {
     assert(leaf->is_leaf_page());
 
-    IxNodeHandle *prev = fetch_node(leaf->get_prev_leaf());
+    auto prev = fetch_node(leaf->get_prev_leaf());
     prev->set_next_leaf(leaf->get_next_leaf());
-    buffer_pool_manager_->unpin_page(prev->get_page_id(), true);
+    prev->mark_dirty();
 
-    IxNodeHandle *next = fetch_node(leaf->get_next_leaf());
+    auto next = fetch_node(leaf->get_next_leaf());
     next->set_prev_leaf(leaf->get_prev_leaf()); // 注意此处是SetPrevLeaf()
-    buffer_pool_manager_->unpin_page(next->get_page_id(), true);
+    next->mark_dirty();
 }
 
 /**
@@ -785,8 +1042,8 @@ void IxIndexHandle::maintain_child(IxNodeHandle *node, int child_idx) {
     if (!node->is_leaf_page()) {
         //  Current node is inner node, load its child and set its parent to current node
         int child_page_no = node->value_at(child_idx);
-        IxNodeHandle *child = fetch_node(child_page_no);
+        auto child = fetch_node(child_page_no);
         child->set_parent_page_no(node->get_page_no());
-        buffer_pool_manager_->unpin_page(child->get_page_id(), true);
+        child->mark_dirty();
     }
 }
\ No newline at end of file
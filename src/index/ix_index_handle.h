@@ -10,7 +10,16 @@ See the Mulan PSL v2 for more details. */
 
 #pragma once
 
+#include <atomic>
+#include <memory>
+#include <set>
+#include <shared_mutex>
+#include <string>
+#include <vector>
+
 #include "ix_defs.h"
+#include "record/rm_defs.h"
+#include "storage/memory_page_store.h"
 #include "transaction/transaction.h"
 
 enum class Operation { FIND = 0, INSERT, DELETE }; // 三种操作：查找、插入、删除
@@ -49,13 +58,14 @@ inline int ix_compare(const char *a, const char *b, const std::vector<ColType> &
     return 0;
 }
 
-/* 管理B+树中的每个节点 */
+/* 管理B+树中的每个节点，持有结点页面的守卫，析构时解锁并unpin */
 class IxNodeHandle {
     friend class IxIndexHandle;
     friend class IxScan;
 
   private:
     const IxFileHdr *file_hdr; // 节点所在文件的头部信息
+    PageGuard guard;           // 读操作持有读锁，修改B+树时持有写锁
     Page *page;                // 存储节点的页面
     IxPageHdr *page_hdr;       // page->data的第一部分，指针指向首地址，长度为sizeof(IxPageHdr)
     char *keys; // page->data的第二部分，指针指向首地址，长度为file_hdr->keys_size，每个key的长度为file_hdr->col_len
@@ -64,7 +74,8 @@ class IxNodeHandle {
   public:
     IxNodeHandle() = default;
 
-    IxNodeHandle(const IxFileHdr *file_hdr_, Page *page_) : file_hdr(file_hdr_), page(page_) {
+    IxNodeHandle(const IxFileHdr *file_hdr_, PageGuard guard_)
+        : file_hdr(file_hdr_), guard(std::move(guard_)), page(guard.get_page()) {
         page_hdr = reinterpret_cast<IxPageHdr *>(page->get_data());
         keys = page->get_data() + sizeof(IxPageHdr);
         rids = reinterpret_cast<Rid *>(keys + file_hdr->keys_size_);
@@ -74,6 +85,11 @@ class IxNodeHandle {
         return page_hdr->num_key;
     }
 
+    // 结点被修改过，释放时写回。只有持有写锁的结点可以调用
+    void mark_dirty() {
+        guard.mark_dirty();
+    }
+
     void set_size(int size) {
         page_hdr->num_key = size;
     }
@@ -215,10 +231,51 @@ class IxIndexHandle {
     BufferPoolManager *buffer_pool_manager_;
     int fd_;              // 存储B+树的文件
     IxFileHdr *file_hdr_; // 存了root_page，但其初始化为2（第0页存FILE_HDR_PAGE，第1页存LEAF_HEADER_PAGE）
-    std::mutex root_latch_;
+    // 插入删除时独占，查找时共享；只读单个叶子的操作（IxScan、get_rid等）只靠结点的读锁
+    mutable std::shared_mutex root_latch_;
+    // 临时表上索引的结点只在内存中，不经过缓冲池；为nullptr时是普通的索引
+    std::unique_ptr<MemoryPageStore> mem_pages_;
+
+    // change buffer中的key按索引的顺序排列，合并时依次删除，落在同一个叶子上的删除只读一次叶子
+    struct KeyLess {
+        const IxFileHdr *file_hdr;
+        bool operator()(const std::string &a, const std::string &b) const {
+            return file_hdr->key_cmp_(a.data(), b.data()) < 0;
+        }
+    };
+    // change buffer：目标叶子不在缓冲池中的删除先暂存在这里，不读叶子。get_value查到暂存的key时视为不存在，
+    // 插入同一个key前先执行它的删除，范围查找前、暂存满时和关闭索引时全部合并。读写都要持有root_latch_
+    std::set<std::string, KeyLess> pending_deletes_;
+    std::atomic<size_t> num_pending_deletes_{0}; // pending_deletes_的大小，不加锁判断是否需要合并
+    size_t change_buffer_size_ = 0;              // 最多暂存的删除数，0表示不暂存
+    int height_ = 0;                             // B+树的层数，只有根结点时为1，0表示还没有计算
+    // 分区表上的本地索引：每个分区一棵B+树，本句柄只把操作转发给各分区的句柄；非分区表为空
+    std::vector<std::unique_ptr<IxIndexHandle>> partitions_;
 
   public:
-    IxIndexHandle(DiskManager *disk_manager, BufferPoolManager *buffer_pool_manager, int fd);
+    IxIndexHandle(DiskManager *disk_manager, BufferPoolManager *buffer_pool_manager, int fd,
+                  size_t change_buffer_size = 0);
+
+    // 临时表上的索引，没有磁盘文件，fd_为-1，结点页面已经由IxManager::create_temp_index初始化
+    IxIndexHandle(IxFileHdr *file_hdr, std::unique_ptr<MemoryPageStore> mem_pages)
+        : disk_manager_(nullptr), buffer_pool_manager_(nullptr), fd_(-1), file_hdr_(file_hdr),
+          mem_pages_(std::move(mem_pages)) {
+    }
+
+    // 分区表上的本地索引，partitions[i]是第i个分区的B+树。插入和删除按rid中的分区号转发，查找访问所有分区
+    explicit IxIndexHandle(std::vector<std::unique_ptr<IxIndexHandle>> partitions)
+        : disk_manager_(nullptr), buffer_pool_manager_(nullptr), fd_(-1), file_hdr_(partitions[0]->file_hdr_),
+          partitions_(std::move(partitions)) {
+    }
+
+    int num_partitions() const {
+        return partitions_.empty() ? 1 : (int)partitions_.size();
+    }
+
+    // 第i个分区的B+树，非分区索引只有它自己
+    IxIndexHandle *partition(int i) {
+        return partitions_.empty() ? this : partitions_[i].get();
+    }
 
     int get_fd() const {
         return fd_;
@@ -234,19 +291,29 @@ class IxIndexHandle {
     // for search
     bool get_value(const char *key, std::vector<Rid> *result, Transaction *transaction);
 
-    std::pair<IxNodeHandle *, bool> find_leaf_page(const char *key, Operation operation, Transaction *transaction,
-                                                   bool find_first = false);
+    std::pair<std::unique_ptr<IxNodeHandle>, bool> find_leaf_page(const char *key, Operation operation,
+                                                                  Transaction *transaction, bool find_first = false);
 
     // for insert
     page_id_t insert_entry(const char *key, const Rid &value, Transaction *transaction);
 
-    IxNodeHandle *split(IxNodeHandle *node);
+    std::unique_ptr<IxNodeHandle> split(IxNodeHandle *node);
 
     void insert_into_parent(IxNodeHandle *old_node, const char *key, IxNodeHandle *new_node, Transaction *transaction);
 
     // for delete
     bool delete_entry(const char *key, Transaction *transaction);
 
+    // 删除rid对应记录的索引项，分区索引按rid中的分区号找到所在的B+树
+    bool delete_entry(const char *key, const Rid &rid, Transaction *transaction);
+
+    // 把change buffer中暂存的删除全部合并到B+树
+    void merge_change_buffer();
+
+    size_t num_pending_deletes() const {
+        return num_pending_deletes_.load(std::memory_order_relaxed);
+    }
+
     bool coalesce_or_redistribute(IxNodeHandle *node, Transaction *transaction = nullptr,
                                   bool *root_is_latched = nullptr);
     bool adjust_root(IxNodeHandle *old_root_node);
@@ -260,24 +327,73 @@ class IxIndexHandle {
 
     Iid upper_bound(const char *key);
 
+    bool is_deleted(const char *key) const;
+
     Iid leaf_end() const;
 
     Iid leaf_begin() const;
 
+    // 读取iid处的键，iid越过叶子结点末尾时返回false
+    bool read_entry(const Iid &iid, char *key) const;
+
+    // 把iid移动到前一个索引项，iid已经是第一个索引项时返回false
+    bool prev_entry(Iid &iid) const;
+
+    // 按键的升序扫描[lower_key, upper_key]内的索引项，分区索引只扫描partitions中的分区，对各分区的扫描做k路归并
+    std::unique_ptr<RecScan> range_scan(const char *lower_key, const char *upper_key,
+                                        const std::vector<int> &partitions);
+
+    std::unique_ptr<RecScan> range_scan(const char *lower_key, const char *upper_key);
+
+    // 读出不小于key的最小的键，没有时返回false
+    bool first_entry(const char *key, char *entry) {
+        return bound_entry(key, entry, false);
+    }
+
+    // 读出不大于key的最大的键，没有时返回false
+    bool last_entry(const char *key, char *entry) {
+        return bound_entry(key, entry, true);
+    }
+
   private:
     // 辅助函数
     void update_root_page_no(page_id_t root) {
         file_hdr_->root_page_ = root;
+        height_ = 0;
     }
 
     bool is_empty() const {
         return file_hdr_->root_page_ == IX_NO_PAGE;
     }
 
+    // for change buffer
+    bool is_delete_pending(const char *key) const {
+        return num_pending_deletes() > 0 && pending_deletes_.count(std::string(key, file_hdr_->col_tot_len_)) > 0;
+    }
+
+    bool remove_entry(const char *key, Transaction *transaction);
+
+    bool buffer_delete(const char *key);
+
+    void merge_pending_deletes();
+
+    page_id_t leaf_page_of(const char *key);
+
+    Iid find_bound(const char *key, bool upper);
+
+    bool bound_entry(const char *key, char *entry, bool last);
+
+    // for partitioned index
+    IxIndexHandle *partition_of_rid(const Rid &rid) {
+        return partitions_[rid.page_no >> RM_PARTITION_PAGE_BITS].get();
+    }
+
     // for get/create node
-    IxNodeHandle *fetch_node(int page_no) const;
+    std::unique_ptr<IxNodeHandle> fetch_node(int page_no);
+
+    std::unique_ptr<IxNodeHandle> fetch_node_read(int page_no) const;
 
-    IxNodeHandle *create_node();
+    std::unique_ptr<IxNodeHandle> create_node();
 
     // for maintain data structure
     void maintain_parent(IxNodeHandle *node);
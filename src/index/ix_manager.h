@@ -21,10 +21,13 @@ class IxManager {
   private:
     DiskManager *disk_manager_;
     BufferPoolManager *buffer_pool_manager_;
+    size_t change_buffer_size_; // 打开的索引暂存删除数的上限，0表示不暂存
 
   public:
-    IxManager(DiskManager *disk_manager, BufferPoolManager *buffer_pool_manager)
-        : disk_manager_(disk_manager), buffer_pool_manager_(buffer_pool_manager) {
+    IxManager(DiskManager *disk_manager, BufferPoolManager *buffer_pool_manager,
+              size_t change_buffer_size = CHANGE_BUFFER_SIZE)
+        : disk_manager_(disk_manager), buffer_pool_manager_(buffer_pool_manager),
+          change_buffer_size_(change_buffer_size) {
     }
 
     std::string get_index_name(const std::string &filename, const std::vector<std::string> &index_cols) {
@@ -62,71 +65,22 @@ class IxManager {
         // Open index file
         int fd = disk_manager_->open_file(ix_name);
 
-        // Create file header and write to file
-        // Theoretically we have: |page_hdr| + (|attr| + |rid|) * n <= PAGE_SIZE
-        // but we reserve one slot for convenient inserting and deleting, i.e.
-        // |page_hdr| + (|attr| + |rid|) * (n + 1) <= PAGE_SIZE
-        int col_tot_len = 0;
-        int col_num = index_cols.size();
-        for (auto &col : index_cols) {
-            col_tot_len += col.len;
-        }
-        if (col_tot_len > IX_MAX_COL_LEN) {
-            throw InvalidColLengthError(col_tot_len);
-        }
-        // 根据 |page_hdr| + (|attr| + |rid|) * (n + 1) <= PAGE_SIZE 求得n的最大值btree_order
-        // 即 n <= btree_order，那么btree_order就是每个结点最多可插入的键值对数量（实际还多留了一个空位，但其不可插入）
-        int btree_order = static_cast<int>((PAGE_SIZE - sizeof(IxPageHdr)) / (col_tot_len + sizeof(Rid)) - 1);
-        assert(btree_order > 2);
-
-        // Create file header and write to file
-        IxFileHdr *fhdr =
-            new IxFileHdr(IX_NO_PAGE, IX_INIT_NUM_PAGES, IX_INIT_ROOT_PAGE, col_num, col_tot_len, btree_order,
-                          (btree_order + 1) * col_tot_len, IX_INIT_ROOT_PAGE, IX_INIT_ROOT_PAGE);
-        for (int i = 0; i < col_num; ++i) {
-            fhdr->col_types_.push_back(index_cols[i].type);
-            fhdr->col_lens_.push_back(index_cols[i].len);
-        }
-        fhdr->update_tot_len();
-
+        IxFileHdr *fhdr = init_file_hdr(index_cols);
         char *data = new char[fhdr->tot_len_];
         fhdr->serialize(data);
 
         disk_manager_->write_page(fd, IX_FILE_HDR_PAGE, data, fhdr->tot_len_);
 
         char page_buf[PAGE_SIZE]; // 在内存中初始化page_buf中的内容，然后将其写入磁盘
-        memset(page_buf, 0, PAGE_SIZE);
         // 注意leaf header页号为1，也标记为叶子结点，其前一个/后一个叶子均指向root node
         // Create leaf list header page and write to file
-        {
-            memset(page_buf, 0, PAGE_SIZE);
-            auto phdr = reinterpret_cast<IxPageHdr *>(page_buf);
-            *phdr = {
-                .next_free_page_no = IX_NO_PAGE,
-                .parent = IX_NO_PAGE,
-                .num_key = 0,
-                .is_leaf = true,
-                .prev_leaf = IX_INIT_ROOT_PAGE,
-                .next_leaf = IX_INIT_ROOT_PAGE,
-            };
-            disk_manager_->write_page(fd, IX_LEAF_HEADER_PAGE, page_buf, PAGE_SIZE);
-        }
+        init_leaf_page(page_buf, IX_INIT_ROOT_PAGE);
+        disk_manager_->write_page(fd, IX_LEAF_HEADER_PAGE, page_buf, PAGE_SIZE);
         // 注意root node页号为2，也标记为叶子结点，其前一个/后一个叶子均指向leaf header
         // Create root node and write to file
-        {
-            memset(page_buf, 0, PAGE_SIZE);
-            auto phdr = reinterpret_cast<IxPageHdr *>(page_buf);
-            *phdr = {
-                .next_free_page_no = IX_NO_PAGE,
-                .parent = IX_NO_PAGE,
-                .num_key = 0,
-                .is_leaf = true,
-                .prev_leaf = IX_LEAF_HEADER_PAGE,
-                .next_leaf = IX_LEAF_HEADER_PAGE,
-            };
-            // Must write PAGE_SIZE here in case of future fetch_node()
-            disk_manager_->write_page(fd, IX_INIT_ROOT_PAGE, page_buf, PAGE_SIZE);
-        }
+        init_leaf_page(page_buf, IX_LEAF_HEADER_PAGE);
+        // Must write PAGE_SIZE here in case of future fetch_node()
+        disk_manager_->write_page(fd, IX_INIT_ROOT_PAGE, page_buf, PAGE_SIZE);
 
         disk_manager_->set_fd2pageno(fd, IX_INIT_NUM_PAGES - 1); // DEBUG
 
@@ -134,6 +88,21 @@ class IxManager {
         disk_manager_->close_file(fd);
     }
 
+    /**
+     * @description: 创建临时表上的索引，B+树的结点存放在内存页面中，不创建磁盘文件、不经过缓冲池
+     * @param {vector<ColMeta>&} index_cols 索引包含的字段
+     * @return {unique_ptr<IxIndexHandle>} 索引句柄，释放时结点随之释放
+     */
+    std::unique_ptr<IxIndexHandle> create_temp_index(const std::vector<ColMeta> &index_cols) {
+        IxFileHdr *fhdr = init_file_hdr(index_cols);
+        fhdr->key_cmp_ = KeyComparator::create(fhdr->col_types_, fhdr->col_lens_); // 打开磁盘上的索引时在反序列化中生成
+        // 第0页对应磁盘文件中的文件头页，不使用
+        auto mem_pages = std::make_unique<MemoryPageStore>(-1, IX_INIT_NUM_PAGES);
+        init_leaf_page(mem_pages->fetch_page_write({-1, IX_LEAF_HEADER_PAGE}).get_data(), IX_INIT_ROOT_PAGE);
+        init_leaf_page(mem_pages->fetch_page_write({-1, IX_INIT_ROOT_PAGE}).get_data(), IX_LEAF_HEADER_PAGE);
+        return std::make_unique<IxIndexHandle>(fhdr, std::move(mem_pages));
+    }
+
     void destroy_index(const std::string &filename, const std::vector<ColMeta> &index_cols) {
         std::string ix_name = get_index_name(filename, index_cols);
         disk_manager_->destroy_file(ix_name);
@@ -148,16 +117,39 @@ class IxManager {
     std::unique_ptr<IxIndexHandle> open_index(const std::string &filename, const std::vector<ColMeta> &index_cols) {
         std::string ix_name = get_index_name(filename, index_cols);
         int fd = disk_manager_->open_file(ix_name);
-        return std::make_unique<IxIndexHandle>(disk_manager_, buffer_pool_manager_, fd);
+        return std::make_unique<IxIndexHandle>(disk_manager_, buffer_pool_manager_, fd, change_buffer_size_);
     }
 
     std::unique_ptr<IxIndexHandle> open_index(const std::string &filename, const std::vector<std::string> &index_cols) {
         std::string ix_name = get_index_name(filename, index_cols);
         int fd = disk_manager_->open_file(ix_name);
-        return std::make_unique<IxIndexHandle>(disk_manager_, buffer_pool_manager_, fd);
+        return std::make_unique<IxIndexHandle>(disk_manager_, buffer_pool_manager_, fd, change_buffer_size_);
+    }
+
+    /**
+     * @description: 打开分区表上的本地索引，每个分区的数据文件上有一个索引文件
+     * @param {vector<string>&} filenames 各分区的数据文件名称，按分区号排列
+     * @param {vector<ColMeta>&} index_cols 索引包含的字段
+     * @return {unique_ptr<IxIndexHandle>} 把操作转发给各分区B+树的索引句柄
+     */
+    std::unique_ptr<IxIndexHandle> open_partitioned_index(const std::vector<std::string> &filenames,
+                                                          const std::vector<ColMeta> &index_cols) {
+        std::vector<std::unique_ptr<IxIndexHandle>> partitions;
+        for (auto &filename : filenames) {
+            partitions.push_back(open_index(filename, index_cols));
+        }
+        return std::make_unique<IxIndexHandle>(std::move(partitions));
     }
 
-    void close_index(const IxIndexHandle *ih) {
+    void close_index(IxIndexHandle *ih) {
+        if (!ih->partitions_.empty()) {
+            for (auto &partition : ih->partitions_) {
+                close_index(partition.get());
+            }
+            return;
+        }
+        // 暂存的删除先合并到B+树，再写回文件头和结点
+        ih->merge_change_buffer();
         char *data = new char[ih->file_hdr_->tot_len_];
         ih->file_hdr_->serialize(data);
         disk_manager_->write_page(ih->fd_, IX_FILE_HDR_PAGE, data, ih->file_hdr_->tot_len_);
@@ -165,4 +157,48 @@ class IxManager {
         buffer_pool_manager_->flush_all_pages(ih->fd_);
         disk_manager_->close_file(ih->fd_);
     }
+
+  private:
+    // 根据索引字段计算B+树的阶，创建文件头
+    static IxFileHdr *init_file_hdr(const std::vector<ColMeta> &index_cols) {
+        // Theoretically we have: |page_hdr| + (|attr| + |rid|) * n <= PAGE_SIZE
+        // but we reserve one slot for convenient inserting and deleting, i.e.
+        // |page_hdr| + (|attr| + |rid|) * (n + 1) <= PAGE_SIZE
+        int col_tot_len = 0;
+        int col_num = index_cols.size();
+        for (auto &col : index_cols) {
+            col_tot_len += col.len;
+        }
+        if (col_tot_len > IX_MAX_COL_LEN) {
+            throw InvalidColLengthError(col_tot_len);
+        }
+        // 根据 |page_hdr| + (|attr| + |rid|) * (n + 1) <= PAGE_SIZE 求得n的最大值btree_order
+        // 即 n <= btree_order，那么btree_order就是每个结点最多可插入的键值对数量（实际还多留了一个空位，但其不可插入）
+        int btree_order = static_cast<int>((PAGE_SIZE - sizeof(IxPageHdr)) / (col_tot_len + sizeof(Rid)) - 1);
+        assert(btree_order > 2);
+
+        IxFileHdr *fhdr =
+            new IxFileHdr(IX_NO_PAGE, IX_INIT_NUM_PAGES, IX_INIT_ROOT_PAGE, col_num, col_tot_len, btree_order,
+                          (btree_order + 1) * col_tot_len, IX_INIT_ROOT_PAGE, IX_INIT_ROOT_PAGE);
+        for (int i = 0; i < col_num; ++i) {
+            fhdr->col_types_.push_back(index_cols[i].type);
+            fhdr->col_lens_.push_back(index_cols[i].len);
+        }
+        fhdr->update_tot_len();
+        return fhdr;
+    }
+
+    // 初始化一个空的叶子结点页面，leaf header和root node互为前后叶子
+    static void init_leaf_page(char *page_buf, int sibling_page_no) {
+        memset(page_buf, 0, PAGE_SIZE);
+        auto phdr = reinterpret_cast<IxPageHdr *>(page_buf);
+        *phdr = {
+            .next_free_page_no = IX_NO_PAGE,
+            .parent = IX_NO_PAGE,
+            .num_key = 0,
+            .is_leaf = true,
+            .prev_leaf = sibling_page_no,
+            .next_leaf = sibling_page_no,
+        };
+    }
 };
\ No newline at end of file
@@ -10,13 +10,22 @@ See the Mulan PSL v2 for more details. */
 
 #include "ix_scan.h"
 
+#include <algorithm>
+
 /**
- * @brief
- * @todo 加上读锁（需要使用缓冲池得到page）
+ * @brief 移动到下一个未删除的索引项
  */
 void IxScan::next() {
+    step();
+    skip_deleted();
+}
+
+/**
+ * @brief 移动到下一个索引项，只在读取当前叶子时持有它的读锁
+ */
+void IxScan::step() {
     assert(!is_end());
-    IxNodeHandle *node = ih_->fetch_node(iid_.page_no);
+    auto node = ih_->fetch_node_read(iid_.page_no);
     assert(node->is_leaf_page());
     assert(iid_.slot_no < node->get_size());
     // increment slot no
@@ -28,6 +37,58 @@ void IxScan::next() {
     }
 }
 
+/**
+ * @brief 跳过删除还暂存在change buffer中的索引项。lower_bound之后新暂存的删除仍在叶子中，读到时视为不存在
+ */
+void IxScan::skip_deleted() {
+    if (ih_->num_pending_deletes() == 0) {
+        return;
+    }
+    std::vector<char> key(ih_->file_hdr_->col_tot_len_);
+    while (!is_end() && ih_->read_entry(iid_, key.data()) && ih_->is_deleted(key.data())) {
+        step();
+    }
+}
+
 Rid IxScan::rid() const {
     return ih_->get_rid(iid_);
+}
+
+/**
+ * @brief 读出当前索引项的键，扫描没有结束时当前位置总是一个存在的索引项
+ */
+void IxScan::key(char *key) const {
+    [[maybe_unused]] bool exists = ih_->read_entry(iid_, key);
+    assert(exists);
+}
+
+/**
+ * @brief 读出各个扫描的第一个键，建立小根堆
+ */
+IxMergeScan::IxMergeScan(std::vector<std::unique_ptr<IxScan>> scans, const KeyComparator *key_cmp, int key_len)
+    : scans_(std::move(scans)), keys_(scans_.size(), std::vector<char>(key_len)), key_cmp_(key_cmp) {
+    for (int i = 0; i < (int)scans_.size(); i++) {
+        if (!scans_[i]->is_end()) {
+            scans_[i]->key(keys_[i].data());
+            heap_.push_back(i);
+        }
+    }
+    std::make_heap(heap_.begin(), heap_.end(), [this](int a, int b) { return after(a, b); });
+}
+
+/**
+ * @brief 堆顶的扫描前进一项，结束时移出堆，否则按新的键放回堆中
+ */
+void IxMergeScan::next() {
+    assert(!is_end());
+    auto after = [this](int a, int b) { return this->after(a, b); };
+    std::pop_heap(heap_.begin(), heap_.end(), after);
+    int i = heap_.back();
+    scans_[i]->next();
+    if (scans_[i]->is_end()) {
+        heap_.pop_back();
+        return;
+    }
+    scans_[i]->key(keys_[i].data());
+    std::push_heap(heap_.begin(), heap_.end(), after);
 }
\ No newline at end of file
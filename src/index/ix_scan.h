@@ -10,6 +10,9 @@ See the Mulan PSL v2 for more details. */
 
 #pragma once
 
+#include <memory>
+#include <vector>
+
 #include "ix_defs.h"
 #include "ix_index_handle.h"
 
@@ -17,7 +20,7 @@ See the Mulan PSL v2 for more details. */
 
 // 用于遍历叶子结点
 // 用于直接遍历叶子结点，而不用findleafpage来得到叶子结点
-// TODO：对page遍历时，要加上读锁
+// 两次next()之间不持有任何页面，每次只对当前叶子加读锁。删除还暂存在change buffer中的索引项被跳过
 class IxScan : public RecScan {
     const IxIndexHandle *ih_;
     Iid iid_; // 初始为lower（用于遍历的指针）
@@ -27,6 +30,7 @@ class IxScan : public RecScan {
   public:
     IxScan(const IxIndexHandle *ih, const Iid &lower, const Iid &upper, BufferPoolManager *bpm)
         : ih_(ih), iid_(lower), end_(upper), bpm_(bpm) {
+        skip_deleted();
     }
 
     void next() override;
@@ -40,4 +44,41 @@ class IxScan : public RecScan {
     const Iid &iid() const {
         return iid_;
     }
+
+    // 读出当前索引项的键，长度为索引字段的总长度
+    void key(char *key) const;
+
+  private:
+    void step();
+
+    void skip_deleted();
+};
+
+// 分区索引的范围扫描：每个分区的B+树上一个IxScan，按各自当前的键组成小根堆做k路归并，
+// 输出的顺序和在一棵B+树上扫描时相同，键相同时分区号小的在前
+class IxMergeScan : public RecScan {
+    std::vector<std::unique_ptr<IxScan>> scans_;
+    std::vector<std::vector<char>> keys_; // keys_[i]是scans_[i]当前索引项的键
+    std::vector<int> heap_;               // 没有结束的扫描，堆顶是当前键最小的扫描
+    const KeyComparator *key_cmp_;
+
+  public:
+    IxMergeScan(std::vector<std::unique_ptr<IxScan>> scans, const KeyComparator *key_cmp, int key_len);
+
+    void next() override;
+
+    bool is_end() const override {
+        return heap_.empty();
+    }
+
+    Rid rid() const override {
+        return scans_[heap_.front()]->rid();
+    }
+
+  private:
+    // 扫描a的当前索引项是否排在扫描b的之后，作为堆的比较函数时堆顶是最先输出的扫描
+    bool after(int a, int b) const {
+        int cmp = (*key_cmp_)(keys_[a].data(), keys_[b].data());
+        return cmp != 0 ? cmp > 0 : a > b;
+    }
 };
\ No newline at end of file
@@ -30,6 +30,15 @@ class Optimizer {
         } else if (auto x = std::dynamic_pointer_cast<ast::ShowTables>(query->parse)) {
             // show tables;
             return std::make_shared<OtherPlan>(T_ShowTable, std::string());
+        } else if (auto x = std::dynamic_pointer_cast<ast::DumpTrace>(query->parse)) {
+            // dump trace;
+            return std::make_shared<OtherPlan>(T_DumpTrace, std::string());
+        } else if (auto x = std::dynamic_pointer_cast<ast::ShowBufferPool>(query->parse)) {
+            // show buffer pool;
+            return std::make_shared<OtherPlan>(T_ShowBufferPool, std::string());
+        } else if (auto x = std::dynamic_pointer_cast<ast::ResetBufferPool>(query->parse)) {
+            // reset buffer pool;
+            return std::make_shared<OtherPlan>(T_ResetBufferPool, std::string());
         } else if (auto x = std::dynamic_pointer_cast<ast::DescTable>(query->parse)) {
             // desc table;
             return std::make_shared<OtherPlan>(T_DescTable, x->tab_name);
@@ -49,7 +58,11 @@ class Optimizer {
             // Set Knob Plan
             return std::make_shared<SetKnobPlan>(x->set_knob_type_, x->bool_val_);
         } else {
-            return planner_->do_planner(query, context);
+            std::shared_ptr<Plan> plan = planner_->do_planner(query, context);
+            if (query->explain_analyze) {
+                return std::make_shared<ExplainPlan>(T_ExplainAnalyze, plan);
+            }
+            return plan;
         }
     }
 };
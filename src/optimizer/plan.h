@@ -23,12 +23,17 @@ typedef enum PlanTag {
     T_Invalid = 1,
     T_Help,
     T_ShowTable,
+    T_DumpTrace,
+    T_ShowBufferPool,
+    T_ResetBufferPool,
     T_DescTable,
     T_CreateTable,
     T_DropTable,
     T_CreateIndex,
     T_DropIndex,
     T_ShowIndex,
+    T_CreateView,
+    T_DropView,
     T_SetKnob,
     T_Insert,
     T_Update,
@@ -40,12 +45,17 @@ typedef enum PlanTag {
     T_Transaction_rollback,
     T_SeqScan,
     T_IndexScan,
+    T_IndexUnion, // OR条件各分支的索引扫描合并Rid
     T_NestLoop,
-    T_SortMerge,          // sort merge join
-    T_SortMergeWithIndex, // 使用索引加快merge join
+    T_SortMerge,     // sort merge join
+    T_SemiJoin,      // 子查询结果构建哈希表的半连接/反连接
+    T_IndexSemiJoin, // 在子查询表的索引上逐条探查的半连接/反连接
     T_Sort,
     T_Aggregation,
-    T_Projection
+    T_IndexAggregation, // 从索引和表的元数据得到聚合结果，subplan_是被替代的扫描
+    T_Projection,
+    T_Limit,
+    T_ExplainAnalyze
 } PlanTag;
 
 // 查询执行计划
@@ -77,6 +87,8 @@ class ScanPlan : public Plan {
     size_t len_;
     std::vector<Condition> fed_conds_;
     std::vector<std::string> index_col_names_;
+    // T_IndexUnion时OR条件每个分支上的索引扫描，conds_是表上的全部条件
+    std::vector<std::shared_ptr<ScanPlan>> union_branches_;
 };
 
 class JoinPlan : public Plan {
@@ -96,10 +108,33 @@ class JoinPlan : public Plan {
     std::shared_ptr<Plan> right_;
     // 连接条件
     std::vector<Condition> conds_;
+    // merge join的左右输入是否已经按连接键有序，有序的一侧不需要排序
+    bool left_ordered_ = false;
+    bool right_ordered_ = false;
     // future TODO: 后续可以支持的连接类型
     JoinType type;
 };
 
+// 不相关的IN/EXISTS子查询规划成的半连接/反连接，输出left_中（不）能匹配子查询结果的记录
+// T_SemiJoin时right_是子查询的计划；T_IndexSemiJoin时right_是子查询表上的索引扫描，只提供探查用的索引和过滤条件
+class SemiJoinPlan : public Plan {
+  public:
+    SemiJoinPlan(PlanTag tag, std::shared_ptr<Plan> left, std::shared_ptr<Plan> right, TabCol outer_col,
+                 bool is_anti) {
+        Plan::tag = tag;
+        left_ = std::move(left);
+        right_ = std::move(right);
+        outer_col_ = std::move(outer_col);
+        is_anti_ = is_anti;
+    }
+    ~SemiJoinPlan() override {
+    }
+    std::shared_ptr<Plan> left_;
+    std::shared_ptr<Plan> right_;
+    TabCol outer_col_; // 外层的连接列，EXISTS时col_name为空
+    bool is_anti_;     // NOT IN/NOT EXISTS
+};
+
 class ProjectionPlan : public Plan {
   public:
     ProjectionPlan(PlanTag tag, std::shared_ptr<Plan> subplan, std::vector<TabCol> sel_cols) {
@@ -146,6 +181,21 @@ class SortPlan : public Plan {
     bool is_desc_;
 };
 
+class LimitPlan : public Plan {
+  public:
+    LimitPlan(PlanTag tag, std::shared_ptr<Plan> subplan, size_t limit, size_t offset) {
+        Plan::tag = tag;
+        subplan_ = std::move(subplan);
+        limit_ = limit;
+        offset_ = offset;
+    }
+    ~LimitPlan() {
+    }
+    std::shared_ptr<Plan> subplan_;
+    size_t limit_;
+    size_t offset_;
+};
+
 // dml语句，包括insert; delete; update; select语句　
 class DMLPlan : public Plan {
   public:
@@ -181,6 +231,9 @@ class DDLPlan : public Plan {
     std::string tab_name_;
     std::vector<std::string> tab_col_names_;
     std::vector<ColDef> cols_;
+    bool temporary_ = false; // 创建临时表
+    PartitionDef partition_; // 创建分区表
+    ViewDef view_;           // 创建物化视图
 };
 
 // help; show tables; desc tables; begin; abort; commit; rollback语句对应的plan
@@ -207,6 +260,18 @@ class SetKnobPlan : public Plan {
     bool bool_value_;
 };
 
+// explain analyze语句，照常执行subplan_，但输出资源统计而不是查询结果
+class ExplainPlan : public Plan {
+  public:
+    ExplainPlan(PlanTag tag, std::shared_ptr<Plan> subplan) {
+        Plan::tag = tag;
+        subplan_ = std::move(subplan);
+    }
+    ~ExplainPlan() {
+    }
+    std::shared_ptr<Plan> subplan_;
+};
+
 class plannerInfo {
   public:
     std::shared_ptr<ast::SelectStmt> parse;
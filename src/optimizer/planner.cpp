@@ -10,9 +10,13 @@ See the Mulan PSL v2 for more details. */
 
 #include "planner.h"
 
+#include <cmath>
 #include <memory>
+#include <set>
 #include <unordered_map>
 
+#include "execution/executor_index_aggregation.h"
+
 bool Planner::get_index_cols(std::string tab_name, std::vector<Condition> &curr_conds,
                              std::vector<std::string> &index_col_names) {
     index_col_names.clear();
@@ -44,9 +48,15 @@ bool Planner::get_index_cols(std::string tab_name, std::vector<Condition> &curr_
 
     // 从 curr_conds 中 解析出 等值条件 和 非等值条件
     for (size_t i = 0; i < curr_conds.size(); i++) {
+        if (curr_conds[i].rhs_expr != nullptr) {
+            continue; // 右侧在每条记录上求值，不能作为索引的查找键
+        }
         if (curr_conds[i].op == OP_EQ) {
             eq_index_map[curr_conds[i].lhs_col.col_name] = i;
-        } else {
+        } else if (curr_conds[i].op == OP_IN) {
+            // IN按每个值做一次等值探查，同一列上已有等值条件时用等值条件
+            eq_index_map.emplace(curr_conds[i].lhs_col.col_name, i);
+        } else if (curr_conds[i].op != OP_OR) {
             neq_index_map[curr_conds[i].lhs_col.col_name] = i;
         }
     }
@@ -138,6 +148,38 @@ bool Planner::get_index_cols(std::string tab_name, std::vector<Condition> &curr_
     // return false;
 }
 
+/**
+ * @description: 有能最左匹配的索引时用索引扫描；否则如果某个OR条件的每个分支都能用索引，
+ * 对各分支分别做索引扫描再合并Rid；都不行时顺序扫描
+ */
+std::shared_ptr<ScanPlan> Planner::make_scan_plan(const std::string &tab_name, std::vector<Condition> conds) {
+    std::vector<std::string> index_col_names;
+    if (get_index_cols(tab_name, conds, index_col_names)) {
+        return std::make_shared<ScanPlan>(T_IndexScan, sm_manager_, tab_name, std::move(conds), index_col_names);
+    }
+    for (auto &cond : conds) {
+        if (cond.op != OP_OR) {
+            continue;
+        }
+        std::vector<std::shared_ptr<ScanPlan>> branches;
+        for (auto branch_conds : cond.disjuncts) {
+            if (!get_index_cols(tab_name, branch_conds, index_col_names)) {
+                break;
+            }
+            branches.push_back(std::make_shared<ScanPlan>(T_IndexScan, sm_manager_, tab_name, std::move(branch_conds),
+                                                          index_col_names));
+        }
+        if (branches.size() == cond.disjuncts.size()) {
+            auto plan = std::make_shared<ScanPlan>(T_IndexUnion, sm_manager_, tab_name, std::move(conds),
+                                                   std::vector<std::string>());
+            plan->union_branches_ = std::move(branches);
+            return plan;
+        }
+    }
+    index_col_names.clear();
+    return std::make_shared<ScanPlan>(T_SeqScan, sm_manager_, tab_name, std::move(conds), index_col_names);
+}
+
 /**
  * @brief 表算子条件谓词生成
  *
@@ -215,16 +257,228 @@ std::shared_ptr<Plan> pop_scan(int *scantbl, std::string table, std::vector<std:
     return nullptr;
 }
 
+// 交换条件的左右两边
+void swap_cond(Condition &cond) {
+    std::map<CompOp, CompOp> swap_op = {
+        {OP_EQ, OP_EQ}, {OP_NE, OP_NE}, {OP_LT, OP_GT}, {OP_GT, OP_LT}, {OP_LE, OP_GE}, {OP_GE, OP_LE},
+    };
+    std::swap(cond.lhs_col, cond.rhs_col);
+    cond.op = swap_op.at(cond.op);
+}
+
+/**
+ * @description: 判断按order有序的输出是否也按keys有序
+ * @param {bool} allow_reorder 是否允许调整keys的顺序
+ * @param {vector<size_t>} &perm 输出参数，order的前keys.size()列依次对应keys[perm[i]]
+ */
+bool match_order(const std::vector<TabCol> &order, const std::vector<TabCol> &keys, bool allow_reorder,
+                 std::vector<size_t> &perm) {
+    if (keys.empty() || order.size() < keys.size()) {
+        return false;
+    }
+    perm.clear();
+    for (size_t i = 0; i < keys.size(); i++) {
+        auto it = std::find_if(keys.begin(), keys.end(), [&](const TabCol &key) {
+            return key.tab_name == order[i].tab_name && key.col_name == order[i].col_name;
+        });
+        size_t pos = it - keys.begin();
+        if (it == keys.end() || (!allow_reorder && pos != i) ||
+            std::find(perm.begin(), perm.end(), pos) != perm.end()) {
+            return false;
+        }
+        perm.push_back(pos);
+    }
+    return true;
+}
+
+std::vector<TabCol> Planner::get_plan_order(const std::shared_ptr<Plan> &plan) {
+    std::vector<TabCol> order;
+    if (auto x = std::dynamic_pointer_cast<SemiJoinPlan>(plan)) {
+        // 半连接按外层的顺序输出
+        order = get_plan_order(x->left_);
+    } else if (auto x = std::dynamic_pointer_cast<ScanPlan>(plan)) {
+        if (x->tag == T_IndexScan) {
+            // 索引扫描按索引列的顺序输出
+            for (auto &col_name : x->index_col_names_) {
+                order.push_back({.tab_name = x->tab_name_, .col_name = col_name});
+            }
+        }
+    } else if (auto x = std::dynamic_pointer_cast<JoinPlan>(plan)) {
+        if (x->tag == T_NestLoop) {
+            // 左表是外层循环
+            order = get_plan_order(x->left_);
+        } else if (x->tag == T_SortMerge) {
+            // merge join按左表的连接键输出，连接键排在conds_的最前面
+            for (auto &cond : x->conds_) {
+                if (cond.is_rhs_val || cond.op != OP_EQ) {
+                    break;
+                }
+                order.push_back(cond.lhs_col);
+            }
+        }
+    }
+    return order;
+}
+
+bool Planner::order_by_index(const std::shared_ptr<Plan> &plan, const std::vector<TabCol> &keys, bool allow_reorder,
+                             std::vector<size_t> &perm) {
+    if (match_order(get_plan_order(plan), keys, allow_reorder, perm)) {
+        return true;
+    }
+    if (auto semi = std::dynamic_pointer_cast<SemiJoinPlan>(plan)) {
+        return order_by_index(semi->left_, keys, allow_reorder, perm);
+    }
+    auto scan = std::dynamic_pointer_cast<ScanPlan>(plan);
+    if (scan == nullptr || scan->tag == T_IndexUnion) {
+        return false; // 换成整个索引的扫描会失去OR条件各分支的索引探查
+    }
+    TabMeta &tab = sm_manager_->db_.get_table(scan->tab_name_);
+    for (auto &index : tab.indexes) {
+        std::vector<TabCol> index_order;
+        std::vector<std::string> index_col_names;
+        for (auto &col : index.cols) {
+            index_order.push_back({.tab_name = scan->tab_name_, .col_name = col.name});
+            index_col_names.push_back(col.name);
+        }
+        if (match_order(index_order, keys, allow_reorder, perm)) {
+            // 换成按该索引扫描，扫描条件不变，仍然在IndexScanExecutor中过滤
+            scan->tag = T_IndexScan;
+            scan->index_col_names_ = std::move(index_col_names);
+            return true;
+        }
+    }
+    return false;
+}
+
+std::shared_ptr<Plan> Planner::make_merge_join(std::shared_ptr<Plan> left, std::shared_ptr<Plan> right,
+                                               std::vector<Condition> conds) {
+    // 等值的列比较条件是连接键，lhs_col在左表，rhs_col在右表
+    std::vector<Condition> keys;
+    std::vector<Condition> residual;
+    for (auto &cond : conds) {
+        if (!cond.is_rhs_val && cond.op == OP_EQ) {
+            keys.push_back(std::move(cond));
+        } else {
+            residual.push_back(std::move(cond));
+        }
+    }
+    auto reorder_keys = [&keys](const std::vector<size_t> &perm) {
+        std::vector<Condition> reordered;
+        for (auto pos : perm) {
+            reordered.push_back(keys[pos]);
+        }
+        keys = std::move(reordered);
+    };
+    auto key_cols = [&keys](bool lhs) {
+        std::vector<TabCol> cols;
+        for (auto &cond : keys) {
+            cols.push_back(lhs ? cond.lhs_col : cond.rhs_col);
+        }
+        return cols;
+    };
+    // 连接键的顺序由先找到有序输入的一侧决定，另一侧必须按同样的顺序有序才能跳过排序
+    std::vector<size_t> perm;
+    bool left_ordered = order_by_index(left, key_cols(true), true, perm);
+    if (left_ordered) {
+        reorder_keys(perm);
+    }
+    bool right_ordered = order_by_index(right, key_cols(false), !left_ordered, perm);
+    if (right_ordered && !left_ordered) {
+        reorder_keys(perm);
+    }
+    keys.insert(keys.end(), residual.begin(), residual.end());
+    auto join = std::make_shared<JoinPlan>(T_SortMerge, std::move(left), std::move(right), std::move(keys));
+    join->left_ordered_ = left_ordered;
+    join->right_ordered_ = right_ordered;
+    return join;
+}
+
 std::shared_ptr<Query> Planner::logical_optimization(std::shared_ptr<Query> query, Context *context) {
 
-    // TODO 实现逻辑优化规则
+    // 单表的分组聚合改写为扫描物化视图
+    rewrite_with_view(query);
 
     return query;
 }
 
+/**
+ * @description: 单表的分组聚合没有WHERE、HAVING和子查询条件，分组列与某个物化视图相同，选择列都能在视图中找到，
+ * ORDER BY（如果有）是分组列时，改为扫描视图表。投影列的别名取原查询的列名，输出的列标题不变
+ * @return {bool} 是否改写
+ * @param {shared_ptr<Query>} query 分析后的查询，改写时替换表、选择列，并清空分组列
+ */
+bool Planner::rewrite_with_view(const std::shared_ptr<Query> &query) {
+    auto x = std::dynamic_pointer_cast<ast::SelectStmt>(query->parse);
+    if (x == nullptr || query->tables.size() != 1 || query->group_cols.empty() || !query->conds.empty() ||
+        !query->sublinks.empty() || !query->having_conds.empty()) {
+        return false;
+    }
+    std::set<std::string> group_cols;
+    for (auto &group_col : query->group_cols) {
+        group_cols.insert(group_col.col_name);
+    }
+    for (auto &view_name : sm_manager_->get_views(query->tables.front())) {
+        TabMeta &view_tab = sm_manager_->db_.get_table(view_name);
+        const ViewMeta &view = view_tab.view;
+        // 视图表中与col相同的列，没有NULL，COUNT(col)和COUNT(*)相同
+        auto find_col = [&view](const TabCol &col) {
+            for (size_t i = 0; i < view.src_cols.size(); i++) {
+                if (view.aggrs[i] == col.aggr &&
+                    (view.src_cols[i] == col.col_name || col.aggr == ast::AGGR_TYPE_COUNT)) {
+                    return (int)i;
+                }
+            }
+            return -1;
+        };
+        std::set<std::string> view_group_cols;
+        for (size_t i = 0; i < view.src_cols.size(); i++) {
+            if (view.aggrs[i] == ast::NO_AGGR) {
+                view_group_cols.insert(view.src_cols[i]);
+            }
+        }
+        if (view_group_cols != group_cols) {
+            continue;
+        }
+        std::vector<TabCol> cols;
+        for (auto &sel_col : query->cols) {
+            int pos = find_col(sel_col);
+            if (pos < 0) {
+                break;
+            }
+            cols.push_back({.tab_name = view_name,
+                            .col_name = view_tab.cols[pos].name,
+                            .alias = sel_col.alias.empty() ? sel_col.col_name : sel_col.alias,
+                            .aggr = ast::NO_AGGR});
+        }
+        int order_pos = 0;
+        if (x->has_sort) {
+            auto &order_col = x->order->cols;
+            order_pos = order_col->aggr_type == ast::NO_AGGR && group_cols.count(order_col->col_name) > 0
+                            ? find_col({.tab_name = "", .col_name = order_col->col_name, .aggr = ast::NO_AGGR})
+                            : -1;
+        }
+        if (cols.size() != query->cols.size() || order_pos < 0) {
+            continue;
+        }
+        if (x->has_sort) {
+            x->order->cols->tab_name = view_name;
+            x->order->cols->col_name = view_tab.cols[order_pos].name;
+        }
+        query->tables = {view_name};
+        query->cols = std::move(cols);
+        query->group_cols.clear();
+        query->has_aggr = false;
+        return true;
+    }
+    return false;
+}
+
 std::shared_ptr<Plan> Planner::physical_optimization(std::shared_ptr<Query> query, Context *context) {
     std::shared_ptr<Plan> plan = make_one_rel(query);
 
+    // 处理子查询
+    plan = make_semi_joins(query, std::move(plan), context);
+
     // 其他物理优化
 
     // 处理 aggregation 和 groupby
@@ -243,17 +497,7 @@ std::shared_ptr<Plan> Planner::make_one_rel(std::shared_ptr<Query> query) {
     std::vector<std::shared_ptr<Plan>> table_scan_executors(tables.size());
     for (size_t i = 0; i < tables.size(); i++) {
         auto curr_conds = pop_conds(query->conds, tables[i]);
-        // int index_no = get_indexNo(tables[i], curr_conds);
-        std::vector<std::string> index_col_names;
-        bool index_exist = get_index_cols(tables[i], curr_conds, index_col_names);
-        if (index_exist == false) { // 该表没有索引
-            index_col_names.clear();
-            table_scan_executors[i] =
-                std::make_shared<ScanPlan>(T_SeqScan, sm_manager_, tables[i], curr_conds, index_col_names);
-        } else { // 存在索引
-            table_scan_executors[i] =
-                std::make_shared<ScanPlan>(T_IndexScan, sm_manager_, tables[i], curr_conds, index_col_names);
-        }
+        table_scan_executors[i] = make_scan_plan(tables[i], std::move(curr_conds));
     }
     // 只有一个表，不需要join。
     if (tables.size() == 1) {
@@ -295,28 +539,21 @@ std::shared_ptr<Plan> Planner::make_one_rel(std::shared_ptr<Query> query) {
                 table_join_executors =
                     std::make_shared<JoinPlan>(T_NestLoop, std::move(left), std::move(right), join_conds);
             } else if (enable_sortmerge_join) {
-                std::vector<std::string> left_index_col_name;
-                std::vector<std::string> right_index_col_name;
-                // TODO: 临时fix，后续去除
-                bool left_index_exist = get_index_cols(it->lhs_col.tab_name, join_conds, left_index_col_name);
-                std::swap(it->lhs_col, it->rhs_col);
-                std::swap(join_conds[0].lhs_col, join_conds[0].rhs_col);
-                bool right_index_exist = get_index_cols(it->lhs_col.tab_name, join_conds, right_index_col_name);
-                std::swap(it->lhs_col, it->rhs_col);
-                std::swap(join_conds[0].lhs_col, join_conds[0].rhs_col);
-                if (left_index_exist && right_index_exist) {
-                    std::vector<Condition> empty;
-                    left = std::make_shared<ScanPlan>(T_IndexScan, sm_manager_, it->lhs_col.tab_name, empty,
-                                                      left_index_col_name);
-                    right = std::make_shared<ScanPlan>(T_IndexScan, sm_manager_, it->rhs_col.tab_name, empty,
-                                                       right_index_col_name);
-                    table_join_executors =
-                        std::make_shared<JoinPlan>(T_SortMergeWithIndex, std::move(left), std::move(right), join_conds);
-                } else {
-                    table_join_executors =
-                        std::make_shared<JoinPlan>(T_SortMerge, std::move(left), std::move(right), join_conds);
+                // 同一对表之间的其他条件一起交给merge join：等值条件作为多列连接键，其余条件在连接后过滤
+                for (auto jt = std::next(it); jt != conds.end();) {
+                    if (!jt->is_rhs_val && jt->lhs_col.tab_name == it->rhs_col.tab_name &&
+                        jt->rhs_col.tab_name == it->lhs_col.tab_name) {
+                        swap_cond(*jt);
+                    }
+                    if (!jt->is_rhs_val && jt->lhs_col.tab_name == it->lhs_col.tab_name &&
+                        jt->rhs_col.tab_name == it->rhs_col.tab_name) {
+                        join_conds.push_back(std::move(*jt));
+                        jt = conds.erase(jt);
+                    } else {
+                        jt++;
+                    }
                 }
-                assert(left_index_exist == right_index_exist);
+                table_join_executors = make_merge_join(std::move(left), std::move(right), std::move(join_conds));
             } else {
                 // error
                 throw RMDBError("No join executor selected!");
@@ -385,6 +622,65 @@ std::shared_ptr<Plan> Planner::make_one_rel(std::shared_ptr<Query> query) {
     return table_join_executors;
 }
 
+/**
+ * @description: 每个子查询条件在plan之上加一个半连接/反连接，子查询只执行一次。
+ * 能对外层记录逐条做索引探查，且外层记录数乘以B+树的高度小于子查询表的记录数时用索引探查，
+ * 否则执行子查询构建哈希表
+ */
+std::shared_ptr<Plan> Planner::make_semi_joins(const std::shared_ptr<Query> &query, std::shared_ptr<Plan> plan,
+                                               Context *context) {
+    for (auto &sublink : query->sublinks) {
+        auto &subquery = sublink.subquery;
+        std::vector<std::string> index_col_names;
+        if (!sublink.lhs_col.col_name.empty() && get_probe_index(*subquery, index_col_names)) {
+            const std::string &sub_tab = subquery->tables[0];
+            double inner_rows = sm_manager_->fhs_.at(sub_tab)->get_num_records();
+            double outer_rows = estimate_rows(plan);
+            if (outer_rows * (std::log2(inner_rows + 1) + 1) < inner_rows) {
+                auto probe =
+                    std::make_shared<ScanPlan>(T_IndexScan, sm_manager_, sub_tab, subquery->conds, index_col_names);
+                plan = std::make_shared<SemiJoinPlan>(T_IndexSemiJoin, std::move(plan), std::move(probe),
+                                                      sublink.lhs_col, sublink.is_anti);
+                continue;
+            }
+        }
+        auto sub_plan = generate_select_plan(subquery, context);
+        plan = std::make_shared<SemiJoinPlan>(T_SemiJoin, std::move(plan), std::move(sub_plan), sublink.lhs_col,
+                                              sublink.is_anti);
+    }
+    return plan;
+}
+
+/**
+ * @description: 子查询是单表上不带聚合、LIMIT和嵌套子查询的SELECT col，且col是该表某个索引的第一列
+ */
+bool Planner::get_probe_index(const Query &subquery, std::vector<std::string> &index_col_names) {
+    if (subquery.tables.size() != 1 || subquery.has_aggr || !subquery.group_cols.empty() || subquery.limit >= 0 ||
+        !subquery.sublinks.empty()) {
+        return false;
+    }
+    const TabCol &sel_col = subquery.cols[0];
+    for (auto &index : sm_manager_->db_.get_table(subquery.tables[0]).indexes) {
+        if (index.cols[0].name == sel_col.col_name) {
+            index_col_names.clear();
+            for (auto &col : index.cols) {
+                index_col_names.push_back(col.name);
+            }
+            return true;
+        }
+    }
+    return false;
+}
+
+size_t Planner::estimate_rows(const std::shared_ptr<Plan> &plan) {
+    if (auto x = std::dynamic_pointer_cast<SemiJoinPlan>(plan)) {
+        return estimate_rows(x->left_);
+    } else if (auto x = std::dynamic_pointer_cast<ScanPlan>(plan)) {
+        return sm_manager_->fhs_.at(x->tab_name_)->get_num_records();
+    }
+    return SIZE_MAX;
+}
+
 std::shared_ptr<Plan> Planner::generate_sort_plan(std::shared_ptr<Query> query, std::shared_ptr<Plan> plan) {
     auto x = std::dynamic_pointer_cast<ast::SelectStmt>(query->parse);
     if (!x->has_sort) {
@@ -402,7 +698,19 @@ std::shared_ptr<Plan> Planner::generate_sort_plan(std::shared_ptr<Query> query,
         if (col.name.compare(x->order->cols->col_name) == 0)
             sel_col = {.tab_name = col.tab_name, .col_name = col.name};
     }
-    return std::make_shared<SortPlan>(T_Sort, std::move(plan), sel_col, x->order->orderby_dir == ast::OrderBy_DESC);
+    bool is_desc = x->order->orderby_dir == ast::OrderBy_DESC;
+    std::vector<size_t> perm;
+    if (!is_desc && match_order(get_plan_order(plan), {sel_col}, false, perm)) {
+        // 输入已经按排序列升序输出，不需要再排序
+        return plan;
+    }
+    auto scan = std::dynamic_pointer_cast<ScanPlan>(plan);
+    if (!is_desc && query->limit >= 0 && scan != nullptr && scan->tag == T_SeqScan &&
+        order_by_index(plan, {sel_col}, false, perm)) {
+        // 带LIMIT时改为按索引顺序扫描，读出前limit + offset条记录就可以结束，不需要排序
+        return plan;
+    }
+    return std::make_shared<SortPlan>(T_Sort, std::move(plan), sel_col, is_desc);
 }
 
 std::shared_ptr<Plan> Planner::generate_aggregation_group_plan(std::shared_ptr<Query> query,
@@ -411,6 +719,13 @@ std::shared_ptr<Plan> Planner::generate_aggregation_group_plan(std::shared_ptr<Q
     if (!query->has_aggr && query->group_cols.empty()) {
         return plan;
     }
+    auto scan = std::dynamic_pointer_cast<ScanPlan>(plan);
+    if (scan != nullptr && IndexAggregationExecutor::supported(sm_manager_, scan->tab_name_, scan->conds_, query->cols,
+                                                               query->group_cols, query->having_conds)) {
+        // MIN/MAX通过一次索引探查得到，COUNT直接读表的记录数，不再扫描
+        return std::make_shared<AggregationPlan>(T_IndexAggregation, std::move(plan), query->cols,
+                                                 query->group_cols, query->having_conds);
+    }
     return std::make_shared<AggregationPlan>(T_Aggregation, std::move(plan), query->cols, query->group_cols,
                                              query->having_conds);
 }
@@ -430,6 +745,9 @@ std::shared_ptr<Plan> Planner::generate_select_plan(std::shared_ptr<Query> query
     auto sel_cols = query->cols;
     std::shared_ptr<Plan> plannerRoot = physical_optimization(query, context);
     plannerRoot = std::make_shared<ProjectionPlan>(T_Projection, std::move(plannerRoot), std::move(sel_cols));
+    if (query->limit >= 0) {
+        plannerRoot = std::make_shared<LimitPlan>(T_Limit, std::move(plannerRoot), query->limit, query->offset);
+    }
 
     return plannerRoot;
 }
@@ -450,11 +768,24 @@ std::shared_ptr<Plan> Planner::do_planner(std::shared_ptr<Query> query, Context
                 throw InternalError("Unexpected field type");
             }
         }
-        plannerRoot = std::make_shared<DDLPlan>(T_CreateTable, x->tab_name, std::vector<std::string>(), col_defs);
+        auto ddl_plan = std::make_shared<DDLPlan>(T_CreateTable, x->tab_name, std::vector<std::string>(), col_defs);
+        ddl_plan->temporary_ = x->temporary;
+        ddl_plan->partition_ = query->partition;
+        plannerRoot = ddl_plan;
     } else if (auto x = std::dynamic_pointer_cast<ast::DropTable>(query->parse)) {
         // drop table;
         plannerRoot =
             std::make_shared<DDLPlan>(T_DropTable, x->tab_name, std::vector<std::string>(), std::vector<ColDef>());
+    } else if (auto x = std::dynamic_pointer_cast<ast::CreateView>(query->parse)) {
+        // create materialized view;
+        auto ddl_plan =
+            std::make_shared<DDLPlan>(T_CreateView, x->view_name, std::vector<std::string>(), std::vector<ColDef>());
+        ddl_plan->view_ = query->view;
+        plannerRoot = ddl_plan;
+    } else if (auto x = std::dynamic_pointer_cast<ast::DropView>(query->parse)) {
+        // drop materialized view;
+        plannerRoot =
+            std::make_shared<DDLPlan>(T_DropView, x->view_name, std::vector<std::string>(), std::vector<ColDef>());
     } else if (auto x = std::dynamic_pointer_cast<ast::CreateIndex>(query->parse)) {
         // create index;
         plannerRoot = std::make_shared<DDLPlan>(T_CreateIndex, x->tab_name, x->col_names, std::vector<ColDef>());
@@ -471,41 +802,17 @@ std::shared_ptr<Plan> Planner::do_planner(std::shared_ptr<Query> query, Context
                                                 std::vector<Condition>(), std::vector<SetClause>());
     } else if (auto x = std::dynamic_pointer_cast<ast::DeleteStmt>(query->parse)) {
         // delete;
-        // 生成表扫描方式
-        std::shared_ptr<Plan> table_scan_executors;
-        // 只有一张表，不需要进行物理优化了
-        // int index_no = get_indexNo(x->tab_name, query->conds);
-        std::vector<std::string> index_col_names;
-        bool index_exist = get_index_cols(x->tab_name, query->conds, index_col_names);
-
-        if (index_exist == false) { // 该表没有索引
-            index_col_names.clear();
-            table_scan_executors =
-                std::make_shared<ScanPlan>(T_SeqScan, sm_manager_, x->tab_name, query->conds, index_col_names);
-        } else { // 存在索引
-            table_scan_executors =
-                std::make_shared<ScanPlan>(T_IndexScan, sm_manager_, x->tab_name, query->conds, index_col_names);
-        }
+        // 生成表扫描方式，只有一张表，不需要进行物理优化了
+        std::shared_ptr<Plan> table_scan_executors =
+            make_semi_joins(query, make_scan_plan(x->tab_name, query->conds), context);
 
         plannerRoot = std::make_shared<DMLPlan>(T_Delete, table_scan_executors, x->tab_name, std::vector<Value>(),
                                                 query->conds, std::vector<SetClause>());
     } else if (auto x = std::dynamic_pointer_cast<ast::UpdateStmt>(query->parse)) {
         // update;
-        // 生成表扫描方式
-        std::shared_ptr<Plan> table_scan_executors;
-        // 只有一张表，不需要进行物理优化了
-        // int index_no = get_indexNo(x->tab_name, query->conds);
-        std::vector<std::string> index_col_names;
-        bool index_exist = get_index_cols(x->tab_name, query->conds, index_col_names);
-
-        if (index_exist == false) { // 该表没有索引
-            index_col_names.clear();
-            table_scan_executors =
-                std::make_shared<ScanPlan>(T_SeqScan, sm_manager_, x->tab_name, query->conds, index_col_names);
-        } else { // 存在索引
-            table_scan_executors =
-                std::make_shared<ScanPlan>(T_IndexScan, sm_manager_, x->tab_name, query->conds, index_col_names);
-        }
+        // 生成表扫描方式，只有一张表，不需要进行物理优化了
+        std::shared_ptr<Plan> table_scan_executors =
+            make_semi_joins(query, make_scan_plan(x->tab_name, query->conds), context);
         plannerRoot = std::make_shared<DMLPlan>(T_Update, table_scan_executors, x->tab_name, std::vector<Value>(),
                                                 query->conds, query->set_clauses);
     } else if (auto x = std::dynamic_pointer_cast<ast::SelectStmt>(query->parse)) {
@@ -514,6 +821,8 @@ std::shared_ptr<Plan> Planner::do_planner(std::shared_ptr<Query> query, Context
         // 生成select语句的查询执行计划
         // DML
         //  |
+        // (Limit)
+        //  |
         // Projection
         //  |
         // (Join)
@@ -51,8 +51,32 @@ class Planner {
     std::shared_ptr<Query> logical_optimization(std::shared_ptr<Query> query, Context *context);
     std::shared_ptr<Plan> physical_optimization(std::shared_ptr<Query> query, Context *context);
 
+    // 用匹配的物化视图回答单表的分组聚合，改写为扫描视图表
+    bool rewrite_with_view(const std::shared_ptr<Query> &query);
+
     std::shared_ptr<Plan> make_one_rel(std::shared_ptr<Query> query);
 
+    // 生成merge join，输入能按连接键有序输出时不再排序
+    std::shared_ptr<Plan> make_merge_join(std::shared_ptr<Plan> left, std::shared_ptr<Plan> right,
+                                          std::vector<Condition> conds);
+
+    // 计划的输出顺序，返回空表示无序
+    std::vector<TabCol> get_plan_order(const std::shared_ptr<Plan> &plan);
+
+    // 尝试让plan按keys有序输出，必要时把扫描换成索引扫描
+    bool order_by_index(const std::shared_ptr<Plan> &plan, const std::vector<TabCol> &keys, bool allow_reorder,
+                        std::vector<size_t> &perm);
+
+    // 把IN/EXISTS子查询规划成plan之上的半连接/反连接
+    std::shared_ptr<Plan> make_semi_joins(const std::shared_ptr<Query> &query, std::shared_ptr<Plan> plan,
+                                          Context *context);
+
+    // 子查询能否对外层记录逐条做索引探查，能则返回所用索引的列名
+    bool get_probe_index(const Query &subquery, std::vector<std::string> &index_col_names);
+
+    // 估计plan输出的记录数的上界，无法估计时返回SIZE_MAX
+    size_t estimate_rows(const std::shared_ptr<Plan> &plan);
+
     std::shared_ptr<Plan> generate_sort_plan(std::shared_ptr<Query> query, std::shared_ptr<Plan> plan);
 
     std::shared_ptr<Plan> generate_aggregation_group_plan(std::shared_ptr<Query> query, std::shared_ptr<Plan> plan);
@@ -63,6 +87,9 @@ class Planner {
     bool get_index_cols(std::string tab_name, std::vector<Condition> &curr_conds,
                         std::vector<std::string> &index_col_names);
 
+    // 为单表上的条件选择扫描方式：索引扫描、OR条件的Rid合并或顺序扫描
+    std::shared_ptr<ScanPlan> make_scan_plan(const std::string &tab_name, std::vector<Condition> conds);
+
     ColType interp_sv_type(ast::SvType sv_type) {
         std::map<ast::SvType, ColType> m = {{ast::SV_TYPE_INT, TYPE_INT},
                                             {ast::SV_TYPE_FLOAT, TYPE_FLOAT},
@@ -18,14 +18,30 @@ namespace ast {
 
 enum SvType { SV_TYPE_INT, SV_TYPE_FLOAT, SV_TYPE_STRING, SV_TYPE_BOOL, SV_TYPE_DATE };
 
-enum SvCompOp { SV_OP_EQ, SV_OP_NE, SV_OP_LT, SV_OP_GT, SV_OP_LE, SV_OP_GE };
+enum SvCompOp {
+    SV_OP_EQ,
+    SV_OP_NE,
+    SV_OP_LT,
+    SV_OP_GT,
+    SV_OP_LE,
+    SV_OP_GE,
+    SV_OP_IN,
+    SV_OP_OR,
+    SV_OP_NOT_IN,
+    SV_OP_EXISTS,
+    SV_OP_NOT_EXISTS
+};
+
+enum SvArithOp { SV_ARITH_ADD, SV_ARITH_SUB, SV_ARITH_MUL, SV_ARITH_DIV };
 
 enum OrderByDir { OrderBy_DEFAULT, OrderBy_ASC, OrderBy_DESC };
 
-enum SetKnobType { EnableNestLoop, EnableSortMerge };
+enum SetKnobType { EnableNestLoop, EnableSortMerge, EnableTrace };
 
 enum AggregationType { NO_AGGR, AGGR_TYPE_COUNT, AGGR_TYPE_MAX, AGGR_TYPE_MIN, AGGR_TYPE_SUM };
 
+enum SvPartitionType { SV_PARTITION_RANGE, SV_PARTITION_HASH };
+
 // Base class for tree nodes
 struct TreeNode {
     virtual ~TreeNode() = default; // enable polymorphism
@@ -35,6 +51,12 @@ struct Help : public TreeNode {};
 
 struct ShowTables : public TreeNode {};
 
+struct DumpTrace : public TreeNode {};
+
+struct ShowBufferPool : public TreeNode {};
+
+struct ResetBufferPool : public TreeNode {};
+
 struct TxnBegin : public TreeNode {};
 
 struct TxnCommit : public TreeNode {};
@@ -62,12 +84,18 @@ struct ColDef : public Field {
     }
 };
 
+struct PartitionDef;
+
 struct CreateTable : public TreeNode {
     std::string tab_name;
     std::vector<std::shared_ptr<Field>> fields;
+    bool temporary;                          // CREATE TEMPORARY TABLE
+    std::shared_ptr<PartitionDef> partition; // PARTITION BY子句，没有时为nullptr
 
-    CreateTable(std::string tab_name_, std::vector<std::shared_ptr<Field>> fields_)
-        : tab_name(std::move(tab_name_)), fields(std::move(fields_)) {
+    CreateTable(std::string tab_name_, std::vector<std::shared_ptr<Field>> fields_, bool temporary_ = false,
+                std::shared_ptr<PartitionDef> partition_ = nullptr)
+        : tab_name(std::move(tab_name_)), fields(std::move(fields_)), temporary(temporary_),
+          partition(std::move(partition_)) {
     }
 };
 
@@ -149,6 +177,26 @@ struct DateLit : public Value {
     }
 };
 
+// PARTITION BY RANGE (col) (PARTITION p VALUES LESS THAN (v), ...)或PARTITION BY HASH (col) PARTITIONS n
+struct PartitionDef : public TreeNode {
+    SvPartitionType type;
+    std::string col_name;
+    int num_partitions = 0;                     // HASH分区的分区数
+    std::vector<std::string> names;             // RANGE分区各分区的名称
+    std::vector<std::shared_ptr<Value>> bounds; // RANGE分区各分区的上界，nullptr表示MAXVALUE
+
+    PartitionDef(SvPartitionType type_) : type(type_) {
+    }
+};
+
+// IN (v1, v2, ...)的右侧
+struct ValueList : public Expr {
+    std::vector<std::shared_ptr<Value>> vals;
+
+    ValueList(std::vector<std::shared_ptr<Value>> vals_) : vals(std::move(vals_)) {
+    }
+};
+
 struct Col : public Expr {
     std::string tab_name;
     std::string col_name;
@@ -162,11 +210,22 @@ struct Col : public Expr {
     }
 };
 
+// lhs op rhs，两侧是常量、列或算术表达式
+struct ArithExpr : public Expr {
+    std::shared_ptr<Expr> lhs;
+    SvArithOp op;
+    std::shared_ptr<Expr> rhs;
+
+    ArithExpr(std::shared_ptr<Expr> lhs_, SvArithOp op_, std::shared_ptr<Expr> rhs_)
+        : lhs(std::move(lhs_)), op(op_), rhs(std::move(rhs_)) {
+    }
+};
+
 struct SetClause : public TreeNode {
     std::string col_name;
-    std::shared_ptr<Value> val;
+    std::shared_ptr<Expr> val; // 常量、列或算术表达式
 
-    SetClause(std::string col_name_, std::shared_ptr<Value> val_)
+    SetClause(std::string col_name_, std::shared_ptr<Expr> val_)
         : col_name(std::move(col_name_)), val(std::move(val_)) {
     }
 };
@@ -176,9 +235,16 @@ struct BinaryExpr : public TreeNode {
     SvCompOp op;
     std::shared_ptr<Expr> rhs;
 
+    // op为SV_OP_OR时lhs和rhs为空，任意一个分支内的条件全部成立即可
+    // op为SV_OP_EXISTS/SV_OP_NOT_EXISTS时lhs为空，rhs是子查询
+    std::vector<std::vector<std::shared_ptr<BinaryExpr>>> disjuncts;
+
     BinaryExpr(std::shared_ptr<Col> lhs_, SvCompOp op_, std::shared_ptr<Expr> rhs_)
         : lhs(std::move(lhs_)), op(op_), rhs(std::move(rhs_)) {
     }
+    BinaryExpr(std::vector<std::vector<std::shared_ptr<BinaryExpr>>> disjuncts_)
+        : op(SV_OP_OR), disjuncts(std::move(disjuncts_)) {
+    }
 };
 
 struct OrderBy : public TreeNode {
@@ -200,6 +266,15 @@ struct GroupBy : public TreeNode {
     }
 };
 
+// LIMIT limit OFFSET offset
+struct Limit : public TreeNode {
+    int limit;
+    int offset;
+
+    Limit(int limit_, int offset_) : limit(limit_), offset(offset_) {
+    }
+};
+
 struct InsertStmt : public TreeNode {
     std::string tab_name;
     std::vector<std::shared_ptr<Value>> vals;
@@ -249,16 +324,42 @@ struct SelectStmt : public TreeNode {
     bool has_sort;
     std::shared_ptr<OrderBy> order;
     std::shared_ptr<GroupBy> group;
+    std::shared_ptr<Limit> limit;
 
     SelectStmt(std::vector<std::shared_ptr<Col>> cols_, std::vector<std::string> tabs_,
                std::vector<std::shared_ptr<BinaryExpr>> conds_, std::shared_ptr<OrderBy> order_,
-               std::shared_ptr<GroupBy> group_)
+               std::shared_ptr<GroupBy> group_, std::shared_ptr<Limit> limit_ = nullptr)
         : cols(std::move(cols_)), tabs(std::move(tabs_)), conds(std::move(conds_)), group(std::move(group_)),
-          order(std::move(order_)) {
+          order(std::move(order_)), limit(std::move(limit_)) {
         has_sort = (bool)order;
     }
 };
 
+// IN (SELECT ...)和EXISTS (SELECT ...)的右侧，只支持不相关子查询
+struct SubQuery : public Expr {
+    std::shared_ptr<SelectStmt> stmt;
+
+    SubQuery(std::shared_ptr<SelectStmt> stmt_) : stmt(std::move(stmt_)) {
+    }
+};
+
+// CREATE MATERIALIZED VIEW view_name AS SELECT ...，只支持单表的分组聚合
+struct CreateView : public TreeNode {
+    std::string view_name;
+    std::shared_ptr<SelectStmt> select;
+
+    CreateView(std::string view_name_, std::shared_ptr<SelectStmt> select_)
+        : view_name(std::move(view_name_)), select(std::move(select_)) {
+    }
+};
+
+struct DropView : public TreeNode {
+    std::string view_name;
+
+    DropView(std::string view_name_) : view_name(std::move(view_name_)) {
+    }
+};
+
 // set enable_nestloop
 struct SetStmt : public TreeNode {
     SetKnobType set_knob_type_;
@@ -268,6 +369,14 @@ struct SetStmt : public TreeNode {
     }
 };
 
+// explain analyze <dml>
+struct ExplainStmt : public TreeNode {
+    std::shared_ptr<TreeNode> stmt;
+
+    ExplainStmt(std::shared_ptr<TreeNode> stmt_) : stmt(std::move(stmt_)) {
+    }
+};
+
 // Semantic value
 struct SemValue {
     int sv_int; // int and date
@@ -288,6 +397,8 @@ struct SemValue {
     std::shared_ptr<Field> sv_field;
     std::vector<std::shared_ptr<Field>> sv_fields;
 
+    std::shared_ptr<PartitionDef> sv_partition;
+
     std::shared_ptr<Expr> sv_expr;
 
     std::shared_ptr<Value> sv_val;
@@ -306,6 +417,10 @@ struct SemValue {
 
     std::shared_ptr<GroupBy> sv_groupby;
 
+    std::shared_ptr<Limit> sv_limit;
+
+    std::shared_ptr<SelectStmt> sv_select;
+
     SetKnobType sv_setKnobType;
 };
 
@@ -50,10 +50,18 @@ class TreePrinter {
     static std::string op2str(SvCompOp op) {
         static std::map<SvCompOp, std::string> m{
             {SV_OP_EQ, "=="}, {SV_OP_NE, "!="}, {SV_OP_LT, "<"}, {SV_OP_GT, ">"}, {SV_OP_LE, "<="}, {SV_OP_GE, ">="},
+            {SV_OP_IN, "IN"}, {SV_OP_OR, "OR"}, {SV_OP_NOT_IN, "NOT IN"}, {SV_OP_EXISTS, "EXISTS"},
+            {SV_OP_NOT_EXISTS, "NOT EXISTS"},
         };
         return m.at(op);
     }
 
+    static std::string arith_op2str(SvArithOp op) {
+        static std::map<SvArithOp, std::string> m{
+            {SV_ARITH_ADD, "+"}, {SV_ARITH_SUB, "-"}, {SV_ARITH_MUL, "*"}, {SV_ARITH_DIV, "/"}};
+        return m.at(op);
+    }
+
     template <typename T> static void print_node_list(std::vector<T> nodes, int offset) {
         std::cout << offset2string(offset);
         offset += 2;
@@ -71,9 +79,26 @@ class TreePrinter {
         } else if (auto x = std::dynamic_pointer_cast<ShowTables>(node)) {
             std::cout << "SHOW_TABLES\n";
         } else if (auto x = std::dynamic_pointer_cast<CreateTable>(node)) {
-            std::cout << "CREATE_TABLE\n";
+            std::cout << (x->temporary ? "CREATE_TEMPORARY_TABLE\n" : "CREATE_TABLE\n");
             print_val(x->tab_name, offset);
             print_node_list(x->fields, offset);
+            if (x->partition != nullptr) {
+                print_node(x->partition, offset);
+            }
+        } else if (auto x = std::dynamic_pointer_cast<PartitionDef>(node)) {
+            std::cout << (x->type == SV_PARTITION_HASH ? "PARTITION_BY_HASH\n" : "PARTITION_BY_RANGE\n");
+            print_val(x->col_name, offset);
+            if (x->type == SV_PARTITION_HASH) {
+                print_val(x->num_partitions, offset);
+            }
+            for (size_t i = 0; i < x->names.size(); i++) {
+                print_val(x->names[i], offset);
+                if (x->bounds[i] != nullptr) {
+                    print_node(x->bounds[i], offset);
+                } else {
+                    print_val("MAXVALUE", offset);
+                }
+            }
         } else if (auto x = std::dynamic_pointer_cast<DropTable>(node)) {
             std::cout << "DROP_TABLE\n";
             print_val(x->tab_name, offset);
@@ -113,13 +138,35 @@ class TreePrinter {
         } else if (auto x = std::dynamic_pointer_cast<StringLit>(node)) {
             std::cout << "STRING_LIT\n";
             print_val(x->val, offset);
+        } else if (auto x = std::dynamic_pointer_cast<ArithExpr>(node)) {
+            std::cout << "ARITH_EXPR\n";
+            print_node(x->lhs, offset);
+            print_val(arith_op2str(x->op), offset);
+            print_node(x->rhs, offset);
         } else if (auto x = std::dynamic_pointer_cast<SetClause>(node)) {
             std::cout << "SET_CLAUSE\n";
             print_val(x->col_name, offset);
             print_node(x->val, offset);
+        } else if (auto x = std::dynamic_pointer_cast<ValueList>(node)) {
+            std::cout << "VALUE_LIST\n";
+            for (auto &val : x->vals) {
+                print_node(val, offset);
+            }
+        } else if (auto x = std::dynamic_pointer_cast<SubQuery>(node)) {
+            std::cout << "SUBQUERY\n";
+            print_node(x->stmt, offset);
         } else if (auto x = std::dynamic_pointer_cast<BinaryExpr>(node)) {
             std::cout << "BINARY_EXPR\n";
-            print_node(x->lhs, offset);
+            if (x->op == SV_OP_OR) {
+                print_val(op2str(x->op), offset);
+                for (auto &conds : x->disjuncts) {
+                    print_node_list(conds, offset);
+                }
+                return;
+            }
+            if (x->lhs != nullptr) {
+                print_node(x->lhs, offset);
+            }
             print_val(op2str(x->op), offset);
             print_node(x->rhs, offset);
         } else if (auto x = std::dynamic_pointer_cast<InsertStmt>(node)) {
@@ -140,6 +187,29 @@ class TreePrinter {
             print_node_list(x->cols, offset);
             print_val_list(x->tabs, offset);
             print_node_list(x->conds, offset);
+            if (x->limit != nullptr) {
+                print_node(x->limit, offset);
+            }
+        } else if (auto x = std::dynamic_pointer_cast<CreateView>(node)) {
+            std::cout << "CREATE_MATERIALIZED_VIEW\n";
+            print_val(x->view_name, offset);
+            print_node(x->select, offset);
+        } else if (auto x = std::dynamic_pointer_cast<DropView>(node)) {
+            std::cout << "DROP_MATERIALIZED_VIEW\n";
+            print_val(x->view_name, offset);
+        } else if (auto x = std::dynamic_pointer_cast<Limit>(node)) {
+            std::cout << "LIMIT\n";
+            print_val(x->limit, offset);
+            print_val(x->offset, offset);
+        } else if (auto x = std::dynamic_pointer_cast<ExplainStmt>(node)) {
+            std::cout << "EXPLAIN_ANALYZE\n";
+            print_node(x->stmt, offset);
+        } else if (auto x = std::dynamic_pointer_cast<DumpTrace>(node)) {
+            std::cout << "DUMP_TRACE\n";
+        } else if (auto x = std::dynamic_pointer_cast<ShowBufferPool>(node)) {
+            std::cout << "SHOW_BUFFER_POOL\n";
+        } else if (auto x = std::dynamic_pointer_cast<ResetBufferPool>(node)) {
+            std::cout << "RESET_BUFFER_POOL\n";
         } else if (auto x = std::dynamic_pointer_cast<TxnBegin>(node)) {
             std::cout << "BEGIN\n";
         } else if (auto x = std::dynamic_pointer_cast<TxnCommit>(node)) {
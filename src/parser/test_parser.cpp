@@ -26,10 +26,24 @@ int main() {
         "insert into tb values (1, 3.14, 'pi');",
         "delete from tb where a = 1;",
         "update tb set a = 1, b = 2.2, c = 'xyz' where x = 2 and y < 1.1 and z > 'abc';",
+        "update tb set a = a + 1, b = (b - 2.5) * c / 4 where x = y-1 and z > -3;",
         "select * from tb;",
         "select * from tb where x <> 2 and y >= 3. and z <= '123' and b < tb.a;",
         "select x.a, y.b from x, y where x.a = y.b and c = d;",
         "select x.a, y.b from x join y where x.a = y.b and c = d;",
+        "select * from tb order by a limit 10;",
+        "select a from tb order by a desc limit 10 offset 20;",
+        "select a from tb limit 20, 10;",
+        "select * from tb where a in (1, 2, 3) and b = 1;",
+        "select * from tb where a = 1 or b = 2 and c = 3;",
+        "delete from tb where (a = 1 or b in (2, 3)) and c > 'x';",
+        "select * from tb where a in (select b from tc where c > 1) and not exists (select * from td);",
+        "delete from tb where a not in (select max(b) from tc) and exists (select a from tc);",
+        "explain analyze select * from tb where a = 1;",
+        "explain analyze delete from tb where a = 1;",
+        "dump trace;",
+        "show buffer pool;",
+        "reset buffer pool;",
         "exit;",
         "help;",
         "",
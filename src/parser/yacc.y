@@ -21,8 +21,8 @@ using namespace ast;
 %define parse.error verbose
 
 // keywords
-%token SHOW TABLES CREATE TABLE DROP DESC INSERT INTO VALUES DELETE FROM ASC ORDER GROUP BY HAVING
-WHERE UPDATE SET SELECT MAX MIN SUM COUNT AS INT CHAR FLOAT DATE INDEX AND JOIN EXIT HELP TXN_BEGIN TXN_COMMIT TXN_ABORT TXN_ROLLBACK ORDER_BY ENABLE_NESTLOOP ENABLE_SORTMERGE
+%token SHOW TABLES CREATE TABLE TEMPORARY PARTITION PARTITIONS RANGE HASH LESS THAN MAXVALUE MATERIALIZED VIEW DROP DESC INSERT INTO VALUES DELETE FROM ASC ORDER GROUP BY HAVING LIMIT OFFSET
+WHERE UPDATE SET SELECT MAX MIN SUM COUNT AS INT CHAR FLOAT DATE INDEX AND OR NOT IN EXISTS JOIN EXIT HELP TXN_BEGIN TXN_COMMIT TXN_ABORT TXN_ROLLBACK ORDER_BY ENABLE_NESTLOOP ENABLE_SORTMERGE EXPLAIN ANALYZE ENABLE_TRACE DUMP TRACE BUFFER POOL RESET
 // non-keywords
 %token LEQ NEQ GEQ T_EOF
 
@@ -37,10 +37,11 @@ WHERE UPDATE SET SELECT MAX MIN SUM COUNT AS INT CHAR FLOAT DATE INDEX AND JOIN
 %type <sv_node> stmt dbStmt ddl dml txnStmt setStmt
 %type <sv_field> field
 %type <sv_fields> fieldList
+%type <sv_partition> partitionClause rangePartitionList
 %type <sv_type_len> type
 %type <sv_comp_op> op
-%type <sv_expr> expr
-%type <sv_val> value
+%type <sv_expr> expr term factor
+%type <sv_val> value rangeBound
 %type <sv_vals> valueList
 %type <sv_str> tbName colName alias
 %type <sv_strs> tableList colNameList
@@ -49,9 +50,12 @@ WHERE UPDATE SET SELECT MAX MIN SUM COUNT AS INT CHAR FLOAT DATE INDEX AND JOIN
 %type <sv_set_clause> setClause
 %type <sv_set_clauses> setClauses
 %type <sv_cond> condition
-%type <sv_conds> whereClause optWhereClause
+%type <sv_conds> whereClause optWhereClause conjunction
 %type <sv_orderby>  order_clause opt_order_clause
 %type <sv_groupby>  opt_group_clause
+%type <sv_limit>  opt_limit_clause
+%type <sv_int> limitValue
+%type <sv_select> selectStmt
 %type <sv_orderby_dir> opt_asc_desc
 %type <sv_aggr_type> opt_aggregate
 %type <sv_setKnobType> set_knob_type
@@ -86,6 +90,10 @@ stmt:
     |   dml
     |   txnStmt
     |   setStmt
+    |   EXPLAIN ANALYZE dml
+    {
+        $$ = std::make_shared<ExplainStmt>($3);
+    }
     ;
 
 txnStmt:
@@ -112,6 +120,18 @@ dbStmt:
     {
         $$ = std::make_shared<ShowTables>();
     }
+    |   DUMP TRACE
+    {
+        $$ = std::make_shared<DumpTrace>();
+    }
+    |   SHOW BUFFER POOL
+    {
+        $$ = std::make_shared<ShowBufferPool>();
+    }
+    |   RESET BUFFER POOL
+    {
+        $$ = std::make_shared<ResetBufferPool>();
+    }
     ;
 
 setStmt:
@@ -126,10 +146,26 @@ ddl:
     {
         $$ = std::make_shared<CreateTable>($3, $5);
     }
+    |   CREATE TABLE tbName '(' fieldList ')' partitionClause
+    {
+        $$ = std::make_shared<CreateTable>($3, $5, false, $7);
+    }
+    |   CREATE TEMPORARY TABLE tbName '(' fieldList ')'
+    {
+        $$ = std::make_shared<CreateTable>($4, $6, true);
+    }
     |   DROP TABLE tbName
     {
         $$ = std::make_shared<DropTable>($3);
     }
+    |   CREATE MATERIALIZED VIEW tbName AS selectStmt
+    {
+        $$ = std::make_shared<CreateView>($4, $6);
+    }
+    |   DROP MATERIALIZED VIEW tbName
+    {
+        $$ = std::make_shared<DropView>($4);
+    }
     |   DESC tbName
     {
         $$ = std::make_shared<DescTable>($2);
@@ -161,9 +197,16 @@ dml:
     {
         $$ = std::make_shared<UpdateStmt>($2, $4, $5);
     }
-    |   SELECT selector FROM tableList optWhereClause opt_order_clause opt_group_clause
+    |   selectStmt
+    {
+        $$ = $1;
+    }
+    ;
+
+selectStmt:
+        SELECT selector FROM tableList optWhereClause opt_order_clause opt_group_clause opt_limit_clause
     {
-        $$ = std::make_shared<SelectStmt>($2, $4, $5, $6, $7);
+        $$ = std::make_shared<SelectStmt>($2, $4, $5, $6, $7, $8);
     }
     ;
 
@@ -178,6 +221,50 @@ fieldList:
     }
     ;
 
+partitionClause:
+        PARTITION BY RANGE '(' colName ')' '(' rangePartitionList ')'
+    {
+        $$ = $8;
+        $$->col_name = $5;
+    }
+    |   PARTITION BY HASH '(' colName ')' PARTITIONS VALUE_INT
+    {
+        $$ = std::make_shared<PartitionDef>(SV_PARTITION_HASH);
+        $$->col_name = $5;
+        $$->num_partitions = $8;
+    }
+    ;
+
+rangePartitionList:
+        PARTITION IDENTIFIER VALUES LESS THAN rangeBound
+    {
+        $$ = std::make_shared<PartitionDef>(SV_PARTITION_RANGE);
+        $$->names.push_back($2);
+        $$->bounds.push_back($6);
+    }
+    |   rangePartitionList ',' PARTITION IDENTIFIER VALUES LESS THAN rangeBound
+    {
+        $$->names.push_back($4);
+        $$->bounds.push_back($8);
+    }
+    ;
+
+// MAXVALUE表示没有上界
+rangeBound:
+        '(' value ')'
+    {
+        $$ = $2;
+    }
+    |   MAXVALUE
+    {
+        $$ = nullptr;
+    }
+    |   '(' MAXVALUE ')'
+    {
+        $$ = nullptr;
+    }
+    ;
+
 colNameList:
         colName
     {
@@ -235,6 +322,15 @@ value:
     {
         $$ = std::make_shared<FloatLit>($1);
     }
+    // 负号不属于数字字面量，否则a-1会被切分为a和-1
+    |   '-' VALUE_INT
+    {
+        $$ = std::make_shared<IntLit>(-$2);
+    }
+    |   '-' VALUE_FLOAT
+    {
+        $$ = std::make_shared<FloatLit>(-$2);
+    }
     |   VALUE_STRING
     {
         $$ = std::make_shared<StringLit>($1);
@@ -254,6 +350,26 @@ condition:
     {
         $$ = std::make_shared<BinaryExpr>($1, $2, $3);
     }
+    |   col IN '(' valueList ')'
+    {
+        $$ = std::make_shared<BinaryExpr>($1, SV_OP_IN, std::make_shared<ValueList>($4));
+    }
+    |   col IN '(' selectStmt ')'
+    {
+        $$ = std::make_shared<BinaryExpr>($1, SV_OP_IN, std::make_shared<SubQuery>($4));
+    }
+    |   col NOT IN '(' selectStmt ')'
+    {
+        $$ = std::make_shared<BinaryExpr>($1, SV_OP_NOT_IN, std::make_shared<SubQuery>($5));
+    }
+    |   EXISTS '(' selectStmt ')'
+    {
+        $$ = std::make_shared<BinaryExpr>(nullptr, SV_OP_EXISTS, std::make_shared<SubQuery>($3));
+    }
+    |   NOT EXISTS '(' selectStmt ')'
+    {
+        $$ = std::make_shared<BinaryExpr>(nullptr, SV_OP_NOT_EXISTS, std::make_shared<SubQuery>($4));
+    }
     ;
 
 optWhereClause:
@@ -264,15 +380,38 @@ optWhereClause:
     }
     ;
 
+// AND的优先级高于OR：whereClause是若干conjunction的逻辑或，conjunction是若干条件的逻辑与
 whereClause:
-        condition 
+        conjunction
+    |   whereClause OR conjunction
+    {
+        if ($1.size() == 1 && $1[0]->op == SV_OP_OR) {
+            $$ = $1;
+            $$[0]->disjuncts.push_back($3);
+        } else {
+            $$ = std::vector<std::shared_ptr<BinaryExpr>>{
+                std::make_shared<BinaryExpr>(std::vector<std::vector<std::shared_ptr<BinaryExpr>>>{$1, $3})};
+        }
+    }
+    ;
+
+conjunction:
+        condition
     {
         $$ = std::vector<std::shared_ptr<BinaryExpr>>{$1};
     }
-    |   whereClause AND condition
+    |   '(' whereClause ')'
+    {
+        $$ = $2;
+    }
+    |   conjunction AND condition
     {
         $$.push_back($3);
     }
+    |   conjunction AND '(' whereClause ')'
+    {
+        $$.insert($$.end(), $4.begin(), $4.end());
+    }
     ;
 
 col:
@@ -363,7 +502,32 @@ op:
     }
     ;
 
+// 算术表达式，*和/的优先级高于+和-，同级左结合
 expr:
+        term
+    |   expr '+' term
+    {
+        $$ = std::make_shared<ArithExpr>($1, SV_ARITH_ADD, $3);
+    }
+    |   expr '-' term
+    {
+        $$ = std::make_shared<ArithExpr>($1, SV_ARITH_SUB, $3);
+    }
+    ;
+
+term:
+        factor
+    |   term '*' factor
+    {
+        $$ = std::make_shared<ArithExpr>($1, SV_ARITH_MUL, $3);
+    }
+    |   term '/' factor
+    {
+        $$ = std::make_shared<ArithExpr>($1, SV_ARITH_DIV, $3);
+    }
+    ;
+
+factor:
         value
     {
         $$ = std::static_pointer_cast<Expr>($1);
@@ -372,6 +536,10 @@ expr:
     {
         $$ = std::static_pointer_cast<Expr>($1);
     }
+    |   '(' expr ')'
+    {
+        $$ = $2;
+    }
     ;
 
 setClauses:
@@ -386,7 +554,7 @@ setClauses:
     ;
 
 setClause:
-        colName '=' value
+        colName '=' expr
     {
         $$ = std::make_shared<SetClause>($1, $3);
     }
@@ -437,6 +605,32 @@ opt_group_clause:
     |   /* epsilon */ { /* ignore*/ }
     ;
 
+opt_limit_clause:
+    LIMIT limitValue
+    {
+        $$ = std::make_shared<Limit>($2, 0);
+    }
+    |   LIMIT limitValue OFFSET limitValue
+    {
+        $$ = std::make_shared<Limit>($2, $4);
+    }
+    |   LIMIT limitValue ',' limitValue
+    {
+        // MySQL写法：LIMIT offset, count
+        $$ = std::make_shared<Limit>($4, $2);
+    }
+    |   /* epsilon */ { /* ignore*/ }
+    ;
+
+// 负数在语法上允许，由analyze报告InvalidLimitError
+limitValue:
+        VALUE_INT
+    |   '-' VALUE_INT
+    {
+        $$ = -$2;
+    }
+    ;
+
 order_clause:
       col  opt_asc_desc 
     { 
@@ -459,6 +653,7 @@ opt_aggregate:
 set_knob_type:
     ENABLE_NESTLOOP { $$ = EnableNestLoop; }
     |   ENABLE_SORTMERGE { $$ = EnableSortMerge; }
+    |   ENABLE_TRACE { $$ = EnableTrace; }
     ;
 
 tbName: IDENTIFIER;
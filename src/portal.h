@@ -15,11 +15,18 @@ See the Mulan PSL v2 for more details. */
 #include "execution/executor_abstract.h"
 #include "execution/executor_aggregation.h"
 #include "execution/executor_delete.h"
+#include "execution/executor_gather.h"
+#include "execution/executor_index_aggregation.h"
 #include "execution/executor_index_scan.h"
+#include "execution/executor_index_semi_join.h"
+#include "execution/executor_index_union.h"
 #include "execution/executor_insert.h"
+#include "execution/executor_limit.h"
 #include "execution/executor_merge_join.h"
 #include "execution/executor_nestedloop_join.h"
+#include "execution/executor_parallel_aggregation.h"
 #include "execution/executor_projection.h"
+#include "execution/executor_semi_join.h"
 #include "execution/executor_seq_scan.h"
 #include "execution/executor_update.h"
 #include "optimizer/plan.h"
@@ -41,6 +48,7 @@ struct PortalStmt {
     std::vector<TabCol> sel_cols;
     std::unique_ptr<AbstractExecutor> root;
     std::shared_ptr<Plan> plan;
+    bool explain_analyze = false;
 
     PortalStmt(portalTag tag_, std::vector<TabCol> sel_cols_, std::unique_ptr<AbstractExecutor> root_,
                std::shared_ptr<Plan> plan_)
@@ -61,7 +69,11 @@ class Portal {
     // 将查询执行计划转换成对应的算子树
     std::shared_ptr<PortalStmt> start(std::shared_ptr<Plan> plan, Context *context) {
         // 这里可以将select进行拆分，例如：一个select，带有return的select等
-        if (auto x = std::dynamic_pointer_cast<OtherPlan>(plan)) {
+        if (auto x = std::dynamic_pointer_cast<ExplainPlan>(plan)) {
+            std::shared_ptr<PortalStmt> portal_stmt = start(x->subplan_, context);
+            portal_stmt->explain_analyze = true;
+            return portal_stmt;
+        } else if (auto x = std::dynamic_pointer_cast<OtherPlan>(plan)) {
             return std::make_shared<PortalStmt>(PORTAL_CMD_UTILITY, std::vector<TabCol>(),
                                                 std::unique_ptr<AbstractExecutor>(), plan);
         } else if (auto x = std::dynamic_pointer_cast<SetKnobPlan>(plan)) {
@@ -73,8 +85,13 @@ class Portal {
         } else if (auto x = std::dynamic_pointer_cast<DMLPlan>(plan)) {
             switch (x->tag) {
             case T_select: {
-                std::shared_ptr<ProjectionPlan> p = std::dynamic_pointer_cast<ProjectionPlan>(x->subplan_);
-                std::unique_ptr<AbstractExecutor> root = convert_plan_executor(p, context);
+                // 投影在最上层，或者在LIMIT之下
+                std::shared_ptr<Plan> top = x->subplan_;
+                if (auto limit = std::dynamic_pointer_cast<LimitPlan>(top)) {
+                    top = limit->subplan_;
+                }
+                std::shared_ptr<ProjectionPlan> p = std::dynamic_pointer_cast<ProjectionPlan>(top);
+                std::unique_ptr<AbstractExecutor> root = convert_plan_executor(x->subplan_, context);
                 return std::make_shared<PortalStmt>(PORTAL_ONE_SELECT, std::move(p->sel_cols_), std::move(root), plan);
             }
 
@@ -123,6 +140,10 @@ class Portal {
 
     // 遍历算子树并执行算子生成执行结果
     static void run(const std::shared_ptr<PortalStmt> &portal, QlManager *ql, txn_id_t *txn_id, Context *context) {
+        if (portal->explain_analyze) {
+            ql->explain_analyze(std::move(portal->root), portal->tag == PORTAL_ONE_SELECT, context);
+            return;
+        }
         switch (portal->tag) {
         case PORTAL_ONE_SELECT: {
             ql->select_from(std::move(portal->root), std::move(portal->sel_cols), context);
@@ -152,11 +173,31 @@ class Portal {
     }
 
     std::unique_ptr<AbstractExecutor> convert_plan_executor(std::shared_ptr<Plan> plan, Context *context) {
-        if (auto x = std::dynamic_pointer_cast<ProjectionPlan>(plan)) {
+        if (auto x = std::dynamic_pointer_cast<LimitPlan>(plan)) {
+            return std::make_unique<LimitExecutor>(convert_plan_executor(x->subplan_, context), x->limit_,
+                                                   x->offset_);
+        } else if (auto x = std::dynamic_pointer_cast<ProjectionPlan>(plan)) {
+            auto scan = std::dynamic_pointer_cast<ScanPlan>(x->subplan_);
+            if (is_parallel_scan(scan)) {
+                // 投影下推到gather，工作线程只拷贝需要的列
+                auto gather =
+                    std::make_unique<GatherExecutor>(sm_manager_, scan->tab_name_, scan->conds_, x->sel_cols_, context);
+                return std::make_unique<ProjectionExecutor>(std::move(gather), x->sel_cols_);
+            }
             return std::make_unique<ProjectionExecutor>(convert_plan_executor(x->subplan_, context), x->sel_cols_);
         } else if (auto x = std::dynamic_pointer_cast<ScanPlan>(plan)) {
-            if (x->tag == T_SeqScan) {
+            if (is_parallel_scan(x)) {
+                return std::make_unique<GatherExecutor>(sm_manager_, x->tab_name_, x->conds_, std::vector<TabCol>(),
+                                                        context);
+            } else if (x->tag == T_SeqScan) {
                 return std::make_unique<SeqScanExecutor>(sm_manager_, x->tab_name_, x->conds_, context);
+            } else if (x->tag == T_IndexUnion) {
+                std::vector<std::unique_ptr<AbstractExecutor>> branches;
+                for (auto &branch : x->union_branches_) {
+                    branches.push_back(convert_plan_executor(branch, context));
+                }
+                return std::make_unique<IndexUnionExecutor>(sm_manager_, x->tab_name_, x->conds_, std::move(branches),
+                                                            context);
             } else {
                 return std::make_unique<IndexScanExecutor>(sm_manager_, x->tab_name_, x->conds_, x->index_col_names_,
                                                            context);
@@ -169,19 +210,45 @@ class Portal {
                 join =
                     std::make_unique<NestedLoopJoinExecutor>(std::move(left), std::move(right), std::move(x->conds_));
             } else if (x->tag == T_SortMerge) {
-                join = std::make_unique<MergeJoinExecutor>(std::move(left), std::move(right), std::move(x->conds_));
-            } else if (x->tag == T_SortMergeWithIndex) {
-                join =
-                    std::make_unique<MergeJoinExecutor>(std::move(left), std::move(right), std::move(x->conds_), true);
+                join = std::make_unique<MergeJoinExecutor>(std::move(left), std::move(right), std::move(x->conds_),
+                                                           x->left_ordered_, x->right_ordered_);
             }
             return join;
+        } else if (auto x = std::dynamic_pointer_cast<SemiJoinPlan>(plan)) {
+            std::unique_ptr<AbstractExecutor> outer = convert_plan_executor(x->left_, context);
+            if (x->tag == T_IndexSemiJoin) {
+                auto probe = std::dynamic_pointer_cast<ScanPlan>(x->right_);
+                return std::make_unique<IndexSemiJoinExecutor>(sm_manager_, std::move(outer), x->outer_col_,
+                                                               probe->tab_name_, probe->conds_,
+                                                               probe->index_col_names_, x->is_anti_);
+            }
+            return std::make_unique<SemiJoinExecutor>(std::move(outer), convert_plan_executor(x->right_, context),
+                                                      x->outer_col_, x->is_anti_);
         } else if (auto x = std::dynamic_pointer_cast<SortPlan>(plan)) {
             return std::make_unique<SortExecutor>(convert_plan_executor(x->subplan_, context), x->sel_col_,
                                                   x->is_desc_);
         } else if (auto x = std::dynamic_pointer_cast<AggregationPlan>(plan)) {
+            auto scan = std::dynamic_pointer_cast<ScanPlan>(x->subplan_);
+            if (x->tag == T_IndexAggregation) {
+                return std::make_unique<IndexAggregationExecutor>(sm_manager_, scan->tab_name_, scan->conds_,
+                                                                  x->sel_cols_, context);
+            }
+            if (is_parallel_scan(scan) && ParallelAggregationExecutor::supported(sm_manager_, scan->tab_name_,
+                                                                                x->sel_cols_, x->group_cols_,
+                                                                                x->having_conds_)) {
+                return std::make_unique<ParallelAggregationExecutor>(sm_manager_, scan->tab_name_, scan->conds_,
+                                                                     x->sel_cols_, x->group_cols_, x->having_conds_,
+                                                                     context);
+            }
             return std::make_unique<AggregationExecutor>(convert_plan_executor(x->subplan_, context), x->sel_cols_,
                                                          x->group_cols_, x->having_conds_);
         }
         return nullptr;
     }
+
+  private:
+    // 顺序扫描的表足够大时改为按morsel并行扫描
+    bool is_parallel_scan(const std::shared_ptr<ScanPlan> &scan) {
+        return scan != nullptr && scan->tag == T_SeqScan && ParallelTableScan::worthwhile(sm_manager_, scan->tab_name_);
+    }
 };
\ No newline at end of file
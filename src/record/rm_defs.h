@@ -14,9 +14,18 @@ See the Mulan PSL v2 for more details. */
 #include "storage/buffer_pool_manager.h"
 
 constexpr int RM_NO_PAGE = -1;
+constexpr int RM_NOT_IN_FREE_LIST = -2; // 页面不在空闲页面链表中（已满，或者是某个插入条带的目标页面）
 constexpr int RM_FILE_HDR_PAGE = 0;
 constexpr int RM_FIRST_RECORD_PAGE = 1;
 constexpr int RM_MAX_RECORD_SIZE = 512;
+constexpr int RM_INSERT_STRIPES = 8; // 每个表的插入条带数，各会话线程分散到不同条带的目标页面上插入
+// 分区表的页号和Rid中，低RM_PARTITION_PAGE_BITS位是分区文件内的页号，高位是分区号；非分区表只有0号分区
+constexpr int RM_PARTITION_PAGE_BITS = 22;
+constexpr int RM_PARTITION_PAGE_MASK = (1 << RM_PARTITION_PAGE_BITS) - 1;
+constexpr int RM_MAX_PARTITIONS = 1 << (31 - RM_PARTITION_PAGE_BITS);
+// 数据文件的格式版本。版本0的文件头没有version字段，已满的页面的next_free_page_no不是RM_NOT_IN_FREE_LIST，
+// 而是填满前在空闲页面链表中的链接，链表末尾可能是num_pages
+constexpr int RM_FILE_VERSION = 1;
 
 /* 文件头，记录表数据文件的元信息，写入磁盘中文件的第0号页面 */
 struct RmFileHdr {
@@ -25,11 +34,18 @@ struct RmFileHdr {
     int num_records_per_page; // 每个页面最多能存储的元组个数
     int first_free_page_no;   // 文件中当前第一个包含空闲空间的页面号（初始化为-1）
     int bitmap_size;          // 每个页面bitmap大小
+    int version;              // 文件格式的版本，旧文件中没有这个字段，读出为0
+};
+
+/* 一段连续的数据页[begin, end)，分区表的页号带有分区号 */
+struct RmPageRange {
+    int begin;
+    int end;
 };
 
 /* 表数据文件中每个页面的页头，记录每个页面的元信息 */
 struct RmPageHdr {
-    int next_free_page_no; // 当前页面满了之后，下一个包含空闲空间的页面号（初始化为-1）
+    int next_free_page_no; // 空闲页面链表中的下一页，链表末尾为RM_NO_PAGE，不在链表中时为RM_NOT_IN_FREE_LIST
     int num_records;       // 当前页面中当前已经存储的记录个数（初始化为0）
 };
 
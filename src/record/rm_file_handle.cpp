@@ -10,6 +10,8 @@ See the Mulan PSL v2 for more details. */
 
 #include "rm_file_handle.h"
 
+#include <algorithm>
+
 /**
  * @description: 获取当前表中记录号为rid的记录
  * @param {Rid&} rid 记录号，指定记录的位置
@@ -20,12 +22,30 @@ std::unique_ptr<RmRecord> RmFileHandle::get_record(const Rid &rid, Context *cont
     // Todo:
     // 1. 获取指定记录所在的page handle
     // 2. 初始化一个指向RmRecord的指针（赋值其内部的data和size）
-    auto page_handle = fetch_page_handle(rid.page_no);
+    if (!partitions_.empty()) {
+        return partition_of_page(rid.page_no)->get_record(local_rid(rid), context);
+    }
+    if (record_cache_ != nullptr) {
+        auto record = std::make_unique<RmRecord>(file_hdr_.record_size);
+        bool is_set;
+        if (record_cache_->read_record(rid.page_no, rid.slot_no, record->data, &is_set)) {
+            assert(is_set); // 此记录必须有效
+            return record;
+        }
+    }
+    auto page_handle = fetch_page_handle_read(rid.page_no);
     auto record_size = page_handle.file_hdr->record_size;
     assert(Bitmap::is_set(page_handle.bitmap, rid.slot_no)); // 此记录必须有效
-    auto ptr = std::make_unique<RmRecord>(record_size, page_handle.get_slot(rid.slot_no));
-    buffer_pool_manager_->unpin_page({fd_, rid.page_no}, false);
-    return ptr;
+    return std::make_unique<RmRecord>(record_size, page_handle.get_slot(rid.slot_no));
+}
+
+/**
+ * @description: 当前线程使用的插入条带，线程第一次插入时按顺序分配，之后固定不变
+ */
+static int insert_stripe_of_thread() {
+    static std::atomic<int> next_stripe{0};
+    thread_local int stripe = next_stripe.fetch_add(1, std::memory_order_relaxed) % RM_INSERT_STRIPES;
+    return stripe;
 }
 
 /**
@@ -35,27 +55,57 @@ std::unique_ptr<RmRecord> RmFileHandle::get_record(const Rid &rid, Context *cont
  * @return {Rid} 插入的记录的记录号（位置）
  */
 Rid RmFileHandle::insert_record(char *buf, Context *context) {
-    // Todo:
-    // 1. 获取当前未满的page handle
-    // 2. 在page handle中找到空闲slot位置
-    // 3. 将buf复制到空闲slot位置
-    // 4. 更新page_handle.page_hdr中的数据结构
-    // 注意考虑插入一条记录后页面已满的情况，需要更新file_hdr_.first_free_page_no
-    auto page_handle = create_page_handle();
-    int record_size = page_handle.file_hdr->record_size;
+    if (!partitions_.empty()) {
+        int partition = partition_of_(buf);
+        Rid rid = partitions_[partition]->insert_record(buf, context);
+        return Rid{global_page_no(partition, rid.page_no), rid.slot_no};
+    }
+    // 插入当前线程条带的目标页面，目标页面满了才从空闲页面链表领取下一页
+    RmInsertStripe &stripe = insert_stripes_[insert_stripe_of_thread()];
+    while (true) {
+        page_id_t page_no = stripe.page_no.load(std::memory_order_acquire);
+        if (page_no == RM_NO_PAGE) {
+            std::scoped_lock lock{stripe.latch};
+            if (stripe.page_no.load(std::memory_order_relaxed) != RM_NO_PAGE) {
+                continue; // 共用条带的线程已经领取了新页面
+            }
+            RmPageHandle page_handle = claim_free_page_handle();
+            stripe.page_no.store(page_handle.page->get_page_id().page_no, std::memory_order_release);
+            return insert_into_page(stripe, page_handle, buf);
+        }
+        RmPageHandle page_handle = fetch_page_handle(page_no);
+        if (page_handle.page_hdr->num_records < file_hdr_.num_records_per_page) {
+            return insert_into_page(stripe, page_handle, buf);
+        }
+        // 事务回滚时按位置插回的记录可能填满目标页面
+        stripe.page_no.compare_exchange_strong(page_no, RM_NO_PAGE);
+    }
+}
+
+/**
+ * @description: 把记录插入条带目标页面的第一个空闲slot，页面因此填满时条带放弃该页面
+ * @return {Rid} 插入的记录的记录号（位置）
+ * @param {RmInsertStripe&} stripe 页面所属的条带
+ * @param {RmPageHandle&} page_handle 未满的目标页面，持有写锁
+ * @param {char*} buf 要插入的记录的数据
+ */
+Rid RmFileHandle::insert_into_page(RmInsertStripe &stripe, RmPageHandle &page_handle, char *buf) {
     int num_slot = file_hdr_.num_records_per_page;
     // 找到第一个0
     int first_zero = Bitmap::first_bit(false, page_handle.bitmap, num_slot);
     assert(first_zero < num_slot); // 因为此页未满所以一定能找到
-    memcpy(page_handle.get_slot(first_zero), buf, record_size);
+    memcpy(page_handle.get_slot(first_zero), buf, file_hdr_.record_size);
     Bitmap::set(page_handle.bitmap, first_zero);
     page_handle.page_hdr->num_records++;
-    if (page_handle.page_hdr->num_records == file_hdr_.num_records_per_page) { // 刚好用完这一页
-        // 在插入前这一页在链表中，所以`next_free_page_no`有效
-        file_hdr_.first_free_page_no = page_handle.page_hdr->next_free_page_no;
-    }
     page_id_t page_no = page_handle.page->get_page_id().page_no;
-    buffer_pool_manager_->unpin_page({fd_, page_no}, true);
+    if (page_handle.page_hdr->num_records == num_slot) {
+        // 已满的页面不在空闲页面链表中，删除记录后再由release_page_handle()放回
+        page_id_t expected = page_no;
+        stripe.page_no.compare_exchange_strong(expected, RM_NO_PAGE);
+    }
+    page_handle.guard.mark_dirty();
+    write_through(page_handle, first_zero);
+    add_num_records(page_no, 1);
     return Rid{page_no, first_zero};
 }
 
@@ -65,12 +115,23 @@ Rid RmFileHandle::insert_record(char *buf, Context *context) {
  * @param {char*} buf 要插入记录的数据
  */
 void RmFileHandle::insert_record(const Rid &rid, char *buf) {
+    if (!partitions_.empty()) {
+        partition_of_page(rid.page_no)->insert_record(local_rid(rid), buf);
+        return;
+    }
     auto page_handle = fetch_page_handle(rid.page_no);
     auto record_size = page_handle.file_hdr->record_size;
+    bool occupied = Bitmap::is_set(page_handle.bitmap, rid.slot_no);
     memcpy(page_handle.get_slot(rid.slot_no), buf, record_size);
     Bitmap::set(page_handle.bitmap, rid.slot_no);
-    // page_handle.page_hdr->num_records++; // TODO： 是否自增？
-    buffer_pool_manager_->unpin_page(page_handle.page->get_page_id(), true);
+    if (!occupied) {
+        // 页头中的记录数要和bitmap一致，COUNT(*)依赖它。页面因此填满时不从空闲页面链表中摘除，
+        // 领取时再丢弃，这样不需要在持有页面写锁时遍历链表
+        page_handle.page_hdr->num_records++;
+        add_num_records(rid.page_no, 1);
+    }
+    page_handle.guard.mark_dirty();
+    write_through(page_handle, rid.slot_no);
 }
 
 /**
@@ -83,6 +144,10 @@ void RmFileHandle::delete_record(const Rid &rid, Context *context) {
     // 1. 获取指定记录所在的page handle
     // 2. 更新page_handle.page_hdr中的数据结构
     // 注意考虑删除一条记录后页面未满的情况，需要调用release_page_handle()
+    if (!partitions_.empty()) {
+        partition_of_page(rid.page_no)->delete_record(local_rid(rid), context);
+        return;
+    }
 
     auto page_handle = fetch_page_handle(rid.page_no);
     int num_slot = file_hdr_.num_records_per_page;
@@ -92,7 +157,9 @@ void RmFileHandle::delete_record(const Rid &rid, Context *context) {
     }
     Bitmap::reset(page_handle.bitmap, rid.slot_no);
     page_handle.page_hdr->num_records--;
-    buffer_pool_manager_->unpin_page(page_handle.page->get_page_id(), true);
+    page_handle.guard.mark_dirty();
+    write_through(page_handle, -1);
+    add_num_records(rid.page_no, -1);
 }
 
 /**
@@ -105,34 +172,81 @@ void RmFileHandle::update_record(const Rid &rid, char *buf, Context *context) {
     // Todo:
     // 1. 获取指定记录所在的page handle
     // 2. 更新记录
+    if (!partitions_.empty()) {
+        partition_of_page(rid.page_no)->update_record(local_rid(rid), buf, context);
+        return;
+    }
 
     auto page_handle = fetch_page_handle(rid.page_no);
     memcpy(page_handle.get_slot(rid.slot_no), buf, page_handle.file_hdr->record_size);
-    buffer_pool_manager_->unpin_page(page_handle.page->get_page_id(), true);
+    page_handle.guard.mark_dirty();
+    write_through(page_handle, rid.slot_no);
 }
 
 /**
  * 以下函数为辅助函数，仅提供参考，可以选择完成如下函数，也可以删除如下函数，在单元测试中不涉及如下函数接口的直接调用
  */
 /**
- * @description: 获取指定页面的页面句柄
+ * @description: 获取指定页面的页面句柄，持有页面的写锁
  * @param {int} page_no 页面号
  * @return {RmPageHandle} 指定页面的句柄
  */
-RmPageHandle RmFileHandle::fetch_page_handle(int page_no) const {
+RmPageHandle RmFileHandle::fetch_page_handle(int page_no) {
     // Todo:
     // 使用缓冲池获取指定页面，并生成page_handle返回给上层
     // if page_no is invalid, throw PageNotExistError exception
-    Page *page = buffer_pool_manager_->fetch_page({fd_, page_no});
-    if (page == nullptr) {
+    if (!partitions_.empty()) {
+        return partition_of_page(page_no)->fetch_page_handle(page_no & RM_PARTITION_PAGE_MASK);
+    }
+    WritePageGuard guard = mem_pages_ != nullptr ? mem_pages_->fetch_page_write({fd_, page_no})
+                                                  : buffer_pool_manager_->fetch_page_write({fd_, page_no});
+    if (!guard) {
         // TODO: 确定表名
         throw PageNotExistError("TODO: 确定表名", page_no);
     }
-    return RmPageHandle(&file_hdr_, page);
+    return RmPageHandle(&file_hdr_, std::move(guard));
+}
+
+/**
+ * @description: 获取指定页面的页面句柄，持有页面的读锁
+ * @param {int} page_no 页面号
+ * @return {RmPageHandle} 指定页面的句柄
+ */
+RmPageHandle RmFileHandle::fetch_page_handle_read(int page_no) const {
+    if (!partitions_.empty()) {
+        return partition_of_page(page_no)->fetch_page_handle_read(page_no & RM_PARTITION_PAGE_MASK);
+    }
+    ReadPageGuard guard = mem_pages_ != nullptr ? mem_pages_->fetch_page_read({fd_, page_no})
+                                                 : buffer_pool_manager_->fetch_page_read({fd_, page_no});
+    if (!guard) {
+        throw PageNotExistError("TODO: 确定表名", page_no);
+    }
+    return RmPageHandle(&file_hdr_, std::move(guard));
+}
+
+/**
+ * @description: 页面中slot_no之后第一条记录的位置，有记录缓存时不访问缓冲池
+ * @return {int} 记录的slot_no，没有时返回num_records_per_page
+ * @param {int} page_no 页面号
+ * @param {int} slot_no 从slot_no之后开始查找，-1表示从页面开头查找
+ */
+int RmFileHandle::next_record_slot(int page_no, int slot_no) const {
+    if (!partitions_.empty()) {
+        return partition_of_page(page_no)->next_record_slot(page_no & RM_PARTITION_PAGE_MASK, slot_no);
+    }
+    int num_slot = file_hdr_.num_records_per_page;
+    if (record_cache_ != nullptr) {
+        char bitmap[PAGE_SIZE];
+        if (record_cache_->read_image(page_no, file_hdr_.bitmap_size, bitmap)) {
+            return Bitmap::next_bit(true, bitmap, num_slot, slot_no);
+        }
+    }
+    RmPageHandle page_handle = fetch_page_handle_read(page_no);
+    return Bitmap::next_bit(true, page_handle.bitmap, num_slot, slot_no);
 }
 
 /**
- * @description: 创建一个新的page handle
+ * @description: 创建一个新的page handle，需要持有free_list_latch_
  * @return {RmPageHandle} 新的PageHandle
  */
 RmPageHandle RmFileHandle::create_new_page_handle() {
@@ -141,70 +255,203 @@ RmPageHandle RmFileHandle::create_new_page_handle() {
     // 2.更新page handle中的相关信息
     // 3.更新file_hdr_
     PageId page_id = {fd_, INVALID_PAGE_ID};
-    Page *page = buffer_pool_manager_->new_page(&page_id);
-    file_hdr_.first_free_page_no = page_id.page_no;
+    WritePageGuard guard = mem_pages_ != nullptr ? mem_pages_->new_page_write(&page_id)
+                                                  : buffer_pool_manager_->new_page_write(&page_id);
+    if (!guard) {
+        throw PageNotExistError("TODO: 确定表名", page_id.page_no);
+    }
     file_hdr_.num_pages++;
-    return RmPageHandle(&file_hdr_, page);
+    if (record_cache_ != nullptr && !record_cache_->covers(page_id.page_no)) {
+        record_cache_->disable();
+    }
+    return RmPageHandle(&file_hdr_, std::move(guard));
 }
 
 /**
- * @brief 创建或获取一个空闲的page handle
+ * @brief 从空闲页面链表头部领取一个未满的页面，链表为空时分配新页面。领取的页面移出链表，由条带独占插入
  *
- * @return RmPageHandle 返回生成的空闲page handle
- * @note pin the page, remember to unpin it outside!
+ * @return RmPageHandle 领取的页面，持有页面的写锁
  */
-RmPageHandle RmFileHandle::create_page_handle() {
-    // Todo:
-    // 1. 判断file_hdr_中是否还有空闲页
-    //     1.1 没有空闲页：使用缓冲池来创建一个新page；可直接调用create_new_page_handle()
-    //     1.2 有空闲页：直接获取第一个空闲页
-    // 2. 生成page handle并返回给上层
-    auto no = file_hdr_.first_free_page_no;
-    // -1是非法值，说明此文件连一页也没有分配给记录（file_handler占据了第0页）
-    if (no == file_hdr_.num_pages || no == -1) {
-        auto page_handle = create_new_page_handle();
-        page_handle.page_hdr->next_free_page_no = file_hdr_.num_pages; // free page链表末尾
-        return page_handle;
+RmPageHandle RmFileHandle::claim_free_page_handle() {
+    while (true) {
+        std::unique_lock<std::mutex> lock(free_list_latch_);
+        page_id_t no = file_hdr_.first_free_page_no;
+        if (no == RM_NO_PAGE) {
+            RmPageHandle page_handle = create_new_page_handle();
+            page_handle.page_hdr->next_free_page_no = RM_NOT_IN_FREE_LIST;
+            return page_handle;
+        }
+        assert(no != RM_FILE_HDR_PAGE);
+        // 删除记录的线程先持有页面写锁再把页面放回链表，这里也要先放开free_list_latch_再加页面锁
+        lock.unlock();
+        RmPageHandle page_handle = fetch_page_handle(no);
+        lock.lock();
+        if (file_hdr_.first_free_page_no != no) {
+            continue; // 链表头已经被其他条带领取，或者放回了新的页面
+        }
+        file_hdr_.first_free_page_no = page_handle.page_hdr->next_free_page_no;
+        page_handle.page_hdr->next_free_page_no = RM_NOT_IN_FREE_LIST;
+        page_handle.guard.mark_dirty();
+        if (page_handle.page_hdr->num_records < file_hdr_.num_records_per_page) {
+            return page_handle;
+        }
+        // 回滚时被插回的记录填满、留在链表中的页面，移出链表后直接丢弃
     }
-    assert(no != 0 && no < file_hdr_.num_pages);
-    Page *page = buffer_pool_manager_->fetch_page({fd_, no});
-    return RmPageHandle(&file_hdr_, page);
 }
 
 /**
- * @description: 当一个页面从没有空闲空间的状态变为有空闲空间状态时，更新文件头和页头中空闲页面相关的元数据
+ * @description: 页面从没有空闲空间变为有空闲空间时，如果它不在空闲页面链表中，把它放到链表头部
+ * @param {RmPageHandle&} page_handle 要放回的页面，持有写锁
  */
 void RmFileHandle::release_page_handle(RmPageHandle &page_handle) {
-    // Todo:
-    // 当page从已满变成未满，考虑如何更新：
-    // 1. page_handle.page_hdr->next_free_page_no
-    // 2. file_hdr_.first_free_page_no
+    // 页面的next_free_page_no只在持有其写锁时修改，不需要free_list_latch_就能判断是否在链表中
+    if (page_handle.page_hdr->next_free_page_no != RM_NOT_IN_FREE_LIST) {
+        return;
+    }
+    std::scoped_lock lock{free_list_latch_};
+    page_handle.page_hdr->next_free_page_no = file_hdr_.first_free_page_no;
+    file_hdr_.first_free_page_no = page_handle.page->get_page_id().page_no;
+    page_handle.guard.mark_dirty();
+    //    file_hdr_.num_pages--;    // 此文件分配了页后就不会收回
+}
 
-    // 单向链表组织空闲page，链表头为`page_handle.page_hdr->next_free_page_no`
-    // 将新的空闲page插入到链表中，同时保证链表降序
+/**
+ * @description: 把各条带未满的目标页面放回空闲页面链表，关闭文件前调用，否则重新打开后这些页面的空闲空间不会再被使用
+ */
+void RmFileHandle::release_insert_pages() {
+    for (auto &partition : partitions_) {
+        partition->release_insert_pages();
+    }
+    for (auto &stripe : insert_stripes_) {
+        page_id_t page_no = stripe.page_no.exchange(RM_NO_PAGE);
+        if (page_no == RM_NO_PAGE) {
+            continue;
+        }
+        RmPageHandle page_handle = fetch_page_handle(page_no);
+        if (page_handle.page_hdr->num_records < file_hdr_.num_records_per_page) {
+            release_page_handle(page_handle);
+        }
+    }
+}
 
-    page_id_t page_no = page_handle.page->get_page_id().page_no;
-    assert(page_no != file_hdr_.first_free_page_no); // 不能释放一个已经空闲的页
-    if (page_no > file_hdr_.first_free_page_no) {
-        // ... -> 4 -> 插入5 -> 6 -> ...
-        // ... -> 3 -> 插入5 -> 6 -> ...
-        // 找到第一个大于page_no的节点，在其前面插入
-        RmPageHandle prev = fetch_page_handle(file_hdr_.first_free_page_no);
-        while (prev.page_hdr->next_free_page_no != -1 && prev.page_hdr->next_free_page_no < page_no) {
-            int next_no = prev.page_hdr->next_free_page_no;
-            buffer_pool_manager_->unpin_page(prev.page->get_page_id(), false);
-            prev = fetch_page_handle(next_no);
+/**
+ * @description: 打开旧版本的文件时重建空闲页面链表，未满的页面按页号顺序放入链表，已满的页面标记为
+ * RM_NOT_IN_FREE_LIST。否则已满页面上残留的链接会让release_page_handle()认为它已经在链表中，删除记录后
+ * 空出的位置不会再被使用。新的文件头在关闭文件时写回，中途崩溃的话下次打开重新执行
+ */
+void RmFileHandle::upgrade_free_list() {
+    file_hdr_.first_free_page_no = RM_NO_PAGE;
+    for (int page_no = file_hdr_.num_pages - 1; page_no >= RM_FIRST_RECORD_PAGE; page_no--) {
+        RmPageHandle page_handle = fetch_page_handle(page_no);
+        if (page_handle.page_hdr->num_records < file_hdr_.num_records_per_page) {
+            page_handle.page_hdr->next_free_page_no = file_hdr_.first_free_page_no;
+            file_hdr_.first_free_page_no = page_no;
+        } else {
+            page_handle.page_hdr->next_free_page_no = RM_NOT_IN_FREE_LIST;
         }
-        assert(prev.page_hdr->next_free_page_no != page_no); // 不能释放一个已经空闲的页
-        assert(prev.page_hdr->next_free_page_no != -1);      // 链表中不存在这一页
-        page_handle.page_hdr->next_free_page_no = prev.page_hdr->next_free_page_no;
-        prev.page_hdr->next_free_page_no = page_no;
-        buffer_pool_manager_->unpin_page(prev.page->get_page_id(), true);
-    } else if (page_no < file_hdr_.first_free_page_no) {
-        // 插入在头部 -> item -> item -> ...
-        page_handle.page_hdr->next_free_page_no = file_hdr_.first_free_page_no;
-        file_hdr_.first_free_page_no = page_handle.page->get_page_id().page_no;
-    }
-    buffer_pool_manager_->unpin_page(page_handle.page->get_page_id(), true);
-    //    file_hdr_.num_pages--;    // 此文件分配了页后就不会收回
+        page_handle.guard.mark_dirty();
+    }
+    file_hdr_.version = RM_FILE_VERSION;
+}
+
+/**
+ * @description: 创建记录缓存并读入已有的数据页，只在打开文件时调用
+ * @param {int} max_pages 缓存能容纳的数据页数，表增长到超过该值后缓存停用
+ */
+void RmFileHandle::init_record_cache(int max_pages) {
+    record_cache_ = std::make_unique<RmRecordCache>(file_hdr_, max_pages);
+    for (int page_no = RM_FIRST_RECORD_PAGE; page_no < file_hdr_.num_pages; page_no++) {
+        RmPageHandle page_handle = fetch_page_handle_read(page_no);
+        record_cache_->store_page(page_no, page_handle.bitmap);
+    }
+}
+
+/**
+ * @description: 表中的记录数，第一次调用时累加各页面头中的num_records，之后直接返回维护的计数。
+ * 累加时插入删除照常进行，由add_num_records按页面是否已经累加过决定是否记入count_delta_
+ */
+int RmFileHandle::get_num_records() const {
+    if (!partitions_.empty()) {
+        int num_records = 0;
+        for (auto &partition : partitions_) {
+            num_records += partition->get_num_records();
+        }
+        return num_records;
+    }
+    int num_records = num_records_.load();
+    if (num_records >= 0) {
+        return num_records;
+    }
+    std::scoped_lock pass_lock{count_pass_latch_};
+    num_records = num_records_.load();
+    if (num_records >= 0) {
+        return num_records; // 等待期间其他线程已经统计完
+    }
+    num_records = 0;
+    for (int page_no = RM_FIRST_RECORD_PAGE;; page_no++) {
+        {
+            // 新页面在free_list_latch_下分配，判断已经累加完所有页面和写入结果之间不会有新页面
+            std::scoped_lock lock{free_list_latch_};
+            if (page_no >= file_hdr_.num_pages) {
+                std::scoped_lock count_lock{count_latch_};
+                num_records += count_delta_;
+                num_records_.store(num_records);
+                return num_records;
+            }
+        }
+        RmPageHandle page_handle = fetch_page_handle_read(page_no);
+        num_records += page_handle.page_hdr->num_records;
+        counted_pages_.store(page_no + 1);
+    }
+}
+
+/**
+ * @description: 各分区数据文件的页数之和，非分区表就是文件头中的num_pages
+ */
+int RmFileHandle::get_num_pages() const {
+    if (partitions_.empty()) {
+        return file_hdr_.num_pages;
+    }
+    int num_pages = 0;
+    for (auto &partition : partitions_) {
+        num_pages += partition->file_hdr_.num_pages;
+    }
+    return num_pages;
+}
+
+/**
+ * @description: 把要扫描的分区的数据页按页号顺序划分为morsel，每个morsel可以由任意线程独立扫描
+ * @return {vector<RmPageRange>} 各morsel的页面范围，都不跨分区
+ * @param {vector<int>&} partitions 要扫描的分区，升序
+ * @param {int} morsel_pages 每个morsel最多包含的页数
+ */
+std::vector<RmPageRange> RmFileHandle::page_morsels(const std::vector<int> &partitions, int morsel_pages) const {
+    std::vector<RmPageRange> morsels;
+    for (int partition : partitions) {
+        RmPageRange range = page_range(partition);
+        for (int begin = range.begin; begin < range.end; begin += morsel_pages) {
+            morsels.push_back({begin, std::min(begin + morsel_pages, range.end)});
+        }
+    }
+    return morsels;
+}
+
+/**
+ * @description: 插入删除记录后更新计数。正在统计时，只记下已经累加过的页面上的修改，其余的页面累加时会读到
+ * @param {int} page_no 修改的页面，调用者持有它的写锁，统计不会在此期间越过它
+ * @param {int} delta 记录数的变化
+ */
+void RmFileHandle::add_num_records(int page_no, int delta) {
+    int num_records = num_records_.load();
+    while (num_records >= 0) {
+        if (num_records_.compare_exchange_weak(num_records, num_records + delta)) {
+            return;
+        }
+    }
+    std::scoped_lock lock{count_latch_};
+    if (num_records_.load() >= 0) {
+        num_records_.fetch_add(delta); // 加锁前统计刚刚结束
+    } else if (page_no < counted_pages_.load()) {
+        count_delta_ += delta;
+    }
 }
\ No newline at end of file
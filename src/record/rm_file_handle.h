@@ -12,23 +12,32 @@ See the Mulan PSL v2 for more details. */
 
 #include <cassert>
 
+#include <algorithm>
+#include <atomic>
+#include <functional>
 #include <memory>
+#include <mutex>
+#include <vector>
 
 #include "bitmap.h"
 #include "common/context.h"
 #include "rm_defs.h"
+#include "rm_record_cache.h"
+#include "storage/memory_page_store.h"
 
 class RmManager;
 
-/* 对表数据文件中的页面进行封装 */
+/* 对表数据文件中的页面进行封装，持有页面的守卫，析构时解锁并unpin页面 */
 struct RmPageHandle {
     const RmFileHdr *file_hdr; // 当前页面所在文件的文件头指针
+    PageGuard guard;           // 页面的读锁或写锁，只有写锁时可以修改页面
     Page *page;                // 页面的实际数据，包括页面存储的数据、元信息等
     RmPageHdr *page_hdr; // page->data的第一部分，存储页面元信息，指针指向首地址，长度为sizeof(RmPageHdr)
     char *bitmap; // page->data的第二部分，存储页面的bitmap，指针指向首地址，长度为file_hdr->bitmap_size
     char *slots; // page->data的第三部分，存储表的记录，指针指向首地址，每个slot的长度为file_hdr->record_size
 
-    RmPageHandle(const RmFileHdr *fhdr_, Page *page_) : file_hdr(fhdr_), page(page_) {
+    RmPageHandle(const RmFileHdr *fhdr_, PageGuard guard_)
+        : file_hdr(fhdr_), guard(std::move(guard_)), page(guard.get_page()) {
         page_hdr = reinterpret_cast<RmPageHdr *>(page->get_data() + Page::OFFSET_PAGE_HDR);
         bitmap = page->get_data() + sizeof(RmPageHdr) + Page::OFFSET_PAGE_HDR;
         slots = bitmap + file_hdr->bitmap_size;
@@ -40,6 +49,12 @@ struct RmPageHandle {
     }
 };
 
+/* 插入条带，持有一个从空闲页面链表中领取的页面作为插入目标。按缓存行对齐，不同条带之间没有伪共享 */
+struct alignas(64) RmInsertStripe {
+    std::atomic<page_id_t> page_no{RM_NO_PAGE}; // 插入目标页面，RM_NO_PAGE表示需要领取新页面
+    std::mutex latch;                           // 领取新页面时持有，共用条带的线程不会重复领取
+};
+
 /* 每个RmFileHandle对应一个表的数据文件，里面有多个page，每个page的数据封装在RmPageHandle中 */
 class RmFileHandle {
     friend class RmScan;
@@ -50,16 +65,57 @@ class RmFileHandle {
     BufferPoolManager *buffer_pool_manager_;
     int fd_;             // 打开文件后产生的文件句柄
     RmFileHdr file_hdr_; // 文件头，维护当前表文件的元数据
+    // 保护file_hdr_.first_free_page_no、num_pages和空闲页面链表中各页面的next_free_page_no，
+    // 需要先持有页面的写锁再加这把锁
+    mutable std::mutex free_list_latch_;
+    // 每个会话线程固定向其中一个条带的目标页面插入，并发插入不竞争同一页面的写锁，也不访问文件头
+    RmInsertStripe insert_stripes_[RM_INSERT_STRIPES];
+    // 表中的记录数，第一次查询时由各页面头中的num_records累加得到，之后随插入删除维护，-1表示尚未统计
+    mutable std::atomic<int> num_records_{-1};
+    // 统计时按页号顺序累加，counted_pages_之前的页面已经累加过，在持有下一页的读锁时推进。统计期间这些页面上的
+    // 插入删除记在count_delta_中，统计结束时加上；之后的页面上的插入删除会在累加时读到
+    mutable std::atomic<int> counted_pages_{RM_FIRST_RECORD_PAGE};
+    mutable int count_delta_ = 0;
+    mutable std::mutex count_pass_latch_; // 同时只有一个线程统计记录数
+    mutable std::mutex count_latch_;      // 保护count_delta_和统计结束时对num_records_的写入
+    // 打开时数据页不超过record_cache_pages的小表才有记录缓存，读记录时优先读缓存，不访问缓冲池
+    std::unique_ptr<RmRecordCache> record_cache_;
+    // 临时表的页面只在内存中，不经过缓冲池；为nullptr时是普通的表
+    std::unique_ptr<MemoryPageStore> mem_pages_;
+    // 分区表的各分区的文件句柄，分区表本身没有数据文件，读写都按页号中的分区号转给对应分区；为空时是普通的表
+    std::vector<std::unique_ptr<RmFileHandle>> partitions_;
+    std::function<int(const char *)> partition_of_; // 插入的记录所在的分区
 
   public:
-    RmFileHandle(DiskManager *disk_manager, BufferPoolManager *buffer_pool_manager, int fd)
+    RmFileHandle(DiskManager *disk_manager, BufferPoolManager *buffer_pool_manager, int fd, int record_cache_pages = 0)
         : disk_manager_(disk_manager), buffer_pool_manager_(buffer_pool_manager), fd_(fd) {
         // 注意：这里从磁盘中读出文件描述符为fd的文件的file_hdr，读到内存中
         // 这里实际就是初始化file_hdr，只不过是从磁盘中读出进行初始化
         // init file_hdr_
-        disk_manager_->read_page(fd, RM_FILE_HDR_PAGE, (char *)&file_hdr_, sizeof(file_hdr_));
+        // 旧文件的文件头比RmFileHdr短，没有数据页时整个文件可能都比它短，缺少的字段为0
+        int file_size = disk_manager_->get_file_size(disk_manager_->get_file_name(fd));
+        disk_manager_->read_page(fd, RM_FILE_HDR_PAGE, (char *)&file_hdr_,
+                                 std::min(file_size, (int)sizeof(file_hdr_)));
         // disk_manager管理的fd对应的文件中，设置从file_hdr_.num_pages开始分配page_no
         disk_manager_->set_fd2pageno(fd, file_hdr_.num_pages);
+        if (file_hdr_.version < RM_FILE_VERSION) {
+            upgrade_free_list();
+        }
+        if (record_cache_pages > 0 && file_hdr_.num_pages - RM_FIRST_RECORD_PAGE <= record_cache_pages) {
+            init_record_cache(record_cache_pages);
+        }
+    }
+
+    // 临时表的文件句柄，没有磁盘文件，fd_为-1
+    RmFileHandle(const RmFileHdr &file_hdr, std::unique_ptr<MemoryPageStore> mem_pages)
+        : disk_manager_(nullptr), buffer_pool_manager_(nullptr), fd_(-1), file_hdr_(file_hdr),
+          mem_pages_(std::move(mem_pages)) {
+    }
+
+    // 分区表的文件句柄，fd_为-1，文件头复制自0号分区，只用于获取记录大小等各分区相同的信息
+    RmFileHandle(std::vector<std::unique_ptr<RmFileHandle>> partitions, std::function<int(const char *)> partition_of)
+        : disk_manager_(nullptr), buffer_pool_manager_(nullptr), fd_(-1), file_hdr_(partitions[0]->file_hdr_),
+          partitions_(std::move(partitions)), partition_of_(std::move(partition_of)) {
     }
 
     RmFileHdr get_file_hdr() const {
@@ -69,16 +125,102 @@ class RmFileHandle {
         return fd_;
     }
 
+    /* 表中的记录数，只读页面头，不扫描记录 */
+    int get_num_records() const;
+
+    /* 各分区数据文件的页数之和，包括文件头页 */
+    int get_num_pages() const;
+
+    int num_partitions() const {
+        return partitions_.empty() ? 1 : (int)partitions_.size();
+    }
+
+    /* 分区的数据页，不包括文件头页；页面数随插入增长，每次调用时重新读取 */
+    RmPageRange page_range(int partition) const {
+        if (partitions_.empty()) {
+            return {RM_FIRST_RECORD_PAGE, file_hdr_.num_pages};
+        }
+        int num_pages = partitions_[partition]->file_hdr_.num_pages;
+        return {global_page_no(partition, RM_FIRST_RECORD_PAGE), global_page_no(partition, num_pages)};
+    }
+
+    /* 把各分区的数据页划分为不超过morsel_pages页的morsel，morsel不跨分区，按页号升序排列 */
+    std::vector<RmPageRange> page_morsels(const std::vector<int> &partitions, int morsel_pages) const;
+
     /* 判断指定位置上是否已经存在一条记录，通过Bitmap来判断 */
     bool is_record(const Rid &rid) const {
-        RmPageHandle page_handle = fetch_page_handle(rid.page_no);
-        bool retval = Bitmap::is_set(page_handle.bitmap, rid.slot_no); // page的slot_no位置上是否有record
-        buffer_pool_manager_->unpin_page(page_handle.page->get_page_id(), false);
-        return retval;
+        if (!partitions_.empty()) {
+            return partition_of_page(rid.page_no)->is_record(local_rid(rid));
+        }
+        bool is_set;
+        if (record_cache_ != nullptr && record_cache_->read_record(rid.page_no, rid.slot_no, nullptr, &is_set)) {
+            return is_set;
+        }
+        RmPageHandle page_handle = fetch_page_handle_read(rid.page_no);
+        return Bitmap::is_set(page_handle.bitmap, rid.slot_no); // page的slot_no位置上是否有record
     }
 
     std::unique_ptr<RmRecord> get_record(const Rid &rid, Context *context) const;
 
+    /* 直接在页面上对记录求值，不拷贝记录，用于扫描时过滤；有记录缓存时对缓存中复制出的记录求值 */
+    template <typename Predicate>
+    bool test_record(const Rid &rid, Predicate &&pred) const {
+        if (!partitions_.empty()) {
+            return partition_of_page(rid.page_no)->test_record(local_rid(rid), std::forward<Predicate>(pred));
+        }
+        if (record_cache_ != nullptr) {
+            char record[RM_MAX_RECORD_SIZE];
+            bool is_set;
+            if (record_cache_->read_record(rid.page_no, rid.slot_no, record, &is_set)) {
+                assert(is_set);
+                return pred(static_cast<const char *>(record));
+            }
+        }
+        RmPageHandle page_handle = fetch_page_handle_read(rid.page_no);
+        assert(Bitmap::is_set(page_handle.bitmap, rid.slot_no)); // 此记录必须有效
+        return pred(static_cast<const char *>(page_handle.get_slot(rid.slot_no)));
+    }
+
+    /* 直接在页面上修改记录，fn(char *record)原地写入新值，页面标记为脏；fn抛出异常前不能修改记录 */
+    template <typename Fn>
+    void modify_record(const Rid &rid, Fn &&fn) {
+        if (!partitions_.empty()) {
+            partition_of_page(rid.page_no)->modify_record(local_rid(rid), std::forward<Fn>(fn));
+            return;
+        }
+        RmPageHandle page_handle = fetch_page_handle(rid.page_no);
+        assert(Bitmap::is_set(page_handle.bitmap, rid.slot_no)); // 此记录必须有效
+        fn(page_handle.get_slot(rid.slot_no));
+        page_handle.guard.mark_dirty();
+        write_through(page_handle, rid.slot_no);
+    }
+
+    /* 页面只fetch一次，按slot顺序对页内每条记录调用fn(slot_no, record)，用于按页划分的并行扫描 */
+    template <typename Fn>
+    void for_each_record(int page_no, Fn &&fn) const {
+        if (!partitions_.empty()) {
+            partition_of_page(page_no)->for_each_record(page_no & RM_PARTITION_PAGE_MASK, std::forward<Fn>(fn));
+            return;
+        }
+        int num_slot = file_hdr_.num_records_per_page;
+        if (record_cache_ != nullptr) {
+            char image[PAGE_SIZE];
+            if (record_cache_->read_image(page_no, record_cache_->image_size(), image)) {
+                const char *slots = image + file_hdr_.bitmap_size;
+                for (int slot_no = Bitmap::first_bit(true, image, num_slot); slot_no < num_slot;
+                     slot_no = Bitmap::next_bit(true, image, num_slot, slot_no)) {
+                    fn(slot_no, slots + slot_no * file_hdr_.record_size);
+                }
+                return;
+            }
+        }
+        RmPageHandle page_handle = fetch_page_handle_read(page_no);
+        for (int slot_no = Bitmap::first_bit(true, page_handle.bitmap, num_slot); slot_no < num_slot;
+             slot_no = Bitmap::next_bit(true, page_handle.bitmap, num_slot, slot_no)) {
+            fn(slot_no, static_cast<const char *>(page_handle.get_slot(slot_no)));
+        }
+    }
+
     Rid insert_record(char *buf, Context *context);
 
     void insert_record(const Rid &rid, char *buf);
@@ -89,10 +231,48 @@ class RmFileHandle {
 
     RmPageHandle create_new_page_handle();
 
-    RmPageHandle fetch_page_handle(int page_no) const;
+    // 获取页面并加写锁
+    RmPageHandle fetch_page_handle(int page_no);
+
+    // 获取页面并加读锁，不能修改页面
+    RmPageHandle fetch_page_handle_read(int page_no) const;
+
+    // 页面中slot_no之后第一条记录的slot，没有时返回num_records_per_page；slot_no为-1时从页面开头查找
+    int next_record_slot(int page_no, int slot_no) const;
 
   private:
-    RmPageHandle create_page_handle();
+    static int global_page_no(int partition, int page_no) {
+        return (partition << RM_PARTITION_PAGE_BITS) | page_no;
+    }
+
+    // 分区表中页号所在分区的文件句柄
+    RmFileHandle *partition_of_page(int page_no) const {
+        return partitions_[page_no >> RM_PARTITION_PAGE_BITS].get();
+    }
+
+    // 分区表的Rid在分区文件中的位置
+    static Rid local_rid(const Rid &rid) {
+        return Rid{rid.page_no & RM_PARTITION_PAGE_MASK, rid.slot_no};
+    }
+
+    RmPageHandle claim_free_page_handle();
+
+    Rid insert_into_page(RmInsertStripe &stripe, RmPageHandle &page_handle, char *buf);
 
     void release_page_handle(RmPageHandle &page_handle);
-};
\ No newline at end of file
+
+    void release_insert_pages();
+
+    void init_record_cache(int max_pages);
+
+    void upgrade_free_list();
+
+    // 页面的bitmap和slot_no处的记录修改后写入记录缓存，需要持有页面的写锁
+    void write_through(const RmPageHandle &page_handle, int slot_no) {
+        if (record_cache_ != nullptr) {
+            record_cache_->store_record(page_handle.page->get_page_id().page_no, page_handle.bitmap, slot_no);
+        }
+    }
+
+    void add_num_records(int page_no, int delta);
+};
\ No newline at end of file
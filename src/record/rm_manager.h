@@ -21,10 +21,13 @@ class RmManager {
   private:
     DiskManager *disk_manager_;
     BufferPoolManager *buffer_pool_manager_;
+    int record_cache_pages_; // 数据页不超过该值的表打开时建立记录缓存，0表示不缓存
 
   public:
-    RmManager(DiskManager *disk_manager, BufferPoolManager *buffer_pool_manager)
-        : disk_manager_(disk_manager), buffer_pool_manager_(buffer_pool_manager) {
+    RmManager(DiskManager *disk_manager, BufferPoolManager *buffer_pool_manager,
+              int record_cache_pages = RECORD_CACHE_PAGES)
+        : disk_manager_(disk_manager), buffer_pool_manager_(buffer_pool_manager),
+          record_cache_pages_(record_cache_pages) {
     }
 
     /**
@@ -39,15 +42,7 @@ class RmManager {
         disk_manager_->create_file(filename);
         int fd = disk_manager_->open_file(filename);
 
-        // 初始化file header
-        RmFileHdr file_hdr{};
-        file_hdr.record_size = record_size;
-        file_hdr.num_pages = 1;
-        file_hdr.first_free_page_no = RM_NO_PAGE;
-        // We have: sizeof(hdr) + (n + 7) / 8 + n * record_size <= PAGE_SIZE
-        file_hdr.num_records_per_page =
-            (BITMAP_WIDTH * (PAGE_SIZE - 1 - (int)sizeof(RmFileHdr)) + 1) / (1 + record_size * BITMAP_WIDTH);
-        file_hdr.bitmap_size = (file_hdr.num_records_per_page + BITMAP_WIDTH - 1) / BITMAP_WIDTH;
+        RmFileHdr file_hdr = init_file_hdr(record_size);
 
         // 将file header写入磁盘文件（名为file name，文件描述符为fd）中的第0页
         // head page直接写入磁盘，没有经过缓冲区的NewPage，那么也就不需要FlushPage
@@ -55,6 +50,19 @@ class RmManager {
         disk_manager_->close_file(fd);
     }
 
+    /**
+     * @description: 创建临时表的文件句柄，记录存放在内存页面中，不创建磁盘文件、不经过缓冲池，句柄释放时记录随之释放
+     * @param {int} record_size 表中记录的大小
+     */
+    std::unique_ptr<RmFileHandle> create_temp_file(int record_size) {
+        if (record_size < 1 || record_size > RM_MAX_RECORD_SIZE) {
+            throw InvalidRecordSizeError(record_size);
+        }
+        // 第0页对应磁盘文件中的文件头页，不使用
+        auto mem_pages = std::make_unique<MemoryPageStore>(-1, RM_FIRST_RECORD_PAGE);
+        return std::make_unique<RmFileHandle>(init_file_hdr(record_size), std::move(mem_pages));
+    }
+
     /**
      * @description: 删除表的数据文件
      * @param {string&} filename 要删除的文件名称
@@ -71,17 +79,54 @@ class RmManager {
      */
     std::unique_ptr<RmFileHandle> open_file(const std::string &filename) {
         int fd = disk_manager_->open_file(filename);
-        return std::make_unique<RmFileHandle>(disk_manager_, buffer_pool_manager_, fd);
+        return std::make_unique<RmFileHandle>(disk_manager_, buffer_pool_manager_, fd, record_cache_pages_);
+    }
+
+    /**
+     * @description: 打开分区表各分区的数据文件，返回按分区转发读写的文件句柄
+     * @param {vector<string>&} filenames 各分区的数据文件名称，按分区号排列
+     * @param {function<int(const char *)>} partition_of 插入的记录所在的分区
+     * @return {unique_ptr<RmFileHandle>} 分区表的文件句柄
+     */
+    std::unique_ptr<RmFileHandle> open_partitioned_file(const std::vector<std::string> &filenames,
+                                                        std::function<int(const char *)> partition_of) {
+        std::vector<std::unique_ptr<RmFileHandle>> partitions;
+        for (auto &filename : filenames) {
+            partitions.push_back(open_file(filename));
+        }
+        return std::make_unique<RmFileHandle>(std::move(partitions), std::move(partition_of));
     }
     /**
      * @description: 关闭表的数据文件
      * @param {RmFileHandle*} file_handle 要关闭文件的句柄
      */
-    void close_file(const RmFileHandle *file_handle) {
+    void close_file(RmFileHandle *file_handle) {
+        if (!file_handle->partitions_.empty()) {
+            for (auto &partition : file_handle->partitions_) {
+                close_file(partition.get());
+            }
+            return;
+        }
+        file_handle->release_insert_pages();
         disk_manager_->write_page(file_handle->fd_, RM_FILE_HDR_PAGE, (char *)&file_handle->file_hdr_,
                                   sizeof(file_handle->file_hdr_));
         // 缓冲区的所有页刷到磁盘，注意这句话必须写在close_file前面
         buffer_pool_manager_->flush_all_pages(file_handle->fd_);
         disk_manager_->close_file(file_handle->fd_);
     }
+
+  private:
+    // 初始化file header
+    static RmFileHdr init_file_hdr(int record_size) {
+        RmFileHdr file_hdr{};
+        file_hdr.record_size = record_size;
+        file_hdr.num_pages = 1;
+        file_hdr.first_free_page_no = RM_NO_PAGE;
+        file_hdr.version = RM_FILE_VERSION;
+        // We have: sizeof(hdr) + (n + 7) / 8 + n * record_size <= PAGE_SIZE
+        file_hdr.num_records_per_page =
+            (BITMAP_WIDTH * (PAGE_SIZE - 1 - (int)sizeof(RmFileHdr)) + 1) / (1 + record_size * BITMAP_WIDTH);
+        file_hdr.bitmap_size = (file_hdr.num_records_per_page + BITMAP_WIDTH - 1) / BITMAP_WIDTH;
+        return file_hdr;
+    }
 };
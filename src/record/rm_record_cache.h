@@ -0,0 +1,149 @@
+/* Copyright (c) 2023 Renmin University of China
+RMDB is licensed under Mulan PSL v2.
+You can use this software according to the terms and conditions of the Mulan PSL v2.
+You may obtain a copy of Mulan PSL v2 at:
+        http://license.coscl.org.cn/MulanPSL2
+THIS SOFTWARE IS PROVIDED ON AN "AS IS" BASIS, WITHOUT WARRANTIES OF ANY KIND,
+EITHER EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO NON-INFRINGEMENT,
+MERCHANTABILITY OR FIT FOR A PARTICULAR PURPOSE.
+See the Mulan PSL v2 for more details. */
+
+#pragma once
+
+#include <atomic>
+#include <cstring>
+#include <memory>
+#include <mutex>
+
+#include "bitmap.h"
+#include "rm_defs.h"
+
+/**
+ * @description: 小表的记录缓存，在内存中保存表的前max_pages个数据页的bitmap和全部记录（页面中页头之后的部分）。
+ * 修改页面的线程在持有页面写锁时把改动写入缓存，版本号在写入前后各加一；读者不加锁也不访问缓冲池，
+ * 像seqlock一样先复制数据再检查版本号，读到奇数版本号或者版本号变了就返回false，由调用者改为读页面。
+ * 表增长到超过max_pages页后缓存停用，版本号停在奇数上，之后的读全部返回false
+ */
+class RmRecordCache {
+  public:
+    RmRecordCache(const RmFileHdr &file_hdr, int max_pages)
+        : max_pages_(max_pages),
+          image_size_(file_hdr.bitmap_size + file_hdr.num_records_per_page * file_hdr.record_size),
+          bitmap_size_(file_hdr.bitmap_size),
+          record_size_(file_hdr.record_size),
+          images_(new char[(size_t)max_pages * image_size_]()) {
+    }
+
+    // 缓存能否容纳该页面
+    bool covers(int page_no) const {
+        return page_no >= RM_FIRST_RECORD_PAGE && page_no < RM_FIRST_RECORD_PAGE + max_pages_;
+    }
+
+    /**
+     * @description: 读出一条记录，不加锁
+     * @return {bool} 读到一致的结果时返回true；缓存已停用、页面不在缓存中或者读的期间有写入时返回false
+     * @param {int} page_no 记录所在的页面
+     * @param {int} slot_no 记录所在的slot
+     * @param {char*} dst 记录存在时复制到这里，为nullptr时只判断记录是否存在
+     * @param {bool*} is_set 返回记录是否存在
+     */
+    bool read_record(int page_no, int slot_no, char *dst, bool *is_set) const {
+        uint64_t version = version_.load(std::memory_order_acquire);
+        if ((version & 1) || !covers(page_no)) {
+            return false;
+        }
+        const char *image = image_of(page_no);
+        *is_set = Bitmap::is_set(image, slot_no);
+        if (*is_set && dst != nullptr) {
+            memcpy(dst, image + bitmap_size_ + slot_no * record_size_, record_size_);
+        }
+        std::atomic_thread_fence(std::memory_order_acquire);
+        return version_.load(std::memory_order_relaxed) == version;
+    }
+
+    /**
+     * @description: 读出页面的前len个字节，bitmap在最前面，之后是各个slot，不加锁
+     * @return {bool} 同read_record
+     */
+    bool read_image(int page_no, size_t len, char *dst) const {
+        uint64_t version = version_.load(std::memory_order_acquire);
+        if ((version & 1) || !covers(page_no)) {
+            return false;
+        }
+        memcpy(dst, image_of(page_no), len);
+        std::atomic_thread_fence(std::memory_order_acquire);
+        return version_.load(std::memory_order_relaxed) == version;
+    }
+
+    size_t image_size() const {
+        return image_size_;
+    }
+
+    /**
+     * @description: 页面的bitmap和一条记录被修改后写入缓存，需要持有页面的写锁
+     * @param {int} page_no 被修改的页面
+     * @param {char*} image 页面中bitmap的首地址，各个slot紧跟在bitmap之后
+     * @param {int} slot_no 被修改的记录，小于0时只写入bitmap（删除记录）
+     */
+    void store_record(int page_no, const char *image, int slot_no) {
+        std::scoped_lock lock{latch_};
+        if (disabled_ || !covers(page_no)) {
+            return;
+        }
+        begin_write();
+        char *dst = image_of(page_no);
+        memcpy(dst, image, bitmap_size_);
+        if (slot_no >= 0) {
+            size_t offset = bitmap_size_ + (size_t)slot_no * record_size_;
+            memcpy(dst + offset, image + offset, record_size_);
+        }
+        end_write();
+    }
+
+    // 写入整个页面，需要持有页面的锁
+    void store_page(int page_no, const char *image) {
+        std::scoped_lock lock{latch_};
+        if (disabled_ || !covers(page_no)) {
+            return;
+        }
+        begin_write();
+        memcpy(image_of(page_no), image, image_size_);
+        end_write();
+    }
+
+    // 表的页面数超过缓存容量后停用缓存，之后不再写入，读者都改为读页面
+    void disable() {
+        std::scoped_lock lock{latch_};
+        if (!disabled_) {
+            disabled_ = true;
+            begin_write();
+        }
+    }
+
+  private:
+    int max_pages_;
+    size_t image_size_;
+    size_t bitmap_size_;
+    size_t record_size_;
+    std::unique_ptr<char[]> images_;
+    std::atomic<uint64_t> version_{0}; // 奇数表示正在写入或者缓存已停用
+    std::mutex latch_;                 // 写者之间互斥，读者不需要
+    bool disabled_ = false;
+
+    const char *image_of(int page_no) const {
+        return images_.get() + (size_t)(page_no - RM_FIRST_RECORD_PAGE) * image_size_;
+    }
+
+    char *image_of(int page_no) {
+        return images_.get() + (size_t)(page_no - RM_FIRST_RECORD_PAGE) * image_size_;
+    }
+
+    void begin_write() {
+        version_.store(version_.load(std::memory_order_relaxed) + 1, std::memory_order_relaxed);
+        std::atomic_thread_fence(std::memory_order_release);
+    }
+
+    void end_write() {
+        version_.store(version_.load(std::memory_order_relaxed) + 1, std::memory_order_release);
+    }
+};
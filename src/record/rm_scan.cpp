@@ -11,12 +11,29 @@ See the Mulan PSL v2 for more details. */
 #include "rm_scan.h"
 #include "rm_file_handle.h"
 #include <algorithm>
+#include <numeric>
+
+// 表的所有分区，非分区表只有0号分区
+static std::vector<int> all_partitions(const RmFileHandle *file_handle) {
+    std::vector<int> partitions(file_handle->num_partitions());
+    std::iota(partitions.begin(), partitions.end(), 0);
+    return partitions;
+}
+
+/**
+ * @brief 初始化file_handle和rid，扫描所有分区
+ * @param file_handle
+ */
+RmScan::RmScan(const RmFileHandle *file_handle) : RmScan(file_handle, all_partitions(file_handle)) {
+}
 
 /**
  * @brief 初始化file_handle和rid
  * @param file_handle
+ * @param partitions 要扫描的分区，升序
  */
-RmScan::RmScan(const RmFileHandle *file_handle) : file_handle_(file_handle) {
+RmScan::RmScan(const RmFileHandle *file_handle, std::vector<int> partitions)
+    : file_handle_(file_handle), partitions_(std::move(partitions)) {
     // Todo:
     // 初始化file_handle和rid（指向第一个存放了记录的位置）
 
@@ -28,25 +45,8 @@ RmScan::RmScan(const RmFileHandle *file_handle) : file_handle_(file_handle) {
     //    ^ first_free_page_no
     // 3. □ ■ ◧ ■
     //    ^ first_free_page_no
-    auto hdr = file_handle_->file_hdr_;
-    page_id_t page_no = -1;
-    int slot_no = -1;
-
     // 链表对寻找非全空无帮助，遍历page
-    int num_slot = hdr.num_records_per_page;
-    for (page_no = 1; page_no < hdr.num_pages; ++page_no) {
-        auto page_handle = file_handle->fetch_page_handle(page_no);
-        int first_one = Bitmap::first_bit(true, page_handle.bitmap, num_slot);
-        file_handle_->buffer_pool_manager_->unpin_page(page_handle.page->get_page_id(), false);
-        if (first_one < num_slot) { // 此页非全空
-            slot_no = first_one;
-            break;
-        }
-    }
-    if (slot_no == -1) { // 所有页面全空，到达终点
-        page_no = -1;
-    }
-    rid_ = Rid{page_no, slot_no};
+    seek(0, -1, -1);
 }
 
 /**
@@ -58,21 +58,30 @@ void RmScan::next() {
 
     // 1. page内部查bitmap找到下一个记录
     // 2. 整个page内后面为空(或已经在page末尾），前往下一个非全空页
-    auto hdr = file_handle_->file_hdr_;
-    int num_slot = hdr.num_records_per_page;
-    int curr = rid_.slot_no;
     assert(!is_end()); // 迭代器失效后不能再迭代
+    seek(partition_idx_, rid_.page_no, rid_.slot_no);
+}
 
-    for (int page_no = rid_.page_no; page_no < hdr.num_pages; ++page_no) {
-        // 找到此page内第一个记录
-        auto page_handle = file_handle_->fetch_page_handle(page_no);
-        int first_one = Bitmap::next_bit(true, page_handle.bitmap, num_slot, curr);
-        curr = -1; // 先搜索当前页后面，再搜索后面的页的全部
-        file_handle_->buffer_pool_manager_->unpin_page(page_handle.page->get_page_id(), false);
-        if (first_one < num_slot) {
-            rid_ = {page_no, first_one};
-            return;
+/**
+ * @brief 从partitions_[partition_idx]中的page_no页的slot_no之后开始，找到第一个存放了记录的位置，
+ * 当前分区后面没有记录时前往下一个要扫描的分区；page_no为-1时从分区的第一个数据页开始
+ */
+void RmScan::seek(size_t partition_idx, int page_no, int slot_no) {
+    int num_slot = file_handle_->file_hdr_.num_records_per_page;
+    for (; partition_idx < partitions_.size(); partition_idx++) {
+        // 页面数随插入增长，每个分区开始扫描时重新读取
+        RmPageRange range = file_handle_->page_range(partitions_[partition_idx]);
+        for (page_no = std::max(page_no, range.begin); page_no < range.end; ++page_no) {
+            // 找到此page内第一个记录
+            int first_one = file_handle_->next_record_slot(page_no, slot_no);
+            slot_no = -1; // 先搜索当前页后面，再搜索后面的页的全部
+            if (first_one < num_slot) {
+                partition_idx_ = partition_idx;
+                rid_ = {page_no, first_one};
+                return;
+            }
         }
+        page_no = -1;
     }
     rid_ = {-1, -1};
     // 到达终点
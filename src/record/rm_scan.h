@@ -10,20 +10,30 @@ See the Mulan PSL v2 for more details. */
 
 #pragma once
 
+#include <vector>
+
 #include "rm_defs.h"
 
 class RmFileHandle;
 
 class RmScan : public RecScan {
     const RmFileHandle *file_handle_;
+    std::vector<int> partitions_; // 要扫描的分区，升序
+    size_t partition_idx_ = 0;    // rid_所在的分区在partitions_中的下标
     Rid rid_;
 
   public:
     RmScan(const RmFileHandle *file_handle);
 
+    // 只扫描指定的分区，用于分区裁剪
+    RmScan(const RmFileHandle *file_handle, std::vector<int> partitions);
+
     void next() override;
 
     bool is_end() const override;
 
     Rid rid() const override;
+
+  private:
+    void seek(size_t partition_idx, int page_no, int slot_no);
 };
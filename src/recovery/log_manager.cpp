@@ -9,6 +9,7 @@ MERCHANTABILITY OR FIT FOR A PARTICULAR PURPOSE.
 See the Mulan PSL v2 for more details. */
 
 #include "log_manager.h"
+#include "common/query_stats.h"
 #include <cstring>
 
 /**
@@ -17,6 +18,7 @@ See the Mulan PSL v2 for more details. */
  * @return {lsn_t} 返回该日志的日志记录号
  */
 lsn_t LogManager::add_log_to_buffer(LogRecord *log_record) {
+    thread_stats().log_bytes += log_record->log_tot_len_;
 }
 
 /**
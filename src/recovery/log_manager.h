@@ -14,6 +14,7 @@ See the Mulan PSL v2 for more details. */
 #include "log_defs.h"
 #include "record/rm_defs.h"
 #include <iostream>
+#include <memory>
 #include <mutex>
 #include <vector>
 
@@ -170,25 +171,26 @@ class UpdateLogRecord : public LogRecord {};
 
 class LogBuffer {
   public:
-    LogBuffer() {
+    explicit LogBuffer(size_t buffer_size = LOG_BUFFER_SIZE)
+        : buffer_(new char[buffer_size + 1]()), buffer_size_(buffer_size) {
         offset_ = 0;
-        memset(buffer_, 0, sizeof(buffer_));
     }
 
     bool is_full(int append_size) {
-        if (offset_ + append_size > LOG_BUFFER_SIZE)
+        if (static_cast<size_t>(offset_ + append_size) > buffer_size_)
             return true;
         return false;
     }
 
-    char buffer_[LOG_BUFFER_SIZE + 1];
-    int offset_; // 写入log的offset
+    std::unique_ptr<char[]> buffer_;
+    size_t buffer_size_; // 缓冲区大小，启动时由配置决定
+    int offset_;         // 写入log的offset
 };
 
 /* 日志管理器，负责把日志写入日志缓冲区，以及把日志缓冲区中的内容写入磁盘中 */
 class LogManager {
   public:
-    LogManager(DiskManager *disk_manager) {
+    LogManager(DiskManager *disk_manager, size_t log_buffer_size = LOG_BUFFER_SIZE) : log_buffer_(log_buffer_size) {
         disk_manager_ = disk_manager;
     }
 
@@ -0,0 +1,94 @@
+/* Copyright (c) 2023 Renmin University of China
+RMDB is licensed under Mulan PSL v2.
+You can use this software according to the terms and conditions of the Mulan PSL v2.
+You may obtain a copy of Mulan PSL v2 at:
+        http://license.coscl.org.cn/MulanPSL2
+THIS SOFTWARE IS PROVIDED ON AN "AS IS" BASIS, WITHOUT WARRANTIES OF ANY KIND,
+EITHER EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO NON-INFRINGEMENT,
+MERCHANTABILITY OR FIT FOR A PARTICULAR PURPOSE.
+See the Mulan PSL v2 for more details. */
+
+#include "clock_replacer.h"
+
+ClockReplacer::ClockReplacer(size_t num_pages) : frames_(new FrameState[num_pages]), max_size_(num_pages) {
+}
+
+ClockReplacer::~ClockReplacer() = default;
+
+/**
+ * @description: 使用CLOCK策略选择一个victim frame：时钟指针经过访问位为1的可淘汰帧时清零，给它第二次机会，
+ * 淘汰第一个访问位为0的可淘汰帧。两圈之后所有帧的访问位都被清过一次，第三圈不再看访问位，
+ * 避免其他线程不断访问时一直找不到victim
+ * @param {frame_id_t*} frame_id 被移除的frame的id
+ * @return {bool} 如果成功淘汰了一个页面则返回true，否则返回false
+ */
+bool ClockReplacer::victim(frame_id_t *frame_id) {
+    std::scoped_lock lock{latch_};
+    for (size_t i = 0; i < 3 * max_size_ && size_.load(std::memory_order_relaxed) > 0; i++) {
+        auto &frame = frames_[hand_];
+        frame_id_t id = static_cast<frame_id_t>(hand_);
+        hand_ = (hand_ + 1) % max_size_;
+        if (!frame.evictable.load(std::memory_order_relaxed)) {
+            continue;
+        }
+        if (i < 2 * max_size_ && frame.ref.load(std::memory_order_relaxed)) {
+            frame.ref.store(false, std::memory_order_relaxed);
+            continue;
+        }
+        if (frame.evictable.exchange(false, std::memory_order_relaxed)) {
+            size_.fetch_sub(1, std::memory_order_relaxed);
+            *frame_id = id;
+            return true;
+        }
+    }
+    return false;
+}
+
+/**
+ * @description: 固定指定的frame，即该页面无法被淘汰，同时记录一次访问。
+ * 缓冲池命中时都会调用，帧已经是固定状态时只有两次读，不写共享的缓存行
+ * @param {frame_id_t} 需要固定的frame的id
+ */
+void ClockReplacer::pin(frame_id_t frame_id) {
+    check_frame_id(frame_id, "pin");
+    auto &frame = frames_[frame_id];
+    if (!frame.ref.load(std::memory_order_relaxed)) {
+        frame.ref.store(true, std::memory_order_relaxed);
+    }
+    if (frame.evictable.load(std::memory_order_relaxed) && frame.evictable.exchange(false, std::memory_order_relaxed)) {
+        size_.fetch_sub(1, std::memory_order_relaxed);
+    }
+}
+
+/**
+ * @description: 取消固定一个frame，代表该页面可以被淘汰
+ * @param {frame_id_t} frame_id 取消固定的frame的id
+ */
+void ClockReplacer::unpin(frame_id_t frame_id) {
+    check_frame_id(frame_id, "unpin");
+    auto &frame = frames_[frame_id];
+    if (!frame.ref.load(std::memory_order_relaxed)) {
+        frame.ref.store(true, std::memory_order_relaxed);
+    }
+    if (frame.evictable.load(std::memory_order_relaxed)) {
+        return;
+    }
+    if (!frame.evictable.exchange(true, std::memory_order_relaxed)) {
+        size_.fetch_add(1, std::memory_order_relaxed);
+    }
+}
+
+/**
+ * @description: 获取当前replacer中可以被淘汰的页面数量
+ */
+size_t ClockReplacer::Size() {
+    return size_.load(std::memory_order_relaxed);
+}
+
+void ClockReplacer::check_frame_id(frame_id_t frame_id, const char *func) const {
+    if (frame_id < 0 || static_cast<size_t>(frame_id) >= max_size_) {
+        char msg[80];
+        std::snprintf(msg, 80, "ClockReplacer::%s invalid frame_id: %d", func, frame_id);
+        throw InternalError(std::string(msg));
+    }
+}
@@ -0,0 +1,57 @@
+/* Copyright (c) 2023 Renmin University of China
+RMDB is licensed under Mulan PSL v2.
+You can use this software according to the terms and conditions of the Mulan PSL v2.
+You may obtain a copy of Mulan PSL v2 at:
+        http://license.coscl.org.cn/MulanPSL2
+THIS SOFTWARE IS PROVIDED ON AN "AS IS" BASIS, WITHOUT WARRANTIES OF ANY KIND,
+EITHER EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO NON-INFRINGEMENT,
+MERCHANTABILITY OR FIT FOR A PARTICULAR PURPOSE.
+See the Mulan PSL v2 for more details. */
+
+#pragma once
+
+#include <atomic>
+#include <memory>
+#include <mutex>
+
+#include "common/config.h"
+#include "errors.h"
+#include "replacer/replacer.h"
+
+/*
+ClockReplacer实现了CLOCK（second chance）替换策略。
+pin/unpin只读写该帧的访问位和可淘汰标记，不加锁，也不移动链表结点，缓冲池命中时不会在这里互相阻塞；
+victim用时钟指针扫描，跳过可淘汰帧时清除其访问位，多个victim之间加锁互斥
+*/
+class ClockReplacer : public Replacer {
+  public:
+    /**
+     * @description: 创建一个新的ClockReplacer
+     * @param {size_t} num_pages ClockReplacer最多需要存储的page数量
+     */
+    explicit ClockReplacer(size_t num_pages);
+
+    ~ClockReplacer() override;
+
+    bool victim(frame_id_t *frame_id) override;
+
+    void pin(frame_id_t frame_id) override;
+
+    void unpin(frame_id_t frame_id) override;
+
+    size_t Size() override;
+
+  private:
+    struct FrameState {
+        std::atomic<bool> ref{false};       // 访问位，pin/unpin时置位，时钟指针经过时清除
+        std::atomic<bool> evictable{false}; // 是否unpinned，可以被淘汰
+    };
+
+    std::unique_ptr<FrameState[]> frames_;
+    size_t max_size_;             // 最大容量（与缓冲池的容量相同）
+    std::atomic<size_t> size_{0}; // 可淘汰的帧数
+    std::mutex latch_;            // victim之间互斥
+    size_t hand_ = 0;             // 时钟指针，由latch_保护
+
+    void check_frame_id(frame_id_t frame_id, const char *func) const;
+};
@@ -14,9 +14,13 @@ See the Mulan PSL v2 for more details. */
 #include <netinet/in.h>
 #include <readline/history.h>
 #include <readline/readline.h>
+#include <thread>
 #include <unistd.h>
 
 #include "analyze/analyze.h"
+#include "common/result_cache.h"
+#include "common/server_config.h"
+#include "common/tracer.h"
 #include "errors.h"
 #include "optimizer/optimizer.h"
 #include "optimizer/plan.h"
@@ -24,30 +28,54 @@ See the Mulan PSL v2 for more details. */
 #include "portal.h"
 #include "recovery/log_recovery.h"
 
-#define SOCK_PORT 8765
-#define MAX_CONN_LIMIT 8
-
 static bool should_exit = false;
 
-// 构建全局所需的管理器对象
-auto disk_manager = std::make_unique<DiskManager>();
-auto buffer_pool_manager = std::make_unique<BufferPoolManager>(BUFFER_POOL_SIZE, disk_manager.get());
-auto rm_manager = std::make_unique<RmManager>(disk_manager.get(), buffer_pool_manager.get());
-auto ix_manager = std::make_unique<IxManager>(disk_manager.get(), buffer_pool_manager.get());
-auto sm_manager =
-    std::make_unique<SmManager>(disk_manager.get(), buffer_pool_manager.get(), rm_manager.get(), ix_manager.get());
-auto lock_manager = std::make_unique<LockManager>();
-auto txn_manager = std::make_unique<TransactionManager>(lock_manager.get(), sm_manager.get());
-auto planner = std::make_unique<Planner>(sm_manager.get());
-auto optimizer = std::make_unique<Optimizer>(sm_manager.get(), planner.get());
-auto ql_manager = std::make_unique<QlManager>(sm_manager.get(), txn_manager.get(), planner.get());
-auto log_manager = std::make_unique<LogManager>(disk_manager.get());
-auto recovery = std::make_unique<RecoveryManager>(disk_manager.get(), buffer_pool_manager.get(), sm_manager.get());
-auto portal = std::make_unique<Portal>(sm_manager.get());
-auto analyze = std::make_unique<Analyze>(sm_manager.get());
+// 全局所需的管理器对象，解析完启动参数后在init_managers()中构建
+std::unique_ptr<DiskManager> disk_manager;
+std::unique_ptr<BufferPoolManager> buffer_pool_manager;
+std::unique_ptr<RmManager> rm_manager;
+std::unique_ptr<IxManager> ix_manager;
+std::unique_ptr<SmManager> sm_manager;
+std::unique_ptr<LockManager> lock_manager;
+std::unique_ptr<TransactionManager> txn_manager;
+std::unique_ptr<Planner> planner;
+std::unique_ptr<Optimizer> optimizer;
+std::unique_ptr<QlManager> ql_manager;
+std::unique_ptr<LogManager> log_manager;
+std::unique_ptr<RecoveryManager> recovery;
+std::unique_ptr<Portal> portal;
+std::unique_ptr<Analyze> analyze;
+std::unique_ptr<ResultCache> result_cache; // result_cache_size为0时不创建
 pthread_mutex_t *buffer_mutex;
 pthread_mutex_t *sockfd_mutex;
 
+// 按server_config构建全局管理器对象
+void init_managers() {
+    disk_manager = std::make_unique<DiskManager>();
+    buffer_pool_manager = std::make_unique<BufferPoolManager>(server_config.buffer_pool_size, disk_manager.get(),
+                                                              server_config.replacer_type);
+    rm_manager = std::make_unique<RmManager>(disk_manager.get(), buffer_pool_manager.get(),
+                                             static_cast<int>(server_config.record_cache_pages));
+    ix_manager =
+        std::make_unique<IxManager>(disk_manager.get(), buffer_pool_manager.get(), server_config.change_buffer_size);
+    sm_manager =
+        std::make_unique<SmManager>(disk_manager.get(), buffer_pool_manager.get(), rm_manager.get(), ix_manager.get());
+    lock_manager = std::make_unique<LockManager>();
+    txn_manager = std::make_unique<TransactionManager>(lock_manager.get(), sm_manager.get());
+    planner = std::make_unique<Planner>(sm_manager.get());
+    optimizer = std::make_unique<Optimizer>(sm_manager.get(), planner.get());
+    ql_manager = std::make_unique<QlManager>(sm_manager.get(), txn_manager.get(), planner.get());
+    log_manager = std::make_unique<LogManager>(disk_manager.get(), server_config.log_buffer_size);
+    recovery = std::make_unique<RecoveryManager>(disk_manager.get(), buffer_pool_manager.get(), sm_manager.get());
+    portal = std::make_unique<Portal>(sm_manager.get());
+    analyze = std::make_unique<Analyze>(sm_manager.get());
+    if (server_config.result_cache_size > 0) {
+        result_cache = std::make_unique<ResultCache>(server_config.result_cache_size, [](const std::string &tab_name) {
+            return sm_manager->table_version(tab_name);
+        });
+    }
+}
+
 static jmp_buf jmpbuf;
 void sigint_handler(int signo) {
     should_exit = true;
@@ -67,6 +95,28 @@ void SetTransaction(txn_id_t *txn_id, Context *context) {
     }
 }
 
+// 把执行时间超过阈值的语句及其资源消耗追加到慢查询日志中
+void log_slow_query(const char *sql, Context *context) {
+    static std::mutex slow_log_latch;
+    double elapsed = context->elapsed_ms();
+    if (elapsed < server_config.slow_query_threshold_ms) {
+        return;
+    }
+    std::scoped_lock lock{slow_log_latch};
+    std::fstream outfile;
+    outfile.open(SLOW_QUERY_LOG_NAME, std::ios::out | std::ios::app);
+    outfile << "elapsed_ms=" << elapsed << " " << context->stats_.to_string() << " sql: " << sql << "\n";
+    outfile.close();
+}
+
+// 查询读到的全部表，包括where中的子查询读到的表
+void collect_query_tables(const Query &query, std::vector<std::string> *tab_names) {
+    tab_names->insert(tab_names->end(), query.tables.begin(), query.tables.end());
+    for (auto &sublink : query.sublinks) {
+        collect_query_tables(*sublink.subquery, tab_names);
+    }
+}
+
 void *client_handler(void *sock_fd) {
     int fd = *((int *)sock_fd);
     pthread_mutex_unlock(sockfd_mutex);
@@ -80,6 +130,8 @@ void *client_handler(void *sock_fd) {
     int offset = 0;
     // 记录客户端当前正在执行的事务ID
     txn_id_t txn_id = INVALID_TXN_ID;
+    // 本次连接中所有语句的资源消耗累计
+    QueryStats session_stats;
 
     std::string output = "establish client connection, sockfd: " + std::to_string(fd) + "\n";
     std::cout << output;
@@ -116,62 +168,110 @@ void *client_handler(void *sock_fd) {
         offset = 0;
 
         // 开启事务，初始化系统所需的上下文信息（包括事务对象指针、锁管理器指针、日志管理器指针、存放结果的buffer、记录结果长度的变量）
+        TRACE_SPAN("statement");
         Context *context = new Context(lock_manager.get(), log_manager.get(), nullptr, data_send, &offset);
+        context->session_id_ = fd;
         SetTransaction(&txn_id, context); // 暂时注释掉，否则会SIGSEGV
 
-        // 用于判断是否已经调用了yy_delete_buffer来删除buf
-        bool finish_analyze = false;
-        pthread_mutex_lock(buffer_mutex);
-        YY_BUFFER_STATE buf = yy_scan_string(data_recv);
-        if (yyparse() == 0) {
-            if (ast::parse_tree != nullptr) {
-                try {
-                    // analyze and rewrite
-                    std::shared_ptr<Query> query = analyze->do_analyze(ast::parse_tree);
-                    yy_delete_buffer(buf);
-                    finish_analyze = true;
-                    pthread_mutex_unlock(buffer_mutex);
-                    // 优化器
-                    std::shared_ptr<Plan> plan = optimizer->plan_query(query, context);
-                    // portal
-                    std::shared_ptr<PortalStmt> portalStmt = portal->start(plan, context);
-                    portal->run(portalStmt, ql_manager.get(), &txn_id, context);
-                    portal->drop();
-                } catch (TransactionAbortException &e) {
-                    // 事务需要回滚，需要把abort信息返回给客户端并写入output.txt文件中
-                    std::string str = "abort\n";
-                    memcpy(data_send, str.c_str(), str.length());
-                    data_send[str.length()] = '\0';
-                    offset = str.length();
-
-                    // 回滚事务
-                    txn_manager->abort(context->txn_, log_manager.get());
-                    std::cout << e.GetInfo() << std::endl;
-
-                    std::fstream outfile;
-                    outfile.open("output.txt", std::ios::out | std::ios::app);
-                    outfile << str;
-                    outfile.close();
-                } catch (RMDBError &e) {
-                    // 遇到异常，需要打印failure到output.txt文件中，并发异常信息返回给客户端
-                    std::cerr << e.what() << std::endl;
-
-                    memcpy(data_send, e.what(), e.get_msg_len());
-                    data_send[e.get_msg_len()] = '\n';
-                    data_send[e.get_msg_len() + 1] = '\0';
-                    offset = e.get_msg_len() + 1;
-
-                    // 将报错信息写入output.txt
-                    std::fstream outfile;
-                    outfile.open("output.txt", std::ios::out | std::ios::app);
-                    outfile << "failure\n";
-                    outfile.close();
-                }
+        // 结果缓存命中时直接返回缓存的结果，不需要解析、规划和执行
+        std::string cache_key;
+        bool cache_hit = false;
+        if (result_cache != nullptr) {
+            cache_key = ResultCache::normalize(data_recv);
+            std::string reply;
+            if (result_cache->lookup(cache_key, &reply, &context->select_output_)) {
+                memcpy(data_send, reply.data(), reply.size());
+                offset = reply.size();
+                std::fstream outfile;
+                outfile.open("output.txt", std::ios::out | std::ios::app);
+                outfile << context->select_output_;
+                outfile.close();
+                cache_hit = true;
             }
         }
-        if (finish_analyze == false) {
-            yy_delete_buffer(buf);
-            pthread_mutex_unlock(buffer_mutex);
+
+        if (!cache_hit) {
+            // 用于判断是否已经调用了yy_delete_buffer来删除buf
+            bool finish_analyze = false;
+            pthread_mutex_lock(buffer_mutex);
+            YY_BUFFER_STATE buf = yy_scan_string(data_recv);
+            int parse_ret;
+            {
+                TRACE_SPAN("parse");
+                parse_ret = yyparse();
+            }
+            if (parse_ret == 0) {
+                if (ast::parse_tree != nullptr) {
+                    try {
+                        // analyze and rewrite
+                        std::shared_ptr<Query> query;
+                        {
+                            TRACE_SPAN("analyze");
+                            query = analyze->do_analyze(ast::parse_tree);
+                        }
+                        // 只缓存SELECT的结果，在执行之前记下读到的各表的版本号
+                        bool cacheable = result_cache != nullptr && !query->explain_analyze &&
+                                         std::dynamic_pointer_cast<ast::SelectStmt>(ast::parse_tree) != nullptr;
+                        ResultCache::TableVersions versions;
+                        if (cacheable) {
+                            std::vector<std::string> tab_names;
+                            collect_query_tables(*query, &tab_names);
+                            versions = result_cache->snapshot(tab_names);
+                        }
+                        yy_delete_buffer(buf);
+                        finish_analyze = true;
+                        pthread_mutex_unlock(buffer_mutex);
+                        // 优化器
+                        std::shared_ptr<Plan> plan;
+                        {
+                            TRACE_SPAN("plan");
+                            plan = optimizer->plan_query(query, context);
+                        }
+                        // portal
+                        TRACE_SPAN("execute");
+                        std::shared_ptr<PortalStmt> portalStmt = portal->start(plan, context);
+                        portal->run(portalStmt, ql_manager.get(), &txn_id, context);
+                        portal->drop();
+                        if (cacheable) {
+                            result_cache->insert(cache_key, std::string(data_send, offset),
+                                                 std::move(context->select_output_), std::move(versions));
+                        }
+                    } catch (TransactionAbortException &e) {
+                        // 事务需要回滚，需要把abort信息返回给客户端并写入output.txt文件中
+                        std::string str = "abort\n";
+                        memcpy(data_send, str.c_str(), str.length());
+                        data_send[str.length()] = '\0';
+                        offset = str.length();
+
+                        // 回滚事务
+                        txn_manager->abort(context->txn_, log_manager.get());
+                        std::cout << e.GetInfo() << std::endl;
+
+                        std::fstream outfile;
+                        outfile.open("output.txt", std::ios::out | std::ios::app);
+                        outfile << str;
+                        outfile.close();
+                    } catch (RMDBError &e) {
+                        // 遇到异常，需要打印failure到output.txt文件中，并发异常信息返回给客户端
+                        std::cerr << e.what() << std::endl;
+
+                        memcpy(data_send, e.what(), e.get_msg_len());
+                        data_send[e.get_msg_len()] = '\n';
+                        data_send[e.get_msg_len() + 1] = '\0';
+                        offset = e.get_msg_len() + 1;
+
+                        // 将报错信息写入output.txt
+                        std::fstream outfile;
+                        outfile.open("output.txt", std::ios::out | std::ios::app);
+                        outfile << "failure\n";
+                        outfile.close();
+                    }
+                }
+            }
+            if (finish_analyze == false) {
+                yy_delete_buffer(buf);
+                pthread_mutex_unlock(buffer_mutex);
+            }
         }
         // future TODO: 格式化 sql_handler.result, 传给客户端
         // send result with fixed format, use protobuf in the future
@@ -183,14 +283,35 @@ void *client_handler(void *sock_fd) {
         {
             txn_manager->commit(context->txn_, context->log_mgr_);
         }
+
+        // 语句结束，合并本线程的资源统计
+        context->collect_stats();
+        session_stats.merge(context->stats_);
+        log_slow_query(data_recv, context);
+        delete context;
     }
 
     // Clear
     std::cout << "Terminating current client_connection..." << std::endl;
+    // 临时表随会话结束而删除，需要在关闭fd之前，否则fd可能被新连接复用
+    sm_manager->drop_temp_tables(fd);
+    std::cout << "session totals: " << session_stats.to_string() << std::endl;
     close(fd);          // close a file descriptor.
     pthread_exit(NULL); // terminate calling thread!
 }
 
+// 收到SIGUSR1时把tracer中的事件dump到文件，信号在专门的线程中同步处理
+void trace_signal_handler(sigset_t sigset) {
+    while (true) {
+        int signo;
+        if (sigwait(&sigset, &signo) != 0) {
+            break;
+        }
+        size_t num_events = Tracer::dump(TRACE_FILE_NAME);
+        std::cout << "dump " << num_events << " trace events to " << TRACE_FILE_NAME << std::endl;
+    }
+}
+
 void start_server() {
     // init mutex
     buffer_mutex = (pthread_mutex_t *)malloc(sizeof(pthread_mutex_t));
@@ -212,14 +333,14 @@ void start_server() {
     memset(&s_addr_in, 0, sizeof(s_addr_in));
     s_addr_in.sin_family = AF_INET;
     s_addr_in.sin_addr.s_addr = htonl(INADDR_ANY);
-    s_addr_in.sin_port = htons(SOCK_PORT);
+    s_addr_in.sin_port = htons(server_config.port);
     fd_temp = bind(sockfd_server, (struct sockaddr *)(&s_addr_in), sizeof(s_addr_in));
     if (fd_temp == -1) {
         std::cout << "Bind error!" << std::endl;
         exit(1);
     }
 
-    fd_temp = listen(sockfd_server, MAX_CONN_LIMIT);
+    fd_temp = listen(sockfd_server, server_config.max_conn_limit);
     if (fd_temp == -1) {
         std::cout << "Listen error!" << std::endl;
         exit(1);
@@ -264,11 +385,24 @@ void start_server() {
 }
 
 int main(int argc, char **argv) {
-    if (argc != 2) {
+    std::string db_name;
+    try {
+        // 配置文件和命令行参数覆盖config.h中的默认值
+        db_name = server_config.parse_args(argc, argv);
+    } catch (RMDBError &e) {
+        std::cerr << e.what() << std::endl;
+        db_name.clear();
+    }
+    if (db_name.empty()) {
         // 需要指定数据库名称
-        std::cerr << "Usage: " << argv[0] << " <database>" << std::endl;
+        std::cerr << "Usage: " << argv[0] << " [--config <file>] [--<option>=<value>]... <database>" << std::endl;
+        std::cerr << "Options: buffer-pool-size, log-buffer-size, replacer-type, port, max-conn-limit, sort-memory, "
+                     "merge-join-memory, merge-join-debug-output, enable-runtime-filter, parallel-workers, "
+                     "parallel-min-pages, pin-workers, slow-query-threshold-ms"
+                  << std::endl;
         exit(1);
     }
+    init_managers();
 
     signal(SIGINT, sigint_handler);
     try {
@@ -283,8 +417,6 @@ int main(int argc, char **argv) {
                      "Welcome to RMDB!\n"
                      "Type 'help;' for help.\n"
                      "\n";
-        // Database name is passed by args
-        std::string db_name = argv[1];
         if (!sm_manager->is_dir(db_name)) {
             // Database not found, create a new one
             sm_manager->create_db(db_name);
@@ -297,6 +429,13 @@ int main(int argc, char **argv) {
         recovery->redo();
         recovery->undo();
 
+        // SIGUSR1只由trace线程处理，需在创建其他线程之前屏蔽
+        sigset_t trace_sigset;
+        sigemptyset(&trace_sigset);
+        sigaddset(&trace_sigset, SIGUSR1);
+        pthread_sigmask(SIG_BLOCK, &trace_sigset, nullptr);
+        std::thread(trace_signal_handler, trace_sigset).detach();
+
         // 开启服务端，开始接受客户端连接
         start_server();
     } catch (RMDBError &e) {
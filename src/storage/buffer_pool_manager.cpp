@@ -9,6 +9,8 @@ MERCHANTABILITY OR FIT FOR A PARTICULAR PURPOSE.
 See the Mulan PSL v2 for more details. */
 
 #include "buffer_pool_manager.h"
+#include "common/query_stats.h"
+#include "common/tracer.h"
 #include <algorithm>
 
 /**
@@ -22,13 +24,45 @@ bool BufferPoolManager::find_victim_page(frame_id_t *frame_id) {
     // 1.1 未满获得frame
     // 1.2 已满使用lru_replacer中的方法选择淘汰页面
 
-    if (free_list_.empty()) {
-        return replacer_->victim(frame_id);
-    } else {
-        *frame_id = free_list_.front();
+    if (!free_list_.empty()) {
+        *frame_id = free_list_.front(); // 空闲帧的pin_count_已经是PIN_COUNT_FREE
         free_list_.pop_front();
         return true;
     }
+    while (replacer_->victim(frame_id)) {
+        // 无锁的fetch_page可能刚刚pin了这个帧，CAS成功后其他线程就无法再pin它。
+        // 失败时该帧被使用中，下次unpin到0时会重新交给replacer
+        int expected = 0;
+        if (pages_[*frame_id].pin_count_.compare_exchange_strong(expected, Page::PIN_COUNT_FREE,
+                                                                 std::memory_order_acquire)) {
+            return true;
+        }
+    }
+    return false;
+}
+
+/**
+ * @description: pin_count_大于0时减一，减到0时交给replacer，不需要加锁
+ * @return {bool} pin_count_已经小于等于0时返回false
+ * @param {frame_id_t} frame_id 目标帧
+ * @param {bool} is_dirty 若页面应该被标记为dirty则为true
+ */
+bool BufferPoolManager::unpin_frame(frame_id_t frame_id, bool is_dirty) {
+    Page *page = &pages_[frame_id];
+    int count = page->pin_count_.load(std::memory_order_relaxed);
+    if (count > 0 && is_dirty) {
+        page->is_dirty_.store(true, std::memory_order_relaxed); // 避免`is_dirty_`被`false`覆盖
+    }
+    while (count > 0) {
+        if (page->pin_count_.compare_exchange_weak(count, count - 1, std::memory_order_acq_rel,
+                                                   std::memory_order_relaxed)) {
+            if (count == 1) {
+                replacer_->unpin(frame_id);
+            }
+            return true;
+        }
+    }
+    return false;
 }
 
 /**
@@ -50,7 +84,7 @@ void BufferPoolManager::update_page(Page *page, PageId new_page_id, frame_id_t n
     }
     page_table_.erase(page_id);
 
-    page_table_[new_page_id] = new_frame_id;
+    page_table_.insert(new_page_id, new_frame_id);
 
     Page *ptr = &pages_[new_frame_id];
     ptr->is_dirty_ = false;
@@ -58,6 +92,22 @@ void BufferPoolManager::update_page(Page *page, PageId new_page_id, frame_id_t n
     ptr->id_ = new_page_id;
 }
 
+/**
+ * @description: 当前线程的命中次数累加到的分片，线程第一次命中时按顺序分配，之后固定不变
+ */
+static int hit_shard_of_thread() {
+    static std::atomic<int> next_shard{0};
+    thread_local int shard = next_shard.fetch_add(1, std::memory_order_relaxed) % BUFFER_POOL_HIT_SHARDS;
+    return shard;
+}
+
+/**
+ * @description: 记一次fd上的命中，只写当前线程的分片
+ */
+void BufferPoolManager::count_hit(int fd) {
+    hit_shards_[hit_shard_of_thread()].hits[fd].fetch_add(1, std::memory_order_relaxed);
+}
+
 /**
  * @description: 从buffer pool获取需要的页。
  *              如果页表中存在page_id（说明该page在缓冲池中），并且pin_count++。
@@ -75,25 +125,74 @@ Page *BufferPoolManager::fetch_page(PageId page_id) {
     // 3.     调用disk_manager_的read_page读取目标页到frame
     // 4.     固定目标页，更新pin_count_
     // 5.     返回目标页
+    thread_stats().bp_fetches++;
+    frame_id_t frame_id;
+    // 命中时不加锁：查页表得到的帧pin成功后不会再被替换，但在查表和pin之间可能已经换成了别的页面，需要检查id_
+    if (page_table_.find(page_id, &frame_id)) {
+        Page *p = &pages_[frame_id];
+        if (p->try_pin()) {
+            if (p->id_ == page_id) {
+                count_hit(page_id.fd);
+                replacer_->pin(frame_id);
+                return p;
+            }
+            unpin_frame(frame_id, false);
+        }
+    }
     std::scoped_lock lock{latch_};
-    if (page_table_.find(page_id) != page_table_.end()) { // 在buffer pool中
-        Page *p = &pages_[page_table_[page_id]];
-        // pin_cout_ == 0时此页还能留在buffer_pool中，可能已经unpinned，确保已经pin
-        replacer_->pin(page_table_[page_id]);
-        p->pin_count_++;
+    if (page_table_.find(page_id, &frame_id)) { // 加锁前被其他线程加载，或者无锁的查找和pin没有成功
+        count_hit(page_id.fd);
+        Page *p = &pages_[frame_id];
+        // pin_cout_ == 0时此页还能留在buffer_pool中，可能已经unpinned，确保已经pin。页表中的帧只在latch_下被替换
+        p->pin_count_.fetch_add(1, std::memory_order_acquire);
+        replacer_->pin(frame_id);
         return p;
     }
+    TRACE_SPAN("BufferPoolManager::fetch_page miss");
     frame_id_t victim;
     if (!find_victim_page(&victim)) {
         return nullptr; // 没有可淘汰页或空闲页，无法加载到buffer pool中
     }
+    thread_stats().bp_misses++;
+    misses_[page_id.fd].fetch_add(1, std::memory_order_relaxed);
     update_page(&pages_[victim], page_id, victim);
     disk_manager_->read_page(page_id.fd, page_id.page_no, pages_[victim].get_data(), PAGE_SIZE);
-    pages_[victim].pin_count_ = 1;
+    pages_[victim].pin_count_.store(1, std::memory_order_release); // 之后无锁的fetch_page才能pin这个帧
     replacer_->pin(victim); // 该页首次pin
     return &pages_[victim];
 }
 
+/**
+ * @description: fetch_page并加读锁，守卫析构时解锁并unpin
+ * @return {ReadPageGuard} 缓冲池中没有可用的帧时返回空守卫
+ * @param {PageId} page_id 需要获取的页的PageId
+ */
+ReadPageGuard BufferPoolManager::fetch_page_read(PageId page_id) {
+    return ReadPageGuard(this, fetch_page(page_id));
+}
+
+/**
+ * @description: fetch_page并加写锁，守卫析构时解锁并unpin，修改过页面时由mark_dirty()决定是否为脏页
+ * @return {WritePageGuard} 缓冲池中没有可用的帧时返回空守卫
+ * @param {PageId} page_id 需要获取的页的PageId
+ */
+WritePageGuard BufferPoolManager::fetch_page_write(PageId page_id) {
+    return WritePageGuard(this, fetch_page(page_id));
+}
+
+/**
+ * @description: new_page并加写锁，新页面总是脏页
+ * @return {WritePageGuard} 创建失败时返回空守卫
+ * @param {PageId*} page_id 当成功创建一个新的page时存储其page_id
+ */
+WritePageGuard BufferPoolManager::new_page_write(PageId *page_id) {
+    WritePageGuard guard(this, new_page(page_id));
+    if (guard) {
+        guard.mark_dirty();
+    }
+    return guard;
+}
+
 /**
  * @description: 取消固定pin_count>0的在缓冲池中的page
  * @return {bool} 如果目标页的pin_count<=0则返回false，否则返回true
@@ -110,24 +209,15 @@ bool BufferPoolManager::unpin_page(PageId page_id, bool is_dirty) {
     // 2.2 若pin_count_大于0，则pin_count_自减一
     // 2.2.1 若自减后等于0，则调用replacer_的Unpin
     // 3 根据参数is_dirty，更改P的is_dirty_
-    std::scoped_lock lock{latch_};
-    if (page_table_.find(page_id) == page_table_.end()) {
-        return false;
-    }
-    Page *p = &pages_[page_table_[page_id]];
-    bool retval = p->pin_count_ > 0;
-    if (p->pin_count_ == 0) {
-        return false;
-    } else if (p->pin_count_ > 0) {
-        p->pin_count_--;
-    }
-    if (p->pin_count_ == 0) {
-        replacer_->unpin(page_table_[page_id]);
-    }
-    if (is_dirty) {
-        p->is_dirty_ = true; // 避免`p->is_dirty_`被`false`覆盖
+    // 调用者持有该页面的pin，页面不会被替换，查到的帧就是页面所在的帧。无锁查找失败时加锁再查一次
+    frame_id_t frame_id;
+    if (!page_table_.find(page_id, &frame_id)) {
+        std::scoped_lock lock{latch_};
+        if (!page_table_.find(page_id, &frame_id)) {
+            return false;
+        }
     }
-    return retval;
+    return unpin_frame(frame_id, is_dirty);
 }
 
 /**
@@ -143,11 +233,11 @@ bool BufferPoolManager::flush_page(PageId page_id) {
     // 2. 无论P是否为脏都将其写回磁盘。
     // 3. 更新P的is_dirty_
     std::scoped_lock lock{latch_};
-    auto it = page_table_.find(page_id);
-    if (it == page_table_.end()) {
+    frame_id_t frame_id;
+    if (!page_table_.find(page_id, &frame_id)) {
         return false;
     }
-    Page *p = &pages_[it->second];
+    Page *p = &pages_[frame_id];
     disk_manager_->write_page(page_id.fd, page_id.page_no, p->data_, PAGE_SIZE);
     p->is_dirty_ = false;
     return true;
@@ -171,8 +261,10 @@ Page *BufferPoolManager::new_page(PageId *page_id) {
     }
     page_id->page_no = disk_manager_->allocate_page(page_id->fd);
     update_page(&pages_[victim], *page_id, victim);
+    // 被替换的帧中还是原来页面的数据，新页面从全0开始（B+树分裂时新结点的num_key不能继承旧数据）
+    pages_[victim].reset_memory();
+    pages_[victim].pin_count_.store(1, std::memory_order_release);
     replacer_->pin(victim);
-    pages_[victim].pin_count_ = 1;
     return &pages_[victim];
 }
 
@@ -187,21 +279,27 @@ bool BufferPoolManager::delete_page(PageId page_id) {
     // 3.   将目标页数据写回磁盘，从页表中删除目标页，重置其元数据，将其加入free_list_，返回true
 
     std::scoped_lock lock{latch_};
-    auto it = page_table_.find(page_id);
-    if (it == page_table_.end()) {
+    frame_id_t frame_id;
+    if (!page_table_.find(page_id, &frame_id)) {
         return true;
     }
-    if (pages_[it->second].pin_count_ != 0) {
+    Page *page = &pages_[frame_id];
+    // 和无锁的fetch_page竞争，CAS成功后其他线程就无法再pin这个帧
+    int expected = 0;
+    if (!page->pin_count_.compare_exchange_strong(expected, Page::PIN_COUNT_FREE, std::memory_order_acquire)) {
         return false;
     }
-    Page *page = &pages_[it->second];
     if (page->is_dirty_) {
         disk_manager_->write_page(page_id.fd, page_id.page_no, page->data_, PAGE_SIZE);
         //        page->is_dirty_ = false;  // no need
     }
-    memset(page, 0, sizeof(Page)); // 填充零
-    free_list_.push_back(it->second);
-    page_table_.erase(it);
+    // Page中有读写锁，不能整体memset
+    page->reset_memory();
+    page->id_ = PageId{};
+    page->is_dirty_ = false;
+    free_list_.push_back(frame_id);
+    page_table_.erase(page_id);
+    replacer_->pin(frame_id); // 从replacer中移除，空闲帧只能从free_list_中取得
     return true;
 }
 
@@ -217,4 +315,58 @@ void BufferPoolManager::flush_all_pages(int fd) {
             disk_manager_->write_page(fd, page_id.page_no, pages_[i].data_, PAGE_SIZE);
         }
     }
-}
\ No newline at end of file
+}
+/**
+ * @description: 统计每个文件驻留/脏/固定的帧数以及命中率。
+ *              按批扫描帧数组，每批只短暂持有latch_，不会长时间阻塞fetch_page等操作，
+ *              因此结果是近似的快照。
+ * @return {BufferPoolStats} 缓冲池统计信息
+ */
+BufferPoolStats BufferPoolManager::get_stats() {
+    static constexpr size_t FRAME_SCAN_BATCH = 1024;
+    BufferPoolStats stats;
+    stats.pool_size = pool_size_;
+    for (size_t begin = 0; begin < pool_size_; begin += FRAME_SCAN_BATCH) {
+        std::scoped_lock lock{latch_};
+        for (size_t i = begin; i < std::min(pool_size_, begin + FRAME_SCAN_BATCH); i++) {
+            Page *page = &pages_[i];
+            frame_id_t frame_id;
+            if (!page_table_.find(page->id_, &frame_id) || frame_id != static_cast<frame_id_t>(i)) {
+                continue; // 空闲帧
+            }
+            auto &file_stats = stats.files[page->id_.fd];
+            file_stats.resident++;
+            file_stats.dirty += page->is_dirty() ? 1 : 0;
+            file_stats.pinned += page->get_pin_count() > 0 ? 1 : 0;
+        }
+    }
+    {
+        std::scoped_lock lock{latch_};
+        stats.free_list_size = free_list_.size();
+    }
+    stats.replacer_size = replacer_->Size();
+    for (int fd = 0; fd < DiskManager::MAX_FD; fd++) {
+        uint64_t hits = 0;
+        for (auto &shard : hit_shards_) {
+            hits += shard.hits[fd].load(std::memory_order_relaxed);
+        }
+        uint64_t misses = misses_[fd].load(std::memory_order_relaxed);
+        if (hits != 0 || misses != 0) {
+            stats.files[fd].hits = hits;
+            stats.files[fd].misses = misses;
+        }
+    }
+    return stats;
+}
+
+/**
+ * @description: 清零所有文件的命中/未命中计数
+ */
+void BufferPoolManager::reset_stats() {
+    for (int fd = 0; fd < DiskManager::MAX_FD; fd++) {
+        for (auto &shard : hit_shards_) {
+            shard.hits[fd].store(0, std::memory_order_relaxed);
+        }
+        misses_[fd].store(0, std::memory_order_relaxed);
+    }
+}
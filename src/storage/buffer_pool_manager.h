@@ -13,39 +13,66 @@ See the Mulan PSL v2 for more details. */
 #include <unistd.h>
 
 #include <cassert>
+#include <atomic>
 #include <list>
-#include <unordered_map>
+#include <map>
 #include <vector>
 
 #include "disk_manager.h"
 #include "errors.h"
 #include "page.h"
+#include "page_guard.h"
+#include "page_table.h"
+#include "replacer/clock_replacer.h"
 #include "replacer/lru_replacer.h"
 #include "replacer/replacer.h"
 
+// 某个文件在缓冲池中的帧统计
+struct BufferPoolFileStats {
+    size_t resident = 0; // 驻留在缓冲池中的帧数
+    size_t dirty = 0;    // 其中的脏页数
+    size_t pinned = 0;   // 其中pin_count_ > 0的帧数
+    uint64_t hits = 0;   // 自上次reset_stats()以来fetch_page命中的次数
+    uint64_t misses = 0; // 自上次reset_stats()以来fetch_page未命中的次数
+};
+
+// SHOW BUFFER POOL的数据来源
+struct BufferPoolStats {
+    std::map<int, BufferPoolFileStats> files; // fd -> 统计信息
+    size_t pool_size = 0;
+    size_t free_list_size = 0;
+    size_t replacer_size = 0;
+};
+
 class BufferPoolManager {
   private:
+    // 一个分片的各文件命中次数，按缓存行对齐，不同分片之间没有伪共享
+    struct alignas(64) HitShard {
+        std::atomic<uint64_t> hits[DiskManager::MAX_FD]{};
+    };
+
     size_t pool_size_; // buffer_pool中可容纳页面的个数，即帧的个数
     Page *pages_; // buffer_pool中的Page对象数组，在构造空间中申请内存空间，在析构函数中释放，大小为BUFFER_POOL_SIZE
-    std::unordered_map<PageId, frame_id_t, PageIdHash>
-        page_table_; // 帧号和页面号的映射哈希表，用于根据页面的PageId定位该页面的帧编号
+    PageTable page_table_; // 帧号和页面号的映射哈希表，用于根据页面的PageId定位该页面的帧编号，查找不需要加锁
     std::list<frame_id_t> free_list_; // 空闲帧编号的链表
     DiskManager *disk_manager_;
-    Replacer *replacer_; // buffer_pool的置换策略，当前赛题中为LRU置换策略
-    std::mutex latch_;   // 用于共享数据结构的并发控制
+    Replacer *replacer_; // buffer_pool的置换策略，默认为CLOCK置换策略
+    // 保护free_list_、页表的修改和页面的替换；命中的fetch_page和unpin_page不需要加锁
+    std::mutex latch_;
+    // 按文件统计的命中/未命中次数，读取时不需要加锁。命中不加锁且最频繁，按线程分片累加，读取时求和
+    HitShard hit_shards_[BUFFER_POOL_HIT_SHARDS];
+    std::atomic<uint64_t> misses_[DiskManager::MAX_FD]{};
 
   public:
-    BufferPoolManager(size_t pool_size, DiskManager *disk_manager)
-        : pool_size_(pool_size), disk_manager_(disk_manager) {
+    BufferPoolManager(size_t pool_size, DiskManager *disk_manager, const std::string &replacer_type = REPLACER_TYPE)
+        : pool_size_(pool_size), page_table_(pool_size), disk_manager_(disk_manager) {
         // 为buffer pool分配一块连续的内存空间
         pages_ = new Page[pool_size_];
         // 可以被Replacer改变
-        if (REPLACER_TYPE == "LRU")
-            replacer_ = new LRUReplacer(pool_size_);
-        else if (REPLACER_TYPE == "CLOCK")
+        if (replacer_type == "LRU")
             replacer_ = new LRUReplacer(pool_size_);
         else {
-            replacer_ = new LRUReplacer(pool_size_);
+            replacer_ = new ClockReplacer(pool_size_);
         }
         // 初始化时，所有的page都在free_list_中
         for (size_t i = 0; i < pool_size_; ++i) {
@@ -63,12 +90,24 @@ class BufferPoolManager {
      * @param {Page*} page 脏页
      */
     static void mark_dirty(Page *page) {
-        page->is_dirty_ = true;
+        page->is_dirty_.store(true, std::memory_order_relaxed);
+    }
+
+    // 页面当前是否在缓冲池中，不加锁也不pin，返回后随时可能被换出或读入，只能作为提示
+    bool is_resident(PageId page_id) const {
+        frame_id_t frame_id;
+        return page_table_.find(page_id, &frame_id);
     }
 
   public:
     Page *fetch_page(PageId page_id);
 
+    ReadPageGuard fetch_page_read(PageId page_id);
+
+    WritePageGuard fetch_page_write(PageId page_id);
+
+    WritePageGuard new_page_write(PageId *page_id);
+
     bool unpin_page(PageId page_id, bool is_dirty);
 
     bool flush_page(PageId page_id);
@@ -79,8 +118,16 @@ class BufferPoolManager {
 
     void flush_all_pages(int fd);
 
+    BufferPoolStats get_stats();
+
+    void reset_stats();
+
   private:
     bool find_victim_page(frame_id_t *frame_id);
 
+    bool unpin_frame(frame_id_t frame_id, bool is_dirty);
+
     void update_page(Page *page, PageId new_page_id, frame_id_t new_frame_id);
-};
\ No newline at end of file
+
+    void count_hit(int fd);
+};
\ No newline at end of file
@@ -13,8 +13,10 @@ See the Mulan PSL v2 for more details. */
 #include <assert.h>   // for assert
 #include <string.h>   // for memset
 #include <sys/stat.h> // for stat
-#include <unistd.h>   // for lseek
+#include <unistd.h>   // for lseek, pread, pwrite
 
+#include "common/query_stats.h"
+#include "common/tracer.h"
 #include "defs.h"
 
 DiskManager::DiskManager() {
@@ -33,11 +35,13 @@ void DiskManager::write_page(int fd, page_id_t page_no, const char *offset, int
     // 1.lseek()定位到文件头，通过(fd,page_no)可以定位指定页面及其在磁盘文件中的偏移量
     // 2.调用write()函数
     // 注意write返回值与num_bytes不等时 throw InternalError("DiskManager::write_page Error");
+    TRACE_SPAN("DiskManager::write_page");
 
-    lseek(fd, page_no * PAGE_SIZE, SEEK_SET);
-    if (write(fd, offset, num_bytes) != num_bytes) {
+    // 使用pwrite，不依赖共享的文件偏移量，多个线程可以同时读写同一个文件
+    if (pwrite(fd, offset, num_bytes, (off_t)page_no * PAGE_SIZE) != num_bytes) {
         throw InternalError("DiskManager::write_page Error");
     }
+    thread_stats().pages_written++;
 }
 
 /**
@@ -52,10 +56,11 @@ void DiskManager::read_page(int fd, page_id_t page_no, char *offset, int num_byt
     // 1.lseek()定位到文件头，通过(fd,page_no)可以定位指定页面及其在磁盘文件中的偏移量
     // 2.调用read()函数
     // 注意read返回值与num_bytes不等时，throw InternalError("DiskManager::read_page Error");
-    lseek(fd, page_no * PAGE_SIZE, SEEK_SET);
-    if (read(fd, offset, num_bytes) != num_bytes) {
+    TRACE_SPAN("DiskManager::read_page");
+    if (pread(fd, offset, num_bytes, (off_t)page_no * PAGE_SIZE) != num_bytes) {
         throw InternalError("DiskManager::read_page Error");
     }
+    thread_stats().pages_read++;
 }
 
 /**
@@ -257,4 +262,4 @@ void DiskManager::write_log(char *log_data, int size) {
     if (bytes_write != size) {
         throw UnixError();
     }
-}
\ No newline at end of file
+}
\ No newline at end of file
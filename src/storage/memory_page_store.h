@@ -0,0 +1,119 @@
+/* Copyright (c) 2023 Renmin University of China
+RMDB is licensed under Mulan PSL v2.
+You can use this software according to the terms and conditions of the Mulan PSL v2.
+You may obtain a copy of Mulan PSL v2 at:
+        http://license.coscl.org.cn/MulanPSL2
+THIS SOFTWARE IS PROVIDED ON AN "AS IS" BASIS, WITHOUT WARRANTIES OF ANY KIND,
+EITHER EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO NON-INFRINGEMENT,
+MERCHANTABILITY OR FIT FOR A PARTICULAR PURPOSE.
+See the Mulan PSL v2 for more details. */
+
+#pragma once
+
+#include <atomic>
+#include <mutex>
+
+#include "errors.h"
+#include "page.h"
+#include "page_guard.h"
+
+/**
+ * @description: 临时表的页面存储。页面从内存中成块分配，不进缓冲池、不写日志也不读写磁盘，随存储对象一起释放。
+ * 第k块有FIRST_CHUNK_PAGES << k个页面，块目录大小固定，分配新块不会移动已有的页面，所以查找页面不需要加锁，
+ * 只有分配页面时持有latch_。页面不会被替换，返回的守卫bpm为nullptr，只负责页面的读写锁
+ */
+class MemoryPageStore {
+  public:
+    /**
+     * @param {int} fd 页面的PageId中使用的文件描述符，临时表没有文件，通常为-1
+     * @param {int} num_reserved_pages 预先分配的页面数，页号从0开始，与磁盘文件中文件头等固定页面的页号对应
+     */
+    MemoryPageStore(int fd, int num_reserved_pages) : fd_(fd) {
+        for (int i = 0; i < num_reserved_pages; i++) {
+            allocate_page();
+        }
+    }
+
+    ~MemoryPageStore() {
+        for (auto &chunk : chunks_) {
+            delete[] chunk.load(std::memory_order_relaxed);
+        }
+    }
+
+    MemoryPageStore(const MemoryPageStore &) = delete;
+    MemoryPageStore &operator=(const MemoryPageStore &) = delete;
+
+    // 页面不存在时得到空守卫
+    ReadPageGuard fetch_page_read(PageId page_id) {
+        return ReadPageGuard(nullptr, get_page(page_id.page_no));
+    }
+
+    WritePageGuard fetch_page_write(PageId page_id) {
+        return WritePageGuard(nullptr, get_page(page_id.page_no));
+    }
+
+    /**
+     * @description: 分配下一个页号的页面，内容全为0，返回时已加写锁
+     * @param {PageId*} page_id 返回新页面的PageId
+     */
+    WritePageGuard new_page_write(PageId *page_id) {
+        Page *page;
+        {
+            std::scoped_lock lock{latch_};
+            page = allocate_page();
+        }
+        *page_id = page->get_page_id();
+        return WritePageGuard(nullptr, page);
+    }
+
+    int get_num_pages() const {
+        return num_pages_.load(std::memory_order_acquire);
+    }
+
+  private:
+    static constexpr int FIRST_CHUNK_PAGES = 16; // 第一块的页面数，小的临时表只占用64KB
+    static constexpr int MAX_CHUNKS = 26;        // 总共约10亿个页面，不会用完
+
+    int fd_;
+    std::mutex latch_; // 分配页面时持有
+    std::atomic<int> num_pages_{0};
+    std::atomic<Page *> chunks_[MAX_CHUNKS] = {};
+
+    // 页号page_no所在的块和块内的下标：page_no + FIRST_CHUNK_PAGES的最高位决定块号
+    static void locate(page_id_t page_no, int *chunk, int *offset) {
+        unsigned n = (unsigned)page_no + FIRST_CHUNK_PAGES;
+        int high_bit = 31 - __builtin_clz(n);
+        *chunk = high_bit - __builtin_ctz(FIRST_CHUNK_PAGES);
+        *offset = (int)(n - (1u << high_bit));
+    }
+
+    Page *get_page(page_id_t page_no) const {
+        if (page_no < 0 || page_no >= num_pages_.load(std::memory_order_acquire)) {
+            return nullptr;
+        }
+        int chunk, offset;
+        locate(page_no, &chunk, &offset);
+        return &chunks_[chunk].load(std::memory_order_acquire)[offset];
+    }
+
+    // 需要持有latch_（构造时除外），块的第一个页面被分配时才分配整块
+    Page *allocate_page() {
+        page_id_t page_no = num_pages_.load(std::memory_order_relaxed);
+        int chunk, offset;
+        locate(page_no, &chunk, &offset);
+        if (chunk >= MAX_CHUNKS) {
+            throw InternalError("MemoryPageStore::allocate_page out of pages");
+        }
+        if (offset == 0) {
+            int chunk_pages = FIRST_CHUNK_PAGES << chunk;
+            Page *pages = new Page[chunk_pages];
+            for (int i = 0; i < chunk_pages; i++) {
+                pages[i].id_ = PageId{fd_, page_no + i};
+            }
+            chunks_[chunk].store(pages, std::memory_order_release);
+        }
+        Page *page = &chunks_[chunk].load(std::memory_order_relaxed)[offset];
+        num_pages_.store(page_no + 1, std::memory_order_release);
+        return page;
+    }
+};
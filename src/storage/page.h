@@ -10,6 +10,11 @@ See the Mulan PSL v2 for more details. */
 
 #pragma once
 
+#include <atomic>
+#include <cstring>
+#include <shared_mutex>
+#include <thread>
+
 #include "common/config.h"
 
 /**
@@ -56,6 +61,7 @@ template <> struct std::hash<PageId> {
  */
 class Page {
     friend class BufferPoolManager;
+    friend class MemoryPageStore;
 
   public:
     Page() {
@@ -73,13 +79,15 @@ class Page {
     }
 
     bool is_dirty() const {
-        return is_dirty_;
+        return is_dirty_.load(std::memory_order_relaxed);
     }
 
     static constexpr size_t OFFSET_PAGE_START = 0;
     static constexpr size_t OFFSET_LSN = 0;
     static constexpr size_t OFFSET_PAGE_HDR = 4;
 
+    static constexpr int PIN_COUNT_FREE = -1; // 帧在free_list_中，或者被某个线程选中正在替换
+
     inline lsn_t get_page_lsn() {
         return *reinterpret_cast<lsn_t *>(get_data() + OFFSET_LSN);
     }
@@ -88,11 +96,66 @@ class Page {
         memcpy(get_data() + OFFSET_LSN, &page_lsn, sizeof(lsn_t));
     }
 
+    // 空闲或正在被替换的帧返回PIN_COUNT_FREE
     inline int get_pin_count() const {
-        return pin_count_;
+        return pin_count_.load(std::memory_order_relaxed);
+    }
+
+    /**
+     * @description: 获取页面的写锁。已经持有写锁的线程可以再次获取（B+树分裂时会再次fetch正在修改的结点），
+     * 释放同样次数后才真正解锁。通常不直接调用，而是通过WritePageGuard
+     */
+    void w_latch() {
+        if (writer_.load(std::memory_order_relaxed) == std::this_thread::get_id()) {
+            write_depth_++;
+            return;
+        }
+        rwlatch_.lock();
+        writer_.store(std::this_thread::get_id(), std::memory_order_relaxed);
+        write_depth_ = 1;
+    }
+
+    void w_unlatch() {
+        if (--write_depth_ == 0) {
+            writer_.store(std::thread::id(), std::memory_order_relaxed);
+            rwlatch_.unlock();
+        }
+    }
+
+    /**
+     * @description: 获取页面的读锁。本线程已经持有写锁时按写锁重入处理
+     * @return {bool} true: 获取了读锁，用r_unlatch()释放；false: 写锁重入，用w_unlatch()释放
+     */
+    bool r_latch() {
+        if (writer_.load(std::memory_order_relaxed) == std::this_thread::get_id()) {
+            write_depth_++;
+            return false;
+        }
+        rwlatch_.lock_shared();
+        return true;
+    }
+
+    void r_unlatch() {
+        rwlatch_.unlock_shared();
     }
 
   private:
+    /**
+     * @description: pin_count_不小于0时加一。不需要持有缓冲池的latch_，pin成功后帧不会被替换，
+     * 但帧中可能已经换成了别的页面，调用者需要再检查id_
+     * @return {bool} 帧空闲或正在被替换时返回false
+     */
+    bool try_pin() {
+        int count = pin_count_.load(std::memory_order_relaxed);
+        while (count >= 0) {
+            if (pin_count_.compare_exchange_weak(count, count + 1, std::memory_order_acquire,
+                                                 std::memory_order_relaxed)) {
+                return true;
+            }
+        }
+        return false;
+    }
+
     void reset_memory() {
         memset(data_, OFFSET_PAGE_START, PAGE_SIZE);
     } // 将data_的PAGE_SIZE个字节填充为0
@@ -105,9 +168,14 @@ class Page {
      */
     char data_[PAGE_SIZE] = {};
 
-    /** 脏页判断 */
-    bool is_dirty_ = false;
+    /** 脏页判断，在减少pin_count_之前设置，替换该帧的线程一定能看到 */
+    std::atomic<bool> is_dirty_{false};
+
+    /** The pin count of this page. 只在latch_下从0变为PIN_COUNT_FREE，从PIN_COUNT_FREE变为1 */
+    std::atomic<int> pin_count_{PIN_COUNT_FREE};
 
-    /** The pin count of this page. */
-    int pin_count_ = 0;
+    /** 页面内容的读写锁，和pin_count_无关，由持有pin的线程获取 */
+    std::shared_mutex rwlatch_;
+    std::atomic<std::thread::id> writer_{}; // 持有写锁的线程，只有该线程自己会读到自己的id
+    int write_depth_ = 0;                   // 写锁的重入次数，只由持有写锁的线程访问
 };
\ No newline at end of file
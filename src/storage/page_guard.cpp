@@ -0,0 +1,71 @@
+/* Copyright (c) 2023 Renmin University of China
+RMDB is licensed under Mulan PSL v2.
+You can use this software according to the terms and conditions of the Mulan PSL v2.
+You may obtain a copy of Mulan PSL v2 at:
+        http://license.coscl.org.cn/MulanPSL2
+THIS SOFTWARE IS PROVIDED ON AN "AS IS" BASIS, WITHOUT WARRANTIES OF ANY KIND,
+EITHER EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO NON-INFRINGEMENT,
+MERCHANTABILITY OR FIT FOR A PARTICULAR PURPOSE.
+See the Mulan PSL v2 for more details. */
+
+#include "page_guard.h"
+#include "buffer_pool_manager.h"
+
+/**
+ * @description: 对已经pin的页面加锁，page为nullptr（缓冲池已满）时得到空守卫
+ * @param {BufferPoolManager*} bpm 页面所在的缓冲池，析构时在其中unpin；为nullptr时页面在MemoryPageStore中，不需要unpin
+ * @param {Page*} page 已经pin的页面
+ * @param {bool} exclusive true加写锁，false加读锁
+ */
+PageGuard::PageGuard(BufferPoolManager *bpm, Page *page, bool exclusive) : bpm_(bpm), page_(page) {
+    if (page_ == nullptr) {
+        return;
+    }
+    if (exclusive) {
+        page_->w_latch();
+        latch_ = Latch::EXCLUSIVE;
+    } else {
+        latch_ = page_->r_latch() ? Latch::SHARED : Latch::EXCLUSIVE;
+    }
+}
+
+PageGuard::PageGuard(PageGuard &&that) noexcept
+    : bpm_(that.bpm_), page_(that.page_), latch_(that.latch_), is_dirty_(that.is_dirty_) {
+    that.page_ = nullptr;
+    that.latch_ = Latch::NONE;
+    that.is_dirty_ = false;
+}
+
+PageGuard &PageGuard::operator=(PageGuard &&that) noexcept {
+    if (this != &that) {
+        release();
+        bpm_ = that.bpm_;
+        page_ = that.page_;
+        latch_ = that.latch_;
+        is_dirty_ = that.is_dirty_;
+        that.page_ = nullptr;
+        that.latch_ = Latch::NONE;
+        that.is_dirty_ = false;
+    }
+    return *this;
+}
+
+/**
+ * @description: 先解锁再unpin，unpin之后页面可能被淘汰，不能再访问
+ */
+void PageGuard::release() {
+    if (page_ == nullptr) {
+        return;
+    }
+    if (latch_ == Latch::EXCLUSIVE) {
+        page_->w_unlatch();
+    } else if (latch_ == Latch::SHARED) {
+        page_->r_unlatch();
+    }
+    if (bpm_ != nullptr) {
+        bpm_->unpin_page(page_->get_page_id(), is_dirty_);
+    }
+    page_ = nullptr;
+    latch_ = Latch::NONE;
+    is_dirty_ = false;
+}
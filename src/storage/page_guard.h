@@ -0,0 +1,97 @@
+/* Copyright (c) 2023 Renmin University of China
+RMDB is licensed under Mulan PSL v2.
+You can use this software according to the terms and conditions of the Mulan PSL v2.
+You may obtain a copy of Mulan PSL v2 at:
+        http://license.coscl.org.cn/MulanPSL2
+THIS SOFTWARE IS PROVIDED ON AN "AS IS" BASIS, WITHOUT WARRANTIES OF ANY KIND,
+EITHER EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO NON-INFRINGEMENT,
+MERCHANTABILITY OR FIT FOR A PARTICULAR PURPOSE.
+See the Mulan PSL v2 for more details. */
+
+#pragma once
+
+#include <cassert>
+
+#include "page.h"
+
+class BufferPoolManager;
+
+/**
+ * @description: 页面守卫，持有一个已经pin的页面和它的读锁或写锁，析构或release()时解锁并unpin。
+ * 只能移动，被移动的守卫变为空守卫；移动赋值先释放自己原来持有的页面。
+ * 由BufferPoolManager::fetch_page_read/fetch_page_write/new_page_write创建，缓冲池满时得到空守卫；
+ * 临时表的页面由MemoryPageStore创建，bpm_为nullptr，只解锁不unpin
+ */
+class PageGuard {
+  public:
+    PageGuard() = default;
+
+    PageGuard(const PageGuard &) = delete;
+    PageGuard &operator=(const PageGuard &) = delete;
+
+    PageGuard(PageGuard &&that) noexcept;
+
+    PageGuard &operator=(PageGuard &&that) noexcept;
+
+    ~PageGuard() {
+        release();
+    }
+
+    // 提前解锁并unpin，之后守卫为空
+    void release();
+
+    // 页面被修改过，unpin时标记为脏页。只有持有写锁时可以调用
+    void mark_dirty() {
+        assert(latch_ == Latch::EXCLUSIVE);
+        is_dirty_ = true;
+    }
+
+    Page *get_page() const {
+        return page_;
+    }
+
+    PageId get_page_id() const {
+        return page_->get_page_id();
+    }
+
+    explicit operator bool() const {
+        return page_ != nullptr;
+    }
+
+  protected:
+    enum class Latch { NONE, SHARED, EXCLUSIVE };
+
+    PageGuard(BufferPoolManager *bpm, Page *page, bool exclusive);
+
+  private:
+    BufferPoolManager *bpm_ = nullptr;
+    Page *page_ = nullptr;
+    Latch latch_ = Latch::NONE; // 实际持有的锁，写锁重入时读守卫也持有EXCLUSIVE
+    bool is_dirty_ = false;
+};
+
+/* 持有页面读锁的守卫，同一页面可以同时被多个读守卫持有 */
+class ReadPageGuard : public PageGuard {
+  public:
+    ReadPageGuard() = default;
+
+    ReadPageGuard(BufferPoolManager *bpm, Page *page) : PageGuard(bpm, page, false) {
+    }
+
+    const char *get_data() const {
+        return get_page()->get_data();
+    }
+};
+
+/* 持有页面写锁的守卫，修改页面后需要调用mark_dirty() */
+class WritePageGuard : public PageGuard {
+  public:
+    WritePageGuard() = default;
+
+    WritePageGuard(BufferPoolManager *bpm, Page *page) : PageGuard(bpm, page, true) {
+    }
+
+    char *get_data() const {
+        return get_page()->get_data();
+    }
+};
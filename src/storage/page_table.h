@@ -0,0 +1,156 @@
+/* Copyright (c) 2023 Renmin University of China
+RMDB is licensed under Mulan PSL v2.
+You can use this software according to the terms and conditions of the Mulan PSL v2.
+You may obtain a copy of Mulan PSL v2 at:
+        http://license.coscl.org.cn/MulanPSL2
+THIS SOFTWARE IS PROVIDED ON AN "AS IS" BASIS, WITHOUT WARRANTIES OF ANY KIND,
+EITHER EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO NON-INFRINGEMENT,
+MERCHANTABILITY OR FIT FOR A PARTICULAR PURPOSE.
+See the Mulan PSL v2 for more details. */
+
+#pragma once
+
+#include <atomic>
+#include <cstdint>
+#include <memory>
+
+#include "page.h"
+
+/**
+ * @description: 缓冲池的页表，记录PageId所在的帧。线性探测的开放定址哈希表，槽位数是不小于两倍帧数的2的幂，
+ * 删除时把后面的项前移，不使用墓碑。insert/erase只在BufferPoolManager::latch_下调用，修改前后各把版本号加一；
+ * find不加锁，像seqlock一样乐观地读：读到奇数版本号或者读完后版本号变了，说明期间有修改，结果作废重读
+ */
+class PageTable {
+  public:
+    explicit PageTable(size_t pool_size) {
+        size_t capacity = 2;
+        shift_ = 63;
+        while (capacity < pool_size * 2) {
+            capacity <<= 1;
+            shift_--;
+        }
+        mask_ = capacity - 1;
+        keys_ = std::make_unique<std::atomic<uint64_t>[]>(capacity);
+        frames_ = std::make_unique<std::atomic<frame_id_t>[]>(capacity);
+        for (size_t i = 0; i < capacity; i++) {
+            keys_[i].store(EMPTY_KEY, std::memory_order_relaxed);
+            frames_[i].store(INVALID_FRAME_ID, std::memory_order_relaxed);
+        }
+    }
+
+    /**
+     * @description: 查找页面所在的帧，不需要加锁。持有latch_时没有并发的修改，结果是准确的
+     * @return {bool} 找到时返回true；页面不在页表中，或者几次重读期间页表一直在被修改时返回false
+     * @param {PageId} page_id 要查找的页面
+     * @param {frame_id_t*} frame_id 找到时存放页面所在的帧
+     */
+    bool find(PageId page_id, frame_id_t *frame_id) const {
+        uint64_t key = pack(page_id);
+        for (int retry = 0; retry < FIND_RETRIES; retry++) {
+            uint64_t version = version_.load(std::memory_order_acquire);
+            if (version & 1) {
+                continue;
+            }
+            bool found = false;
+            size_t slot = home(key);
+            // 读到一半的表可能没有空槽，最多探测一圈
+            for (size_t i = 0; i <= mask_; i++) {
+                uint64_t k = keys_[slot].load(std::memory_order_relaxed);
+                if (k == key) {
+                    *frame_id = frames_[slot].load(std::memory_order_relaxed);
+                    found = true;
+                    break;
+                }
+                if (k == EMPTY_KEY) {
+                    break;
+                }
+                slot = (slot + 1) & mask_;
+            }
+            std::atomic_thread_fence(std::memory_order_acquire);
+            if (version_.load(std::memory_order_relaxed) == version) {
+                return found;
+            }
+        }
+        return false;
+    }
+
+    // 插入或更新page_id所在的帧，需要持有latch_
+    void insert(PageId page_id, frame_id_t frame_id) {
+        uint64_t key = pack(page_id);
+        size_t slot = home(key);
+        while (true) {
+            uint64_t k = keys_[slot].load(std::memory_order_relaxed);
+            if (k == key || k == EMPTY_KEY) {
+                break;
+            }
+            slot = (slot + 1) & mask_;
+        }
+        begin_write();
+        frames_[slot].store(frame_id, std::memory_order_relaxed);
+        keys_[slot].store(key, std::memory_order_relaxed);
+        end_write();
+    }
+
+    // 删除page_id，不在页表中时什么也不做，需要持有latch_
+    void erase(PageId page_id) {
+        uint64_t key = pack(page_id);
+        size_t hole = home(key);
+        while (true) {
+            uint64_t k = keys_[hole].load(std::memory_order_relaxed);
+            if (k == key) {
+                break;
+            }
+            if (k == EMPTY_KEY) {
+                return;
+            }
+            hole = (hole + 1) & mask_;
+        }
+        begin_write();
+        // 后面探测序列经过hole的项前移填补空位，直到遇到空槽
+        size_t next = (hole + 1) & mask_;
+        while (true) {
+            uint64_t k = keys_[next].load(std::memory_order_relaxed);
+            if (k == EMPTY_KEY) {
+                break;
+            }
+            if (((next - home(k)) & mask_) >= ((next - hole) & mask_)) {
+                frames_[hole].store(frames_[next].load(std::memory_order_relaxed), std::memory_order_relaxed);
+                keys_[hole].store(k, std::memory_order_relaxed);
+                hole = next;
+            }
+            next = (next + 1) & mask_;
+        }
+        keys_[hole].store(EMPTY_KEY, std::memory_order_relaxed);
+        end_write();
+    }
+
+  private:
+    static constexpr uint64_t EMPTY_KEY = ~0ULL; // 对应{fd: -1, page_no: -1}，不会出现在页表中
+    static constexpr frame_id_t INVALID_FRAME_ID = -1;
+    static constexpr int FIND_RETRIES = 3; // 无锁查找的重读次数，之后由调用者加锁查找
+
+    size_t mask_;
+    int shift_;
+    std::unique_ptr<std::atomic<uint64_t>[]> keys_;
+    std::unique_ptr<std::atomic<frame_id_t>[]> frames_;
+    std::atomic<uint64_t> version_{0}; // 奇数表示正在修改
+
+    static uint64_t pack(PageId page_id) {
+        return (uint64_t)(uint32_t)page_id.fd << 32 | (uint32_t)page_id.page_no;
+    }
+
+    // Fibonacci哈希，取乘积的高位，同一文件连续的页号分散到不同的槽
+    size_t home(uint64_t key) const {
+        return (key * 0x9E3779B97F4A7C15ULL) >> shift_;
+    }
+
+    void begin_write() {
+        version_.store(version_.load(std::memory_order_relaxed) + 1, std::memory_order_relaxed);
+        std::atomic_thread_fence(std::memory_order_release);
+    }
+
+    void end_write() {
+        version_.store(version_.load(std::memory_order_relaxed) + 1, std::memory_order_release);
+    }
+};
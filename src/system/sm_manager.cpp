@@ -13,11 +13,15 @@ See the Mulan PSL v2 for more details. */
 #include <sys/stat.h>
 #include <unistd.h>
 
+#include <algorithm>
 #include <fstream>
+#include <numeric>
 
+#include "common/task_scheduler.h"
 #include "index/ix.h"
 #include "record/rm.h"
 #include "record_printer.h"
+#include "sm_partition.h"
 
 /**
  * @description: 判断是否为一个文件夹
@@ -91,13 +95,16 @@ void SmManager::open_db(const std::string &db_name) {
     std::ifstream ifs(DB_META_NAME);
     ifs >> db_;
     for (auto &[table_name, table_meta] : db_.tabs_) {
-        fhs_[table_name] = rm_manager_->open_file(table_name);
+        fhs_[table_name] = open_table_file(table_meta);
     }
     // open index
     for (auto &[table_name, table_meta] : db_.tabs_) {
         for (auto &index_meta : table_meta.indexes) {
             ihs_[ix_manager_->get_index_name(table_name, index_meta.cols)] =
-                ix_manager_->open_index(table_name, index_meta.cols);
+                open_table_index(table_meta, index_meta.cols);
+        }
+        if (table_meta.view.is_view()) {
+            views_[table_meta.view.base_tab].push_back(table_name);
         }
     }
 }
@@ -166,8 +173,11 @@ void SmManager::desc_table(const std::string &tab_name, Context *context) {
  * @param {string&} tab_name 表的名称
  * @param {vector<ColDef>&} col_defs 表的字段
  * @param {Context*} context
+ * @param {bool} temporary 是否为临时表
+ * @param {PartitionDef&} partition 分区方式，type为PARTITION_NONE时不分区
  */
-void SmManager::create_table(const std::string &tab_name, const std::vector<ColDef> &col_defs, Context *context) {
+void SmManager::create_table(const std::string &tab_name, const std::vector<ColDef> &col_defs, Context *context,
+                             bool temporary, const PartitionDef &partition) {
     if (db_.is_table(tab_name)) {
         throw TableExistsError(tab_name);
     }
@@ -186,16 +196,124 @@ void SmManager::create_table(const std::string &tab_name, const std::vector<ColD
         curr_offset += col_def.len;
         tab.cols.push_back(col);
     }
+    if (partition.type != PARTITION_NONE) {
+        if (temporary) {
+            throw InvalidPartitionError("temporary table " + tab_name + " cannot be partitioned");
+        }
+        tab.partition = check_partition(tab, partition);
+    }
     // Create & open record file
     int record_size = curr_offset; // record_size就是col meta所占的大小（表的元数据也是以记录的形式进行存储的）
-    rm_manager_->create_file(tab_name, record_size);
+    if (temporary) {
+        // 临时表的记录只在内存中，不创建数据文件，也不写入元数据文件
+        tab.is_temporary = true;
+        fhs_.emplace(tab_name, rm_manager_->create_temp_file(record_size));
+        db_.tabs_[tab_name] = tab;
+        temp_tables_[context != nullptr ? context->session_id_ : -1].push_back(tab_name);
+        return;
+    }
+    // 分区表的每个分区是一个数据文件
+    for (auto &filename : data_file_names(tab)) {
+        rm_manager_->create_file(filename, record_size);
+    }
     db_.tabs_[tab_name] = tab;
     // fhs_[tab_name] = rm_manager_->open_file(tab_name);
-    fhs_.emplace(tab_name, rm_manager_->open_file(tab_name));
+    fhs_.emplace(tab_name, open_table_file(tab));
 
     flush_meta();
 }
 
+/**
+ * @description: 检查建表语句中的分区方式：分区列必须存在，分区名不能重复，RANGE分区的上界必须严格递增，
+ * 只有最后一个分区的上界可以是MAXVALUE
+ * @return {PartitionMeta} 分区元数据，上界转换为分区列的原始字节
+ * @param {TabMeta&} tab 要创建的表，已经有全部的列
+ * @param {PartitionDef&} partition 建表语句中的分区方式
+ */
+PartitionMeta SmManager::check_partition(const TabMeta &tab, const PartitionDef &partition) {
+    auto col = std::find_if(tab.cols.begin(), tab.cols.end(),
+                            [&](const ColMeta &col) { return col.name == partition.col_name; });
+    if (col == tab.cols.end()) {
+        throw ColumnNotFoundError(partition.col_name);
+    }
+    int n = (int)partition.names.size();
+    if (n < 1 || n > RM_MAX_PARTITIONS) {
+        throw InvalidPartitionError("number of partitions must be between 1 and " + std::to_string(RM_MAX_PARTITIONS));
+    }
+    for (int i = 0; i < n; i++) {
+        if (std::count(partition.names.begin(), partition.names.end(), partition.names[i]) > 1) {
+            throw InvalidPartitionError("duplicate partition name " + partition.names[i]);
+        }
+    }
+    PartitionMeta meta;
+    meta.type = partition.type;
+    meta.col_name = partition.col_name;
+    meta.names = partition.names;
+    if (partition.type != PARTITION_RANGE) {
+        return meta;
+    }
+    for (int i = 0; i < n; i++) {
+        const auto &bound = partition.bounds[i];
+        if (!bound.has_value()) {
+            if (i != n - 1) {
+                throw InvalidPartitionError("MAXVALUE can only be used in the last partition");
+            }
+            meta.bounds.emplace_back();
+            continue;
+        }
+        // 整数列的上界不能是小数，截断后分区的范围会改变
+        if (!colTypeCanHold(col->type, bound->type) || (col->type == TYPE_INT && bound->type == TYPE_FLOAT)) {
+            throw IncompatibleTypeError(coltype2str(col->type), coltype2str(bound->type));
+        }
+        std::string bytes(col->len, '\0');
+        ValueView::of(*bound).store(bytes.data(), col->type, col->len);
+        ValueView value = ValueView::of(bytes.data(), col->type, col->len);
+        if (i > 0 && value.compare(ValueView::of(meta.bounds[i - 1].data(), col->type, col->len)) <= 0) {
+            throw InvalidPartitionError("VALUES LESS THAN must be strictly increasing, see partition " +
+                                        partition.names[i]);
+        }
+        meta.bounds.push_back(std::move(bytes));
+    }
+    return meta;
+}
+
+/**
+ * @description: 表的数据文件名称，非分区表只有一个与表同名的文件，分区表的每个分区一个文件，名称为"表名.分区名"
+ */
+std::vector<std::string> SmManager::data_file_names(const TabMeta &tab) {
+    if (!tab.partition.is_partitioned()) {
+        return {tab.name};
+    }
+    std::vector<std::string> filenames;
+    for (auto &name : tab.partition.names) {
+        filenames.push_back(tab.name + "." + name);
+    }
+    return filenames;
+}
+
+/**
+ * @description: 打开表的数据文件，分区表的文件句柄按分区列把插入的记录路由到各分区
+ */
+std::unique_ptr<RmFileHandle> SmManager::open_table_file(const TabMeta &tab) {
+    if (!tab.partition.is_partitioned()) {
+        return rm_manager_->open_file(tab.name);
+    }
+    Partitioner partitioner(tab);
+    return rm_manager_->open_partitioned_file(
+        data_file_names(tab), [partitioner](const char *record) { return partitioner.partition_of(record); });
+}
+
+/**
+ * @description: 打开表上的索引。分区表上的索引是本地索引，每个分区的数据文件上一棵B+树，名称为"表名.分区名_列名.idx"，
+ * 由一个句柄统一访问
+ */
+std::unique_ptr<IxIndexHandle> SmManager::open_table_index(const TabMeta &tab, const std::vector<ColMeta> &cols) {
+    if (!tab.partition.is_partitioned()) {
+        return ix_manager_->open_index(tab.name, cols);
+    }
+    return ix_manager_->open_partitioned_index(data_file_names(tab), cols);
+}
+
 /**
  * @description: 删除表
  * @param {string&} tab_name 表的名称
@@ -206,16 +324,58 @@ void SmManager::drop_table(const std::string &tab_name, Context *context) {
     if (it1 == fhs_.end()) {
         throw TableNotFoundError(tab_name);
     }
-    rm_manager_->close_file(it1->second.get());
-    rm_manager_->destroy_file(tab_name);
-    //    TODO: 删除索引
-    if (db_.get_table(tab_name).indexes.size() > 0) {
-        for (auto &index_meta : db_.get_table(tab_name).indexes) {
-            drop_index(tab_name, index_meta.cols, context);
+    bool temporary = db_.get_table(tab_name).is_temporary;
+    {
+        // 基表上的修改会并发地读views_，查找和删除都在view_latch_下进行
+        std::lock_guard<std::mutex> lock(view_latch_);
+        auto views_it = views_.find(tab_name);
+        if (views_it != views_.end()) {
+            throw InvalidViewError("table " + tab_name + " is used by materialized view " + views_it->second.front());
+        }
+        const ViewMeta &view = db_.get_table(tab_name).view;
+        if (view.is_view()) {
+            auto &views = views_.at(view.base_tab);
+            views.erase(std::remove(views.begin(), views.end(), tab_name), views.end());
+            if (views.empty()) {
+                views_.erase(view.base_tab);
+            }
+        }
+    }
+    if (!temporary) {
+        rm_manager_->close_file(it1->second.get());
+        for (auto &filename : data_file_names(db_.get_table(tab_name))) {
+            rm_manager_->destroy_file(filename);
         }
     }
+    // drop_index会从indexes中删除索引，遍历副本
+    auto indexes = db_.get_table(tab_name).indexes;
+    for (auto &index_meta : indexes) {
+        drop_index(tab_name, index_meta.cols, context);
+    }
     fhs_.erase(tab_name);
     db_.tabs_.erase(tab_name);
+    if (temporary) {
+        for (auto &[session_id, tab_names] : temp_tables_) {
+            tab_names.erase(std::remove(tab_names.begin(), tab_names.end(), tab_name), tab_names.end());
+        }
+    }
+    bump_table_version(tab_name);
+}
+
+/**
+ * @description: 会话断开时删除该会话创建的、仍然存在的临时表
+ * @param {int} session_id 会话id，即Context::session_id_
+ */
+void SmManager::drop_temp_tables(int session_id) {
+    auto it = temp_tables_.find(session_id);
+    if (it == temp_tables_.end()) {
+        return;
+    }
+    std::vector<std::string> tab_names = std::move(it->second);
+    temp_tables_.erase(it);
+    for (auto &tab_name : tab_names) {
+        drop_table(tab_name, nullptr);
+    }
 }
 
 /**
@@ -225,7 +385,10 @@ void SmManager::drop_table(const std::string &tab_name, Context *context) {
  * @param {Context*} context
  */
 void SmManager::create_index(const std::string &tab_name, const std::vector<std::string> &col_names, Context *context) {
-    if (ix_manager_->exists(tab_name, col_names))
+    TabMeta &tab = db_.get_table(tab_name);
+    bool temporary = tab.is_temporary;
+    if (temporary ? ihs_.count(ix_manager_->get_index_name(tab_name, col_names)) > 0
+                  : ix_manager_->exists(data_file_names(tab).front(), col_names))
         throw IndexExistsError(tab_name, col_names);
 
     std::vector<ColMeta> cols;
@@ -239,35 +402,62 @@ void SmManager::create_index(const std::string &tab_name, const std::vector<std:
     auto index_meta = IndexMeta{.tab_name = tab_name, .col_tot_len = col_tot_len, .col_num = cols.size(), .cols = cols};
 
     // 插入数据到索引文件
-    ix_manager_->create_index(tab_name, cols);
-    auto ix_handler = ix_manager_->open_index(tab_name, cols);
+    std::unique_ptr<IxIndexHandle> ix_handler;
+    if (temporary) {
+        ix_handler = ix_manager_->create_temp_index(cols);
+    } else {
+        // 分区表的每个分区一个索引文件，插入时按rid中的分区号分别插入各分区的B+树
+        for (auto &filename : data_file_names(tab)) {
+            ix_manager_->create_index(filename, cols);
+        }
+        ix_handler = open_table_index(tab, cols);
+    }
     auto file_handler = fhs_.at(tab_name).get();
     auto txn = nullptr ? nullptr : context->txn_;
-    RmScan rm_scan(file_handler);
-
-    bool delete_flag = false;
 
-    for (; !rm_scan.is_end(); rm_scan.next()) {
-        auto record = file_handler->get_record(rm_scan.rid(), context);
-
-        auto projected_record = std::make_unique<RmRecord>(index_meta.col_tot_len);
-        size_t offset = 0;
-        for (const auto &col : cols) {
-            memcpy(projected_record->data + offset, record->data + col.offset, col.len);
-            offset += col.len;
+    // 由调度器并行地从各个morsel中提取键，再按记录在文件中的顺序插入B+树（B+树的插入不是线程安全的）
+    std::vector<int> partitions(file_handler->num_partitions());
+    std::iota(partitions.begin(), partitions.end(), 0);
+    std::vector<RmPageRange> morsels = file_handler->page_morsels(partitions, MORSEL_PAGES);
+    size_t num_morsels = morsels.size();
+    std::vector<std::vector<char>> keys(num_morsels);
+    std::vector<std::vector<Rid>> rids(num_morsels);
+    auto extract_keys = [&](size_t morsel, size_t) {
+        for (int page_no = morsels[morsel].begin; page_no < morsels[morsel].end; page_no++) {
+            file_handler->for_each_record(page_no, [&](int slot_no, const char *record) {
+                size_t offset = keys[morsel].size();
+                keys[morsel].resize(offset + col_tot_len);
+                for (const auto &col : cols) {
+                    memcpy(keys[morsel].data() + offset, record + col.offset, col.len);
+                    offset += col.len;
+                }
+                rids[morsel].push_back(Rid{page_no, slot_no});
+            });
+            TaskScheduler::yield();
         }
+    };
+    TaskScheduler::instance().submit(num_morsels, extract_keys)->wait();
 
-        try {
-            ix_handler->insert_entry(projected_record->data, rm_scan.rid(), txn);
-        } catch (const IndexKeyDuplicateError &e) {
-            delete_flag = true;
+    bool delete_flag = false;
+
+    for (size_t morsel = 0; morsel < num_morsels && !delete_flag; morsel++) {
+        for (size_t i = 0; i < rids[morsel].size(); i++) {
+            try {
+                ix_handler->insert_entry(keys[morsel].data() + i * col_tot_len, rids[morsel][i], txn);
+            } catch (const IndexKeyDuplicateError &e) {
+                delete_flag = true;
+                break;
+            }
         }
+        std::vector<char>().swap(keys[morsel]);
     }
 
     // 更新元数据
     ihs_.emplace(ix_manager_->get_index_name(tab_name, col_names), std::move(ix_handler));
     db_.get_table(tab_name).indexes.emplace_back(index_meta);
-    flush_meta();
+    if (!temporary) {
+        flush_meta();
+    }
 
     if (delete_flag) {
         drop_index(tab_name, col_names, context);
@@ -275,6 +465,40 @@ void SmManager::create_index(const std::string &tab_name, const std::vector<std:
     }
 }
 
+/**
+ * @description: 显示缓冲池中每个表文件和索引文件的驻留帧数、脏页数、固定帧数和命中率，以及空闲链表和替换器的长度
+ * @param {Context*} context
+ */
+void SmManager::show_buffer_pool(Context *context) {
+    BufferPoolStats stats = buffer_pool_manager_->get_stats();
+
+    std::vector<std::string> captions = {"File", "Resident", "Dirty", "Pinned", "Hit Ratio"};
+    RecordPrinter printer(captions.size());
+    printer.print_separator(context);
+    printer.print_record(captions, context);
+    printer.print_separator(context);
+    for (auto &[fd, file_stats] : stats.files) {
+        std::string file_name;
+        try {
+            file_name = disk_manager_->get_file_name(fd);
+        } catch (FileNotOpenError &) {
+            file_name = "fd " + std::to_string(fd); // 文件已关闭，但仍有命中统计
+        }
+        uint64_t accesses = file_stats.hits + file_stats.misses;
+        std::string hit_ratio = accesses == 0 ? "-" : std::to_string(100.0 * file_stats.hits / accesses) + "%";
+        printer.print_record({file_name, std::to_string(file_stats.resident), std::to_string(file_stats.dirty),
+                              std::to_string(file_stats.pinned), hit_ratio},
+                             context);
+    }
+    printer.print_separator(context);
+
+    RecordPrinter summary_printer(2);
+    summary_printer.print_record({"pool_size", std::to_string(stats.pool_size)}, context);
+    summary_printer.print_record({"free_list_size", std::to_string(stats.free_list_size)}, context);
+    summary_printer.print_record({"replacer_size", std::to_string(stats.replacer_size)}, context);
+    summary_printer.print_separator(context);
+}
+
 /**
  * @description: 删除索引
  * @param {string&} tab_name 表名称
@@ -282,33 +506,47 @@ void SmManager::create_index(const std::string &tab_name, const std::vector<std:
  * @param {Context*} context
  */
 void SmManager::drop_index(const std::string &tab_name, const std::vector<std::string> &col_names, Context *context) {
-    if (!ix_manager_->exists(tab_name, col_names))
+    auto index_name = ix_manager_->get_index_name(tab_name, col_names);
+    auto &tab_meta = db_.tabs_.at(tab_name);
+    if (tab_meta.is_temporary) {
+        // 临时表的索引只在内存中，释放句柄即释放所有结点
+        if (ihs_.erase(index_name) == 0)
+            throw IndexNotFoundError(tab_name, col_names);
+        tab_meta.indexes.erase(tab_meta.get_index_meta(col_names));
+        return;
+    }
+
+    std::vector<std::string> filenames = data_file_names(tab_meta);
+    if (!ix_manager_->exists(filenames.front(), col_names))
         throw IndexNotFoundError(tab_name, col_names);
 
     // 删除索引
-    auto index_name = ix_manager_->get_index_name(tab_name, col_names);
-
     bool in_ihs = ihs_.find(index_name) != ihs_.end();
 
     if (in_ihs) {
-        // 删除page
-        for (int i = 0; i < ihs_.at(index_name)->get_page_cnt(); ++i) {
-            PageId page_id = {ihs_.at(index_name)->get_fd(), i};
-            // 得到page_id对应的page，然后强行让pin_count为0，然后删除page
-            auto page = buffer_pool_manager_->fetch_page(page_id);
-            while (page->get_pin_count() > 0) {
-                buffer_pool_manager_->unpin_page(page_id, true);
+        // 删除page，分区表上的索引逐个分区删除
+        IxIndexHandle *ih = ihs_.at(index_name).get();
+        for (int partition = 0; partition < ih->num_partitions(); partition++) {
+            IxIndexHandle *partition_ih = ih->partition(partition);
+            for (int i = 0; i < partition_ih->get_page_cnt(); ++i) {
+                PageId page_id = {partition_ih->get_fd(), i};
+                // 得到page_id对应的page，然后强行让pin_count为0，然后删除page
+                auto page = buffer_pool_manager_->fetch_page(page_id);
+                while (page->get_pin_count() > 0) {
+                    buffer_pool_manager_->unpin_page(page_id, true);
+                }
+                buffer_pool_manager_->delete_page(page_id);
             }
-            buffer_pool_manager_->delete_page(page_id);
         }
         // 更新元数据
-        ix_manager_->close_index(ihs_.at(index_name).get());
+        ix_manager_->close_index(ih);
         ihs_.erase(index_name);
     }
 
-    ix_manager_->destroy_index(tab_name, col_names);
+    for (auto &filename : filenames) {
+        ix_manager_->destroy_index(filename, col_names);
+    }
 
-    auto &tab_meta = db_.tabs_.at(tab_name);
     tab_meta.indexes.erase(tab_meta.get_index_meta(col_names));
     flush_meta();
 }
@@ -353,4 +591,339 @@ void SmManager::drop_index(const std::string &tab_name, const std::vector<ColMet
     for (auto &col : cols)
         col_names.emplace_back(col.name);
     drop_index(tab_name, col_names, context);
-}
\ No newline at end of file
+}
+/**
+ * @description: 物化视图表的列：依次是选择列、没有出现在选择列中的GROUP BY列，视图没有COUNT时再加一列COUNT(*)，
+ * 用来判断分组是否已经没有记录。列名是别名，没有别名时分组列用原列名，聚合列为"聚合函数_列名"，如sum_v、count_star
+ * @return {vector<ColDef>} 视图表的列
+ * @param {TabMeta&} base 基表
+ * @param {ViewDef&} def 视图的定义
+ * @param {ViewMeta&} view 输出参数，填入视图表每一列的来源列和聚合函数
+ */
+std::vector<ColDef> SmManager::view_col_defs(const TabMeta &base, const ViewDef &def, ViewMeta &view) {
+    static const std::map<ast::AggregationType, std::string> aggr_names = {{ast::AGGR_TYPE_COUNT, "count"},
+                                                                            {ast::AGGR_TYPE_MAX, "max"},
+                                                                            {ast::AGGR_TYPE_MIN, "min"},
+                                                                            {ast::AGGR_TYPE_SUM, "sum"}};
+    std::vector<TabCol> cols = def.sel_cols;
+    for (auto &group_col : def.group_cols) {
+        bool selected = std::any_of(cols.begin(), cols.end(), [&](const TabCol &col) {
+            return col.aggr == ast::NO_AGGR && col.col_name == group_col.col_name;
+        });
+        if (!selected) {
+            cols.push_back(group_col);
+        }
+    }
+    bool has_count = std::any_of(cols.begin(), cols.end(),
+                                 [](const TabCol &col) { return col.aggr == ast::AGGR_TYPE_COUNT; });
+    if (!has_count) {
+        cols.push_back({.tab_name = base.name, .col_name = "*", .alias = "", .aggr = ast::AGGR_TYPE_COUNT});
+    }
+
+    std::vector<ColDef> col_defs;
+    for (auto &col : cols) {
+        ColDef col_def;
+        if (col.aggr == ast::AGGR_TYPE_COUNT) {
+            col_def.type = TYPE_INT;
+            col_def.len = sizeof(int);
+            if (view.count_col < 0) {
+                view.count_col = (int)col_defs.size(); // 没有NULL，COUNT(col)和COUNT(*)相同
+            }
+        } else {
+            auto src = std::find_if(base.cols.begin(), base.cols.end(),
+                                    [&](const ColMeta &meta) { return meta.name == col.col_name; });
+            if (src == base.cols.end()) {
+                throw ColumnNotFoundError(col.col_name);
+            }
+            if (col.aggr == ast::AGGR_TYPE_SUM && src->type != TYPE_INT && src->type != TYPE_FLOAT) {
+                throw InvalidViewError("SUM(" + col.col_name + ") requires an INT or FLOAT column");
+            }
+            col_def.type = src->type;
+            col_def.len = src->len;
+        }
+        if (!col.alias.empty()) {
+            col_def.name = col.alias;
+        } else if (col.aggr == ast::NO_AGGR) {
+            col_def.name = col.col_name;
+        } else {
+            col_def.name = aggr_names.at(col.aggr) + "_" + (col.col_name == "*" ? "star" : col.col_name);
+        }
+        for (auto &prev : col_defs) {
+            if (prev.name == col_def.name) {
+                throw InvalidViewError("duplicate column name " + col_def.name);
+            }
+        }
+        col_defs.push_back(col_def);
+        view.src_cols.push_back(col.col_name);
+        view.aggrs.push_back(col.aggr);
+    }
+    return col_defs;
+}
+
+/**
+ * @description: 创建物化视图：建一张与视图同名的表和分组列上的索引，扫描基表填入每个分组的聚合结果，
+ * 之后基表的增删改由maintain_views同步到视图
+ * @param {string&} view_name 视图名称
+ * @param {ViewDef&} def 视图的定义，单表的分组聚合
+ * @param {Context*} context
+ */
+void SmManager::create_view(const std::string &view_name, const ViewDef &def, Context *context) {
+    if (db_.is_table(view_name)) {
+        throw TableExistsError(view_name);
+    }
+    TabMeta &base = db_.get_table(def.base_tab);
+    if (base.is_temporary) {
+        throw InvalidViewError("base table " + base.name + " is a temporary table");
+    }
+    if (base.view.is_view()) {
+        throw InvalidViewError("base table " + base.name + " is a materialized view");
+    }
+    ViewMeta view;
+    view.base_tab = base.name;
+    std::vector<ColDef> col_defs = view_col_defs(base, def, view);
+    std::vector<std::string> group_col_names;
+    for (size_t i = 0; i < col_defs.size(); i++) {
+        if (view.aggrs[i] == ast::NO_AGGR) {
+            group_col_names.push_back(col_defs[i].name);
+        }
+    }
+
+    create_table(view_name, col_defs, context);
+    TabMeta &view_tab = db_.get_table(view_name);
+    view_tab.view = std::move(view);
+    create_index(view_name, group_col_names, context);
+
+    // 扫描基表，按插入的方式逐条累加到视图中
+    std::lock_guard<std::mutex> lock(view_latch_);
+    RmFileHandle *fh = fhs_.at(base.name).get();
+    for (int partition = 0; partition < fh->num_partitions(); partition++) {
+        RmPageRange range = fh->page_range(partition);
+        for (int page_no = range.begin; page_no < range.end; page_no++) {
+            fh->for_each_record(page_no, [&](int, const char *record) {
+                apply_view_delta(view_tab, base, record, true, context);
+            });
+        }
+    }
+    views_[base.name].push_back(view_name);
+    flush_meta();
+}
+
+/**
+ * @description: 删除物化视图
+ * @param {string&} view_name 视图名称
+ * @param {Context*} context
+ */
+void SmManager::drop_view(const std::string &view_name, Context *context) {
+    if (!db_.get_table(view_name).view.is_view()) {
+        throw InvalidViewError(view_name + " is not a materialized view");
+    }
+    drop_table(view_name, context);
+}
+
+/**
+ * @description: 把基表的一条记录的增删改同步到建在该表上的所有物化视图。在基表的记录和索引修改之后调用，
+ * 删除时MIN/MAX需要重新扫描的分组不会再看到被删除的记录。更新看作先删除旧记录再插入新记录
+ * @param {string&} tab_name 基表名称
+ * @param {char*} old_record 删除或更新前的记录，插入时为nullptr
+ * @param {char*} new_record 插入或更新后的记录，删除时为nullptr
+ * @param {Context*} context 回滚时为nullptr
+ */
+void SmManager::maintain_views(const std::string &tab_name, const char *old_record, const char *new_record,
+                               Context *context) {
+    std::lock_guard<std::mutex> lock(view_latch_);
+    auto it = views_.find(tab_name);
+    if (it == views_.end()) {
+        return;
+    }
+    TabMeta &base = db_.get_table(tab_name);
+    for (auto &view_name : it->second) {
+        TabMeta &view_tab = db_.get_table(view_name);
+        if (old_record != nullptr && new_record != nullptr) {
+            // 没有修改视图用到的列，视图不变
+            bool changed = false;
+            for (auto &src_col : view_tab.view.src_cols) {
+                if (src_col != "*") {
+                    auto col = base.get_col(src_col);
+                    changed |= memcmp(old_record + col->offset, new_record + col->offset, col->len) != 0;
+                }
+            }
+            if (!changed) {
+                continue;
+            }
+        }
+        if (old_record != nullptr) {
+            apply_view_delta(view_tab, base, old_record, false, context);
+        }
+        if (new_record != nullptr) {
+            apply_view_delta(view_tab, base, new_record, true, context);
+        }
+    }
+}
+
+/**
+ * @description: 表的修改计数，结果缓存用它判断缓存的查询结果是否过期
+ * @return {uint64_t} 从未修改过的表为0
+ * @param {string&} tab_name 表的名称
+ */
+uint64_t SmManager::table_version(const std::string &tab_name) const {
+    std::lock_guard<std::mutex> lock(table_version_latch_);
+    auto it = table_versions_.find(tab_name);
+    return it != table_versions_.end() ? it->second : 0;
+}
+
+/**
+ * @description: 表的内容改变后增加修改计数，建在该表上的物化视图随之改变，计数一起增加。
+ * 在修改完成之后调用，执行期间读到修改前版本号的查询结果在下次查找时失效
+ * @param {string&} tab_name 被修改的表
+ */
+void SmManager::bump_table_version(const std::string &tab_name) {
+    std::lock_guard<std::mutex> lock(table_version_latch_);
+    table_versions_[tab_name]++;
+    for (auto &view_name : get_views(tab_name)) {
+        table_versions_[view_name]++;
+    }
+}
+
+/**
+ * @description: 在视图中找到基表记录所在的分组，累加或减去这条记录。新的分组插入一条视图记录，
+ * 记录数减为0的分组删除；删除的值恰好是分组的MIN/MAX时，重新扫描基表得到该分组的MIN/MAX
+ * @param {TabMeta&} view_tab 视图表
+ * @param {TabMeta&} base 基表
+ * @param {char*} record 基表的记录
+ * @param {bool} is_insert 插入为true，删除为false
+ * @param {Context*} context
+ */
+void SmManager::apply_view_delta(TabMeta &view_tab, TabMeta &base, const char *record, bool is_insert,
+                                 Context *context) {
+    const ViewMeta &view = view_tab.view;
+    const IndexMeta &index = view_tab.indexes.front(); // 分组列的索引
+    IxIndexHandle *ih = ihs_.at(ix_manager_->get_index_name(view_tab.name, index.cols)).get();
+    RmFileHandle *fh = fhs_.at(view_tab.name).get();
+    Transaction *txn = context != nullptr ? context->txn_ : nullptr;
+
+    std::vector<const ColMeta *> src_cols(view.src_cols.size(), nullptr);
+    std::vector<char> key;
+    for (size_t i = 0; i < view.src_cols.size(); i++) {
+        if (view.src_cols[i] == "*") {
+            continue;
+        }
+        src_cols[i] = &*base.get_col(view.src_cols[i]);
+        if (view.aggrs[i] == ast::NO_AGGR) {
+            key.insert(key.end(), record + src_cols[i]->offset, record + src_cols[i]->offset + src_cols[i]->len);
+        }
+    }
+
+    std::vector<Rid> rids;
+    if (!ih->get_value(key.data(), &rids, txn)) {
+        if (!is_insert) {
+            throw InternalError("materialized view " + view_tab.name + " has no group for the deleted record");
+        }
+        // 新的分组，聚合列的初值就是这条记录的值
+        std::vector<char> buf(fh->get_file_hdr().record_size);
+        for (size_t i = 0; i < view_tab.cols.size(); i++) {
+            auto &col = view_tab.cols[i];
+            if (view.aggrs[i] == ast::AGGR_TYPE_COUNT) {
+                *(int *)(buf.data() + col.offset) = 1;
+            } else {
+                memcpy(buf.data() + col.offset, record + src_cols[i]->offset, col.len);
+            }
+        }
+        Rid rid = fh->insert_record(buf.data(), context);
+        ih->insert_entry(key.data(), rid, txn);
+        return;
+    }
+
+    Rid rid = rids.front();
+    auto view_record = fh->get_record(rid, context);
+    char *buf = view_record->data;
+    bool recompute = false;
+    for (size_t i = 0; i < view_tab.cols.size(); i++) {
+        auto &col = view_tab.cols[i];
+        char *dst = buf + col.offset;
+        switch (view.aggrs[i]) {
+        case ast::AGGR_TYPE_COUNT:
+            *(int *)dst += is_insert ? 1 : -1;
+            break;
+        case ast::AGGR_TYPE_SUM: {
+            const char *src = record + src_cols[i]->offset;
+            if (col.type == TYPE_INT) {
+                *(int *)dst += is_insert ? *(int *)src : -*(int *)src;
+            } else {
+                *(float *)dst += is_insert ? *(float *)src : -*(float *)src;
+            }
+            break;
+        }
+        case ast::AGGR_TYPE_MIN:
+        case ast::AGGR_TYPE_MAX: {
+            const char *src = record + src_cols[i]->offset;
+            int cmp = ValueView::of(src, col.type, col.len).compare(ValueView::of(dst, col.type, col.len));
+            if (!is_insert) {
+                recompute |= cmp == 0;
+            } else if (view.aggrs[i] == ast::AGGR_TYPE_MIN ? cmp < 0 : cmp > 0) {
+                memcpy(dst, src, col.len);
+            }
+            break;
+        }
+        default:
+            break;
+        }
+    }
+
+    if (*(int *)(buf + view_tab.cols[view.count_col].offset) == 0) {
+        ih->delete_entry(key.data(), txn);
+        fh->delete_record(rid, context);
+        return;
+    }
+    if (recompute) {
+        recompute_view_extremes(view_tab, base, key.data(), buf);
+    }
+    fh->update_record(rid, buf, context);
+}
+
+/**
+ * @description: 扫描基表，重新计算一个分组的MIN/MAX，写入视图记录
+ * @param {TabMeta&} view_tab 视图表
+ * @param {TabMeta&} base 基表
+ * @param {char*} key 分组列的值，按视图表中分组列的顺序
+ * @param {char*} view_record 该分组的视图记录
+ */
+void SmManager::recompute_view_extremes(TabMeta &view_tab, TabMeta &base, const char *key, char *view_record) {
+    const ViewMeta &view = view_tab.view;
+    std::vector<const ColMeta *> group_cols;
+    std::vector<std::pair<size_t, const ColMeta *>> extreme_cols; // MIN/MAX列在视图表中的下标和在基表中的来源列
+    for (size_t i = 0; i < view.src_cols.size(); i++) {
+        if (view.aggrs[i] == ast::NO_AGGR) {
+            group_cols.push_back(&*base.get_col(view.src_cols[i]));
+        } else if (view.aggrs[i] == ast::AGGR_TYPE_MIN || view.aggrs[i] == ast::AGGR_TYPE_MAX) {
+            extreme_cols.emplace_back(i, &*base.get_col(view.src_cols[i]));
+        }
+    }
+
+    RmFileHandle *fh = fhs_.at(base.name).get();
+    bool first = true;
+    auto accumulate = [&](int, const char *record) {
+        size_t offset = 0;
+        for (auto col : group_cols) {
+            if (memcmp(record + col->offset, key + offset, col->len) != 0) {
+                return;
+            }
+            offset += col->len;
+        }
+        for (auto &[i, src_col] : extreme_cols) {
+            auto &col = view_tab.cols[i];
+            const char *src = record + src_col->offset;
+            char *dst = view_record + col.offset;
+            int cmp = first ? 0 : ValueView::of(src, col.type, col.len).compare(ValueView::of(dst, col.type, col.len));
+            if (first || (view.aggrs[i] == ast::AGGR_TYPE_MIN ? cmp < 0 : cmp > 0)) {
+                memcpy(dst, src, col.len);
+            }
+        }
+        first = false;
+    };
+    for (int partition = 0; partition < fh->num_partitions(); partition++) {
+        RmPageRange range = fh->page_range(partition);
+        for (int page_no = range.begin; page_no < range.end; page_no++) {
+            fh->for_each_record(page_no, accumulate);
+        }
+    }
+}
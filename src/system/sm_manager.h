@@ -10,6 +10,9 @@ See the Mulan PSL v2 for more details. */
 
 #pragma once
 
+#include <mutex>
+#include <optional>
+
 #include "common/context.h"
 #include "index/ix.h"
 #include "record/rm_file_handle.h"
@@ -24,6 +27,21 @@ struct ColDef {
     int len;          // Length of column
 };
 
+/* 建表语句中的分区方式 */
+struct PartitionDef {
+    PartitionType type = PARTITION_NONE;
+    std::string col_name;                     // 分区列
+    std::vector<std::string> names;           // 各分区的名称
+    std::vector<std::optional<Value>> bounds; // RANGE分区各分区的上界（不含），std::nullopt表示MAXVALUE
+};
+
+/* 创建物化视图语句中的SELECT，已经过语义检查 */
+struct ViewDef {
+    std::string base_tab;           // 基表
+    std::vector<TabCol> sel_cols;   // 选择列，含聚合函数
+    std::vector<TabCol> group_cols; // GROUP BY列
+};
+
 /* 系统管理器，负责元数据管理和DDL语句的执行 */
 class SmManager {
   public:
@@ -37,6 +55,11 @@ class SmManager {
     BufferPoolManager *buffer_pool_manager_;
     RmManager *rm_manager_;
     IxManager *ix_manager_;
+    std::unordered_map<int, std::vector<std::string>> temp_tables_; // 会话id -> 该会话创建的临时表
+    std::unordered_map<std::string, std::vector<std::string>> views_; // 基表名称 -> 建在该表上的物化视图
+    mutable std::mutex view_latch_;                                  // 保护views_，并串行化物化视图记录的读-改-写
+    std::unordered_map<std::string, uint64_t> table_versions_;       // 表名 -> 修改计数，用于判断缓存的查询结果是否过期
+    mutable std::mutex table_version_latch_;
 
   public:
     SmManager(DiskManager *disk_manager, BufferPoolManager *buffer_pool_manager, RmManager *rm_manager,
@@ -76,10 +99,13 @@ class SmManager {
 
     void desc_table(const std::string &tab_name, Context *context);
 
-    void create_table(const std::string &tab_name, const std::vector<ColDef> &col_defs, Context *context);
+    void create_table(const std::string &tab_name, const std::vector<ColDef> &col_defs, Context *context,
+                      bool temporary = false, const PartitionDef &partition = PartitionDef());
 
     void drop_table(const std::string &tab_name, Context *context);
 
+    void drop_temp_tables(int session_id);
+
     void create_index(const std::string &tab_name, const std::vector<std::string> &col_names, Context *context);
 
     void drop_index(const std::string &tab_name, const std::vector<std::string> &col_names, Context *context);
@@ -87,4 +113,43 @@ class SmManager {
     void drop_index(const std::string &tab_name, const std::vector<ColMeta> &col_names, Context *context);
 
     void show_index(const std::string &tab_name, Context *context);
+
+    void show_buffer_pool(Context *context);
+
+    void create_view(const std::string &view_name, const ViewDef &def, Context *context);
+
+    void drop_view(const std::string &view_name, Context *context);
+
+    bool has_views(const std::string &tab_name) const {
+        std::lock_guard<std::mutex> lock(view_latch_);
+        return views_.count(tab_name) > 0;
+    }
+
+    std::vector<std::string> get_views(const std::string &tab_name) const {
+        std::lock_guard<std::mutex> lock(view_latch_);
+        auto it = views_.find(tab_name);
+        return it != views_.end() ? it->second : std::vector<std::string>();
+    }
+
+    void maintain_views(const std::string &tab_name, const char *old_record, const char *new_record,
+                        Context *context);
+
+    uint64_t table_version(const std::string &tab_name) const;
+
+    void bump_table_version(const std::string &tab_name);
+
+  private:
+    static PartitionMeta check_partition(const TabMeta &tab, const PartitionDef &partition);
+
+    static std::vector<std::string> data_file_names(const TabMeta &tab);
+
+    std::unique_ptr<RmFileHandle> open_table_file(const TabMeta &tab);
+
+    std::unique_ptr<IxIndexHandle> open_table_index(const TabMeta &tab, const std::vector<ColMeta> &cols);
+
+    static std::vector<ColDef> view_col_defs(const TabMeta &base, const ViewDef &def, ViewMeta &view);
+
+    void apply_view_delta(TabMeta &view_tab, TabMeta &base, const char *record, bool is_insert, Context *context);
+
+    void recompute_view_extremes(TabMeta &view_tab, TabMeta &base, const char *key, char *view_record);
 };
\ No newline at end of file
@@ -78,17 +78,128 @@ struct IndexMeta {
     }
 };
 
+enum PartitionType { PARTITION_NONE = 0, PARTITION_RANGE, PARTITION_HASH };
+
+/* 分区元数据，每个分区是一个单独的数据文件，文件名为"表名.分区名" */
+struct PartitionMeta {
+    PartitionType type = PARTITION_NONE;
+    std::string col_name;            // 分区列
+    std::vector<std::string> names;  // 各分区的名称
+    std::vector<std::string> bounds; // RANGE分区各分区的上界（不含），分区列的原始字节，空串表示MAXVALUE
+
+    bool is_partitioned() const {
+        return type != PARTITION_NONE;
+    }
+
+    friend std::ostream &operator<<(std::ostream &os, const PartitionMeta &partition) {
+        os << partition.type;
+        if (!partition.is_partitioned()) {
+            return os;
+        }
+        os << ' ' << partition.col_name << ' ' << partition.names.size();
+        for (size_t i = 0; i < partition.names.size(); i++) {
+            os << "\n" << partition.names[i];
+            if (partition.type == PARTITION_RANGE) {
+                // 上界按十六进制写入，字符串中可能有空白
+                static const char *digits = "0123456789abcdef";
+                std::string hex = partition.bounds[i].empty() ? "-" : "";
+                for (unsigned char c : partition.bounds[i]) {
+                    hex += digits[c >> 4];
+                    hex += digits[c & 0xf];
+                }
+                os << ' ' << hex;
+            }
+        }
+        return os;
+    }
+
+    friend std::istream &operator>>(std::istream &is, PartitionMeta &partition) {
+        int type;
+        is >> type;
+        partition.type = static_cast<PartitionType>(type);
+        if (!partition.is_partitioned()) {
+            return is;
+        }
+        size_t n;
+        is >> partition.col_name >> n;
+        partition.names.resize(n);
+        partition.bounds.resize(type == PARTITION_RANGE ? n : 0);
+        for (size_t i = 0; i < n; i++) {
+            is >> partition.names[i];
+            if (partition.type == PARTITION_RANGE) {
+                std::string hex;
+                is >> hex;
+                for (size_t j = 0; hex != "-" && j + 1 < hex.size(); j += 2) {
+                    partition.bounds[i] += static_cast<char>(std::stoi(hex.substr(j, 2), nullptr, 16));
+                }
+            }
+        }
+        return is;
+    }
+};
+
+/* 物化视图元数据。视图的数据是与视图同名的表，基表的每个分组一条记录，表上建有分组列的索引，基表增删改时同步维护 */
+struct ViewMeta {
+    std::string base_tab;                    // 基表名称，空串表示不是物化视图
+    std::vector<std::string> src_cols;       // 视图表每一列在基表中的来源列，COUNT(*)为"*"
+    std::vector<ast::AggregationType> aggrs; // 视图表每一列的聚合函数，分组列为NO_AGGR
+    int count_col = -1;                      // COUNT(*)列的下标，分组的记录数减为0时删除该分组
+
+    bool is_view() const {
+        return !base_tab.empty();
+    }
+
+    friend std::ostream &operator<<(std::ostream &os, const ViewMeta &view) {
+        if (!view.is_view()) {
+            return os << '-';
+        }
+        os << view.base_tab << ' ' << view.count_col << ' ' << view.src_cols.size();
+        for (size_t i = 0; i < view.src_cols.size(); i++) {
+            os << "\n" << view.src_cols[i] << ' ' << view.aggrs[i];
+        }
+        return os;
+    }
+
+    friend std::istream &operator>>(std::istream &is, ViewMeta &view) {
+        is >> view.base_tab;
+        if (view.base_tab == "-") {
+            view.base_tab.clear();
+            return is;
+        }
+        size_t n;
+        is >> view.count_col >> n;
+        view.src_cols.resize(n);
+        view.aggrs.resize(n);
+        for (size_t i = 0; i < n; i++) {
+            int aggr;
+            is >> view.src_cols[i] >> aggr;
+            view.aggrs[i] = static_cast<ast::AggregationType>(aggr);
+        }
+        return is;
+    }
+};
+
+// 元数据文件的格式版本，写在文件开头的META_VERSION_MARKER之后。没有这一行的是版本1，表没有分区和物化视图的定义
+constexpr int META_VERSION = 2;
+static const std::string META_VERSION_MARKER = "#version";
+
 /* 表元数据 */
 struct TabMeta {
     std::string name;               // 表名称
     std::vector<ColMeta> cols;      // 表包含的字段
     std::vector<IndexMeta> indexes; // 表上建立的索引
+    bool is_temporary = false;      // 临时表，数据只在内存中，不写入元数据文件，会话断开时删除
+    PartitionMeta partition;        // 分区方式，未分区时type为PARTITION_NONE
+    ViewMeta view;                  // 物化视图的定义，普通表的base_tab为空
 
     TabMeta() {
     }
 
     TabMeta(const TabMeta &other) {
         name = other.name;
+        is_temporary = other.is_temporary;
+        partition = other.partition;
+        view = other.view;
         for (auto col : other.cols)
             cols.push_back(col);
     }
@@ -151,22 +262,32 @@ struct TabMeta {
         for (auto &index : tab.indexes) {
             os << index << "\n";
         }
+        os << tab.partition << "\n";
+        os << tab.view << "\n";
         return os;
     }
 
     friend std::istream &operator>>(std::istream &is, TabMeta &tab) {
+        return tab.read(is, META_VERSION);
+    }
+
+    // 按version版本的格式读取，旧版本中没有的字段保持默认值
+    std::istream &read(std::istream &is, int version) {
         size_t n;
-        is >> tab.name >> n;
+        is >> name >> n;
         for (size_t i = 0; i < n; i++) {
             ColMeta col;
             is >> col;
-            tab.cols.push_back(col);
+            cols.push_back(col);
         }
         is >> n;
         for (size_t i = 0; i < n; ++i) {
             IndexMeta index;
             is >> index;
-            tab.indexes.push_back(index);
+            indexes.push_back(index);
+        }
+        if (version >= 2) {
+            is >> partition >> view;
         }
         return is;
     }
@@ -204,20 +325,36 @@ class DbMeta {
     }
 
     // 重载操作符 <<
+    // 临时表不写入元数据文件，重启后不存在
     friend std::ostream &operator<<(std::ostream &os, const DbMeta &db_meta) {
-        os << db_meta.name_ << '\n' << db_meta.tabs_.size() << '\n';
+        size_t num_tabs = 0;
         for (auto &entry : db_meta.tabs_) {
-            os << entry.second << '\n';
+            num_tabs += !entry.second.is_temporary;
+        }
+        os << META_VERSION_MARKER << ' ' << META_VERSION << '\n';
+        os << db_meta.name_ << '\n' << num_tabs << '\n';
+        for (auto &entry : db_meta.tabs_) {
+            if (!entry.second.is_temporary) {
+                os << entry.second << '\n';
+            }
         }
         return os;
     }
 
     friend std::istream &operator>>(std::istream &is, DbMeta &db_meta) {
+        int version = 1;
+        is >> db_meta.name_;
+        if (db_meta.name_ == META_VERSION_MARKER) {
+            is >> version >> db_meta.name_;
+        }
+        if (version > META_VERSION) {
+            throw RMDBError("Unsupported meta version " + std::to_string(version));
+        }
         size_t n;
-        is >> db_meta.name_ >> n;
+        is >> n;
         for (size_t i = 0; i < n; i++) {
             TabMeta tab;
-            is >> tab;
+            tab.read(is, version);
             db_meta.tabs_[tab.name] = tab;
         }
         return is;
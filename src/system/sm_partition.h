@@ -0,0 +1,164 @@
+/* Copyright (c) 2023 Renmin University of China
+RMDB is licensed under Mulan PSL v2.
+You can use this software according to the terms and conditions of the Mulan PSL v2.
+You may obtain a copy of Mulan PSL v2 at:
+        http://license.coscl.org.cn/MulanPSL2
+THIS SOFTWARE IS PROVIDED ON AN "AS IS" BASIS, WITHOUT WARRANTIES OF ANY KIND,
+EITHER EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO NON-INFRINGEMENT,
+MERCHANTABILITY OR FIT FOR A PARTICULAR PURPOSE.
+See the Mulan PSL v2 for more details. */
+
+#pragma once
+
+#include <cstdint>
+#include <vector>
+
+#include "common/common.h"
+#include "sm_meta.h"
+
+/**
+ * @description: 按表的分区方式计算记录所在的分区，并根据扫描的选择条件裁剪不可能有满足条件记录的分区。
+ * RANGE分区按上界二分查找；HASH分区对分区列的原始字节做FNV-1a哈希，字符串末尾以'\0'填充，常量和记录得到相同的字节
+ */
+class Partitioner {
+  public:
+    explicit Partitioner(const TabMeta &tab) : tab_name_(tab.name), partition_(tab.partition) {
+        if (partition_.is_partitioned()) {
+            auto it = std::find_if(tab.cols.begin(), tab.cols.end(),
+                                   [&](const ColMeta &col) { return col.name == partition_.col_name; });
+            assert(it != tab.cols.end());
+            col_ = *it;
+        }
+    }
+
+    int num_partitions() const {
+        return partition_.is_partitioned() ? (int)partition_.names.size() : 1;
+    }
+
+    /**
+     * @description: 记录所在的分区
+     * @return {int} 分区号，非分区表总是0
+     * @param {char*} record 整条记录
+     */
+    int partition_of(const char *record) const {
+        if (!partition_.is_partitioned()) {
+            return 0;
+        }
+        int partition = partition_of_key(record + col_.offset);
+        if (partition < 0) {
+            throw InvalidPartitionError("table " + tab_name_ + " has no partition for the value of " + col_.name);
+        }
+        return partition;
+    }
+
+    /**
+     * @description: 裁剪分区：分区列与常量比较的条件（=、<、<=、>、>=和IN）排除不可能有满足条件记录的分区，
+     * 其他条件不参与裁剪。HASH分区只能用=和IN裁剪
+     * @return {vector<int>} 需要扫描的分区，升序；条件矛盾时可能为空
+     * @param {vector<Condition>&} conds 扫描的选择条件，都是本表的列
+     */
+    std::vector<int> prune(const std::vector<Condition> &conds) const {
+        int n = num_partitions();
+        std::vector<bool> keep(n, true);
+        for (auto &cond : conds) {
+            if (!partition_.is_partitioned() || !cond.is_rhs_val || cond.rhs_expr != nullptr || cond.op == OP_OR ||
+                cond.lhs_col.col_name != col_.name) {
+                continue;
+            }
+            for (int i = 0; i < n; i++) {
+                keep[i] = keep[i] && may_match(i, cond);
+            }
+        }
+        std::vector<int> partitions;
+        for (int i = 0; i < n; i++) {
+            if (keep[i]) {
+                partitions.push_back(i);
+            } else {
+                thread_stats().partitions_pruned++;
+            }
+        }
+        return partitions;
+    }
+
+  private:
+    std::string tab_name_;
+    PartitionMeta partition_;
+    ColMeta col_; // 分区列
+
+    // 分区列的原始字节所在的分区，RANGE分区中大于等于所有上界时返回-1
+    int partition_of_key(const char *key) const {
+        if (partition_.type == PARTITION_HASH) {
+            return (int)(hash_key(key) % partition_.names.size());
+        }
+        return range_partition_of(ValueView::of(key, col_.type, col_.len));
+    }
+
+    // 第一个上界大于value的分区，上界升序排列
+    int range_partition_of(const ValueView &value) const {
+        int lo = 0, hi = (int)partition_.bounds.size();
+        while (lo < hi) {
+            int mid = (lo + hi) / 2;
+            if (partition_.bounds[mid].empty() || value.compare(bound(mid)) < 0) {
+                hi = mid;
+            } else {
+                lo = mid + 1;
+            }
+        }
+        return lo < (int)partition_.bounds.size() ? lo : -1;
+    }
+
+    ValueView bound(int partition) const {
+        return ValueView::of(partition_.bounds[partition].data(), col_.type, col_.len);
+    }
+
+    uint64_t hash_key(const char *key) const {
+        uint64_t hash = 14695981039346656037ULL;
+        for (int i = 0; i < col_.len; i++) {
+            hash = (hash ^ (unsigned char)key[i]) * 1099511628211ULL;
+        }
+        return hash;
+    }
+
+    // 常量所在的分区；字符串比分区列长时不可能等于任何记录，返回-1
+    int partition_of_value(const Value &value) const {
+        ValueView view = ValueView::of(value);
+        if (partition_.type == PARTITION_RANGE) {
+            return range_partition_of(view);
+        }
+        if (view.type == TYPE_STRING && view.len > col_.len) {
+            return -1;
+        }
+        std::vector<char> key(col_.len);
+        view.store(key.data(), col_.type, col_.len);
+        return partition_of_key(key.data());
+    }
+
+    // 分区中是否可能有满足cond的记录
+    bool may_match(int partition, const Condition &cond) const {
+        if (cond.op == OP_EQ) {
+            return partition_of_value(cond.rhs_val) == partition;
+        }
+        if (cond.op == OP_IN) {
+            return std::any_of(cond.rhs_vals.begin(), cond.rhs_vals.end(),
+                               [&](const Value &value) { return partition_of_value(value) == partition; });
+        }
+        if (partition_.type != PARTITION_RANGE) {
+            return true;
+        }
+        // RANGE分区i中的值在[bounds[i - 1], bounds[i])内
+        ValueView value = ValueView::of(cond.rhs_val);
+        bool has_lower = partition > 0;
+        bool has_upper = !partition_.bounds[partition].empty();
+        switch (cond.op) {
+        case OP_LT:
+            return !has_lower || bound(partition - 1).compare(value) < 0;
+        case OP_LE:
+            return !has_lower || bound(partition - 1).compare(value) <= 0;
+        case OP_GT:
+        case OP_GE:
+            return !has_upper || bound(partition).compare(value) > 0;
+        default:
+            return true;
+        }
+    }
+};
@@ -0,0 +1,94 @@
+/* Copyright (c) 2023 Renmin University of China
+RMDB is licensed under Mulan PSL v2.
+You can use this software according to the terms and conditions of the Mulan PSL v2.
+You may obtain a copy of Mulan PSL v2 at:
+        http://license.coscl.org.cn/MulanPSL2
+THIS SOFTWARE IS PROVIDED ON AN "AS IS" BASIS, WITHOUT WARRANTIES OF ANY KIND,
+EITHER EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO NON-INFRINGEMENT,
+MERCHANTABILITY OR FIT FOR A PARTICULAR PURPOSE.
+See the Mulan PSL v2 for more details. */
+
+// TaskScheduler的基准测试：调度开销和负载均衡
+// 用法: scheduler_benchmark [工作线程数，默认CPU核数-1]
+
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <thread>
+#include <vector>
+
+#include "common/task_scheduler.h"
+
+using Clock = std::chrono::steady_clock;
+
+static double elapsed_us(Clock::time_point start) {
+    return std::chrono::duration<double, std::micro>(Clock::now() - start).count();
+}
+
+// 忙等指定的时间，模拟一个morsel的计算量
+static void spin(double us) {
+    auto start = Clock::now();
+    while (elapsed_us(start) < us) {
+    }
+}
+
+// 提交大量空任务，测量每个任务的调度开销，并与每个任务创建一个线程对比
+static void bench_overhead(TaskScheduler &scheduler) {
+    printf("== scheduling overhead ==\n");
+    printf("%10s %14s %14s\n", "tasks", "total_us", "ns_per_task");
+    for (size_t num_tasks : {1000, 10000, 100000}) {
+        auto start = Clock::now();
+        scheduler.submit(num_tasks, [](size_t, size_t) {})->wait();
+        double us = elapsed_us(start);
+        printf("%10zu %14.1f %14.1f\n", num_tasks, us, us * 1000 / num_tasks);
+    }
+    const size_t num_threads = 1000;
+    auto start = Clock::now();
+    for (size_t i = 0; i < num_threads; i++) {
+        std::thread([] {}).join();
+    }
+    double us = elapsed_us(start);
+    printf("%10s %14.1f %14.1f  (std::thread per task)\n", "1000", us, us * 1000 / num_threads);
+}
+
+/**
+ * 每个任务忙等cost(task)微秒，比较实际耗时和理想耗时(总计算量/线程数)。
+ * submit()按连续的块分配任务，倾斜的负载会集中在少数线程的队列中，只能靠窃取来均衡
+ */
+template <typename Cost>
+static void bench_balance(TaskScheduler &scheduler, const char *name, size_t num_tasks, Cost cost) {
+    double total = 0;
+    for (size_t task = 0; task < num_tasks; task++) {
+        total += cost(task);
+    }
+    auto before = scheduler.stats();
+    auto start = Clock::now();
+    scheduler.submit(num_tasks, [&cost](size_t task, size_t) { spin(cost(task)); })->wait();
+    double us = elapsed_us(start);
+    auto after = scheduler.stats();
+    double ideal = total / scheduler.num_workers();
+    printf("%-10s %12.0f %12.0f %11.1f%% %10lu\n", name, us, ideal, ideal / us * 100,
+           (unsigned long)(after.stolen - before.stolen));
+}
+
+int main(int argc, char **argv) {
+    size_t num_threads = std::max(1u, std::thread::hardware_concurrency()) - 1;
+    if (argc > 1) {
+        num_threads = std::strtoul(argv[1], nullptr, 10);
+    }
+    TaskScheduler scheduler(num_threads);
+    printf("workers: %zu (including the submitting thread)\n\n", scheduler.num_workers());
+
+    bench_overhead(scheduler);
+
+    printf("\n== load balancing ==\n");
+    printf("%-10s %12s %12s %12s %10s\n", "workload", "elapsed_us", "ideal_us", "efficiency", "stolen");
+    const size_t num_tasks = 64 * scheduler.num_workers();
+    bench_balance(scheduler, "uniform", num_tasks, [](size_t) { return 200.0; });
+    // 开头的1/8任务代价是其余的20倍，全部落在第一个块中
+    bench_balance(scheduler, "skewed", num_tasks,
+                  [num_tasks](size_t task) { return task < num_tasks / 8 ? 2000.0 : 100.0; });
+    // 每隔一个任务代价很高，模拟选择率不均匀的morsel
+    bench_balance(scheduler, "alternate", num_tasks, [](size_t task) { return task % 2 == 0 ? 500.0 : 20.0; });
+    return 0;
+}
@@ -9,6 +9,9 @@ MERCHANTABILITY OR FIT FOR A PARTICULAR PURPOSE.
 See the Mulan PSL v2 for more details. */
 
 #include "transaction_manager.h"
+
+#include <unordered_set>
+
 #include "record/rm_file_handle.h"
 #include "system/sm_manager.h"
 
@@ -173,12 +176,13 @@ void TransactionManager::abort(Transaction *txn, LogManager *log_manager) {
                         memcpy(key + offset, record->data + col->offset, col->len);
                         offset += col->len;
                     }
-                    ih->delete_entry(key, nullptr);
+                    ih->delete_entry(key, write_record->GetRid(), nullptr);
                     delete[] key;
                 }
 
                 // delete
                 fh_->delete_record(write_record->GetRid(), nullptr);
+                sm_manager_->maintain_views(write_record->GetTableName(), record->data, nullptr, nullptr);
             } else if (write_record->GetWriteType() == WType::DELETE_TUPLE) {
                 // insert
                 fh_->insert_record(write_record->GetRid(), write_record->GetRecord().data);
@@ -197,6 +201,8 @@ void TransactionManager::abort(Transaction *txn, LogManager *log_manager) {
                     ih->insert_entry(key, write_record->GetRid(), nullptr);
                     delete[] key;
                 }
+                sm_manager_->maintain_views(write_record->GetTableName(), nullptr, write_record->GetRecord().data,
+                                            nullptr);
             } else if (write_record->GetWriteType() == WType::UPDATE_TUPLE) {
                 // update
                 fh_->update_record(write_record->GetRid(), write_record->GetOldRecord().data, nullptr);
@@ -222,13 +228,23 @@ void TransactionManager::abort(Transaction *txn, LogManager *log_manager) {
                         continue;
                     }
 
-                    ih->delete_entry(key_new, nullptr);
+                    ih->delete_entry(key_new, write_record->GetRid(), nullptr);
                     ih->insert_entry(key_old, write_record->GetRid(), nullptr);
                     delete[] key_old;
                     delete[] key_new;
                 }
+                sm_manager_->maintain_views(write_record->GetTableName(), write_record->GetRecord().data,
+                                            write_record->GetOldRecord().data, nullptr);
             }
         }
+        // 回滚改变了这些表的内容，缓存的查询结果失效
+        std::unordered_set<std::string> tab_names;
+        for (auto write_record : *(txn->get_write_set())) {
+            tab_names.insert(write_record->GetTableName());
+        }
+        for (auto &tab_name : tab_names) {
+            sm_manager_->bump_table_version(tab_name);
+        }
     }
 
     // 2. 释放所有锁
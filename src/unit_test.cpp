@@ -13,24 +13,34 @@ See the Mulan PSL v2 for more details. */
 #define private public
 
 #include "execution/external_merge_sort.h"
+#include "common/result_cache.h"
+#include "common/task_scheduler.h"
+#include "index/ix.h"
 #include "record/rm.h"
 #include "storage/buffer_pool_manager.h"
+#include "system/sm_partition.h"
 
 #undef private
 
+#include <algorithm>
 #include <cassert>
+#include <climits>
 #include <cstdio>
 #include <cstdlib>
 #include <cstring>
 #include <ctime>
+#include <functional>
 #include <iostream>
 #include <memory>
+#include <random>
 #include <set>
+#include <sstream>
 #include <string>
 #include <thread> // NOLINT
 #include <unordered_map>
 #include <vector>
 
+#include "replacer/clock_replacer.h"
 #include "replacer/lru_replacer.h"
 #include "storage/disk_manager.h"
 #include "gtest/gtest.h"
@@ -240,6 +250,46 @@ TEST(LRUReplacerTest, SampleTest) {
     EXPECT_EQ(4, value);
 }
 
+TEST(ClockReplacerTest, SampleTest) {
+    ClockReplacer clock_replacer(7);
+
+    // Scenario: unpin six elements, i.e. add them to the replacer.
+    clock_replacer.unpin(1);
+    clock_replacer.unpin(2);
+    clock_replacer.unpin(3);
+    clock_replacer.unpin(4);
+    clock_replacer.unpin(5);
+    clock_replacer.unpin(6);
+    clock_replacer.unpin(1);
+    EXPECT_EQ(6, clock_replacer.Size());
+
+    // Scenario: get three victims. The first sweep clears all reference bits.
+    int value;
+    clock_replacer.victim(&value);
+    EXPECT_EQ(1, value);
+    clock_replacer.victim(&value);
+    EXPECT_EQ(2, value);
+    clock_replacer.victim(&value);
+    EXPECT_EQ(3, value);
+
+    // Scenario: pin elements in the replacer.
+    clock_replacer.pin(3);
+    clock_replacer.pin(4);
+    EXPECT_EQ(2, clock_replacer.Size());
+
+    // Scenario: unpin 4. Its reference bit is set, so it gets a second chance.
+    clock_replacer.unpin(4);
+
+    clock_replacer.victim(&value);
+    EXPECT_EQ(5, value);
+    clock_replacer.victim(&value);
+    EXPECT_EQ(6, value);
+    clock_replacer.victim(&value);
+    EXPECT_EQ(4, value);
+    EXPECT_EQ(0, clock_replacer.Size());
+    EXPECT_FALSE(clock_replacer.victim(&value));
+}
+
 /** 注意：每个测试点只测试了单个文件！
  * 对于每个测试点，先创建和进入目录TEST_DB_NAME
  * 然后在此目录下创建和打开文件TEST_FILE_NAME，记录其文件描述符fd */
@@ -671,6 +721,894 @@ TEST(RecordManagerTest, SimpleTest) {
     rm_manager->destroy_file(filename);
 }
 
+TEST(RecordManagerTest, ConcurrentInsertTest) {
+    auto disk_manager = std::make_unique<DiskManager>();
+    auto buffer_pool_manager = std::make_unique<BufferPoolManager>(BUFFER_POOL_SIZE, disk_manager.get());
+    auto rm_manager = std::make_unique<RmManager>(disk_manager.get(), buffer_pool_manager.get());
+
+    std::string filename = "concurrent_insert.txt";
+    if (disk_manager->is_file(filename)) {
+        disk_manager->destroy_file(filename);
+    }
+    rm_manager->create_file(filename, 64);
+    auto file_handle = rm_manager->open_file(filename);
+
+    // 多个线程同时插入，每个线程插入到自己条带的页面上
+    const int num_threads = 8;
+    const int records_per_thread = 2000;
+    std::vector<std::vector<Rid>> rids(num_threads);
+    std::vector<std::thread> threads;
+    for (int t = 0; t < num_threads; t++) {
+        threads.emplace_back([&, t] {
+            char buf[64];
+            for (int i = 0; i < records_per_thread; i++) {
+                memset(buf, 0, sizeof(buf));
+                *reinterpret_cast<int *>(buf) = t * records_per_thread + i;
+                rids[t].push_back(file_handle->insert_record(buf, nullptr));
+            }
+        });
+    }
+    for (auto &thread : threads) {
+        thread.join();
+    }
+    std::set<std::pair<int, int>> distinct;
+    for (int t = 0; t < num_threads; t++) {
+        for (int i = 0; i < records_per_thread; i++) {
+            Rid rid = rids[t][i];
+            EXPECT_TRUE(distinct.insert({rid.page_no, rid.slot_no}).second);
+            auto rec = file_handle->get_record(rid, nullptr);
+            EXPECT_EQ(*reinterpret_cast<int *>(rec->data), t * records_per_thread + i);
+        }
+    }
+    EXPECT_EQ(file_handle->get_num_records(), num_threads * records_per_thread);
+
+    // 删除一半记录，关闭文件后重新插入同样多的记录，应当复用空闲空间而不分配新页面
+    for (int t = 0; t < num_threads; t++) {
+        for (int i = 0; i < records_per_thread; i += 2) {
+            file_handle->delete_record(rids[t][i], nullptr);
+        }
+    }
+    rm_manager->close_file(file_handle.get());
+    file_handle = rm_manager->open_file(filename);
+    int num_pages = file_handle->get_file_hdr().num_pages;
+    char buf[64] = {};
+    for (int i = 0; i < num_threads * records_per_thread / 2; i++) {
+        file_handle->insert_record(buf, nullptr);
+    }
+    EXPECT_EQ(file_handle->get_file_hdr().num_pages, num_pages);
+    EXPECT_EQ(file_handle->get_num_records(), num_threads * records_per_thread);
+
+    rm_manager->close_file(file_handle.get());
+    rm_manager->destroy_file(filename);
+}
+
+/**
+ * @brief 重新打开文件后，第一次查询记录数和并发的插入删除同时进行，插入删除都要计入
+ */
+TEST(RecordManagerTest, ConcurrentRecordCountTest) {
+    auto disk_manager = std::make_unique<DiskManager>();
+    auto buffer_pool_manager = std::make_unique<BufferPoolManager>(BUFFER_POOL_SIZE, disk_manager.get());
+    auto rm_manager = std::make_unique<RmManager>(disk_manager.get(), buffer_pool_manager.get());
+
+    std::string filename = "concurrent_count.txt";
+    if (disk_manager->is_file(filename)) {
+        disk_manager->destroy_file(filename);
+    }
+    rm_manager->create_file(filename, 64);
+    auto file_handle = rm_manager->open_file(filename);
+    const int num_initial = 20000;
+    char buf[64] = {};
+    std::vector<Rid> initial;
+    for (int i = 0; i < num_initial; i++) {
+        initial.push_back(file_handle->insert_record(buf, nullptr));
+    }
+    rm_manager->close_file(file_handle.get());
+    file_handle = rm_manager->open_file(filename);
+
+    // 插入线程各插入records_per_thread条，删除线程删除一半原有记录，同时查询记录数
+    const int num_threads = 4;
+    const int records_per_thread = 2000;
+    std::atomic<bool> done{false};
+    std::vector<std::thread> threads;
+    for (int t = 0; t < num_threads; t++) {
+        threads.emplace_back([&] {
+            char record[64] = {};
+            for (int i = 0; i < records_per_thread; i++) {
+                file_handle->insert_record(record, nullptr);
+            }
+        });
+    }
+    threads.emplace_back([&] {
+        for (int i = 0; i < num_initial; i += 2) {
+            file_handle->delete_record(initial[i], nullptr);
+        }
+    });
+    std::thread reader([&] {
+        while (!done) {
+            int count = file_handle->get_num_records();
+            EXPECT_GE(count, num_initial / 2);
+            EXPECT_LE(count, num_initial + num_threads * records_per_thread);
+        }
+    });
+    for (auto &thread : threads) {
+        thread.join();
+    }
+    done = true;
+    reader.join();
+
+    int expected = num_initial / 2 + num_threads * records_per_thread;
+    EXPECT_EQ(file_handle->get_num_records(), expected);
+    int scanned = 0;
+    for (RmScan scan(file_handle.get()); !scan.is_end(); scan.next()) {
+        scanned++;
+    }
+    EXPECT_EQ(scanned, expected);
+
+    rm_manager->close_file(file_handle.get());
+    rm_manager->destroy_file(filename);
+}
+
+/**
+ * @brief 版本0的文件中已满的页面保留着填满前在空闲页面链表中的链接，打开时重建链表，删除已满页面中的记录后
+ * 空出的位置应当被重新使用
+ */
+TEST(RecordManagerTest, OldFormatFreeListTest) {
+    auto disk_manager = std::make_unique<DiskManager>();
+    auto buffer_pool_manager = std::make_unique<BufferPoolManager>(BUFFER_POOL_SIZE, disk_manager.get());
+    auto rm_manager = std::make_unique<RmManager>(disk_manager.get(), buffer_pool_manager.get());
+
+    std::string filename = "old_format.txt";
+    if (disk_manager->is_file(filename)) {
+        disk_manager->destroy_file(filename);
+    }
+    rm_manager->create_file(filename, 64);
+    auto file_handle = rm_manager->open_file(filename);
+    const int num_full_pages = 4;
+    int num_records_per_page = file_handle->get_file_hdr().num_records_per_page;
+    char buf[64] = {};
+    std::vector<Rid> rids;
+    for (int i = 0; i < num_full_pages * num_records_per_page; i++) {
+        rids.push_back(file_handle->insert_record(buf, nullptr));
+    }
+    rm_manager->close_file(file_handle.get());
+
+    // 改写成版本0的格式：已满的页面依次指向下一页，最后一页指向num_pages，文件头中的链表为空
+    int fd = disk_manager->open_file(filename);
+    RmFileHdr file_hdr;
+    disk_manager->read_page(fd, RM_FILE_HDR_PAGE, (char *)&file_hdr, sizeof(file_hdr));
+    EXPECT_EQ(file_hdr.num_pages, num_full_pages + 1);
+    char page[PAGE_SIZE];
+    for (int page_no = RM_FIRST_RECORD_PAGE; page_no < file_hdr.num_pages; page_no++) {
+        disk_manager->read_page(fd, page_no, page, PAGE_SIZE);
+        auto page_hdr = reinterpret_cast<RmPageHdr *>(page + Page::OFFSET_PAGE_HDR);
+        EXPECT_EQ(page_hdr->num_records, num_records_per_page);
+        page_hdr->next_free_page_no = page_no + 1;
+        disk_manager->write_page(fd, page_no, page, PAGE_SIZE);
+    }
+    file_hdr.first_free_page_no = file_hdr.num_pages;
+    file_hdr.version = 0;
+    disk_manager->write_page(fd, RM_FILE_HDR_PAGE, (char *)&file_hdr, sizeof(file_hdr));
+    disk_manager->close_file(fd);
+
+    // 换一个缓冲池，不读到改写前缓存的页面
+    buffer_pool_manager = std::make_unique<BufferPoolManager>(BUFFER_POOL_SIZE, disk_manager.get());
+    rm_manager = std::make_unique<RmManager>(disk_manager.get(), buffer_pool_manager.get());
+    file_handle = rm_manager->open_file(filename);
+    EXPECT_EQ(file_handle->get_file_hdr().version, RM_FILE_VERSION);
+    EXPECT_EQ(file_handle->get_file_hdr().first_free_page_no, RM_NO_PAGE);
+
+    std::set<std::pair<int, int>> deleted;
+    for (int i : {num_records_per_page + 1, num_records_per_page + 5, 2 * num_records_per_page - 1,
+                  4 * num_records_per_page - 2}) {
+        file_handle->delete_record(rids[i], nullptr);
+        deleted.insert({rids[i].page_no, rids[i].slot_no});
+    }
+    for (size_t i = 0; i < deleted.size(); i++) {
+        Rid rid = file_handle->insert_record(buf, nullptr);
+        EXPECT_TRUE(deleted.count({rid.page_no, rid.slot_no}));
+    }
+    EXPECT_EQ(file_handle->get_file_hdr().num_pages, num_full_pages + 1);
+    EXPECT_EQ(file_handle->get_num_records(), num_full_pages * num_records_per_page);
+
+    rm_manager->close_file(file_handle.get());
+    rm_manager->destroy_file(filename);
+}
+
+TEST(RecordManagerTest, RecordCacheTest) {
+    auto disk_manager = std::make_unique<DiskManager>();
+    auto buffer_pool_manager = std::make_unique<BufferPoolManager>(BUFFER_POOL_SIZE, disk_manager.get());
+    auto rm_manager = std::make_unique<RmManager>(disk_manager.get(), buffer_pool_manager.get(), 2);
+
+    std::string filename = "record_cache.txt";
+    if (disk_manager->is_file(filename)) {
+        disk_manager->destroy_file(filename);
+    }
+    const int record_size = RM_MAX_RECORD_SIZE;
+    rm_manager->create_file(filename, record_size);
+    auto file_handle = rm_manager->open_file(filename);
+    char buf[record_size];
+    std::vector<Rid> rids;
+    for (int i = 0; i < 10; i++) {
+        memset(buf, i, record_size);
+        rids.push_back(file_handle->insert_record(buf, nullptr));
+    }
+    file_handle->delete_record(rids[3], nullptr);
+    EXPECT_FALSE(file_handle->is_record(rids[3]));
+    EXPECT_TRUE(file_handle->is_record(rids[4]));
+
+    // 一个线程反复更新记录，读者从缓存中读到的记录不能是新旧数据混在一起的
+    std::atomic<bool> stop{false};
+    std::thread writer([&] {
+        char data[record_size];
+        for (int round = 0; round < 20000; round++) {
+            memset(data, round & 0x7f, record_size);
+            file_handle->update_record(rids[0], data, nullptr);
+        }
+        stop = true;
+    });
+    std::vector<std::thread> readers;
+    std::atomic<int> torn{0};
+    for (int t = 0; t < 4; t++) {
+        readers.emplace_back([&] {
+            while (!stop) {
+                auto rec = file_handle->get_record(rids[0], nullptr);
+                for (int i = 1; i < record_size; i++) {
+                    if (rec->data[i] != rec->data[0]) {
+                        torn++;
+                        break;
+                    }
+                }
+            }
+        });
+    }
+    writer.join();
+    for (auto &reader : readers) {
+        reader.join();
+    }
+    EXPECT_EQ(torn.load(), 0);
+
+    // 重新打开后缓存从页面中读入，扫描结果不变
+    rm_manager->close_file(file_handle.get());
+    file_handle = rm_manager->open_file(filename);
+    int num_records = 0;
+    for (RmScan scan(file_handle.get()); !scan.is_end(); scan.next()) {
+        auto rec = file_handle->get_record(scan.rid(), nullptr);
+        int i = 0;
+        while (rids[i].page_no != scan.rid().page_no || rids[i].slot_no != scan.rid().slot_no) {
+            i++;
+        }
+        if (i > 0) {
+            EXPECT_EQ(rec->data[0], (char)i);
+        }
+        num_records++;
+    }
+    EXPECT_EQ(num_records, 9);
+
+    // 表增长到超过缓存容量后停用缓存，仍然读页面
+    memset(buf, 1, record_size);
+    int num_records_per_page = file_handle->get_file_hdr().num_records_per_page;
+    for (int i = 0; i < 2 * num_records_per_page; i++) {
+        file_handle->insert_record(buf, nullptr);
+    }
+    EXPECT_GT(file_handle->get_file_hdr().num_pages, 3);
+    EXPECT_EQ(file_handle->get_num_records(), 9 + 2 * num_records_per_page);
+    EXPECT_EQ(file_handle->get_record(rids[4], nullptr)->data[0], 4);
+
+    rm_manager->close_file(file_handle.get());
+    rm_manager->destroy_file(filename);
+}
+
+/**
+ * @brief 临时表的记录和索引都在内存页面中，跨过多个页面块后读写结果不变，不占用缓冲池
+ */
+TEST(RecordManagerTest, TempFileTest) {
+    auto disk_manager = std::make_unique<DiskManager>();
+    auto buffer_pool_manager = std::make_unique<BufferPoolManager>(BUFFER_POOL_SIZE, disk_manager.get());
+    auto rm_manager = std::make_unique<RmManager>(disk_manager.get(), buffer_pool_manager.get());
+    auto ix_manager = std::make_unique<IxManager>(disk_manager.get(), buffer_pool_manager.get());
+
+    auto file_handle = rm_manager->create_temp_file(sizeof(int));
+    ColMeta col = {.tab_name = "tmp", .name = "id", .alias = "", .type = TYPE_INT, .len = sizeof(int), .offset = 0};
+    auto index_handle = ix_manager->create_temp_index({col});
+    const int num_records = 100000;
+    std::vector<Rid> rids;
+    for (int i = 0; i < num_records; i++) {
+        rids.push_back(file_handle->insert_record(reinterpret_cast<char *>(&i), nullptr));
+        index_handle->insert_entry(reinterpret_cast<char *>(&i), rids.back(), nullptr);
+    }
+    EXPECT_GT(file_handle->get_file_hdr().num_pages, 64); // 跨过前三个页面块
+    for (int i = 0; i < num_records; i += 2) {
+        file_handle->delete_record(rids[i], nullptr);
+        index_handle->delete_entry(reinterpret_cast<char *>(&i), nullptr);
+    }
+
+    int count = 0;
+    for (RmScan scan(file_handle.get()); !scan.is_end(); scan.next()) {
+        int value = *reinterpret_cast<int *>(file_handle->get_record(scan.rid(), nullptr)->data);
+        EXPECT_EQ(value % 2, 1);
+        count++;
+    }
+    EXPECT_EQ(count, num_records / 2);
+    for (int i = 0; i < num_records; i += 997) {
+        std::vector<Rid> result;
+        EXPECT_EQ(index_handle->get_value(reinterpret_cast<char *>(&i), &result, nullptr), i % 2 == 1);
+        if (i % 2 == 1) {
+            EXPECT_EQ(result[0], rids[i]);
+        }
+    }
+    EXPECT_TRUE(buffer_pool_manager->get_stats().files.empty());
+}
+
+/**
+ * @brief 缓冲池很小时大部分叶子不在缓冲池中，删除暂存到change buffer；查找时暂存的key视为不存在，
+ * 重新插入同一个key前先执行它的删除，范围查找前全部合并
+ */
+TEST(RecordManagerTest, ChangeBufferTest) {
+    auto disk_manager = std::make_unique<DiskManager>();
+    auto buffer_pool_manager = std::make_unique<BufferPoolManager>(16, disk_manager.get());
+    auto ix_manager = std::make_unique<IxManager>(disk_manager.get(), buffer_pool_manager.get());
+
+    std::string filename = "change_buffer";
+    std::vector<ColMeta> cols = {
+        {.tab_name = filename, .name = "id", .alias = "", .type = TYPE_INT, .len = sizeof(int), .offset = 0}};
+    if (ix_manager->exists(filename, cols)) {
+        ix_manager->destroy_index(filename, cols);
+    }
+    ix_manager->create_index(filename, cols);
+    auto index_handle = ix_manager->open_index(filename, cols);
+    const int num_keys = 20000;
+    for (int i = 0; i < num_keys; i++) {
+        index_handle->insert_entry(reinterpret_cast<char *>(&i), Rid{.page_no = i / 100, .slot_no = i % 100}, nullptr);
+    }
+
+    thread_stats().reset();
+    for (int i = 0; i < num_keys; i += 2) {
+        EXPECT_TRUE(index_handle->delete_entry(reinterpret_cast<char *>(&i), nullptr));
+    }
+    EXPECT_GT(thread_stats().ix_deletes_buffered, 0);
+    EXPECT_GT(index_handle->num_pending_deletes(), 0);
+    for (int i = 0; i < num_keys; i += 7) {
+        std::vector<Rid> result;
+        EXPECT_EQ(index_handle->get_value(reinterpret_cast<char *>(&i), &result, nullptr), i % 2 == 1);
+    }
+    int key = num_keys - 2;
+    Rid rid = {.page_no = num_keys, .slot_no = 0};
+    index_handle->insert_entry(reinterpret_cast<char *>(&key), rid, nullptr);
+    std::vector<Rid> result;
+    EXPECT_TRUE(index_handle->get_value(reinterpret_cast<char *>(&key), &result, nullptr));
+    EXPECT_EQ(result[0], rid);
+
+    int lower_key = 0;
+    int upper_key = num_keys;
+    Iid lower = index_handle->lower_bound(reinterpret_cast<char *>(&lower_key));
+    Iid upper = index_handle->upper_bound(reinterpret_cast<char *>(&upper_key));
+    EXPECT_EQ(index_handle->num_pending_deletes(), 0);
+    int count = 0;
+    for (IxScan scan(index_handle.get(), lower, upper, buffer_pool_manager.get()); !scan.is_end(); scan.next()) {
+        Rid entry = scan.rid();
+        int value = entry == rid ? key : entry.page_no * 100 + entry.slot_no;
+        EXPECT_TRUE(value % 2 == 1 || value == key);
+        count++;
+    }
+    EXPECT_EQ(count, num_keys / 2 + 1);
+
+    ix_manager->close_index(index_handle.get());
+    ix_manager->destroy_index(filename, cols);
+}
+
+/**
+ * @brief 求出范围扫描的起止位置之后才暂存的删除仍在叶子中，IxScan要跳过它们
+ */
+TEST(RecordManagerTest, ChangeBufferScanSkipsPendingDeletes) {
+    auto disk_manager = std::make_unique<DiskManager>();
+    auto buffer_pool_manager = std::make_unique<BufferPoolManager>(16, disk_manager.get());
+    auto ix_manager = std::make_unique<IxManager>(disk_manager.get(), buffer_pool_manager.get());
+
+    std::string filename = "change_buffer_scan";
+    std::vector<ColMeta> cols = {
+        {.tab_name = filename, .name = "id", .alias = "", .type = TYPE_INT, .len = sizeof(int), .offset = 0}};
+    if (ix_manager->exists(filename, cols)) {
+        ix_manager->destroy_index(filename, cols);
+    }
+    ix_manager->create_index(filename, cols);
+    auto index_handle = ix_manager->open_index(filename, cols);
+    const int num_keys = 20000;
+    for (int i = 0; i < num_keys; i++) {
+        index_handle->insert_entry(reinterpret_cast<char *>(&i), Rid{.page_no = i, .slot_no = 0}, nullptr);
+    }
+
+    // 删除的key离起止位置所在的叶子足够远，直接删除引起的合并不会改变起止位置
+    int lower_key = 0;
+    int upper_key = 12000;
+    Iid lower = index_handle->lower_bound(reinterpret_cast<char *>(&lower_key));
+    Iid upper = index_handle->lower_bound(reinterpret_cast<char *>(&upper_key));
+    for (int i = 2000; i < 10000; i += 2) {
+        index_handle->delete_entry(reinterpret_cast<char *>(&i), nullptr);
+    }
+    size_t num_pending = index_handle->num_pending_deletes();
+    EXPECT_GT(num_pending, 0);
+
+    int count = 0;
+    for (IxScan scan(index_handle.get(), lower, upper, buffer_pool_manager.get()); !scan.is_end(); scan.next()) {
+        int value = scan.rid().page_no;
+        EXPECT_TRUE(value < 2000 || value >= 10000 || value % 2 == 1) << value;
+        count++;
+    }
+    EXPECT_EQ(count, 12000 - 4000);
+    EXPECT_EQ(index_handle->num_pending_deletes(), num_pending); // 扫描不合并
+
+    ix_manager->close_index(index_handle.get());
+    ix_manager->destroy_index(filename, cols);
+}
+
+/**
+ * @brief 删除和查找并发执行：删除返回之后get_value就查不到该key，其他key始终能查到；
+ * 查找范围的起点时合并change buffer，和暂存删除交替进行。结束后索引中恰好剩下没有删除的key
+ */
+TEST(RecordManagerTest, ChangeBufferConcurrentTest) {
+    auto disk_manager = std::make_unique<DiskManager>();
+    auto buffer_pool_manager = std::make_unique<BufferPoolManager>(64, disk_manager.get());
+    auto ix_manager = std::make_unique<IxManager>(disk_manager.get(), buffer_pool_manager.get());
+
+    std::string filename = "change_buffer_concurrent";
+    std::vector<ColMeta> cols = {
+        {.tab_name = filename, .name = "id", .alias = "", .type = TYPE_INT, .len = sizeof(int), .offset = 0}};
+    if (ix_manager->exists(filename, cols)) {
+        ix_manager->destroy_index(filename, cols);
+    }
+    ix_manager->create_index(filename, cols);
+    auto index_handle = ix_manager->open_index(filename, cols);
+    const int num_keys = 50000;
+    for (int i = 0; i < num_keys; i++) {
+        index_handle->insert_entry(reinterpret_cast<char *>(&i), Rid{.page_no = i, .slot_no = 0}, nullptr);
+    }
+
+    // 删除所有偶数key，deleted[i]在删除返回之后置位
+    const int num_deleters = 2;
+    std::vector<std::atomic<bool>> deleted(num_keys);
+    std::atomic<int> running{num_deleters};
+    std::atomic<uint64_t> buffered{0};
+    std::vector<std::thread> threads;
+    for (int t = 0; t < num_deleters; t++) {
+        threads.emplace_back([&, t] {
+            std::vector<int> keys;
+            for (int i = t * 2; i < num_keys; i += num_deleters * 2) {
+                keys.push_back(i);
+            }
+            std::shuffle(keys.begin(), keys.end(), std::mt19937(t));
+            thread_stats().reset();
+            for (int key : keys) {
+                index_handle->delete_entry(reinterpret_cast<char *>(&key), nullptr);
+                deleted[key].store(true);
+            }
+            buffered += thread_stats().ix_deletes_buffered;
+            running--;
+        });
+    }
+    std::atomic<int> errors{0};
+    for (int t = 0; t < 2; t++) {
+        threads.emplace_back([&, t] {
+            std::mt19937 rng(100 + t);
+            for (int round = 0; running.load() > 0; round++) {
+                int key = (int)(rng() % num_keys);
+                bool was_deleted = deleted[key].load();
+                std::vector<Rid> result;
+                bool found = index_handle->get_value(reinterpret_cast<char *>(&key), &result, nullptr);
+                if ((key % 2 == 1 && !found) || (was_deleted && found)) {
+                    errors++;
+                }
+                if (round % 64 == 0) {
+                    index_handle->lower_bound(reinterpret_cast<char *>(&key));
+                }
+            }
+        });
+    }
+    for (auto &thread : threads) {
+        thread.join();
+    }
+    EXPECT_EQ(errors.load(), 0);
+    EXPECT_GT(buffered.load(), 0);
+
+    int lower_key = 0;
+    Iid lower = index_handle->lower_bound(reinterpret_cast<char *>(&lower_key));
+    int count = 0;
+    for (IxScan scan(index_handle.get(), lower, index_handle->leaf_end(), buffer_pool_manager.get());
+         !scan.is_end(); scan.next()) {
+        EXPECT_EQ(scan.rid().page_no, count * 2 + 1);
+        count++;
+    }
+    EXPECT_EQ(count, num_keys / 2);
+
+    ix_manager->close_index(index_handle.get());
+    ix_manager->destroy_index(filename, cols);
+}
+
+/**
+ * @brief 键是(int, char(400))的索引，每个结点只能放几个键，少量的插入删除就会触发分裂、合并和根结点的变化
+ */
+class BPlusTreeTest : public ::testing::Test {
+  public:
+    static constexpr int PAD_LEN = 400;
+
+    void SetUp() override {
+        disk_manager_ = std::make_unique<DiskManager>();
+        buffer_pool_manager_ = std::make_unique<BufferPoolManager>(BUFFER_POOL_SIZE, disk_manager_.get());
+        ix_manager_ = std::make_unique<IxManager>(disk_manager_.get(), buffer_pool_manager_.get());
+        std::vector<ColMeta> cols = {
+            {.tab_name = "bpt", .name = "id", .alias = "", .type = TYPE_INT, .len = sizeof(int), .offset = 0},
+            {.tab_name = "bpt", .name = "pad", .alias = "", .type = TYPE_STRING, .len = PAD_LEN, .offset = 4}};
+        ih_ = ix_manager_->create_temp_index(cols);
+        ASSERT_LT(ih_->file_hdr_->btree_order_, 10);
+    }
+
+    std::vector<char> key(int id) {
+        std::vector<char> buf(sizeof(int) + PAD_LEN, 0);
+        memcpy(buf.data(), &id, sizeof(int));
+        return buf;
+    }
+
+    void insert(int id) {
+        ih_->insert_entry(key(id).data(), Rid{.page_no = id, .slot_no = 0}, nullptr);
+    }
+
+    void remove(int id) {
+        EXPECT_TRUE(ih_->delete_entry(key(id).data(), nullptr));
+    }
+
+    /**
+     * @description: 检查B+树的结构并返回叶子链表中的全部key：内部结点的第i个key等于第i个孩子的第一个key，
+     * 孩子的parent指向该结点，内部的根至少有两个孩子，叶子链表按顺序恰好串起树中的全部叶子
+     */
+    std::vector<int> check_tree() {
+        std::vector<int> leaves;
+        std::function<void(int, int)> visit = [&](int page_no, int parent) {
+            auto node = ih_->fetch_node(page_no);
+            EXPECT_EQ(node->get_parent_page_no(), parent);
+            if (node->is_leaf_page()) {
+                leaves.push_back(page_no);
+                return;
+            }
+            EXPECT_GE(node->get_size(), parent == IX_NO_PAGE ? 2 : 1);
+            for (int i = 0; i < node->get_size(); i++) {
+                int child_no = node->value_at(i);
+                {
+                    auto child = ih_->fetch_node(child_no);
+                    EXPECT_GT(child->get_size(), 0);
+                    EXPECT_EQ(child->key_at(0), node->key_at(i)) << "stale separator in page " << page_no;
+                }
+                visit(child_no, page_no);
+            }
+        };
+        visit(ih_->file_hdr_->root_page_, IX_NO_PAGE);
+
+        std::vector<int> keys;
+        size_t leaf_idx = 0;
+        int prev = IX_LEAF_HEADER_PAGE;
+        int page_no = ih_->fetch_node(IX_LEAF_HEADER_PAGE)->get_next_leaf();
+        while (page_no != IX_LEAF_HEADER_PAGE) {
+            EXPECT_LT(leaf_idx, leaves.size());
+            if (leaf_idx >= leaves.size()) {
+                break;
+            }
+            EXPECT_EQ(page_no, leaves[leaf_idx++]) << "leaf list does not match the tree";
+            auto leaf = ih_->fetch_node(page_no);
+            EXPECT_EQ(leaf->get_prev_leaf(), prev);
+            for (int i = 0; i < leaf->get_size(); i++) {
+                if (!keys.empty()) {
+                    EXPECT_LT(keys.back(), leaf->key_at(i));
+                }
+                keys.push_back(leaf->key_at(i));
+            }
+            prev = page_no;
+            page_no = leaf->get_next_leaf();
+        }
+        EXPECT_EQ(leaf_idx, leaves.size());
+        return keys;
+    }
+
+    int height() {
+        int levels = 1;
+        for (auto node = ih_->fetch_node(ih_->file_hdr_->root_page_); !node->is_leaf_page(); levels++) {
+            node = ih_->fetch_node(node->value_at(0));
+        }
+        return levels;
+    }
+
+  protected:
+    std::unique_ptr<DiskManager> disk_manager_;
+    std::unique_ptr<BufferPoolManager> buffer_pool_manager_;
+    std::unique_ptr<IxManager> ix_manager_;
+    std::unique_ptr<IxIndexHandle> ih_;
+};
+
+// 每次插入的都是新的最小值，父结点中的key要随之更新，否则之后分裂出的结点和旧的key乱序
+TEST_F(BPlusTreeTest, InsertNewMinimumThenSplit) {
+    std::vector<int> expected;
+    for (int id = 500; id < 600; id++) {
+        insert(id);
+    }
+    for (int id = 499; id >= 0; id--) {
+        insert(id);
+    }
+    for (int id = 0; id < 600; id++) {
+        expected.push_back(id);
+    }
+    EXPECT_GT(height(), 2);
+    EXPECT_EQ(check_tree(), expected);
+    for (int id = 0; id < 600; id += 37) {
+        std::vector<Rid> result;
+        EXPECT_TRUE(ih_->get_value(key(id).data(), &result, nullptr));
+    }
+}
+
+// 合并后被删除的叶子要从叶子链表中摘除，范围扫描不能再经过它
+TEST_F(BPlusTreeTest, CoalesceUnlinksLeaf) {
+    const int num_keys = 400;
+    for (int id = 0; id < num_keys; id++) {
+        insert(id);
+    }
+    std::vector<int> victims;
+    for (int id = 50; id < 350; id++) {
+        victims.push_back(id);
+    }
+    std::shuffle(victims.begin(), victims.end(), std::mt19937(7));
+    for (int id : victims) {
+        remove(id);
+    }
+    std::vector<int> expected;
+    for (int id = 0; id < num_keys; id++) {
+        if (id < 50 || id >= 350) {
+            expected.push_back(id);
+        }
+    }
+    EXPECT_EQ(check_tree(), expected);
+    int count = 0;
+    for (IxScan scan(ih_.get(), ih_->leaf_begin(), ih_->leaf_end(), nullptr); !scan.is_end(); scan.next()) {
+        EXPECT_EQ(scan.rid().page_no, expected[count]);
+        count++;
+    }
+    EXPECT_EQ(count, (int)expected.size());
+}
+
+// 删除叶子的第一个key（包括重新分配时移走的key）后，祖先结点中的key要更新
+TEST_F(BPlusTreeTest, RefreshParentSeparator) {
+    for (int id = 0; id < 300; id++) {
+        insert(id);
+    }
+    std::set<int> alive;
+    for (int id = 0; id < 300; id++) {
+        alive.insert(id);
+    }
+    for (int round = 0; round < 5; round++) {
+        // 删除每个叶子的第一个key
+        std::vector<int> firsts;
+        int page_no = ih_->fetch_node(IX_LEAF_HEADER_PAGE)->get_next_leaf();
+        while (page_no != IX_LEAF_HEADER_PAGE) {
+            auto leaf = ih_->fetch_node(page_no);
+            firsts.push_back(leaf->key_at(0));
+            page_no = leaf->get_next_leaf();
+        }
+        for (int id : firsts) {
+            remove(id);
+            alive.erase(id);
+        }
+        EXPECT_EQ(check_tree(), std::vector<int>(alive.begin(), alive.end()));
+    }
+}
+
+// 内部的根只剩一个孩子时，这个孩子成为新的根，树变矮
+TEST_F(BPlusTreeTest, CollapseRootToOnlyChild) {
+    const int num_keys = 200;
+    for (int id = 0; id < num_keys; id++) {
+        insert(id);
+    }
+    EXPECT_GT(height(), 2);
+    for (int id = 2; id < num_keys; id++) {
+        remove(id);
+        check_tree();
+    }
+    EXPECT_EQ(height(), 1);
+    auto root = ih_->fetch_node(ih_->file_hdr_->root_page_);
+    EXPECT_TRUE(root->is_leaf_page());
+    EXPECT_EQ(root->get_parent_page_no(), IX_NO_PAGE);
+    root.reset();
+    EXPECT_EQ(check_tree(), std::vector<int>({0, 1}));
+}
+
+/**
+ * @brief 没有版本行的元数据文件是最初的格式，表没有分区和物化视图的定义，读取时取默认值；写出的是当前版本
+ */
+TEST(SmMetaTest, ReadsMetaWithoutVersion) {
+    ColMeta id = {.tab_name = "t", .name = "id", .alias = "", .type = TYPE_INT, .len = 4, .offset = 0};
+    ColMeta name = {.tab_name = "t", .name = "name", .alias = "", .type = TYPE_STRING, .len = 8, .offset = 4};
+    IndexMeta index = {.tab_name = "t", .col_tot_len = 4, .col_num = 1, .cols = {id}};
+    std::stringstream old_meta;
+    old_meta << "db\n2\n";
+    for (std::string tab_name : {"t", "u"}) {
+        old_meta << tab_name << "\n2\n" << id << "\n" << name << "\n1\n" << index << "\n\n";
+    }
+
+    DbMeta db;
+    old_meta >> db;
+    ASSERT_FALSE(old_meta.fail());
+    EXPECT_EQ(db.name_, "db");
+    ASSERT_EQ(db.tabs_.size(), 2);
+    for (std::string tab_name : {"t", "u"}) {
+        TabMeta &tab = db.get_table(tab_name);
+        EXPECT_EQ(tab.cols.size(), 2);
+        EXPECT_EQ(tab.cols[1].name, "name");
+        EXPECT_TRUE(tab.is_index({"id"}));
+        EXPECT_FALSE(tab.partition.is_partitioned());
+        EXPECT_FALSE(tab.view.is_view());
+    }
+
+    db.get_table("t").partition = {.type = PARTITION_HASH, .col_name = "id", .names = {"p0", "p1"}};
+    db.get_table("u").view = {.base_tab = "t", .src_cols = {"id", "*"}, .aggrs = {ast::NO_AGGR, ast::AGGR_TYPE_COUNT},
+                              .count_col = 1};
+    std::stringstream new_meta;
+    new_meta << db;
+    EXPECT_EQ(new_meta.str().rfind(META_VERSION_MARKER + " " + std::to_string(META_VERSION) + "\n", 0), 0);
+    DbMeta reloaded;
+    new_meta >> reloaded;
+    ASSERT_FALSE(new_meta.fail());
+    EXPECT_EQ(reloaded.name_, "db");
+    EXPECT_EQ(reloaded.get_table("t").partition.names, std::vector<std::string>({"p0", "p1"}));
+    EXPECT_EQ(reloaded.get_table("u").view.base_tab, "t");
+    EXPECT_EQ(reloaded.get_table("u").view.count_col, 1);
+    EXPECT_TRUE(reloaded.get_table("u").is_index({"id"}));
+}
+
+/**
+ * @brief RANGE分区表的记录按分区列写入各分区文件，Rid带有分区号，裁剪后只扫描剩下的分区
+ */
+TEST(RecordManagerTest, PartitionedFileTest) {
+    auto disk_manager = std::make_unique<DiskManager>();
+    auto buffer_pool_manager = std::make_unique<BufferPoolManager>(BUFFER_POOL_SIZE, disk_manager.get());
+    auto rm_manager = std::make_unique<RmManager>(disk_manager.get(), buffer_pool_manager.get());
+
+    // 分区p0: id < 1000，p1: 1000 <= id < 2000，p2: id >= 2000
+    TabMeta tab;
+    tab.name = "partitioned";
+    tab.cols.push_back({.tab_name = tab.name, .name = "id", .alias = "", .type = TYPE_INT, .len = sizeof(int)});
+    tab.partition.type = PARTITION_RANGE;
+    tab.partition.col_name = "id";
+    tab.partition.names = {"p0", "p1", "p2"};
+    for (int bound : {1000, 2000}) {
+        tab.partition.bounds.emplace_back(reinterpret_cast<char *>(&bound), sizeof(int));
+    }
+    tab.partition.bounds.emplace_back();
+    std::vector<std::string> filenames;
+    for (auto &name : tab.partition.names) {
+        filenames.push_back(tab.name + "." + name);
+        if (disk_manager->is_file(filenames.back())) {
+            disk_manager->destroy_file(filenames.back());
+        }
+        rm_manager->create_file(filenames.back(), sizeof(int));
+    }
+    Partitioner partitioner(tab);
+    auto file_handle = rm_manager->open_partitioned_file(
+        filenames, [&partitioner](const char *record) { return partitioner.partition_of(record); });
+
+    const int num_records = 3000;
+    std::vector<Rid> rids;
+    for (int i = 0; i < num_records; i++) {
+        rids.push_back(file_handle->insert_record(reinterpret_cast<char *>(&i), nullptr));
+        EXPECT_EQ(rids.back().page_no >> RM_PARTITION_PAGE_BITS, i / 1000);
+    }
+    for (int i = 0; i < num_records; i += 3) {
+        file_handle->delete_record(rids[i], nullptr);
+    }
+    EXPECT_EQ(file_handle->get_num_records(), num_records - num_records / 3);
+
+    // id >= 1500排除p0，id < 1500排除p2
+    Condition cond{.lhs_col = {.tab_name = tab.name, .col_name = "id"}, .op = OP_GE, .is_rhs_val = true};
+    cond.rhs_val.set_int(1500);
+    std::vector<int> partitions = partitioner.prune({cond});
+    EXPECT_EQ(partitions, std::vector<int>({1, 2}));
+    int count = 0;
+    for (RmScan scan(file_handle.get(), partitions); !scan.is_end(); scan.next()) {
+        int value = *reinterpret_cast<int *>(file_handle->get_record(scan.rid(), nullptr)->data);
+        EXPECT_GE(value, 1000);
+        EXPECT_NE(value % 3, 0);
+        count++;
+    }
+    EXPECT_EQ(count, 2000 - 2000 / 3);
+
+    rm_manager->close_file(file_handle.get());
+    for (auto &filename : filenames) {
+        rm_manager->destroy_file(filename);
+    }
+}
+
+/**
+ * @brief 分区表上的本地索引每个分区一棵B+树：插入和删除按Rid中的分区号转发，范围扫描对各分区的扫描做k路归并，
+ * 输出仍按键的升序
+ */
+TEST(RecordManagerTest, PartitionedIndexTest) {
+    auto disk_manager = std::make_unique<DiskManager>();
+    auto buffer_pool_manager = std::make_unique<BufferPoolManager>(BUFFER_POOL_SIZE, disk_manager.get());
+    auto ix_manager = std::make_unique<IxManager>(disk_manager.get(), buffer_pool_manager.get());
+
+    std::vector<ColMeta> cols = {
+        {.tab_name = "partitioned", .name = "id", .alias = "", .type = TYPE_INT, .len = sizeof(int), .offset = 0}};
+    std::vector<std::string> filenames = {"partitioned.p0", "partitioned.p1", "partitioned.p2"};
+    for (auto &filename : filenames) {
+        if (ix_manager->exists(filename, cols)) {
+            ix_manager->destroy_index(filename, cols);
+        }
+        ix_manager->create_index(filename, cols);
+    }
+    auto index_handle = ix_manager->open_partitioned_index(filenames, cols);
+    EXPECT_EQ(index_handle->num_partitions(), 3);
+
+    // key i在分区i % 3中，相邻的key落在不同的分区
+    const int num_keys = 3000;
+    auto rid_of = [](int i) {
+        return Rid{.page_no = ((i % 3) << RM_PARTITION_PAGE_BITS) | (i / 100 + 1), .slot_no = i % 100};
+    };
+    auto key_of = [](const Rid &rid) { return ((rid.page_no & RM_PARTITION_PAGE_MASK) - 1) * 100 + rid.slot_no; };
+    for (int i = 0; i < num_keys; i++) {
+        index_handle->insert_entry(reinterpret_cast<char *>(&i), rid_of(i), nullptr);
+    }
+    for (int i = 0; i < 3; i++) {
+        int key = i;
+        std::vector<Rid> result;
+        EXPECT_FALSE(index_handle->partition((i + 1) % 3)->get_value(reinterpret_cast<char *>(&key), &result, nullptr));
+        EXPECT_TRUE(index_handle->partition(i)->get_value(reinterpret_cast<char *>(&key), &result, nullptr));
+    }
+
+    int lower_key = 0;
+    int upper_key = num_keys;
+    int expected = 0;
+    auto scan = index_handle->range_scan(reinterpret_cast<char *>(&lower_key), reinterpret_cast<char *>(&upper_key));
+    for (; !scan->is_end(); scan->next()) {
+        EXPECT_EQ(key_of(scan->rid()), expected++);
+    }
+    EXPECT_EQ(expected, num_keys);
+
+    // 删除[1500, 1510)，只扫描0号和2号分区
+    for (int i = 1500; i < 1510; i++) {
+        EXPECT_TRUE(index_handle->delete_entry(reinterpret_cast<char *>(&i), rid_of(i), nullptr));
+    }
+    lower_key = 1000;
+    upper_key = 1999;
+    std::vector<int> keys;
+    scan = index_handle->range_scan(reinterpret_cast<char *>(&lower_key), reinterpret_cast<char *>(&upper_key),
+                                    {0, 2});
+    for (; !scan->is_end(); scan->next()) {
+        keys.push_back(key_of(scan->rid()));
+    }
+    std::vector<int> expected_keys;
+    for (int i = 1000; i <= 1999; i++) {
+        if (i % 3 != 1 && (i < 1500 || i >= 1510)) {
+            expected_keys.push_back(i);
+        }
+    }
+    EXPECT_EQ(keys, expected_keys);
+    EXPECT_TRUE(index_handle->range_scan(nullptr, nullptr, {})->is_end());
+
+    int key = 1500;
+    int entry;
+    EXPECT_TRUE(index_handle->first_entry(reinterpret_cast<char *>(&key), reinterpret_cast<char *>(&entry)));
+    EXPECT_EQ(entry, 1510);
+    key = 1505;
+    EXPECT_TRUE(index_handle->last_entry(reinterpret_cast<char *>(&key), reinterpret_cast<char *>(&entry)));
+    EXPECT_EQ(entry, 1499);
+    key = num_keys;
+    EXPECT_FALSE(index_handle->first_entry(reinterpret_cast<char *>(&key), reinterpret_cast<char *>(&entry)));
+    key = 1507;
+    std::vector<Rid> result;
+    EXPECT_FALSE(index_handle->get_value(reinterpret_cast<char *>(&key), &result, nullptr));
+    key = 1510;
+    EXPECT_TRUE(index_handle->get_value(reinterpret_cast<char *>(&key), &result, nullptr));
+    EXPECT_EQ(result, std::vector<Rid>({rid_of(key)}));
+
+    ix_manager->close_index(index_handle.get());
+    for (auto &filename : filenames) {
+        ix_manager->destroy_index(filename, cols);
+    }
+}
+
 class ExternalMergeSortTest : public ::testing::Test {
   public:
     void SetUp() override {
@@ -679,21 +1617,14 @@ class ExternalMergeSortTest : public ::testing::Test {
     }
 };
 
-int compare_int(const void *a, const void *b, void *arg) {
-    int x = *(int *)a;
-    int y = *(int *)b;
-    if (x > y) {
-        return 1;
-    } else if (x < y) {
-        return -1;
-    } else {
-        return 0;
-    }
+// 记录是单个int
+KeyComparator compare_int() {
+    return KeyComparator::create(std::vector<ColType>{TYPE_INT}, std::vector<int>{sizeof(int)});
 }
 
 TEST_F(ExternalMergeSortTest, SimpleTest1) {
     // 32M规模的排序，波形为重复的-0x8000到0x8000
-    ExternalMergeSorter sorter(1024 * 1024 * 4, 4, compare_int, nullptr);
+    ExternalMergeSorter sorter(1024 * 1024 * 4, 4, compare_int());
     for (int i = 0; i < 0x400; ++i) {
         for (int j = 0x8000; j > -0x8000; --j) {
             sorter.write((const char *)&j);
@@ -713,7 +1644,7 @@ TEST_F(ExternalMergeSortTest, SimpleTest1) {
 
 TEST_F(ExternalMergeSortTest, SimpleTest2) {
     // 除了分隔的文件不同，其他和SimpleTest1相同
-    ExternalMergeSorter sorter(1024 * 1024 * 3, 4, compare_int, nullptr);
+    ExternalMergeSorter sorter(1024 * 1024 * 3, 4, compare_int());
     for (int i = 0; i < 0x400; ++i) {
         for (int j = 0x8000; j > -0x8000; --j) {
             sorter.write((const char *)&j);
@@ -736,7 +1667,7 @@ TEST_F(ExternalMergeSortTest, ReverseOrder) {
     const int num_records_total = 0x1020000;
     // 0x1020000 /0x100000 = 16.125 个文件
     // 0x100000 / 0x20010 = 7.999023556694739 个页
-    ExternalMergeSorter sorter(1024 * 1024 * 6, 4, compare_int, nullptr);
+    ExternalMergeSorter sorter(1024 * 1024 * 6, 4, compare_int());
     for (int i = num_records_total - 1; i >= 0; --i) {
         sorter.write((const char *)&i);
     }
@@ -756,7 +1687,7 @@ TEST_F(ExternalMergeSortTest, RandomInput) {
     // 64M规模的排序，数据完全随机
     const int num_records_total = 0x1020000;
     std::ifstream urandom("/dev/urandom", std::ios::binary);
-    ExternalMergeSorter sorter(1024 * 1024 * 6, 4, compare_int, nullptr);
+    ExternalMergeSorter sorter(1024 * 1024 * 6, 4, compare_int());
     for (int i = 0; i < num_records_total; ++i) {
         int val;
         urandom.read((char *)&val, 4);
@@ -788,7 +1719,7 @@ int wave1(int x) {
 TEST_F(ExternalMergeSortTest, SawtoothWave1) {
     // 258M规模的排序，锯齿形
     const int num_records_total = 0x10200300;
-    ExternalMergeSorter sorter(1024 * 1024 * 32, 4, compare_int, nullptr);
+    ExternalMergeSorter sorter(1024 * 1024 * 32, 4, compare_int());
     for (int i = 0; i < num_records_total; ++i) {
         int val = wave1(i);
         sorter.write((const char *)&val);
@@ -810,7 +1741,7 @@ TEST_F(ExternalMergeSortTest, SawtoothWave1) {
 TEST_F(ExternalMergeSortTest, SawtoothWave2) {
     // 波形为倾斜的锯齿形，其他和SawtoothWave1相同
     const int num_records_total = 0x10200300;
-    ExternalMergeSorter sorter(1024 * 1024 * 32, 4, compare_int, nullptr);
+    ExternalMergeSorter sorter(1024 * 1024 * 32, 4, compare_int());
     for (int i = 0; i < num_records_total; ++i) {
         int val = wave1(i) - i;
         sorter.write((const char *)&val);
@@ -833,7 +1764,7 @@ TEST_F(ExternalMergeSortTest, SortInMemory) {
     // 测试输入数据不必使用外存辅助排序的情况
     // 除了文件大小不同，其他和SawtoothWave2相同
     const int num_records_total = 0x10200300;
-    ExternalMergeSorter sorter(1024 * 1024 * 32, 4, compare_int, nullptr);
+    ExternalMergeSorter sorter(1024 * 1024 * 32, 4, compare_int());
     for (int i = 0; i < num_records_total; ++i) {
         int val = wave1(i) - i;
         sorter.write((const char *)&val);
@@ -850,4 +1781,133 @@ TEST_F(ExternalMergeSortTest, SortInMemory) {
         ASSERT_LE(last_val, val);
         last_val = val;
     }
-}
\ No newline at end of file
+}
+
+TEST_F(ExternalMergeSortTest, DescendingMultiKey) {
+    // 记录为(int, char[8], int)，分别按(int, int)和(char[8], int)降序排序，后者不是连续的键，使用通用比较器
+    struct Rec {
+        int a;
+        char s[8];
+        int b;
+    };
+    ColMeta a{.type = TYPE_INT, .len = 4, .offset = 0};
+    ColMeta s{.type = TYPE_STRING, .len = 8, .offset = 4};
+    ColMeta b{.type = TYPE_INT, .len = 4, .offset = 12};
+    ColMeta ab{.type = TYPE_INT, .len = 4, .offset = 4}; // 把s的前4字节当作int，和a组成连续的两个INT
+    std::vector<std::pair<std::vector<ColMeta>, bool>> keys = {{{a, ab}, true}, {{s, b}, false}};
+    for (auto &[cols, specialized] : keys) {
+        auto cmp = KeyComparator::create(cols, cols);
+        ASSERT_EQ(cmp.is_specialized(), specialized);
+        ExternalMergeSorter sorter(1024 * 64, sizeof(Rec), cmp, true);
+        std::mt19937 rng(90);
+        const int num_records_total = 100000;
+        for (int i = 0; i < num_records_total; ++i) {
+            Rec rec{};
+            rec.a = (int)(rng() % 100) - 50;
+            snprintf(rec.s, sizeof(rec.s), "%u", (unsigned)(rng() % 1000));
+            rec.b = (int)rng();
+            sorter.write((const char *)&rec);
+        }
+        sorter.endWrite();
+        sorter.beginRead();
+        Rec last{};
+        for (int i = 0; i < num_records_total; ++i) {
+            Rec rec{};
+            sorter.read((char *)&rec);
+            if (i > 0) {
+                ASSERT_GE(cmp((const char *)&last, (const char *)&rec), 0);
+            }
+            last = rec;
+        }
+        ASSERT_TRUE(sorter.is_end());
+    }
+}
+
+// 两个run加上排序一个run用的(键, 下标)数组不超过给定的内存；内存不够两条记录时每个run一条记录
+TEST_F(ExternalMergeSortTest, RunFitsInMemory) {
+    // (内存, 记录数)，每条记录一个run时run的个数就是记录数，受打开文件数的限制
+    std::vector<std::pair<ssize_t, int>> cases = {{1024 * 64, 100000}, {1024 * 1024 * 3, 1000000}, {6, 300}};
+    for (auto [total_mem, num_records_total] : cases) {
+        ExternalMergeSorter sorter(total_mem, 4, compare_int());
+        ssize_t run_records = sorter.RUN_SIZE / 4;
+        ASSERT_GE(run_records, 1);
+        if (total_mem >= 2 * 4 + 8) {
+            EXPECT_LE(2 * sorter.RUN_SIZE + run_records * (ssize_t)sizeof(std::pair<int, uint32_t>), total_mem);
+        }
+        std::mt19937 rng(total_mem);
+        for (int i = 0; i < num_records_total; ++i) {
+            int val = (int)(rng() % 1000);
+            sorter.write((const char *)&val);
+        }
+        sorter.endWrite();
+        EXPECT_EQ(sorter.filenames_.size(), (size_t)((num_records_total + run_records - 1) / run_records));
+        sorter.beginRead();
+        int last = INT_MIN;
+        for (int i = 0; i < num_records_total; ++i) {
+            int val;
+            sorter.read((char *)&val);
+            ASSERT_LE(last, val);
+            last = val;
+        }
+        ASSERT_TRUE(sorter.is_end());
+    }
+}
+
+TEST(TaskSchedulerTest, RunsEveryTaskOnce) {
+    TaskScheduler scheduler(3);
+    const size_t num_tasks = 1000;
+    std::vector<std::atomic<int>> runs(num_tasks);
+    std::atomic<size_t> max_worker{0};
+    auto group = scheduler.submit(num_tasks, [&](size_t task, size_t worker) {
+        runs[task]++;
+        size_t seen = max_worker.load();
+        while (worker > seen && !max_worker.compare_exchange_weak(seen, worker)) {
+        }
+    });
+    group->wait();
+    for (auto &count : runs) {
+        ASSERT_EQ(count.load(), 1);
+    }
+    ASSERT_LT(max_worker.load(), scheduler.num_workers());
+}
+
+TEST(TaskSchedulerTest, PropagatesException) {
+    // 没有工作线程时由调用线程执行全部任务，第一个异常在wait()中重新抛出，之后的任务被跳过
+    TaskScheduler scheduler(0);
+    std::atomic<int> runs{0};
+    auto group = scheduler.submit(10, [&](size_t task, size_t) {
+        runs++;
+        if (task == 3) {
+            throw InternalError("task failed");
+        }
+    });
+    ASSERT_THROW(group->wait(), InternalError);
+    ASSERT_EQ(runs.load(), 4);
+}
+
+TEST(ResultCacheTest, InvalidateAndEvict) {
+    std::unordered_map<std::string, uint64_t> versions;
+    ResultCache cache(32, [&](const std::string &tab_name) { return versions[tab_name]; });
+    ASSERT_EQ(ResultCache::normalize("  select *\n from  t where s = 'a  b' ;"), "select * from t where s = 'a  b'");
+
+    std::string reply, output;
+    cache.insert("q1", "r1", "o1", cache.snapshot({"t1", "t2"}));
+    ASSERT_TRUE(cache.lookup("q1", &reply, &output));
+    ASSERT_EQ(reply, "r1");
+    ASSERT_EQ(output, "o1");
+    // 读过的表被修改后结果失效并被删除
+    versions["t2"]++;
+    ASSERT_FALSE(cache.lookup("q1", &reply, &output));
+    ASSERT_EQ(cache.size(), 0);
+
+    // 容量只能放下几个结果，最久未使用的q2被淘汰
+    for (int i = 2; i < 12; i++) {
+        cache.insert("q" + std::to_string(i), "rr", "oo", cache.snapshot({"t1"}));
+    }
+    ASSERT_LE(cache.size(), 32);
+    ASSERT_FALSE(cache.lookup("q2", &reply, &output));
+    ASSERT_TRUE(cache.lookup("q11", &reply, &output));
+    // 超过容量的结果不缓存
+    cache.insert("big", std::string(100, 'x'), "", {});
+    ASSERT_FALSE(cache.lookup("big", &reply, &output));
+}
@@ -0,0 +1,143 @@
+import os
+import re
+import time
+import shutil
+import subprocess
+
+
+class TestArithmetic:
+    DB = "TestArithmeticDB"
+    SERVER = "./rmdb"
+    CLIENT = "./rmdb_client"
+
+    @classmethod
+    def setup_class(cls):
+        if cls.DB in os.listdir():  # 删掉残留的数据库
+            shutil.rmtree(cls.DB)
+        cls.server = subprocess.Popen([cls.SERVER, cls.DB])  # 启动服务器
+        time.sleep(3)  # 等待服务器启动完毕
+
+    @classmethod
+    def teardown_class(cls):
+        cls.server.kill()
+
+    @classmethod
+    def run_sql(cls, sqls):
+        """用一个新的客户端依次执行sqls，返回(写入output.txt的各行, 客户端收到的结果)"""
+        open(f"{cls.DB}/output.txt", "w").close()  # 清空输出，避免之前的输出影响这次的结果
+        client = subprocess.Popen([cls.CLIENT], stdin=subprocess.PIPE, stdout=subprocess.PIPE)
+        stdout, _ = client.communicate("".join(sql + "\n" for sql in sqls).encode())
+        with open(f"{cls.DB}/output.txt", "rt") as f:
+            lines = [line.strip() for line in f]
+        return lines, stdout.decode()
+
+    @classmethod
+    def select_rows(cls, sql):
+        lines, _ = cls.run_sql([sql])
+        assert lines[0] != "failure", sql
+        return sorted(tuple(cls.parse(x.strip()) for x in line.strip("|").split("|")) for line in lines[1:])
+
+    @staticmethod
+    def parse(text):
+        return float(text) if "." in text else int(text)
+
+    @classmethod
+    def metric(cls, sql, name):
+        _, stdout = cls.run_sql([sql])
+        match = re.search(rf"\|\s*{name} \|\s*(\d+) \|", stdout)
+        assert match is not None, stdout
+        return int(match.group(1))
+
+    @classmethod
+    def create_table(cls, name, rows, index=None):
+        sqls = [f"create table {name} (id int, a int, b int, f float);"]
+        if index is not None:
+            sqls.append(f"create index {name}({index});")
+        sqls += [f"insert into {name} values ({', '.join(str(x) for x in row)});" for row in rows]
+        cls.run_sql(sqls)
+
+    def test_set_expression(self):
+        self.create_table("t_set", [(1, 10, 20, 1.5), (2, 30, 40, 2.5), (3, -5, 7, -0.5)])
+        self.run_sql(["update t_set set a = a * 2 + (b - 1) / 2, f = f * 2 where id = 3;",
+                      "update t_set set a = 5 / 2, f = 5 / 2.0 where id = 1;",
+                      "update t_set set f = f + a where id = 2;"])
+        # 整数除法向零截断，和浮点数运算时提升为浮点数
+        assert self.select_rows("select * from t_set;") == [(1, 2, 20, 2.5), (2, 30, 40, 32.5), (3, -7, 7, -1.0)]
+
+    def test_where_expression(self):
+        self.create_table("t_where", [(i, i * 10, i * 3, 0.0) for i in range(10)], index="id")
+        assert self.select_rows("select id from t_where where a = b * 3 + 3;") == [(3,)]
+        assert self.select_rows("select id from t_where where a < b + 10;") == [(0,), (1,)]
+        assert self.select_rows("select id from t_where where id = (2 + 4) / 3;") == [(2,)]
+        # 常量表达式折叠成一个值，仍然可以用索引探查
+        assert self.metric("explain analyze select id from t_where where id = 7 - 2;", "tuples_scanned") == 1
+
+    def test_swap(self):
+        self.create_table("t_swap", [(1, 10, 20, 0.0), (2, 30, 40, 0.0)], index="id")
+        # 所有SET子句读的都是更新前的记录
+        self.run_sql(["update t_swap set a = b, b = a;"])
+        assert self.select_rows("select id, a, b from t_swap;") == [(1, 20, 10), (2, 40, 30)]
+        # 交换的列在索引中时索引同样要更新
+        self.run_sql(["update t_swap set id = a, a = id;"])
+        assert self.select_rows("select id, a from t_swap;") == [(20, 1), (40, 2)]
+        assert self.select_rows("select a from t_swap where id = 40;") == [(2,)]
+        assert self.select_rows("select a from t_swap where id = 2;") == []
+
+    def test_division_by_zero(self):
+        self.create_table("t_div", [(1, 10, 0, 1.5), (2, 30, 5, 2.5)])
+        for sql in ["update t_div set a = a / 0 where id = 1;", "update t_div set f = f / 0;",
+                    "update t_div set a = a / b;", "update t_div set a = 10 / (b - 5) where id = 2;",
+                    "select id from t_div where a = 1 / 0;"]:
+            lines, stdout = self.run_sql([sql])
+            assert lines == ["failure"], sql
+            assert "Division by zero" in stdout, sql
+        # 出错的UPDATE不修改任何记录
+        assert self.select_rows("select * from t_div;") == [(1, 10, 0, 1.5), (2, 30, 5, 2.5)]
+
+    def test_int_wraparound(self):
+        self.create_table("t_wrap", [(1, 2147483647, -2147483647, 0.0), (2, 65536, 0, 0.0)])
+        # 每一步运算先按64位计算再截断为int，溢出时按补码回绕
+        self.run_sql(["update t_wrap set a = a + 1, b = b - 2 where id = 1;",
+                      "update t_wrap set a = a * a where id = 2;"])
+        assert self.select_rows("select id, a, b from t_wrap;") == [(1, -2147483648, 2147483647), (2, 0, 0)]
+        # 中间结果同样回绕：-2147483648 - 1回绕为2147483647
+        self.run_sql(["update t_wrap set b = (a - 1) / 2 where id = 1;"])
+        assert self.select_rows("select b from t_wrap where id = 1;") == [(1073741823,)]
+
+    def test_in_place_and_index_update(self):
+        rows = [(i, i, i * 2, 0.0) for i in range(20)]
+        self.create_table("t_upd", rows, index="id")
+        self.run_sql(["create index t_upd(b);"])
+        # a不在任何索引中，直接在页面上修改
+        self.run_sql(["update t_upd set a = a + 100 where id < 10;"])
+        assert self.select_rows("select a from t_upd where id = 5;") == [(105,)]
+        assert self.select_rows("select a from t_upd where b = 30;") == [(15,)]
+        # b在索引中，旧的索引项要删除，新的要插入
+        self.run_sql(["update t_upd set b = b + 1 where id >= 10;"])
+        assert self.select_rows("select id from t_upd where b = 21;") == [(10,)]
+        assert self.select_rows("select id from t_upd where b = 20;") == []
+        assert self.metric("explain analyze select id from t_upd where b = 39;", "tuples_scanned") == 1
+        # 更新索引的第一列后按新值探查
+        self.run_sql(["update t_upd set id = id + 1000 where b > 32;"])
+        assert self.select_rows("select id from t_upd where id >= 1000;") == [(1016,), (1017,), (1018,), (1019,)]
+        assert self.select_rows("select id from t_upd where id = 16;") == []
+        assert self.select_rows("select id from t_upd where id = 15;") == [(15,)]
+        assert len(self.select_rows("select * from t_upd;")) == len(rows)
+
+    def test_minus_tokens(self):
+        self.create_table("t_minus", [(1, 5, -3, -1.5), (2, -7, 2, 0.5)])
+        # x-1是x - 1，而不是x和-1两个记号
+        self.run_sql(["update t_minus set a = a-1, b = b -1 where id=1;"])
+        assert self.select_rows("select id, a, b from t_minus;") == [(1, 4, -4), (2, -7, 2)]
+        assert self.select_rows("select id from t_minus where a = -7;") == [(2,)]
+        assert self.select_rows("select id from t_minus where a > -10 and a < -1;") == [(2,)]
+        assert self.select_rows("select id from t_minus where f = -1.5;") == [(1,)]
+        assert self.select_rows("select id from t_minus where b = 2 - -2-8;") == [(1,)]
+        self.run_sql(["update t_minus set a = 0 - a, f = f * -1;"])
+        assert self.select_rows("select id, a, f from t_minus;") == [(1, -4, 1.5), (2, 7, -0.5)]
+        lines, _ = self.run_sql(["select id from t_minus limit -1;"])
+        assert lines == ["failure"]
+
+    @classmethod
+    def test_fail(cls):
+        cls.server.kill()  # 在最后一个，保证测试失败后正确关闭服务器
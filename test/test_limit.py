@@ -0,0 +1,91 @@
+import os
+import re
+import time
+import shutil
+import subprocess
+
+
+class TestLimit:
+    DB = "TestLimitDB"
+    SERVER = "./rmdb"
+    CLIENT = "./rmdb_client"
+    ROWS = 200
+
+    @classmethod
+    def setup_class(cls):
+        if cls.DB in os.listdir():  # 删掉残留的数据库
+            shutil.rmtree(cls.DB)
+        cls.server = subprocess.Popen([cls.SERVER, cls.DB])  # 启动服务器
+        time.sleep(3)  # 等待服务器启动完毕
+        sqls = ["create table t (id int, v int, s char(8));", "create index t(id);"]
+        # v是id的一个排列，和id的顺序不同
+        sqls += [f"insert into t values ({i}, {i * 37 % cls.ROWS}, 's{i}');" for i in range(cls.ROWS)]
+        cls.run_sql(sqls)
+
+    @classmethod
+    def teardown_class(cls):
+        cls.server.kill()
+
+    @classmethod
+    def run_sql(cls, sqls):
+        """用一个新的客户端依次执行sqls，返回(写入output.txt的各行, 客户端收到的结果)"""
+        open(f"{cls.DB}/output.txt", "w").close()  # 清空输出，避免之前的输出影响这次的结果
+        client = subprocess.Popen([cls.CLIENT], stdin=subprocess.PIPE, stdout=subprocess.PIPE)
+        stdout, _ = client.communicate("".join(sql + "\n" for sql in sqls).encode())
+        with open(f"{cls.DB}/output.txt", "rt") as f:
+            lines = [line.strip() for line in f]
+        return lines, stdout.decode()
+
+    @classmethod
+    def select_ints(cls, sql):
+        lines, _ = cls.run_sql([sql])
+        assert lines[0] != "failure", sql
+        return [int(line.strip("|").strip()) for line in lines[1:]]
+
+    @classmethod
+    def metric(cls, sql, name):
+        _, stdout = cls.run_sql([sql])
+        match = re.search(rf"\|\s*{name} \|\s*(\d+) \|", stdout)
+        assert match is not None, stdout
+        return int(match.group(1))
+
+    def test_limit_offset(self):
+        assert self.select_ints("select id from t order by id limit 5;") == [0, 1, 2, 3, 4]
+        assert self.select_ints("select id from t order by id limit 5 offset 10;") == [10, 11, 12, 13, 14]
+        assert self.select_ints("select id from t order by id limit 10, 5;") == [10, 11, 12, 13, 14]
+        assert self.select_ints("select id from t order by id limit 0;") == []
+        assert self.select_ints(f"select id from t order by id limit 5 offset {self.ROWS - 2};") == \
+            [self.ROWS - 2, self.ROWS - 1]
+        assert len(self.select_ints("select id from t limit 1000;")) == self.ROWS
+
+    def test_negative_limit(self):
+        lines, _ = self.run_sql(["select id from t limit -1;"])
+        assert lines == ["failure"]
+
+    def test_top_n(self):
+        assert self.select_ints("select v from t order by v limit 3;") == [0, 1, 2]
+        top = self.ROWS - 1
+        assert self.select_ints("select v from t order by v desc limit 3;") == [top, top - 1, top - 2]
+        assert self.select_ints("select v from t order by v desc limit 2 offset 1;") == [top - 1, top - 2]
+        assert self.select_ints("select id from t order by id desc limit 2;") == [top, top - 1]
+
+    def test_sort_desc(self):
+        # 不带LIMIT时由SortExecutor排序，DESC以前被忽略
+        assert self.select_ints("select id from t where id < 10 order by id desc;") == list(range(9, -1, -1))
+        assert self.select_ints("select v from t order by v desc;") == list(range(self.ROWS - 1, -1, -1))
+        assert self.select_ints("select v from t order by v asc;") == list(range(self.ROWS))
+
+    def test_early_termination(self):
+        # LIMIT读够之后扫描就停止，不会读完整张表
+        full = self.metric("explain analyze select * from t;", "tuples_scanned")
+        assert full == self.ROWS
+        assert self.metric("explain analyze select * from t limit 5;", "tuples_scanned") < full
+
+    def test_order_by_limit_uses_index(self):
+        # id上有索引，ORDER BY id LIMIT改为索引扫描，只读limit + offset条；v上没有索引，需要全表排序
+        assert self.metric("explain analyze select id from t order by id limit 3;", "tuples_scanned") <= 3
+        assert self.metric("explain analyze select v from t order by v limit 3;", "tuples_scanned") == self.ROWS
+
+    @classmethod
+    def test_fail(cls):
+        cls.server.kill()  # 在最后一个，保证测试失败后正确关闭服务器
@@ -0,0 +1,145 @@
+import os
+import re
+import time
+import shutil
+import subprocess
+
+
+class TestMaterializedView:
+    DB = "TestMaterializedViewDB"
+    SERVER = "./rmdb"
+    CLIENT = "./rmdb_client"
+    ROWS = 120
+    GROUPS = 4
+    # 视图上的查询和同一个查询加上恒真的WHERE条件：后者不能改写，
+    # 在基表上分组聚合，两者的结果应该相同
+    QUERY = "select w, sum(qty), count(*) as cnt, min(amt), max(qty) from t {} group by w;"
+
+    @classmethod
+    def setup_class(cls):
+        if cls.DB in os.listdir():  # 删掉残留的数据库
+            shutil.rmtree(cls.DB)
+        cls.server = subprocess.Popen([cls.SERVER, cls.DB])  # 启动服务器
+        time.sleep(3)  # 等待服务器启动完毕
+        sqls = ["create table t (id int, w int, amt float, qty int);", "create index t(id);"]
+        sqls += [f"insert into t values ({i}, {i % cls.GROUPS}, {i * 7 % 50}.5, {i * 13 % 40});"
+                 for i in range(cls.ROWS)]
+        sqls += ["create materialized view v as select w, sum(qty), count(*) as cnt, min(amt), max(qty) "
+                 "from t group by w;"]
+        cls.run_sql(sqls)
+
+    @classmethod
+    def teardown_class(cls):
+        cls.server.kill()
+
+    @classmethod
+    def run_sql(cls, sqls):
+        """用一个新的客户端依次执行sqls，返回(写入output.txt的各行, 客户端收到的结果)"""
+        open(f"{cls.DB}/output.txt", "w").close()  # 清空输出，避免之前的输出影响这次的结果
+        client = subprocess.Popen([cls.CLIENT], stdin=subprocess.PIPE, stdout=subprocess.PIPE)
+        stdout, _ = client.communicate("".join(sql + "\n" for sql in sqls).encode())
+        with open(f"{cls.DB}/output.txt", "rt") as f:
+            lines = [line.strip() for line in f]
+        return lines, stdout.decode()
+
+    @classmethod
+    def select_rows(cls, sql):
+        lines, _ = cls.run_sql([sql])
+        assert lines[0] != "failure", sql
+        return sorted(tuple(cls.parse(x.strip()) for x in line.strip("|").split("|")) for line in lines[1:])
+
+    @staticmethod
+    def parse(text):
+        return float(text) if "." in text else int(text)
+
+    @classmethod
+    def metric(cls, sql, name):
+        _, stdout = cls.run_sql([sql])
+        match = re.search(rf"\|\s*{name} \|\s*(\d+) \|", stdout)
+        assert match is not None, stdout
+        return int(match.group(1))
+
+    @classmethod
+    def expected(cls):
+        """在基表上分组聚合的结果"""
+        return cls.select_rows(cls.QUERY.format("where id > -1"))
+
+    @classmethod
+    def check_view(cls):
+        expected = cls.expected()
+        assert cls.select_rows(cls.QUERY.format("")) == expected
+        assert cls.select_rows("select * from v;") == expected
+        return expected
+
+    def test_create(self):
+        rows = self.check_view()
+        assert [row[0] for row in rows] == list(range(self.GROUPS))
+        assert sum(row[2] for row in rows) == self.ROWS
+        # 没有别名的聚合列按聚合和列名命名
+        _, stdout = self.run_sql(["desc v;"])
+        fields = re.findall(r"^\|\s*(\w+) \|", stdout, re.M)
+        assert fields == ["Field", "w", "sum_qty", "cnt", "min_amt", "max_qty"]
+
+    def test_rewrite(self):
+        # 改写后扫描视图表，每个分组一条记录；加上WHERE条件后不能改写，扫描整个基表
+        assert self.metric("explain analyze " + self.QUERY.format(""), "tuples_scanned") == self.GROUPS
+        assert self.metric("explain analyze " + self.QUERY.format("where id > -1"), "tuples_scanned") == self.ROWS
+        # 选择列是视图列的子集、顺序不同时同样改写，列标题不变
+        sql = "select max(qty), w from t {} group by w;"
+        lines, _ = self.run_sql([sql.format("")])
+        assert lines == self.run_sql([sql.format("where id > -1")])[0]
+        assert self.metric("explain analyze " + sql.format(""), "tuples_scanned") == self.GROUPS
+        # ORDER BY分组列时同样改写，按视图表排序
+        lines, _ = self.run_sql(["select w, count(*) from t order by w desc group by w;"])
+        assert [int(line.strip("|").split("|")[0]) for line in lines[1:]] == list(range(self.GROUPS - 1, -1, -1))
+        # 视图中没有的聚合不改写
+        assert self.metric("explain analyze select w, sum(amt) from t group by w;", "tuples_scanned") == self.ROWS
+
+    def test_incremental(self):
+        before = self.check_view()
+        self.run_sql(["insert into t values (1000, 1, 0.25, 99);", "insert into t values (1001, 9, 3.5, 7);"])
+        after = self.check_view()
+        # 新的分组插入一条视图记录，分组1的MIN和MAX被新记录替换
+        assert len(after) == len(before) + 1
+        assert after[1][3] == 0.25 and after[1][4] == 99
+        # 删除分组1的MIN/MAX，重新扫描基表得到新的MIN/MAX；记录数减为0的分组被删除
+        self.run_sql(["delete from t where id = 1000;", "delete from t where id = 1001;"])
+        assert self.check_view() == before
+        # 修改分组列，记录从一个分组移到另一个分组；修改聚合列
+        self.run_sql(["update t set w = 0 where id < 10;", "update t set qty = qty + 100 where w = 2;"])
+        rows = self.check_view()
+        assert rows[2][4] >= 100
+        # 没有修改视图用到的列
+        self.run_sql(["update t set id = id + 10000 where w = 3;"])
+        assert self.check_view() == rows
+        self.run_sql(["delete from t where w = 3;"])
+        assert [row[0] for row in self.check_view()] == [0, 1, 2]
+
+    def test_abort(self):
+        before = self.check_view()
+        self.run_sql(["begin;", "insert into t values (2000, 7, 1.5, 1);", "delete from t where w = 1;",
+                      "update t set qty = 0 where w = 0;", "abort;"])
+        # 回滚时对视图做相反的修改
+        assert self.check_view() == before
+        self.run_sql(["begin;", "insert into t values (2001, 7, 1.5, 1);", "commit;"])
+        assert self.check_view() == sorted(before + [(7, 1, 1, 1.5, 1)])
+
+    def test_restrictions(self):
+        for sql in ["insert into v values (5, 1, 1, 1.0, 1);", "drop table t;", "create index v(cnt);",
+                    "create materialized view v2 as select w, sum(qty) from t where id > 3 group by w;",
+                    "create materialized view v2 as select sum(qty) from t;"]:
+            lines, _ = self.run_sql([sql])
+            assert lines == ["failure"], sql
+
+    def test_drop(self):
+        self.run_sql(["create materialized view v3 as select w, count(*) from t group by w;",
+                      "drop materialized view v3;"])
+        lines, _ = self.run_sql(["select * from v3;"])
+        assert lines == ["failure"]
+        # 删除视图后基表的修改不再维护它
+        self.run_sql(["insert into t values (3000, 1, 1.0, 1);"])
+        self.check_view()
+
+    @classmethod
+    def test_fail(cls):
+        cls.server.kill()  # 在最后一个，保证测试失败后正确关闭服务器
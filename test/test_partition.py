@@ -0,0 +1,114 @@
+import os
+import re
+import time
+import shutil
+import subprocess
+
+
+class TestPartition:
+    DB = "TestPartitionDB"
+    SERVER = "./rmdb"
+    CLIENT = "./rmdb_client"
+    ROWS = 300
+
+    @classmethod
+    def setup_class(cls):
+        if cls.DB in os.listdir():  # 删掉残留的数据库
+            shutil.rmtree(cls.DB)
+        cls.server = subprocess.Popen([cls.SERVER, cls.DB])  # 启动服务器
+        time.sleep(3)  # 等待服务器启动完毕
+        # 插入顺序打乱，id相邻的记录落在不同的页面；v在各分区中交错
+        sqls = ["create table r (id int, v int, name char(8)) partition by range (id) (partition p0 values "
+                "less than (100), partition p1 values less than (200), partition pmax values less than maxvalue);",
+                "create table h (id int, v int) partition by hash (v) partitions 4;"]
+        sqls += [f"insert into r values ({i * 37 % cls.ROWS}, {cls.v(i * 37 % cls.ROWS)}, 'r{i}');"
+                 for i in range(cls.ROWS)]
+        sqls += [f"insert into h values ({i * 3}, {i});" for i in range(cls.ROWS // 3)]
+        sqls += ["create index r(id);", "create index r(v);", "create index h(id);"]
+        cls.run_sql(sqls)
+
+    @classmethod
+    def teardown_class(cls):
+        cls.server.kill()
+
+    @staticmethod
+    def v(i):
+        return i * 11 % 300 + 1000
+
+    @classmethod
+    def run_sql(cls, sqls):
+        """用一个新的客户端依次执行sqls，返回(写入output.txt的各行, 客户端收到的结果)"""
+        open(f"{cls.DB}/output.txt", "w").close()  # 清空输出，避免之前的输出影响这次的结果
+        client = subprocess.Popen([cls.CLIENT], stdin=subprocess.PIPE, stdout=subprocess.PIPE)
+        stdout, _ = client.communicate("".join(sql + "\n" for sql in sqls).encode())
+        with open(f"{cls.DB}/output.txt", "rt") as f:
+            lines = [line.strip() for line in f]
+        return lines, stdout.decode()
+
+    @classmethod
+    def select_rows(cls, sql):
+        """按输出的顺序返回查询结果"""
+        lines, _ = cls.run_sql([sql])
+        assert lines[0] != "failure", sql
+        return [tuple(int(x.strip()) for x in line.strip("|").split("|")) for line in lines[1:]]
+
+    @classmethod
+    def metric(cls, sql, name):
+        _, stdout = cls.run_sql([sql])
+        match = re.search(rf"\|\s*{name}\S* \|\s*(\d+) \|", stdout)
+        assert match is not None, stdout
+        return int(match.group(1))
+
+    def test_order(self):
+        # 每个分区一棵B+树，各分区的扫描归并后仍按键的升序输出
+        assert self.select_rows("select id from r order by id;") == [(i,) for i in range(self.ROWS)]
+        rows = self.select_rows("select v, id from r where v > 1100 order by v;")
+        assert rows == sorted((self.v(i), i) for i in range(self.ROWS) if self.v(i) > 1100)
+        assert self.select_rows("select id from r where id >= 95 and id < 105;") == [(i,) for i in range(95, 105)]
+        assert self.select_rows("select id from h where id > 280;") == [(i,) for i in range(282, 300, 3)]
+
+    def test_prune(self):
+        # 分区列上的条件裁剪掉不需要扫描的分区
+        assert self.metric("explain analyze select * from r where id = 150;", "partitions_pr") == 2
+        assert self.metric("explain analyze select * from r where id = 150;", "tuples_scanned") == 1
+        assert self.select_rows("select id, v from r where id = 150;") == [(150, self.v(150))]
+
+    def test_min_max(self):
+        assert self.select_rows("select max(id), min(id) from r;") == [(self.ROWS - 1, 0)]
+        assert self.select_rows("select max(v), min(v) from r;") == [(1299, 1000)]
+
+    def test_unique(self):
+        # 索引不一定包含分区列，唯一性要检查所有分区
+        for sql in ["insert into r values (150, 9, 'dup');", f"insert into r values (5000, {self.v(7)}, 'dup');"]:
+            lines, _ = self.run_sql([sql])
+            assert lines == ["failure"], sql
+
+    def test_write(self):
+        self.run_sql(["delete from r where id = 150;", "update r set v = 5000 where id = 5;"])
+        assert self.select_rows("select id from r where id > 148 and id < 152;") == [(149,), (151,)]
+        assert self.select_rows("select id from r where v = 5000;") == [(5,)]
+        assert self.select_rows("select id from r where v = 1055;") == []
+        # 回滚时按记录所在的分区撤销索引的修改
+        before = self.select_rows("select id, v from r order by id;")
+        self.run_sql(["begin;", "delete from r where id = 99;", "insert into r values (400, 7000, 'x');",
+                      "update r set v = 6000 where id = 250;", "abort;"])
+        assert self.select_rows("select id, v from r order by id;") == before
+        assert self.select_rows("select id from r where v = 6000;") == []
+        self.run_sql(["insert into r values (150, 1550, 'r');"])
+        assert self.select_rows("select id from r where id = 150;") == [(150,)]
+
+    def test_join(self):
+        rows = self.select_rows("select r.id, h.v from r, h where r.id = h.id;")
+        assert sorted(rows) == [(i, i // 3) for i in range(0, self.ROWS, 3)]
+        rows = self.select_rows("select id from r where id in (select id from h where v < 10);")
+        assert sorted(rows) == [(i,) for i in range(0, 30, 3)]
+
+    def test_recreate(self):
+        self.run_sql(["drop index r(id);"])
+        assert self.select_rows("select id from r where id < 3;") == [(0,), (1,), (2,)]
+        self.run_sql(["create index r(id);"])
+        assert self.select_rows("select id from r order by id;") == [(i,) for i in range(self.ROWS)]
+
+    @classmethod
+    def test_fail(cls):
+        cls.server.kill()  # 在最后一个，保证测试失败后正确关闭服务器
@@ -0,0 +1,121 @@
+import os
+import re
+import time
+import shutil
+import subprocess
+
+
+class TestSubquery:
+    DB = "TestSubqueryDB"
+    SERVER = "./rmdb"
+    CLIENT = "./rmdb_client"
+    SMALL = 5
+    BIG = 300
+
+    @classmethod
+    def setup_class(cls):
+        if cls.DB in os.listdir():  # 删掉残留的数据库
+            shutil.rmtree(cls.DB)
+        cls.server = subprocess.Popen([cls.SERVER, cls.DB])  # 启动服务器
+        time.sleep(3)  # 等待服务器启动完毕
+        # small.id = 0, 3, 6, 9, 12；big和big_noidx的id是偶数，内容相同，只有big有索引
+        sqls = ["create table small (id int, v int);", "create table big (id int, w int);",
+                "create table big_noidx (id int, w int);", "create table empty (id int);",
+                "create index big(id);"]
+        sqls += [f"insert into small values ({i * 3}, {i});" for i in range(cls.SMALL)]
+        for table in ["big", "big_noidx"]:
+            sqls += [f"insert into {table} values ({i * 2}, {i % 7});" for i in range(cls.BIG)]
+        cls.run_sql(sqls)
+
+    @classmethod
+    def teardown_class(cls):
+        cls.server.kill()
+
+    @classmethod
+    def run_sql(cls, sqls):
+        """用一个新的客户端依次执行sqls，返回(写入output.txt的各行, 客户端收到的结果)"""
+        open(f"{cls.DB}/output.txt", "w").close()  # 清空输出，避免之前的输出影响这次的结果
+        client = subprocess.Popen([cls.CLIENT], stdin=subprocess.PIPE, stdout=subprocess.PIPE)
+        stdout, _ = client.communicate("".join(sql + "\n" for sql in sqls).encode())
+        with open(f"{cls.DB}/output.txt", "rt") as f:
+            lines = [line.strip() for line in f]
+        return lines, stdout.decode()
+
+    @classmethod
+    def select_ints(cls, sql):
+        lines, _ = cls.run_sql([sql])
+        assert lines[0] != "failure", sql
+        return sorted(int(line.strip("|").split("|")[0].strip()) for line in lines[1:])
+
+    @classmethod
+    def metric(cls, sql, name):
+        _, stdout = cls.run_sql([sql])
+        match = re.search(rf"\|\s*{name} \|\s*(\d+) \|", stdout)
+        assert match is not None, stdout
+        return int(match.group(1))
+
+    def test_in(self):
+        for big in ["big", "big_noidx"]:
+            assert self.select_ints(f"select id from small where id in (select id from {big});") == [0, 6, 12]
+            # big中w = 3的id是6, 20, 34, ...
+            assert self.select_ints(f"select id from small where id in (select id from {big} where w = 3);") == [6]
+            assert self.select_ints(f"select id from small where id in (select id from {big} where w = 1);") == []
+        assert self.select_ints("select id from big where id in (select id from small);") == [0, 6, 12]
+
+    def test_not_in(self):
+        for big in ["big", "big_noidx"]:
+            assert self.select_ints(f"select id from small where id not in (select id from {big});") == [3, 9]
+            assert self.select_ints(
+                f"select id from small where id > 3 and id not in (select id from {big} where w > 2);") == [9]
+        assert self.select_ints("select id from small where id not in (select id from empty);") == [0, 3, 6, 9, 12]
+        assert len(self.select_ints("select id from big where id not in (select id from small);")) == self.BIG - 3
+
+    def test_exists(self):
+        everything = [0, 3, 6, 9, 12]
+        assert self.select_ints("select id from small where exists (select id from big where id = 4);") == everything
+        assert self.select_ints("select id from small where exists (select id from big where id = 5);") == []
+        assert self.select_ints("select id from small where exists (select id from empty);") == []
+        assert self.select_ints("select id from small where not exists (select id from empty);") == everything
+        assert self.select_ints("select id from small where not exists (select id from big);") == []
+
+    def test_aggregate_null_not_in(self):
+        # 空表上的聚合返回NULL，x NOT IN (NULL)的结果是未知，不输出任何记录；IN同样不匹配
+        assert self.select_ints("select id from small where id not in (select max(id) from empty);") == []
+        assert self.select_ints("select id from small where id in (select max(id) from empty);") == []
+        assert self.select_ints("select id from small where id not in (select max(id) from big);") == \
+            [0, 3, 6, 9, 12]
+        assert self.select_ints("select id from small where id in (select min(id) from big);") == [0]
+
+    def test_index_probe(self):
+        # 外层只有SMALL条记录，子查询的结果列big.id有索引：逐条在索引上探查，不扫描big
+        sql = "explain analyze select id from small where id in (select id from big);"
+        assert self.metric(sql, "tuples_scanned") == self.SMALL
+        assert self.metric(sql, "tuples_produced") == 3
+        # 子查询带条件时只读出探查到的索引项对应的记录
+        sql = "explain analyze select id from small where id not in (select id from big where w > 2);"
+        assert self.metric(sql, "tuples_scanned") < self.SMALL * 2
+        # 没有索引时执行子查询构建哈希表，要扫描整个子查询表
+        sql = "explain analyze select id from small where id in (select id from big_noidx);"
+        assert self.metric(sql, "tuples_scanned") == self.SMALL + self.BIG
+        # 外层记录多，逐条探查的代价比执行一次子查询高，即使small有索引也构建哈希表
+        self.run_sql(["create index small(id);"])
+        sql = "explain analyze select id from big where id in (select id from small);"
+        assert self.metric(sql, "tuples_scanned") == self.BIG + self.SMALL
+        self.run_sql(["drop index small(id);"])
+
+    def test_update_delete(self):
+        self.run_sql(["create table t (id int, v int);"] +
+                     [f"insert into t values ({i}, 0);" for i in range(10)] +
+                     ["update t set v = 1 where id in (select id from big);",
+                      "delete from t where id not in (select id from small);"])
+        lines, _ = self.run_sql(["select * from t;"])
+        rows = sorted(tuple(int(x.strip()) for x in line.strip("|").split("|")) for line in lines[1:])
+        assert rows == [(0, 1), (3, 0), (6, 1), (9, 0)]
+
+    def test_correlated_rejected(self):
+        lines, _ = self.run_sql(["select id from small where id in (select id from big where big.w = small.v);"])
+        assert lines == ["failure"]
+
+    @classmethod
+    def test_fail(cls):
+        cls.server.kill()  # 在最后一个，保证测试失败后正确关闭服务器
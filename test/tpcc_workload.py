@@ -0,0 +1,255 @@
+"""
+TPC-C风格的负载驱动，用于PGO训练和简单的性能对比。
+启动指定的rmdb，用src/test/performance_test/table_data下的数据建表并导入，然后按TPC-C的比例
+执行new_order/payment/order_status/delivery/stock_level五类事务，最后输出吞吐量。
+
+用法: python3 tpcc_workload.py --server ./bin/rmdb [--txns 2000] [--port 8765] [--workdir /tmp/rmdb_tpcc]
+"""
+import argparse
+import csv
+import os
+import random
+import shutil
+import socket
+import subprocess
+import sys
+import time
+
+DATA_DIR = os.path.join(os.path.dirname(os.path.abspath(__file__)), "..", "src", "test", "performance_test",
+                        "table_data")
+TABLES = ["warehouse", "district", "customer", "history", "item", "stock", "orders", "new_orders", "order_line"]
+INDEXES = {
+    "warehouse": ["w_id"],
+    "district": ["d_w_id", "d_id"],
+    "customer": ["c_w_id", "c_d_id", "c_id"],
+    "item": ["i_id"],
+    "stock": ["s_w_id", "s_i_id"],
+    "orders": ["o_w_id", "o_d_id", "o_id"],
+    "new_orders": ["no_w_id", "no_d_id", "no_o_id"],
+    "order_line": ["ol_w_id", "ol_d_id", "ol_o_id", "ol_number"],
+}
+
+
+class Connection:
+    def __init__(self, port):
+        for _ in range(100):
+            try:
+                self.sock = socket.create_connection(("127.0.0.1", port))
+                return
+            except OSError:
+                time.sleep(0.1)
+        raise RuntimeError("cannot connect to rmdb on port {}".format(port))
+
+    def execute(self, sql):
+        # 每条语句以'\0'结尾，服务端的回复同样以'\0'结尾
+        self.sock.sendall(sql.encode() + b"\0")
+        reply = b""
+        while not reply.endswith(b"\0"):
+            chunk = self.sock.recv(1 << 16)
+            if not chunk:
+                raise RuntimeError("server closed the connection")
+            reply += chunk
+        reply = reply[:-1].decode(errors="replace")
+        if "failure" in reply.lower() or "error" in reply.lower():
+            raise RuntimeError("{} -> {}".format(sql, reply.strip()))
+        return reply
+
+    def close(self):
+        self.sock.sendall(b"exit;\0")
+        self.sock.close()
+
+
+def infer_type(values):
+    """根据csv中的数据推断列类型"""
+    try:
+        for v in values:
+            int(v)
+        return "int"
+    except ValueError:
+        pass
+    try:
+        for v in values:
+            float(v)
+        return "float"
+    except ValueError:
+        return "char({})".format(max(len(v) for v in values))
+
+
+def literal(value, col_type):
+    return value if col_type in ("int", "float") else "'{}'".format(value)
+
+
+def load(conn):
+    """建表、建索引并导入初始数据，返回各表的(列名, 列类型, 数据)"""
+    schema = {}
+    for table in TABLES:
+        with open(os.path.join(DATA_DIR, table + ".csv")) as f:
+            rows = list(csv.reader(f))
+        header, rows = rows[0], rows[1:]
+        types = [infer_type([row[i] for row in rows]) for i in range(len(header))]
+        conn.execute("create table {} ({});".format(
+            table, ", ".join("{} {}".format(col, t) for col, t in zip(header, types))))
+        if table in INDEXES:
+            conn.execute("create index {}({});".format(table, ", ".join(INDEXES[table])))
+        for row in rows:
+            conn.execute("insert into {} values ({});".format(
+                table, ", ".join(literal(v, t) for v, t in zip(row, types))))
+        schema[table] = (header, types, rows)
+    return schema
+
+
+class Workload:
+    def __init__(self, conn, schema, seed):
+        self.conn = conn
+        self.rand = random.Random(seed)
+        self.warehouses = [int(row[0]) for row in schema["warehouse"][2]]
+        self.districts = [(int(row[1]), int(row[0])) for row in schema["district"][2]]  # (w_id, d_id)
+        self.customers = {}
+        for row in schema["customer"][2]:
+            self.customers.setdefault((int(row[2]), int(row[1])), []).append(int(row[0]))
+        self.items = [int(row[0]) for row in schema["item"][2]]
+        # 下一个订单号以及尚未配送的订单，由驱动在客户端维护
+        self.next_o_id = {(int(row[1]), int(row[0])): int(row[10]) for row in schema["district"][2]}
+        self.undelivered = {key: [] for key in self.next_o_id}
+        for row in schema["new_orders"][2]:
+            self.undelivered[(int(row[2]), int(row[1]))].append(int(row[0]))
+
+    def now(self):
+        return time.strftime("%Y-%m-%d %H:%M:%S")
+
+    def new_order(self):
+        w_id, d_id = self.rand.choice(self.districts)
+        c_id = self.rand.choice(self.customers[(w_id, d_id)])
+        o_id = self.next_o_id[(w_id, d_id)]
+        self.next_o_id[(w_id, d_id)] += 1
+        ol_cnt = self.rand.randint(5, 15)
+        sql = ["begin;",
+               "select c_discount, c_last, c_credit from customer where c_w_id = {} and c_d_id = {} and c_id = {};"
+               .format(w_id, d_id, c_id),
+               "select w_tax from warehouse where w_id = {};".format(w_id),
+               "select d_next_o_id, d_tax from district where d_w_id = {} and d_id = {};".format(w_id, d_id),
+               "update district set d_next_o_id = {} where d_w_id = {} and d_id = {};".format(o_id + 1, w_id, d_id),
+               "insert into orders values ({}, {}, {}, {}, '{}', 0, {}, 1);".format(o_id, d_id, w_id, c_id, self.now(),
+                                                                                    ol_cnt),
+               "insert into new_orders values ({}, {}, {});".format(o_id, d_id, w_id)]
+        for number in range(1, ol_cnt + 1):
+            i_id = self.rand.choice(self.items)
+            quantity = self.rand.randint(1, 10)
+            sql += ["select i_price, i_name, i_data from item where i_id = {};".format(i_id),
+                    "select s_quantity, s_data, s_dist_01 from stock where s_w_id = {} and s_i_id = {};"
+                    .format(w_id, i_id),
+                    "update stock set s_quantity = {} where s_w_id = {} and s_i_id = {};"
+                    .format(self.rand.randint(10, 100), w_id, i_id),
+                    "insert into order_line values ({}, {}, {}, {}, {}, {}, '{}', {}, {}, '{}');".format(
+                        o_id, d_id, w_id, number, i_id, w_id, self.now(), quantity, quantity * 1.5,
+                        "%024x" % self.rand.getrandbits(96))]
+        sql.append("commit;")
+        self.undelivered[(w_id, d_id)].append(o_id)
+        return sql
+
+    def payment(self):
+        w_id, d_id = self.rand.choice(self.districts)
+        c_id = self.rand.choice(self.customers[(w_id, d_id)])
+        amount = round(self.rand.uniform(1, 5000), 2)
+        return ["begin;",
+                "update warehouse set w_ytd = {} where w_id = {};".format(amount, w_id),
+                "select w_name, w_street_1, w_city from warehouse where w_id = {};".format(w_id),
+                "update district set d_ytd = {} where d_w_id = {} and d_id = {};".format(amount, w_id, d_id),
+                "select d_name, d_street_1, d_city from district where d_w_id = {} and d_id = {};".format(w_id, d_id),
+                "select c_first, c_last, c_balance from customer where c_w_id = {} and c_d_id = {} and c_id = {};"
+                .format(w_id, d_id, c_id),
+                "update customer set c_balance = {} where c_w_id = {} and c_d_id = {} and c_id = {};"
+                .format(-amount, w_id, d_id, c_id),
+                "insert into history values ({}, {}, {}, {}, {}, '{}', {}, '{}');".format(
+                    c_id, d_id, w_id, d_id, w_id, self.now(), amount, "%024x" % self.rand.getrandbits(96)),
+                "commit;"]
+
+    def order_status(self):
+        w_id, d_id = self.rand.choice(self.districts)
+        c_id = self.rand.choice(self.customers[(w_id, d_id)])
+        return ["select c_balance, c_first, c_last from customer where c_w_id = {} and c_d_id = {} and c_id = {};"
+                .format(w_id, d_id, c_id),
+                "select max(o_id) as max_o_id from orders where o_w_id = {} and o_d_id = {} and o_c_id = {};"
+                .format(w_id, d_id, c_id),
+                "select o_id, o_entry_d, o_carrier_id from orders where o_w_id = {} and o_d_id = {} and o_c_id = {} "
+                "order by o_id;".format(w_id, d_id, c_id),
+                "select ol_i_id, ol_supply_w_id, ol_quantity, ol_amount from order_line "
+                "where ol_w_id = {} and ol_d_id = {} and ol_o_id = {};".format(w_id, d_id,
+                                                                             self.next_o_id[(w_id, d_id)] - 1)]
+
+    def delivery(self):
+        w_id = self.rand.choice(self.warehouses)
+        sql = ["begin;"]
+        for d_w_id, d_id in self.districts:
+            if d_w_id != w_id or not self.undelivered[(w_id, d_id)]:
+                continue
+            o_id = self.undelivered[(w_id, d_id)].pop(0)
+            sql += ["select min(no_o_id) as min_o_id from new_orders where no_w_id = {} and no_d_id = {};"
+                    .format(w_id, d_id),
+                    "delete from new_orders where no_w_id = {} and no_d_id = {} and no_o_id = {};"
+                    .format(w_id, d_id, o_id),
+                    "update orders set o_carrier_id = {} where o_w_id = {} and o_d_id = {} and o_id = {};"
+                    .format(self.rand.randint(1, 10), w_id, d_id, o_id),
+                    "select sum(ol_amount) as total from order_line where ol_w_id = {} and ol_d_id = {} "
+                    "and ol_o_id = {};".format(w_id, d_id, o_id)]
+        sql.append("commit;")
+        return sql
+
+    def stock_level(self):
+        w_id, d_id = self.rand.choice(self.districts)
+        o_id = self.next_o_id[(w_id, d_id)]
+        return ["select count(*) as low_stock from order_line, stock where ol_w_id = {} and ol_d_id = {} "
+                "and ol_o_id < {} and ol_o_id >= {} and s_w_id = {} and s_i_id = ol_i_id and s_quantity < {};"
+                .format(w_id, d_id, o_id, o_id - 20, w_id, self.rand.randint(10, 20))]
+
+    def next_transaction(self):
+        # 与TPC-C标准的事务比例一致
+        r = self.rand.randint(1, 100)
+        if r <= 45:
+            return "new_order", self.new_order()
+        if r <= 88:
+            return "payment", self.payment()
+        if r <= 92:
+            return "order_status", self.order_status()
+        if r <= 96:
+            return "delivery", self.delivery()
+        return "stock_level", self.stock_level()
+
+
+def main():
+    parser = argparse.ArgumentParser(description=__doc__, formatter_class=argparse.RawDescriptionHelpFormatter)
+    parser.add_argument("--server", required=True, help="rmdb可执行文件")
+    parser.add_argument("--txns", type=int, default=2000, help="执行的事务数")
+    parser.add_argument("--port", type=int, default=8765)
+    parser.add_argument("--workdir", default="/tmp/rmdb_tpcc", help="数据库所在的工作目录，每次运行前清空")
+    parser.add_argument("--seed", type=int, default=0)
+    args = parser.parse_args()
+
+    shutil.rmtree(args.workdir, ignore_errors=True)
+    os.makedirs(args.workdir)
+    server = subprocess.Popen([os.path.abspath(args.server), "--port", str(args.port), "tpcc"], cwd=args.workdir,
+                              stdout=subprocess.DEVNULL)
+    try:
+        conn = Connection(args.port)
+        schema = load(conn)
+        workload = Workload(conn, schema, args.seed)
+        counts = {}
+        start = time.time()
+        for _ in range(args.txns):
+            name, sql = workload.next_transaction()
+            for stmt in sql:
+                conn.execute(stmt)
+            counts[name] = counts.get(name, 0) + 1
+        elapsed = time.time() - start
+        conn.close()
+    finally:
+        # 正常退出以便插桩版本写出profile
+        server.send_signal(2)
+        server.wait()
+    print("txns: {}  elapsed: {:.2f}s  tps: {:.1f}".format(args.txns, elapsed, args.txns / elapsed))
+    print("  ".join("{}={}".format(name, count) for name, count in sorted(counts.items())))
+    return 0
+
+
+if __name__ == "__main__":
+    sys.exit(main())